@@ -0,0 +1,219 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Deterministic benchmark corpus
+ *
+ * Generates documents of a given shape and approximate size from a fixed
+ * seed, so every run of a benchmark sees byte-for-byte the same input.
+ * Every shape is made of `record` elements with an `id` attribute and
+ * `item` children with a `type` attribute and text, so the same queries
+ * apply to all of them.
+ *
+ *   wide       - many shallow records under the root
+ *   deep       - records nested 32 levels deep inside wrapper elements
+ *   namespace  - records mixing a default namespace and several prefixes
+ *   attribute  - elements carrying a dozen attributes each
+ *   whitespace - indented output with a whitespace text node around
+ *                every element
+ *
+ * Large documents can be written straight to a file:
+ *
+ * usage: node bench/corpus.js --shape wide --size 1g --out wide-1g.xml
+ */
+
+var fs = require('fs');
+
+var SHAPES = ['wide', 'deep', 'namespace', 'attribute', 'whitespace'];
+
+var NAMESPACES = [
+  'urn:xml-selector:bench:a',
+  'urn:xml-selector:bench:b',
+  'urn:xml-selector:bench:c'
+];
+
+var WORDS = ('lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod ' +
+  'tempor incididunt ut labore et dolore magna aliqua enim ad minim veniam').split(' ');
+
+var DEPTH = 32;
+
+/**
+ * Seeded pseudo-random number generator (mulberry32) returning numbers in
+ * [0, 1)
+ */
+function random(seed) {
+  var state = seed >>> 0;
+  return function() {
+    state = (state + 0x6D2B79F5) >>> 0;
+    var t = state;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+/**
+ * Return `count` words of filler text
+ */
+function words(rand, count) {
+  var out = [];
+  for (var i = 0; i < count; i++)
+    out.push(WORDS[Math.floor(rand() * WORDS.length)]);
+  return out.join(' ');
+}
+
+/**
+ * Record generators for each shape. Each returns the XML for record `i`.
+ */
+var records = {
+  
+  wide: function(i, rand) {
+    return '<record id="' + i + '"><item type="' + (i % 3 ? 'a' : 'b') + '">' +
+      words(rand, 4) + '</item><item type="c">' + i + '</item></record>';
+  },
+  
+  deep: function(i, rand) {
+    var open = '', close = '';
+    for (var d = 0; d < DEPTH; d++) {
+      open += '<level depth="' + d + '">';
+      close = '</level>' + close;
+    }
+    return open + '<record id="' + i + '"><item type="' + (i % 3 ? 'a' : 'b') + '">' +
+      words(rand, 4) + '</item></record>' + close;
+  },
+  
+  namespace: function(i, rand) {
+    var ns = i % NAMESPACES.length;
+    return '<record id="' + i + '" xmlns:r="' + NAMESPACES[ns] + '">' +
+      '<n0:item type="' + (i % 3 ? 'a' : 'b') + '">' + words(rand, 3) + '</n0:item>' +
+      '<n1:meta n2:flag="' + (i % 2) + '"/>' +
+      '<r:item type="c">' + i + '</r:item>' +
+      '<item type="d">' + words(rand, 2) + '</item></record>';
+  },
+  
+  attribute: function(i, rand) {
+    var attrs = '';
+    for (var a = 0; a < 12; a++)
+      attrs += ' a' + a + '="' + WORDS[Math.floor(rand() * WORDS.length)] + '"';
+    return '<record id="' + i + '"' + attrs + '><item type="' + (i % 3 ? 'a' : 'b') + '"' + attrs + '>' +
+      words(rand, 2) + '</item></record>';
+  },
+  
+  whitespace: function(i, rand) {
+    return '\n  <record id="' + i + '">\n    <item type="' + (i % 3 ? 'a' : 'b') + '">\n      ' +
+      words(rand, 4) + '\n    </item>\n\n    <item type="c">\n      ' + i + '\n    </item>\n  </record>\n';
+  }
+  
+};
+
+/**
+ * Return the opening and closing text of a document of the given shape
+ */
+function envelope(shape) {
+  if ('namespace' === shape) {
+    var decls = ' xmlns="urn:xml-selector:bench"';
+    for (var n = 0; n < NAMESPACES.length; n++)
+      decls += ' xmlns:n' + n + '="' + NAMESPACES[n] + '"';
+    return ['<?xml version="1.0"?>\n<records' + decls + '>', '</records>\n'];
+  }
+  
+  return ['<?xml version="1.0"?>\n<records>', '</records>\n'];
+}
+
+/**
+ * Generate a document of about `size` bytes (never less than one record),
+ * passing it to `write` in pieces of roughly `chunkSize` bytes. Returns
+ * the number of records written.
+ */
+function generate(shape, size, write, options) {
+  options = options || {};
+  
+  if (!records[shape])
+    throw new Error('unknown shape: ' + shape);
+  
+  var rand = random(options.seed || 1)
+    , chunkSize = options.chunkSize || 1 << 20
+    , parts = envelope(shape)
+    , total = Buffer.byteLength(parts[0]) + Buffer.byteLength(parts[1])
+    , chunk = [parts[0]]
+    , chunkBytes = 0
+    , count = 0
+  ;
+  
+  do {
+    var rec = records[shape](count++, rand);
+    chunk.push(rec);
+    chunkBytes += rec.length;
+    total += rec.length;
+    
+    if (chunkBytes >= chunkSize) {
+      write(chunk.join(''));
+      chunk = [];
+      chunkBytes = 0;
+    }
+  } while (total < size);
+  
+  chunk.push(parts[1]);
+  write(chunk.join(''));
+  
+  return count;
+}
+
+/**
+ * Return a document of about `size` bytes as a string
+ */
+function build(shape, size, options) {
+  var parts = [];
+  generate(shape, size, function(s) { parts.push(s); }, options);
+  return parts.join('');
+}
+
+/**
+ * Parse a size such as 1024, 64k, 16m or 1g
+ */
+function parseSize(str) {
+  var m = /^(\d+(?:\.\d+)?)([kmg]?)b?$/i.exec(String(str).trim());
+  if (!m)
+    throw new Error('invalid size: ' + str);
+  
+  var scale = { '': 1, k: 1024, m: 1024 * 1024, g: 1024 * 1024 * 1024 }[m[2].toLowerCase()];
+  return Math.round(Number(m[1]) * scale);
+}
+
+module.exports.SHAPES = SHAPES;
+module.exports.NAMESPACES = NAMESPACES;
+module.exports.generate = generate;
+module.exports.build = build;
+module.exports.parseSize = parseSize;
+
+if (require.main === module) {
+  var args = {};
+  for (var i = 2; i < process.argv.length - 1; i++)
+    if (/^--/.test(process.argv[i]))
+      args[process.argv[i].slice(2)] = process.argv[++i];
+  
+  if (!args.shape || !args.size || !args.out) {
+    console.error('usage: node bench/corpus.js --shape <' + SHAPES.join('|') + '> --size <bytes|k|m|g> --out <file> [--seed N]');
+    process.exit(1);
+  }
+  
+  var fd = fs.openSync(args.out, 'w');
+  var count = generate(args.shape, parseSize(args.size), function(s) { fs.writeSync(fd, s); },
+    { seed: Number(args.seed) || 1 });
+  fs.closeSync(fd);
+  
+  console.log(JSON.stringify({ shape: args.shape, bytes: fs.statSync(args.out).size, records: count }));
+}
@@ -0,0 +1,262 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Benchmark suite
+ *
+ * Runs parsing, each selector operation, wrapper creation and
+ * serialization against the deterministic corpus in bench/corpus.js and
+ * reports the results as JSON, for comparison against a baseline. Each
+ * benchmark repeats for at least --time ms after a warm up run. Garbage
+ * collection time is included where perf_hooks reports it; run node with
+ * --expose-gc to also collect garbage between benchmarks.
+ *
+ * usage: node bench/suite.js [--shapes wide,deep] [--sizes 1k,64k,1m]
+ *                            [--time ms] [--filter regexp] [--seed N]
+ *                            [--out results.json]
+ */
+
+var fs = require('fs')
+  , path = require('path')
+  , corpus = require('./corpus')
+  , $$ = require(path.join(__dirname, '..', 'index'))
+;
+
+// V8 can't hold larger documents in a single string
+var MAX_DOCUMENT = (function() {
+  try {
+    return require('buffer').constants.MAX_STRING_LENGTH;
+  } catch (e) {
+    return (1 << 28) - 16;
+  }
+})();
+
+/**
+ * Parse command line options of the form --name value
+ */
+function options(argv, defaults) {
+  var opts = {};
+  for (var k in defaults) opts[k] = defaults[k];
+  for (var i = 0; i < argv.length - 1; i++)
+    if (/^--/.test(argv[i]) && argv[i].slice(2) in opts)
+      opts[argv[i].slice(2)] = argv[++i];
+  return opts;
+}
+
+/**
+ * Track time spent in garbage collection, where node reports it
+ */
+var gcTotal = 0, gcTracked = false;
+try {
+  var perf = require('perf_hooks');
+  new perf.PerformanceObserver(function(list) {
+    list.getEntries().forEach(function(entry) { gcTotal += entry.duration; });
+  }).observe({ entryTypes: ['gc'] });
+  gcTracked = true;
+} catch (e) {
+}
+
+/**
+ * Return the time in nanoseconds since `start`, a process.hrtime() value
+ */
+function elapsed(start) {
+  var diff = process.hrtime(start);
+  return diff[0] * 1e9 + diff[1];
+}
+
+/**
+ * The benchmarks run against each document. Each one is given the parsed
+ * document and a few prepared selections, and returns a function to time.
+ * `bytes` benchmarks also report throughput in MB/s.
+ */
+var benchmarks = [
+  { name: 'parse', bytes: true, run: function(c) { return function() { return $$.parseFromString(c.xml); }; } },
+  { name: 'wrap document', run: function(c) { return function() { return $$(c.doc); }; } },
+  
+  { name: 'xQ_find record', run: function(c) { return function() { return c.$doc.search('record'); }; } },
+  { name: 'xQ_find item[type="b"]', run: function(c) { return function() { return c.$doc.search('item[type="b"]'); }; } },
+  { name: 'xQ_find record > item', run: function(c) { return function() { return c.$doc.search('record > item'); }; } },
+  { name: 'xQ_find record item + item', run: function(c) { return function() { return c.$doc.search('record item + item'); }; } },
+  { name: 'xQ_find n0:item', shapes: ['namespace'], run: function(c) {
+    return function() { return c.$ns.search('n0:item'); };
+  } },
+  { name: 'xQ_extract 3 fields', run: function(c) {
+    return function() { return c.$doc.extract({r: 'record', b: {selector: 'item[type="b"]', as: 'texts'}, m: 'meta'}); };
+  } },
+  { name: 'xQ_find 3 fields', run: function(c) {
+    return function() { return [c.$doc.search('record').text(), c.$doc.search('item[type="b"]').texts(), c.$doc.search('meta').text()]; };
+  } },
+  { name: 'xQ_filter', run: function(c) { return function() { return c.$items.filter('[type="a"]'); }; } },
+  { name: 'xQ_not', run: function(c) { return function() { return c.$items.not('[type="a"]'); }; } },
+  { name: 'xQ_children', run: function(c) { return function() { return c.$records.children(); }; } },
+  { name: 'xQ_parent', run: function(c) { return function() { return c.$items.parent(); }; } },
+  { name: 'xQ_parents', run: function(c) { return function() { return c.$items.parents('record'); }; } },
+  { name: 'xQ_parentsUntil', run: function(c) { return function() { return c.$items.parentsUntil('records'); }; } },
+  { name: 'xQ_closest', run: function(c) { return function() { return c.$items.closest('record'); }; } },
+  { name: 'xQ_next', run: function(c) { return function() { return c.$items.next(); }; } },
+  { name: 'xQ_nextAll', run: function(c) { return function() { return c.$items.nextAll(); }; } },
+  { name: 'xQ_nextUntil', run: function(c) { return function() { return c.$items.nextUntil('meta'); }; } },
+  { name: 'xQ_prev', run: function(c) { return function() { return c.$items.prev(); }; } },
+  { name: 'xQ_prevAll', run: function(c) { return function() { return c.$items.prevAll(); }; } },
+  { name: 'xQ_prevUntil', run: function(c) { return function() { return c.$items.prevUntil('meta'); }; } },
+  { name: 'xQ_first', run: function(c) { return function() { return c.$items.first(); }; } },
+  { name: 'xQ_last', run: function(c) { return function() { return c.$items.last(); }; } },
+  
+  { name: 'wrap toArray', run: function(c) { return function() { return c.$doc.search('item').toArray(); }; } },
+  { name: 'wrap index', run: function(c) {
+    return function() {
+      var $q = c.$doc.search('item'), n;
+      for (var i = 0; i < $q.length; i++) n = $q[i];
+      return n;
+    };
+  } },
+  { name: 'wrap nodes', run: function(c) { return function() { return $$(c.items); }; } },
+  
+  { name: 'text', run: function(c) { return function() { return c.$items.text(); }; } },
+  { name: 'texts', run: function(c) { return function() { return c.$items.texts(); }; } },
+  { name: 'xml document', bytes: true, run: function(c) { return function() { return c.$doc.xml(); }; } },
+  { name: 'xml record', run: function(c) { return function() { return c.$records.xml(); }; } },
+  { name: 'xmlAll records', run: function(c) { return function() { return c.$records.xmlAll(); }; } }
+];
+
+/**
+ * Time fn for at least minTime ms
+ */
+function measure(fn, minTime) {
+  var result = fn(), iterations = 0, total = 0;
+  var deadline = minTime * 1e6;
+  
+  while (total < deadline || !iterations) {
+    var start = process.hrtime();
+    result = fn();
+    total += elapsed(start);
+    ++iterations;
+  }
+  
+  return { iterations: iterations, totalNs: total, result: result };
+}
+
+/**
+ * Run the benchmarks in order, yielding to the event loop between them so
+ * garbage collection reports arrive in time
+ */
+function runAll(cases, opts, done) {
+  var results = [], skipped = [], filter = opts.filter ? new RegExp(opts.filter) : null;
+  var context = null;
+  
+  (function next(caseIdx, benchIdx) {
+    if (caseIdx >= cases.length)
+      return done(results, skipped);
+    
+    var c = cases[caseIdx];
+    
+    if (benchIdx === 0) {
+      if (c.bytes > MAX_DOCUMENT) {
+        skipped.push({ shape: c.shape, size: c.size, reason: 'larger than the maximum string length' });
+        return setImmediate(next, caseIdx + 1, 0);
+      }
+      
+      context = { xml: corpus.build(c.shape, c.bytes, { seed: opts.seed }) };
+      context.doc = $$.parseFromString(context.xml);
+      context.$doc = $$(context.doc);
+      context.$records = context.$doc.search('record');
+      context.$items = context.$doc.search('item');
+      context.items = context.$items.toArray();
+      context.$ns = $$(context.doc);
+      corpus.NAMESPACES.forEach(function(uri, n) { context.$ns.addNamespace('n' + n, uri); });
+    }
+    
+    if (benchIdx >= benchmarks.length) {
+      context = null;
+      return setImmediate(next, caseIdx + 1, 0);
+    }
+    
+    var bench = benchmarks[benchIdx];
+    if ( (bench.shapes && bench.shapes.indexOf(c.shape) === -1) || (filter && !filter.test(bench.name)) )
+      return next(caseIdx, benchIdx + 1);
+    
+    if (global.gc)
+      global.gc();
+    
+    var gcStart = gcTotal, heapStart = process.memoryUsage().heapUsed;
+    var m = measure(bench.run(context), opts.time);
+    var heapDelta = process.memoryUsage().heapUsed - heapStart;
+    var count = m.result && 'number' === typeof m.result.length ? m.result.length : undefined;
+    
+    setImmediate(function() {
+      var r = {
+        shape: c.shape,
+        size: c.size,
+        bytes: Buffer.byteLength(context.xml),
+        records: context.$records.length,
+        name: bench.name,
+        iterations: m.iterations,
+        totalMs: m.totalNs / 1e6,
+        nsPerOp: m.totalNs / m.iterations,
+        opsPerSecond: m.iterations * 1e9 / m.totalNs,
+        resultLength: count,
+        gcMs: gcTracked ? gcTotal - gcStart : null,
+        heapDeltaBytes: heapDelta
+      };
+      
+      if (bench.bytes)
+        r.mbPerSecond = (r.bytes / (1024 * 1024)) / (r.nsPerOp / 1e9);
+      
+      results.push(r);
+      next(caseIdx, benchIdx + 1);
+    });
+  })(0, 0);
+}
+
+var opts = options(process.argv.slice(2), {
+  shapes: corpus.SHAPES.join(','),
+  sizes: '1k,64k,1m,16m',
+  time: 500,
+  filter: '',
+  seed: 1,
+  out: ''
+});
+opts.time = Number(opts.time);
+opts.seed = Number(opts.seed);
+
+var cases = [];
+opts.shapes.split(',').forEach(function(shape) {
+  opts.sizes.split(',').forEach(function(size) {
+    cases.push({ shape: shape, size: size, bytes: corpus.parseSize(size) });
+  });
+});
+
+runAll(cases, opts, function(results, skipped) {
+  var report = JSON.stringify({
+    benchmark: 'suite',
+    node: process.version,
+    v8: process.versions.v8,
+    platform: process.platform,
+    arch: process.arch,
+    cpus: require('os').cpus().length,
+    seed: opts.seed,
+    minTimeMs: opts.time,
+    gcTracked: gcTracked,
+    gcForced: !!global.gc,
+    results: results,
+    skipped: skipped
+  }, null, 2);
+  
+  if (opts.out)
+    fs.writeFileSync(opts.out, report + '\n');
+  else
+    console.log(report);
+});
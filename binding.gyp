@@ -22,10 +22,14 @@
         "deps/libxq"
       ],
       "sources": [
+        "ext/AsyncQuery.cpp",
         "ext/CharacterData.cpp",
         "ext/Document.cpp",
         "ext/Element.cpp",
+        "ext/ExternalString.cpp",
+        "ext/InstanceData.cpp",
         "ext/Node.cpp",
+        "ext/XmlStream.cpp",
         "ext/xQWrapper.cpp",
         "ext/xqjs.cpp"
       ],
@@ -31,10 +31,20 @@
         "nodelist.c",
         "xq.c",
         "search.c",
-        "traverse.c"
+        "traverse.c",
+        "parallel.c",
+        "signature.c",
+        "planner.c"
       ],
       "dependencies": [
         "../libxml2.gyp:xml2"
+      ],
+      "conditions": [
+        ["OS!='win'", {
+          "link_settings": {
+            "libraries": [ "-lpthread" ]
+          }
+        }]
       ]
     }
   ]
@@ -37,30 +37,106 @@ typedef enum {
   XQ_INVALID_SEL_UNTERMINATED_STR,
   XQ_INVALID_SEL_UNEXPECTED_TOKEN,
   XQ_NO_MATCH, // this is an internal status code
-  XQ_UNKNOWN_NS_PREFIX
+  XQ_UNKNOWN_NS_PREFIX,
+  XQ_CANCELLED,
+  XQ_OUTPUT_ERROR
 } xQStatusCode;
 
 typedef struct _xQNodeList {
   xmlNodePtr* list;
   unsigned long capacity;
   unsigned long size;
+  int countOnly; // when set, the list counts the nodes pushed to it without storing them
 } xQNodeList;
 
 xQStatusCode xQNodeList_alloc_init(xQNodeList** list, unsigned long size);
 xQStatusCode xQNodeList_init(xQNodeList* list, unsigned long size);
+xQStatusCode xQNodeList_initCounter(xQNodeList* list);
 xQStatusCode xQNodeList_free(xQNodeList* list, int freeList);
 xQStatusCode xQNodeList_insert(xQNodeList* list, xmlNodePtr node, unsigned long atIdx);
 xQStatusCode xQNodeList_remove(xQNodeList* list, unsigned long fromIdx, unsigned long count);
 xQStatusCode xQNodeList_assign(xQNodeList* toList, xQNodeList* fromList);
+xQStatusCode xQNodeList_reserve(xQNodeList* list, unsigned long capacity);
 #define xQNodeList_push(list, node) (xQNodeList_insert(list, node, (list)->size))
 #define xQNodeList_clear(list) ((list)->size = 0)
 
 
 
+#define XQ_STATS_MAX_STEPS 16
+#define XQ_STATS_PLAN_SIZE 256
+
+typedef struct _xQStepStats {
+  const char* operation;  // name of the traversal or filter the step runs
+  unsigned long calls;    // nodes the step was applied to
+  unsigned long visited;  // nodes the step examined
+  unsigned long produced; // nodes the step passed on
+  const void* expr;       // the compiled step, while the query runs
+} xQStepStats;
+
+typedef struct _xQStats {
+  char plan[XQ_STATS_PLAN_SIZE]; // the compiled selector, one step after another
+  unsigned int steps;
+  xQStepStats step[XQ_STATS_MAX_STEPS];
+  unsigned long contextSize;
+  unsigned long resultSize;
+  unsigned long allocations;     // allocations made by libxq for the query
+  unsigned long bytesAllocated;
+  unsigned long signatureBytes;  // memory held by the subtree signatures the query used
+  unsigned long docStatsBytes;   // memory held by the document statistics the query was planned with
+  double compileNs;
+  double evalNs;
+  double startNs;
+} xQStats;
+
+// a Bloom filter of element names, one or two bits set for each name
+typedef unsigned long long xQSignature;
+
+#define XQ_PARALLEL_DEFAULT_THRESHOLD 1024
+
+#define XQ_SIGNATURES_MIN_DESCENDANTS 8
+#define XQ_SIGNATURES_DEFAULT_MAX_BYTES (4 * 1024 * 1024)
+
+typedef struct _xQSignatures {
+  xmlDocPtr document;
+  struct _xQSignatureEntry* table; // signatures of the larger subtrees, keyed by element
+  unsigned long capacity;          // slots in the table, zero or a power of two
+  unsigned long size;              // elements holding a signature
+  unsigned long minDescendants;    // elements below smaller subtrees hold no signature
+  unsigned long maxBytes;          // the most memory the table may use
+  unsigned long bytes;             // memory used by the table
+  int built;
+} xQSignatures;
+
+// elements deeper than this are counted together in the depth histogram
+#define XQ_DOCSTATS_DEPTHS 32
+
+typedef struct _xQDocStats {
+  xmlDocPtr document;
+  unsigned long elements;
+  unsigned long depths[XQ_DOCSTATS_DEPTHS]; // elements at each depth, the root element being at 1
+  xmlHashTablePtr names;      // element name to the elements with that name, in document order
+  xmlHashTablePtr attributes; // attribute name to the number of times and values it's given
+  xmlHashTablePtr values;     // attribute name and value to the elements holding it, in document order
+  int valuesComplete;         // 0 when a DTD may add attribute values the index doesn't hold
+  unsigned long bytes;        // memory used by the statistics
+  int built;
+} xQDocStats;
+
 typedef struct _xQ {
   xmlDocPtr document;
   xQNodeList context;
   xmlHashTablePtr nsPrefixes;
+  volatile int* cancelled; // when set and non-zero, searches stop with XQ_CANCELLED
+  xQStats* stats; // when set, searches record their statistics here
+  unsigned long limit;    // when non-zero, searches stop after this many results
+  unsigned int maxDepth;  // when non-zero, searches look no deeper below each context node
+  xQSignatures* signatures; // when set and built, searches skip subtrees without the names they need
+  xQDocStats* docStats;   // when set and built, searches are planned with the statistics of the document
+  xQNodeList* limitList;  // internal: the result list the limit applies to
+  unsigned int depthLimit; // internal: the deepest node the current search may visit
+  xQSignature subtreeNames; // internal: the names a subtree must hold for the current step to search it
+  unsigned int threads;   // when greater than 1, searches may be split across this many threads
+  unsigned long threshold; // the nodes in the context, or below a context node, before a search is split
 } xQ;
 
 xQStatusCode xQ_alloc_init(xQ** self);
@@ -68,11 +144,18 @@ xQStatusCode xQ_alloc_initDoc(xQ** self, xmlDocPtr doc);
 xQStatusCode xQ_alloc_initFile(xQ** self, const char* filename, xmlDocPtr* doc);
 xQStatusCode xQ_alloc_initMemory(xQ** self, const char* buffer, int size, xmlDocPtr* doc);
 xQStatusCode xQ_alloc_initNodeList(xQ** self, xQNodeList* list);
+xQStatusCode xQ_alloc_initCopy(xQ** self, xQ* other);
 xQStatusCode xQ_init(xQ* self);
 xQStatusCode xQ_free(xQ* self, int freeXQ);
 xQStatusCode xQ_children(xQ* self, const xmlChar* selector, xQ** result);
 xQStatusCode xQ_closest(xQ* self, const xmlChar* selector, xQ** result);
 xQStatusCode xQ_find(xQ* self, const xmlChar* selector, xQ** result);
+xQStatusCode xQ_findLimited(xQ* self, const xmlChar* selector, unsigned long limit, unsigned int maxDepth, xQ** result);
+xQStatusCode xQ_exists(xQ* self, const xmlChar* selector, int* found);
+xQStatusCode xQ_is(xQ* self, const xmlChar* selector, int* found);
+xQStatusCode xQ_count(xQ* self, const xmlChar* selector, unsigned long* count);
+xQStatusCode xQ_extract(xQ* self, const xmlChar** selectors, unsigned int count, xQ** results);
+xQStatusCode xQ_explain(xQ* self, const xmlChar* selector, xmlChar** explanation);
 xQStatusCode xQ_filter(xQ* self, const xmlChar* selector, xQ** result);
 xQStatusCode xQ_next(xQ* self, const xmlChar* selector, xQ** result);
 xQStatusCode xQ_nextAll(xQ* self, const xmlChar* selector, xQ** result);
@@ -89,10 +172,32 @@ unsigned long xQ_length(xQ* self);
 xmlChar* xQ_getText(xQ* self);
 xmlChar* xQ_getAttr(xQ* self, const char* name);
 xmlChar* xQ_getXml(xQ* self);
+const xmlChar* xQNode_getTextRef(xmlNodePtr node, int* len);
+xmlChar* xQNode_getText(xmlNodePtr node, int* len);
+const xmlChar* xQNode_getAttrRef(xmlNodePtr node, const xmlChar* name, int* len);
+int xQNode_hasXml(xmlNodePtr node);
+xQStatusCode xQNode_writeXml(xmlNodePtr node, xmlOutputBufferPtr out);
+xmlChar* xQNode_getXml(xmlNodePtr node, int* len);
+xQStatusCode xQNodeList_writeXml(xQNodeList* list, xmlOutputBufferPtr out, const xmlChar* separator);
 xQStatusCode xQ_first(xQ* self, xQ** result);
 xQStatusCode xQ_last(xQ* self, xQ** result);
 xQStatusCode xQ_addNamespace(xQ* self, const xmlChar* prefix, const xmlChar* uri);
 const xmlChar* xQ_namespaceForPrefix(xQ* self, const xmlChar* prefix);
+void xQ_setParallelism(xQ* self, unsigned int threads, unsigned long threshold);
+
+xQStatusCode xQSignatures_alloc_init(xQSignatures** self, xmlDocPtr doc, unsigned long maxBytes);
+xQStatusCode xQSignatures_build(xQSignatures* self);
+xQStatusCode xQSignatures_free(xQSignatures* self);
+int xQSignatures_get(const xQSignatures* self, xmlNodePtr node, xQSignature* names);
+int xQSignatures_mayHold(const xQSignatures* self, xmlNodePtr node, xQSignature names);
+xQSignature xQSignature_forName(const xmlChar* name);
+
+xQStatusCode xQDocStats_alloc_init(xQDocStats** self, xmlDocPtr doc);
+xQStatusCode xQDocStats_build(xQDocStats* self);
+xQStatusCode xQDocStats_free(xQDocStats* self);
+unsigned long xQDocStats_elementsNamed(const xQDocStats* self, const xmlChar* name, int* nested);
+unsigned long xQDocStats_attributeCount(const xQDocStats* self, const xmlChar* name, unsigned long* distinct);
+unsigned long xQDocStats_elementsWithValue(const xQDocStats* self, const xmlChar* name, const xmlChar* value);
 
 
 
@@ -103,18 +208,56 @@ struct _xQSearchExpr {
   xmlChar** argv;
   xQSearchOp operation;
   xQSearchExpr* next;
+  xQSearchExpr* alternative; // the next selector of a group ("a, b"), on the first step only
+  xQSignature names; // names below a node that this and the following steps need to match there
+  struct _xQPlan* plan; // how the selector is evaluated, on the first step only, once planned
+  struct _xQProgram* program; // a traversal step and the filters after it compiled into one test, or 0
 };
 
+typedef enum {
+  XQ_PLAN_SCAN = 0,  // walk the subtree of each context node, one step after another
+  XQ_PLAN_NAME_SEEK, // verify each element with the name of the last step
+  XQ_PLAN_ATTR_SEEK  // verify each element with the attribute value the last step requires
+} xQPlanMethod;
+
+typedef struct _xQPlan {
+  xQPlanMethod method;
+  xmlDocPtr document;           // the document the statistics describe
+  const xQNodeList* candidates; // elements a seek verifies, in document order
+  const xmlChar* key;           // the element or attribute name a seek looks up
+  const xmlChar* value;         // the attribute value a seek looks up
+  unsigned int compounds;       // traversal steps, each followed by the filters of its element
+  xQSearchExpr** compound;      // the traversal step of each compound
+  const xmlChar** uris;         // the namespace each compound's element must be in, or 0 for any
+  double scanCost;              // estimated elements a scan examines
+  double seekCost;              // estimated elements the cheapest seek examines
+  double estimate;              // estimated number of matches
+} xQPlan;
+
 xQStatusCode xQSearchExpr_alloc_init(xQSearchExpr** self, const xmlChar* expr);
 xQStatusCode xQSearchExpr_alloc_initFilter(xQSearchExpr** self, const xmlChar* expr);
 xQStatusCode xQSearchExpr_free(xQSearchExpr* self);
+xQStatusCode xQSearchExpr_compile(xQSearchExpr* self);
 xQStatusCode xQSearchExpr_eval(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList);
+const char* xQSearchOp_name(xQSearchOp op);
+xQStatusCode xQSearchExpr_plan(xQSearchExpr* self, xQ* context);
+const char* xQPlanMethod_name(xQPlanMethod method);
+xQStatusCode xQSearchExpr_explain(xQSearchExpr* self, xQ* context, const xQStats* measured, xmlBufferPtr out);
 
 xQStatusCode _xQ_findDescendants(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
 xQStatusCode _xQ_findDescendantsByName(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
 xQStatusCode _xQ_findChildrenByName(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
 xQStatusCode _xQ_findNextSiblingByName(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
 xQStatusCode _xQ_filterAttributeEquals(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterAttributeExists(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterAttributePrefix(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterAttributeSuffix(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterAttributeContains(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterAttributeWord(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterAttributeGreater(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterAttributeLess(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterTextContains(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_filterTextEquals(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
 xQStatusCode _xQ_addToOutput(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
 xQStatusCode _xQ_filterByName(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList);
 
@@ -11,3 +11,9 @@
 #ifndef HAVE_INLINE
 #define HAVE_INLINE 1
 #endif
+
+/* HAVE_PTHREAD_H Define to 1 if pthreads are available for parallel searches.
+   Windows builds fall back to searching on the calling thread */
+#if !defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define HAVE_PTHREAD_H 1
+#endif
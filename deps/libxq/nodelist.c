@@ -19,6 +19,7 @@
  */
 
 #include "libxq.h"
+#include "xqutil.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -39,7 +40,7 @@ static xQStatusCode xQNodeList_grow(xQNodeList* list, unsigned long requiredCapa
 xQStatusCode xQNodeList_alloc_init(xQNodeList** list, unsigned long size) {
   xQStatusCode status = XQ_OK;
   
-  *list = (xQNodeList*) malloc(sizeof(xQNodeList));
+  *list = (xQNodeList*) xQ_malloc(sizeof(xQNodeList));
   if (!*list)
     return XQ_OUT_OF_MEMORY;
   
@@ -63,8 +64,9 @@ xQStatusCode xQNodeList_init(xQNodeList* list, unsigned long size) {
   list->list = 0;
   list->capacity = 0;
   list->size = 0;
+  list->countOnly = 0;
 
-  buff = (xmlNodePtr*) malloc(sizeof(xmlNodePtr) * size);
+  buff = (xmlNodePtr*) xQ_malloc(sizeof(xmlNodePtr) * size);
   if (!buff)
     return XQ_OUT_OF_MEMORY;
   
@@ -74,6 +76,21 @@ xQStatusCode xQNodeList_init(xQNodeList* list, unsigned long size) {
   return XQ_OK;
 }
 
+/**
+ * Initialize a node list that only counts the nodes pushed to it. Its
+ * size is the number of nodes pushed; none of them can be read back.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQNodeList_initCounter(xQNodeList* list) {
+  list->list = 0;
+  list->capacity = 0;
+  list->size = 0;
+  list->countOnly = 1;
+  
+  return XQ_OK;
+}
+
 /**
  * Free a node list previously allocated with xQNodeList_alloc_init
  *
@@ -97,7 +114,7 @@ static xQStatusCode xQNodeList_grow(xQNodeList* list, unsigned long requiredCapa
   unsigned long newCapacity;
   xmlNodePtr* buff;
   
-  if (list->capacity >= requiredCapacity)
+  if (list->capacity >= requiredCapacity || list->countOnly)
     return XQ_OK;
   
   newCapacity = list->capacity < 8 ? 8 : list->capacity;
@@ -108,7 +125,7 @@ static xQStatusCode xQNodeList_grow(xQNodeList* list, unsigned long requiredCapa
   if (newCapacity < requiredCapacity)
     return XQ_ARGUMENT_OUT_OF_BOUNDS;
   
-  buff = (xmlNodePtr*) realloc(list->list, sizeof(xmlNodePtr) * newCapacity);
+  buff = (xmlNodePtr*) xQ_realloc(list->list, sizeof(xmlNodePtr) * newCapacity);
   if (!buff)
     return XQ_OUT_OF_MEMORY;
   
@@ -118,6 +135,16 @@ static xQStatusCode xQNodeList_grow(xQNodeList* list, unsigned long requiredCapa
   return XQ_OK;
 }
 
+/**
+ * Ensure the list has room for at least `capacity` items without
+ * reallocating
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQNodeList_reserve(xQNodeList* list, unsigned long capacity) {
+  return xQNodeList_grow(list, capacity);
+}
+
 /**
  * Insert an item into a list at a given index
  *
@@ -129,6 +156,11 @@ xQStatusCode xQNodeList_insert(xQNodeList* list, xmlNodePtr node, unsigned long
   if (atIdx > list->size)
     return XQ_ARGUMENT_OUT_OF_BOUNDS;
   
+  if (list->countOnly) {
+    list->size += 1;
+    return XQ_OK;
+  }
+  
   if (list->capacity < list->size + 1)
     result = xQNodeList_grow(list, list->size + 1);
   
@@ -181,3 +213,66 @@ xQStatusCode xQNodeList_assign(xQNodeList* toList, xQNodeList* fromList) {
   
   return result;
 }
+
+/**
+ * qsort/bsearch comparison of node pointers by address
+ */
+static int compareNodeAddress(const void* a, const void* b) {
+  const char* first = (const char*) *((const xmlNodePtr*) a);
+  const char* second = (const char*) *((const xmlNodePtr*) b);
+  
+  return first < second ? -1 : (first > second ? 1 : 0);
+}
+
+/**
+ * Remove duplicates from a list of nodes in the subtree under root
+ * (including root itself) and put them in document order. The subtree is
+ * walked only until every node in the list has been found.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQNodeList_sortUnique(xQNodeList* list, xmlNodePtr root) {
+  xmlNodePtr* ordered;
+  xmlNodePtr cur = root;
+  unsigned long i, unique, found = 0;
+  
+  if (list->countOnly || list->size < 2)
+    return XQ_OK;
+  
+  qsort(list->list, list->size, sizeof(xmlNodePtr), compareNodeAddress);
+  
+  for (i = 1, unique = 1; i < list->size; i++)
+    if (list->list[i] != list->list[unique - 1])
+      list->list[unique++] = list->list[i];
+  
+  list->size = unique;
+  
+  if (unique < 2)
+    return XQ_OK;
+  
+  ordered = (xmlNodePtr*) xQ_malloc(sizeof(xmlNodePtr) * unique);
+  if (!ordered)
+    return XQ_OUT_OF_MEMORY;
+  
+  // a pre-order walk of the subtree visits nodes in document order
+  while (cur && found < unique) {
+    if (bsearch(&cur, list->list, unique, sizeof(xmlNodePtr), compareNodeAddress))
+      ordered[found++] = cur;
+    
+    if (cur->children && (cur == root || cur->type == XML_ELEMENT_NODE)) {
+      cur = cur->children;
+    } else {
+      while (cur != root && !cur->next)
+        cur = cur->parent;
+      cur = cur == root ? 0 : cur->next;
+    }
+  }
+  
+  // nodes outside the subtree are left in address order
+  if (found == unique)
+    memcpy(list->list, ordered, sizeof(xmlNodePtr) * unique);
+  
+  free(ordered);
+  
+  return XQ_OK;
+}
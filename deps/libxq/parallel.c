@@ -0,0 +1,843 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Parallel search routines and the thread pool backing them
+ *
+ * Documents are never modified while they are searched, so search
+ * operations may run on several threads at once as long as each thread
+ * writes to its own output list and evaluates with its own copy of the
+ * xQ context. Results are merged back together in the original order.
+ */
+
+#include "xqparallel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// a context list is split into this many chunks per thread so a thread
+// that finishes early can pick up more work
+#define XQ_CHUNKS_PER_THREAD 4
+
+// subtree scans aim for tasks of about this many nodes
+#define XQ_SCAN_GRAIN 4096
+
+/**
+ * Set the number of threads searches from self may use and the minimum
+ * number of nodes in its context, or below a context node, before a
+ * search is split across them. Passing 0 or 1 threads disables parallel
+ * searching. Results of a search carry the settings of self.
+ */
+void xQ_setParallelism(xQ* self, unsigned int threads, unsigned long threshold) {
+  self->threads = threads ? threads : 1;
+  self->threshold = threshold ? threshold : 1;
+}
+
+
+#ifdef XQ_HAVE_THREADS
+
+// pool state, all protected by poolLock
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolWake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t poolDone = PTHREAD_COND_INITIALIZER;
+static unsigned int poolSize = 0;
+static unsigned long poolGeneration = 0;
+static xQJobFunc poolJob = 0;
+static void* poolCtx = 0;
+static unsigned int poolParticipants = 0;
+static unsigned int poolPending = 0;
+
+// only one job runs on the pool at a time; other callers run serially
+static pthread_mutex_t poolBusy = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Pool thread main loop
+ */
+static void* poolThreadMain(void* arg) {
+  unsigned int worker = (unsigned int)(size_t) arg;
+  unsigned long seen = 0;
+  xQJobFunc job;
+  void* ctx;
+  unsigned int participants;
+  
+  pthread_mutex_lock(&poolLock);
+  
+  for (;;) {
+    while (poolGeneration == seen)
+      pthread_cond_wait(&poolWake, &poolLock);
+    
+    seen = poolGeneration;
+    
+    if (worker >= poolParticipants)
+      continue;
+    
+    job = poolJob;
+    ctx = poolCtx;
+    participants = poolParticipants;
+    pthread_mutex_unlock(&poolLock);
+    
+    job(ctx, worker, participants);
+    
+    pthread_mutex_lock(&poolLock);
+    if (--poolPending == 0)
+      pthread_cond_signal(&poolDone);
+  }
+  
+  return 0;
+}
+
+/**
+ * Grow the pool to at least `size` threads (not counting the caller).
+ * Must be called with poolLock held.
+ *
+ * Returns the number of threads available
+ */
+static unsigned int xQThreadPool_grow(unsigned int size) {
+  pthread_t thread;
+  
+  while (poolSize < size) {
+    // pool threads are numbered from 1; the caller is worker 0
+    if (pthread_create(&thread, 0, poolThreadMain, (void*)(size_t)(poolSize + 1)) != 0)
+      break;
+    pthread_detach(thread);
+    ++poolSize;
+  }
+  
+  return poolSize;
+}
+
+/**
+ * Run a job on up to `workers` threads, including the calling thread, and
+ * wait for all of them to complete. If the pool is busy with another job
+ * or threads can't be created, fewer workers are used.
+ *
+ * Returns the number of workers that ran the job
+ */
+unsigned int xQThreadPool_run(xQJobFunc job, void* ctx, unsigned int workers) {
+  unsigned int helpers;
+  
+  if (workers <= 1 || pthread_mutex_trylock(&poolBusy) != 0) {
+    job(ctx, 0, 1);
+    return 1;
+  }
+  
+  pthread_mutex_lock(&poolLock);
+  
+  helpers = xQThreadPool_grow(workers - 1);
+  if (helpers > workers - 1)
+    helpers = workers - 1;
+  
+  poolJob = job;
+  poolCtx = ctx;
+  poolParticipants = helpers + 1;
+  poolPending = helpers;
+  ++poolGeneration;
+  pthread_cond_broadcast(&poolWake);
+  
+  pthread_mutex_unlock(&poolLock);
+  
+  job(ctx, 0, helpers + 1);
+  
+  pthread_mutex_lock(&poolLock);
+  while (poolPending)
+    pthread_cond_wait(&poolDone, &poolLock);
+  poolJob = 0;
+  poolCtx = 0;
+  pthread_mutex_unlock(&poolLock);
+  
+  pthread_mutex_unlock(&poolBusy);
+  
+  return helpers + 1;
+}
+
+#else
+
+/**
+ * Run a job on the calling thread (no thread support available)
+ *
+ * Returns the number of workers that ran the job
+ */
+unsigned int xQThreadPool_run(xQJobFunc job, void* ctx, unsigned int workers) {
+  job(ctx, 0, 1);
+  return 1;
+}
+
+#endif // XQ_HAVE_THREADS
+
+
+/**
+ * State shared by the workers of a parallel context search
+ */
+typedef struct _xQParallelFind {
+  xQSearchExpr* expr;
+  xQ* self;
+  xQNodeList* chunks;
+  unsigned long chunkCount;
+  unsigned long chunkSize;
+  unsigned long nextChunk;
+  xQStatusCode status;
+  xQMutex lock;
+} xQParallelFind;
+
+/**
+ * Worker job for a parallel context search. Chunks of the context list
+ * are claimed in order and each is evaluated into its own output list.
+ */
+static void xQParallelFind_job(void* ctx, unsigned int worker, unsigned int workers) {
+  xQParallelFind* state = (xQParallelFind*) ctx;
+  xQStatusCode status = XQ_OK;
+  unsigned long chunk, i, end;
+  xQ evalContext;
+  
+  // each worker evaluates against its own copy of the context
+  memcpy(&evalContext, state->self, sizeof(xQ));
+  
+  for (;;) {
+    xQMutex_lock(&state->lock);
+    chunk = state->status == XQ_OK ? state->nextChunk++ : state->chunkCount;
+    xQMutex_unlock(&state->lock);
+    
+    if (chunk >= state->chunkCount)
+      break;
+    
+    end = (chunk + 1) * state->chunkSize;
+    if (end > state->self->context.size)
+      end = state->self->context.size;
+    
+    for (i = chunk * state->chunkSize; status == XQ_OK && i < end; i++)
+      status = xQSearchExpr_eval(state->expr, &evalContext, state->self->context.list[i], &(state->chunks[chunk]));
+    
+    if (status != XQ_OK) {
+      xQMutex_lock(&state->lock);
+      if (state->status == XQ_OK)
+        state->status = status;
+      xQMutex_unlock(&state->lock);
+      break;
+    }
+  }
+}
+
+/**
+ * Evaluate a search expression against every node in the context of
+ * self, splitting the context across the thread pool, and append the
+ * results to outList in the same order a serial search would produce.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQ_findParallelContext(xQ* self, xQSearchExpr* expr, xQNodeList* outList) {
+  xQParallelFind state;
+  xQStatusCode status = XQ_OK;
+  unsigned long i, total;
+  unsigned int threads = self->threads;
+  
+  state.expr = expr;
+  state.self = self;
+  state.chunkCount = (unsigned long) threads * XQ_CHUNKS_PER_THREAD;
+  if (state.chunkCount > self->context.size)
+    state.chunkCount = self->context.size;
+  if (state.chunkCount < 1)
+    return XQ_OK;
+  state.chunkSize = (self->context.size + state.chunkCount - 1) / state.chunkCount;
+  state.chunkCount = (self->context.size + state.chunkSize - 1) / state.chunkSize;
+  state.nextChunk = 0;
+  state.status = XQ_OK;
+  
+  state.chunks = (xQNodeList*) calloc(state.chunkCount, sizeof(xQNodeList));
+  if (!state.chunks)
+    return XQ_OUT_OF_MEMORY;
+  
+  for (i = 0; status == XQ_OK && i < state.chunkCount; i++)
+    status = xQNodeList_init(&(state.chunks[i]), state.chunkSize);
+  
+  if (status == XQ_OK) {
+    xQMutex_init(&state.lock);
+    xQThreadPool_run(xQParallelFind_job, &state, threads);
+    xQMutex_destroy(&state.lock);
+    status = state.status;
+  }
+  
+  // merge the per-chunk lists in order
+  for (i = 0, total = outList->size; status == XQ_OK && i < state.chunkCount; i++)
+    total += state.chunks[i].size;
+  
+  if (status == XQ_OK)
+    status = xQNodeList_reserve(outList, total);
+  
+  for (i = 0; status == XQ_OK && i < state.chunkCount; i++) {
+    if (!outList->countOnly)
+      memcpy(&(outList->list[outList->size]), state.chunks[i].list, sizeof(xmlNodePtr) * state.chunks[i].size);
+    outList->size += state.chunks[i].size;
+  }
+  
+  for (i = 0; i < state.chunkCount; i++)
+    xQNodeList_free(&(state.chunks[i]), 0);
+  free(state.chunks);
+  
+  return status;
+}
+
+
+/**
+ * A unit of work in a parallel subtree scan, covering the subtrees of the
+ * siblings first through last (or through the final sibling if last is
+ * 0). Tasks form a tree in document order, so their output lists can be
+ * concatenated with a pre-order walk.
+ */
+typedef struct _xQScanTask xQScanTask;
+struct _xQScanTask {
+  xmlNodePtr first;
+  xmlNodePtr last;
+  unsigned long hint;
+  xQNodeList out;
+  xQScanTask* children;
+  xQScanTask* lastChild;
+  xQScanTask* next;
+};
+
+/**
+ * A work-stealing deque. The owning worker pushes and pops at the bottom
+ * while other workers steal from the top.
+ */
+typedef struct _xQTaskDeque {
+  xQScanTask** tasks;
+  unsigned long top;
+  unsigned long bottom;
+  unsigned long capacity;
+  xQMutex lock;
+} xQTaskDeque;
+
+/**
+ * State shared by the workers of a parallel subtree scan
+ */
+typedef struct _xQParallelScan {
+  xQSearchExpr* expr;
+  xQ* self;
+  xmlNodePtr node;
+  xQTaskDeque* deques;
+  unsigned int dequeCount;
+  unsigned long pending;
+  xQStatusCode status;
+  xQMutex lock;
+} xQParallelScan;
+
+/**
+ * Count the nodes in the subtrees of first and its following siblings,
+ * giving up once the count exceeds limit
+ *
+ * Returns the number of nodes counted, at most limit + 1
+ */
+static unsigned long xQScan_probe(xmlNodePtr first, unsigned long limit) {
+  xmlNodePtr parent = first->parent;
+  xmlNodePtr cur = first;
+  unsigned long count = 0;
+  
+  while (cur && ++count <= limit) {
+    if (cur->type == XML_ELEMENT_NODE && cur->children) {
+      cur = cur->children;
+      continue;
+    }
+    
+    while (cur->parent != parent && !cur->next)
+      cur = cur->parent;
+    
+    cur = cur->next;
+  }
+  
+  return count;
+}
+
+/**
+ * Allocate a task. Tasks are linked into their parent's children with
+ * xQScanTask_append once their position in document order is known.
+ *
+ * Returns the new task or 0 if memory could not be allocated
+ */
+static xQScanTask* xQScanTask_alloc_init(xmlNodePtr first, xmlNodePtr last, unsigned long hint) {
+  xQScanTask* task = (xQScanTask*) calloc(1, sizeof(xQScanTask));
+  
+  if (!task)
+    return 0;
+  
+  task->first = first;
+  task->last = last;
+  task->hint = hint;
+  
+  return task;
+}
+
+/**
+ * Append a task to the children of parent
+ */
+static void xQScanTask_append(xQScanTask* parent, xQScanTask* task) {
+  if (parent->lastChild)
+    parent->lastChild->next = task;
+  else
+    parent->children = task;
+  parent->lastChild = task;
+}
+
+/**
+ * Free a task and all of its descendant tasks. Ranges are chained through
+ * the last child, so that link is followed iteratively.
+ */
+static void xQScanTask_free(xQScanTask* task) {
+  xQScanTask* child;
+  xQScanTask* next;
+  
+  while (task) {
+    for (child = task->children; child && child != task->lastChild; child = next) {
+      next = child->next;
+      xQScanTask_free(child);
+    }
+    
+    next = task->lastChild;
+    xQNodeList_free(&(task->out), 0);
+    free(task);
+    task = next;
+  }
+}
+
+/**
+ * Push a task onto the bottom of a deque
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQTaskDeque_push(xQTaskDeque* deque, xQScanTask* task) {
+  xQStatusCode status = XQ_OK;
+  xQScanTask** tasks;
+  unsigned long capacity;
+  
+  xQMutex_lock(&deque->lock);
+  
+  if (deque->top == deque->bottom)
+    deque->top = deque->bottom = 0;
+  
+  if (deque->bottom >= deque->capacity) {
+    capacity = deque->capacity ? deque->capacity * 2 : 64;
+    tasks = (xQScanTask**) realloc(deque->tasks, sizeof(xQScanTask*) * capacity);
+    
+    if (tasks) {
+      deque->tasks = tasks;
+      deque->capacity = capacity;
+    } else {
+      status = XQ_OUT_OF_MEMORY;
+    }
+  }
+  
+  if (status == XQ_OK)
+    deque->tasks[deque->bottom++] = task;
+  
+  xQMutex_unlock(&deque->lock);
+  
+  return status;
+}
+
+/**
+ * Take a task from the bottom (owner) or top (thief) of a deque
+ *
+ * Returns the task or 0 if the deque is empty
+ */
+static xQScanTask* xQTaskDeque_take(xQTaskDeque* deque, int steal) {
+  xQScanTask* task = 0;
+  
+  xQMutex_lock(&deque->lock);
+  
+  if (deque->top < deque->bottom)
+    task = steal ? deque->tasks[deque->top++] : deque->tasks[--deque->bottom];
+  
+  xQMutex_unlock(&deque->lock);
+  
+  return task;
+}
+
+/**
+ * Create a task for a range of siblings, place it next in document order
+ * among the children of parent, and hand it to the other workers by
+ * pushing it onto the worker's own deque
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQParallelScan_spawn(xQParallelScan* state, unsigned int worker, xQScanTask* parent, xmlNodePtr first, xmlNodePtr last, unsigned long hint) {
+  xQStatusCode status;
+  xQScanTask* task;
+  
+  if (!(task = xQScanTask_alloc_init(first, last, hint)))
+    return XQ_OUT_OF_MEMORY;
+  
+  xQScanTask_append(parent, task);
+  
+  xQMutex_lock(&state->lock);
+  ++state->pending;
+  xQMutex_unlock(&state->lock);
+  
+  if ((status = xQTaskDeque_push(&(state->deques[worker]), task)) != XQ_OK) {
+    xQMutex_lock(&state->lock);
+    --state->pending;
+    xQMutex_unlock(&state->lock);
+  }
+  
+  return status;
+}
+
+/**
+ * Search the subtrees of the siblings first through last for the first
+ * step of the expression, counting nodes as they're visited. Elements are
+ * tested and subtrees skipped just as a serial search would: with the
+ * compiled program of the step when it has one, and by the subtree
+ * signatures when they're attached.
+ *
+ * Once more than XQ_SCAN_GRAIN nodes have been visited, the siblings that
+ * haven't been reached yet are handed on as a new range, with the number
+ * searched so far as its size hint. If a single subtree grows past twice
+ * the grain, the walk stops where it is and the unvisited part of each
+ * level, from the current node up to the end of the range, is handed on.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQParallelScan_scan(xQParallelScan* state, xQ* evalContext, xQScanTask* task, xmlNodePtr first, xmlNodePtr last, xQNodeList* outList, unsigned int worker) {
+  xQSearchExpr* expr = state->expr;
+  const xmlChar* name = 0;
+  const xmlChar* ns = 0;
+  xQStatusCode status = XQ_OK;
+  xQProgramRun run;
+  xmlNodePtr parent = first->parent;
+  xmlNodePtr cur = first;
+  xmlNodePtr up;
+  unsigned long count = 0, siblings = 0;
+  int matched;
+  
+  if (expr->program) {
+    if ((status = _xQ_initProgramRun(&run, evalContext, expr->program, first->doc)) != XQ_OK)
+      return status;
+  } else if (expr->operation == _xQ_findDescendantsByName) {
+    name = expr->argv[0];
+    ns = expr->argv[1];
+    nsLookup(evalContext, ns);
+  }
+  
+  while (cur && status == XQ_OK) {
+    
+    if (count > XQ_SCAN_GRAIN * 2 && cur->parent != parent) {
+      status = xQParallelScan_spawn(state, worker, task, cur, 0, 0);
+      
+      for (up = cur->parent; status == XQ_OK && up->parent != parent; up = up->parent)
+        if (up->next)
+          status = xQParallelScan_spawn(state, worker, task, up->next, 0, 0);
+      
+      if (status == XQ_OK && up != last && up->next)
+        status = xQParallelScan_spawn(state, worker, task, up->next, last, 0);
+      
+      break;
+    }
+    
+    ++count;
+    
+    if (cur->type == XML_ELEMENT_NODE) {
+      if (expr->program)
+        matched = _xQ_programMatches(&run, cur, &status) && status == XQ_OK;
+      else
+        matched = !name || ((xmlStrcmp(name, cur->name) == 0) && nsMatch(cur, ns));
+      
+      if (matched)
+        status = xQNodeList_push(outList, cur);
+      
+      if (cur->children && status == XQ_OK && !xQ_subtreeLacks(evalContext, cur, expr->names)) {
+        cur = cur->children;
+        continue;
+      }
+    }
+    
+    while (cur->parent != parent && !cur->next)
+      cur = cur->parent;
+    
+    if (cur->parent == parent) {
+      ++siblings;
+      
+      if (cur == last)
+        break;
+      
+      if (count > XQ_SCAN_GRAIN && cur->next) {
+        if (status == XQ_OK)
+          status = xQParallelScan_spawn(state, worker, task, cur->next, last, siblings);
+        break;
+      }
+    }
+    
+    cur = cur->next;
+  }
+  
+  return status;
+}
+
+/**
+ * Run a single task. A task with a size hint first skips that many
+ * siblings and hands the rest of its range to the other workers, so new
+ * work is published after a short walk along the siblings instead of a
+ * walk through their subtrees. The rest of the task is then searched,
+ * and the remaining steps of the expression applied to what was found.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQParallelScan_run(xQParallelScan* state, xQ* evalContext, xQScanTask* task, unsigned int worker) {
+  xQSearchExpr* expr = state->expr;
+  xQSearchExpr* next = expr->program ? expr->program->next : expr->next;
+  xQStatusCode status = XQ_OK;
+  xQScanTask* remainder = 0;
+  xQNodeList matches;
+  xmlNodePtr last = task->last;
+  xmlNodePtr cur;
+  unsigned long i;
+  
+  if ((status = xQNodeList_init(&(task->out), 16)) != XQ_OK)
+    return status;
+  
+  if (task->hint) {
+    for (i = 1, cur = task->first; i < task->hint && cur != last && cur->next; i++)
+      cur = cur->next;
+    
+    // the remainder is linked in last, after anything found below
+    if (cur != last && cur->next) {
+      if (!(remainder = xQScanTask_alloc_init(cur->next, last, task->hint)))
+        return XQ_OUT_OF_MEMORY;
+      
+      xQMutex_lock(&state->lock);
+      ++state->pending;
+      xQMutex_unlock(&state->lock);
+      
+      if ((status = xQTaskDeque_push(&(state->deques[worker]), remainder)) != XQ_OK) {
+        xQMutex_lock(&state->lock);
+        --state->pending;
+        xQMutex_unlock(&state->lock);
+        xQScanTask_free(remainder);
+        return status;
+      }
+      
+      last = cur;
+    }
+  }
+  
+  if (!next) {
+    status = xQParallelScan_scan(state, evalContext, task, task->first, last, &(task->out), worker);
+    
+  } else if ((status = xQNodeList_init(&matches, 16)) == XQ_OK) {
+    status = xQParallelScan_scan(state, evalContext, task, task->first, last, &matches, worker);
+    
+    for (i = 0; status == XQ_OK && i < matches.size; i++)
+      status = xQSearchExpr_eval(next, evalContext, matches.list[i], &(task->out));
+    
+    xQNodeList_free(&matches, 0);
+  }
+  
+  if (remainder)
+    xQScanTask_append(task, remainder);
+  
+  return status;
+}
+
+/**
+ * Worker job for a parallel subtree scan. Workers take tasks from their
+ * own deque and steal from the others when it's empty, until every task
+ * has been completed.
+ */
+static void xQParallelScan_job(void* ctx, unsigned int worker, unsigned int workers) {
+  xQParallelScan* state = (xQParallelScan*) ctx;
+  xQStatusCode status;
+  xQScanTask* task;
+  unsigned int i;
+  unsigned long pending;
+  xQ evalContext;
+  
+  memcpy(&evalContext, state->self, sizeof(xQ));
+  
+  // without other threads to share the work, search the usual way
+  if (workers == 1) {
+    task = xQTaskDeque_take(&(state->deques[worker]), 0);
+    
+    if ((status = xQNodeList_init(&(task->out), 16)) == XQ_OK)
+      status = xQSearchExpr_eval(state->expr, &evalContext, state->node, &(task->out));
+    
+    state->status = status;
+    state->pending = 0;
+    return;
+  }
+  
+  for (;;) {
+    task = xQTaskDeque_take(&(state->deques[worker]), 0);
+    
+    for (i = 1; !task && i < state->dequeCount; i++)
+      task = xQTaskDeque_take(&(state->deques[(worker + i) % state->dequeCount]), 1);
+    
+    if (!task) {
+      xQMutex_lock(&state->lock);
+      pending = state->pending;
+      xQMutex_unlock(&state->lock);
+      
+      if (!pending)
+        break;
+      
+      xQThread_yield();
+      continue;
+    }
+    
+    // after an error, remaining tasks are drained without running them
+    xQMutex_lock(&state->lock);
+    status = state->status;
+    xQMutex_unlock(&state->lock);
+    
+    if (status == XQ_OK && xQ_isCancelled(&evalContext))
+      status = XQ_CANCELLED;
+    
+    if (status == XQ_OK)
+      status = xQParallelScan_run(state, &evalContext, task, worker);
+    
+    xQMutex_lock(&state->lock);
+    if (status != XQ_OK && state->status == XQ_OK)
+      state->status = status;
+    --state->pending;
+    xQMutex_unlock(&state->lock);
+  }
+}
+
+/**
+ * Count the results collected by a task tree
+ */
+static unsigned long xQScanTask_count(xQScanTask* task) {
+  unsigned long total = 0;
+  xQScanTask* child;
+  
+  for (; task; task = task->lastChild) {
+    total += task->out.size;
+    
+    for (child = task->children; child && child != task->lastChild; child = child->next)
+      total += xQScanTask_count(child);
+  }
+  
+  return total;
+}
+
+/**
+ * Append the results collected by a task tree in document order. The
+ * output list must already have room for them.
+ */
+static void xQScanTask_collect(xQScanTask* task, xQNodeList* outList) {
+  xQScanTask* child;
+  
+  for (; task; task = task->lastChild) {
+    if (task->out.size) {
+      if (!outList->countOnly)
+        memcpy(&(outList->list[outList->size]), task->out.list, sizeof(xmlNodePtr) * task->out.size);
+      outList->size += task->out.size;
+    }
+    
+    for (child = task->children; child && child != task->lastChild; child = child->next)
+      xQScanTask_collect(child, outList);
+  }
+}
+
+/**
+ * Evaluate a search expression beginning with a descendant search from a
+ * single node, dividing the subtree between the threads of the pool.
+ * Small subtrees are searched on the calling thread.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQ_findParallelSubtree(xQ* self, xQSearchExpr* expr, xmlNodePtr node, xQNodeList* outList) {
+  xQParallelScan state;
+  xQStatusCode status = XQ_OK;
+  xQScanTask* root;
+  unsigned long threshold = self->threshold;
+  unsigned int threads = self->threads, i;
+  
+  if (!node || !node->children || xQ_subtreeLacks(self, node, expr->names) ||
+      xQScan_probe(node->children, threshold) <= threshold)
+    return xQSearchExpr_eval(expr, self, node, outList);
+  
+  // validate namespace prefixes up front so errors match a serial search
+  if (expr->operation == _xQ_findDescendantsByName && expr->argv[1] &&
+      expr->argv[1] != XQ_EMPTY_NAMESPACE && !xQ_namespaceForPrefix(self, expr->argv[1]))
+    return XQ_UNKNOWN_NS_PREFIX;
+  
+  // the search root itself is never part of the result, so the scan
+  // starts from a range over its children
+  if (!(root = xQScanTask_alloc_init(node->children, 0, 0)))
+    return XQ_OUT_OF_MEMORY;
+  
+  state.expr = expr;
+  state.self = self;
+  state.node = node;
+  state.dequeCount = threads;
+  state.pending = 1;
+  state.status = XQ_OK;
+  
+  state.deques = (xQTaskDeque*) calloc(threads, sizeof(xQTaskDeque));
+  if (!state.deques) {
+    xQScanTask_free(root);
+    return XQ_OUT_OF_MEMORY;
+  }
+  
+  for (i = 0; i < threads; i++)
+    xQMutex_init(&(state.deques[i].lock));
+  xQMutex_init(&state.lock);
+  
+  status = xQTaskDeque_push(&(state.deques[0]), root);
+  
+  if (status == XQ_OK) {
+    xQThreadPool_run(xQParallelScan_job, &state, threads);
+    status = state.status;
+  }
+  
+  if (status == XQ_OK)
+    status = xQNodeList_reserve(outList, outList->size + xQScanTask_count(root));
+  
+  if (status == XQ_OK)
+    xQScanTask_collect(root, outList);
+  
+  xQMutex_destroy(&state.lock);
+  for (i = 0; i < threads; i++) {
+    xQMutex_destroy(&(state.deques[i].lock));
+    free(state.deques[i].tasks);
+  }
+  free(state.deques);
+  xQScanTask_free(root);
+  
+  return status;
+}
+
+/**
+ * Evaluate a search expression against every node in the context of self
+ * using the thread pool, and append the results to outList in the same
+ * order a serial search would produce. Large context sets are divided
+ * between threads; otherwise descendant searches from each context node
+ * are split by subtree.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_findParallel(xQ* self, xQSearchExpr* expr, xQNodeList* outList) {
+  xQStatusCode status = XQ_OK;
+  unsigned long i;
+  
+  if (self->context.size >= self->threshold)
+    return xQ_findParallelContext(self, expr, outList);
+  
+  for (i = 0; status == XQ_OK && i < self->context.size; i++) {
+    if (!expr->alternative && (expr->operation == _xQ_findDescendants || expr->operation == _xQ_findDescendantsByName))
+      status = xQ_findParallelSubtree(self, expr, self->context.list[i], outList);
+    else
+      status = xQSearchExpr_eval(expr, self, self->context.list[i], outList);
+  }
+  
+  return status;
+}
@@ -0,0 +1,954 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Search planning
+ *
+ * The statistics of a document count its elements by name and depth and
+ * its attributes by name and value, and index the elements by name and
+ * by attribute value. A compiled selector is planned against them: the
+ * filters of each step are ordered so the most selective run first, and
+ * where it's cheaper than walking the document, the elements that may
+ * match the last step are looked up and verified from the bottom up,
+ * checking their ancestors or siblings against the earlier steps.
+ *
+ * A seek produces exactly what a scan would, in the same order. It is
+ * only planned when the two are known to agree: for a single selector
+ * whose every step but the last names an element that never holds
+ * another of the same name, searched from the document or its root.
+ */
+
+#include "libxq.h"
+#include "xqutil.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _xQNameStats {
+  xQNodeList elements; // elements with the name, in document order
+  unsigned int open;   // elements with the name above the one being counted
+  int nested;          // non-zero if one of the elements holds another
+} xQNameStats;
+
+typedef struct _xQAttrStats {
+  unsigned long count;    // elements the attribute is given on
+  unsigned long distinct; // values it's given
+} xQAttrStats;
+
+// elements a scan walks past in the time a seek verifies a candidate,
+// which it reaches with a random read
+#define XQ_PLAN_SEEK_COST 2.0
+
+// share of the elements holding an attribute expected to pass a test of
+// its value other than equality
+#define XQ_PLAN_RANGE_SELECTIVITY (1.0 / 3)
+#define XQ_PLAN_MATCH_SELECTIVITY 0.1
+
+// share of elements expected to pass a text test, which also costs more
+// than a test of an attribute and so runs after them
+#define XQ_PLAN_TEXT_SELECTIVITY 0.1
+#define XQ_PLAN_TEXT_RANK 2.0
+
+// the candidates of a seek for a name or value the document never uses
+static const xQNodeList noElements = { 0, 0, 0, 0 };
+
+// local (private) routines
+static xQStatusCode countElements(xQDocStats* self, xmlNodePtr node, unsigned int depth);
+static xQStatusCode countAttributes(xQDocStats* self, xmlNodePtr node);
+static void freeNameStats(void* payload, xmlChar* name);
+static void freeAttrStats(void* payload, xmlChar* name);
+static void freeValueList(void* payload, xmlChar* name);
+static void sumNameBytes(void* payload, void* data, xmlChar* name);
+static void sumValueBytes(void* payload, void* data, xmlChar* name);
+static int isFilter(xQSearchOp op);
+static double filterRank(const xQDocStats* stats, const xQSearchExpr* filter);
+static double filterSelectivity(const xQDocStats* stats, const xQSearchExpr* filter);
+static void orderFilters(const xQDocStats* stats, xQSearchExpr* step);
+static double averageDepth(const xQDocStats* stats);
+static int holdsOwnName(const xQDocStats* stats, const xQSearchExpr* step);
+static xQStatusCode planSeek(xQSearchExpr* self, xQ* context, const xQDocStats* stats);
+static int matchCompound(xQ* context, const xQPlan* plan, unsigned int i, xmlNodePtr top, xmlNodePtr node, xQStatusCode* status);
+static int reachedFrom(xQ* context, const xQPlan* plan, unsigned int i, xmlNodePtr top, xmlNodePtr node, xQStatusCode* status);
+static int passesFilters(xQ* context, xQSearchExpr* filter, xmlNodePtr node, xQStatusCode* status);
+static xQStatusCode explainStep(const xQSearchExpr* step, xQ* context, const xQStepStats* measured, const xQDocStats* stats, double* estimate, xmlBufferPtr out);
+static xQStatusCode explainPlan(const xQSearchExpr* self, const xQDocStats* stats, xmlBufferPtr out);
+static xQStatusCode explainf(xmlBufferPtr out, const char* format, ...);
+
+
+/**
+ * Allocate and initialize the statistics of a document. They are empty
+ * until xQDocStats_build() is called, so the cost of gathering them can
+ * be put off until a search needs them.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQDocStats_alloc_init(xQDocStats** self, xmlDocPtr doc) {
+  *self = (xQDocStats*) xQ_malloc(sizeof(xQDocStats));
+  if (!*self)
+    return XQ_OUT_OF_MEMORY;
+
+  memset(*self, 0, sizeof(xQDocStats));
+  (*self)->document = doc;
+
+  return XQ_OK;
+}
+
+/**
+ * Gather the statistics of the document in a single pass over it. Does
+ * nothing if they have already been gathered. The document must not
+ * change once its statistics are built.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQDocStats_build(xQDocStats* self) {
+  xQStatusCode status;
+
+  if (self->built || !self->document)
+    return XQ_OK;
+
+  self->names = xmlHashCreate(64);
+  self->attributes = xmlHashCreate(16);
+  self->values = xmlHashCreate(256);
+  if (!self->names || !self->attributes || !self->values)
+    status = XQ_OUT_OF_MEMORY;
+  else
+    status = countElements(self, (xmlNodePtr) self->document, 0);
+
+  if (status != XQ_OK) {
+    xmlHashFree(self->names, freeNameStats);
+    xmlHashFree(self->attributes, freeAttrStats);
+    xmlHashFree(self->values, freeValueList);
+    self->names = self->attributes = self->values = 0;
+    self->elements = 0;
+    memset(self->depths, 0, sizeof(self->depths));
+    return status;
+  }
+
+  // a default from the DTD is an attribute value the index never saw
+  self->valuesComplete = !self->document->intSubset && !self->document->extSubset;
+
+  self->bytes = sizeof(xQDocStats) + xmlHashSize(self->attributes) * sizeof(xQAttrStats);
+  xmlHashScan(self->names, sumNameBytes, &(self->bytes));
+  xmlHashScan(self->values, sumValueBytes, &(self->bytes));
+
+  self->built = 1;
+  return XQ_OK;
+}
+
+/**
+ * Free the statistics of a document
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQDocStats_free(xQDocStats* self) {
+  if (!self)
+    return XQ_OK;
+
+  if (self->names)
+    xmlHashFree(self->names, freeNameStats);
+  if (self->attributes)
+    xmlHashFree(self->attributes, freeAttrStats);
+  if (self->values)
+    xmlHashFree(self->values, freeValueList);
+  free(self);
+
+  return XQ_OK;
+}
+
+/**
+ * Return the number of elements with a name, setting nested to 1 if one
+ * of them holds another and to 0 otherwise
+ */
+unsigned long xQDocStats_elementsNamed(const xQDocStats* self, const xmlChar* name, int* nested) {
+  xQNameStats* stats = self->names ? (xQNameStats*) xmlHashLookup(self->names, name) : 0;
+
+  if (nested)
+    *nested = stats ? stats->nested : 0;
+
+  return stats ? stats->elements.size : 0;
+}
+
+/**
+ * Return the number of elements an attribute is given on, setting
+ * distinct to the number of different values it's given
+ */
+unsigned long xQDocStats_attributeCount(const xQDocStats* self, const xmlChar* name, unsigned long* distinct) {
+  xQAttrStats* stats = self->attributes ? (xQAttrStats*) xmlHashLookup(self->attributes, name) : 0;
+
+  if (distinct)
+    *distinct = stats ? stats->distinct : 0;
+
+  return stats ? stats->count : 0;
+}
+
+/**
+ * Return the number of elements on which an attribute is given a value
+ */
+unsigned long xQDocStats_elementsWithValue(const xQDocStats* self, const xmlChar* name, const xmlChar* value) {
+  xQNodeList* list = self->values ? (xQNodeList*) xmlHashLookup2(self->values, name, value) : 0;
+
+  return list ? list->size : 0;
+}
+
+/**
+ * Count the elements below node, which is at depth, indexing them by
+ * name and attribute value on the way
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode countElements(xQDocStats* self, xmlNodePtr node, unsigned int depth) {
+  xQStatusCode status = XQ_OK;
+  xmlNodePtr cur;
+  xQNameStats* name;
+
+  for (cur = node->children; cur && status == XQ_OK; cur = cur->next) {
+
+    if (cur->type != XML_ELEMENT_NODE)
+      continue;
+
+    self->elements++;
+    self->depths[depth + 1 < XQ_DOCSTATS_DEPTHS ? depth + 1 : XQ_DOCSTATS_DEPTHS - 1]++;
+
+    if (!(name = (xQNameStats*) xmlHashLookup(self->names, cur->name))) {
+      if (!(name = (xQNameStats*) calloc(1, sizeof(xQNameStats))))
+        return XQ_OUT_OF_MEMORY;
+
+      if (xQNodeList_init(&(name->elements), 4) != XQ_OK || xmlHashAddEntry(self->names, cur->name, name) != 0) {
+        freeNameStats(name, 0);
+        return XQ_OUT_OF_MEMORY;
+      }
+    }
+
+    if (name->open)
+      name->nested = 1;
+
+    status = xQNodeList_push(&(name->elements), cur);
+
+    if (status == XQ_OK && cur->properties)
+      status = countAttributes(self, cur);
+
+    if (status == XQ_OK && cur->children) {
+      name->open++;
+      status = countElements(self, cur, depth + 1);
+      name->open--;
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Count the attributes of an element and index it by their values
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode countAttributes(xQDocStats* self, xmlNodePtr node) {
+  xQStatusCode status = XQ_OK;
+  xmlAttrPtr attr;
+  xQAttrStats* stats;
+  xQNodeList* list;
+  const xmlChar* value;
+  xmlChar* copy;
+
+  for (attr = node->properties; attr && status == XQ_OK; attr = attr->next) {
+    copy = 0;
+
+    if (!(stats = (xQAttrStats*) xmlHashLookup(self->attributes, attr->name))) {
+      if (!(stats = (xQAttrStats*) calloc(1, sizeof(xQAttrStats))))
+        return XQ_OUT_OF_MEMORY;
+
+      if (xmlHashAddEntry(self->attributes, attr->name, stats) != 0) {
+        free(stats);
+        return XQ_OUT_OF_MEMORY;
+      }
+    }
+
+    stats->count++;
+
+    // the value the attribute filters see, as xmlGetProp() reads it
+    if (!attr->children)
+      value = (const xmlChar*) "";
+    else if (!attr->children->next && attr->children->type == XML_TEXT_NODE)
+      value = attr->children->content ? attr->children->content : (const xmlChar*) "";
+    else if (!(value = copy = xmlNodeListGetString(node->doc, attr->children, 1)))
+      return XQ_OUT_OF_MEMORY;
+
+    if (!(list = (xQNodeList*) xmlHashLookup2(self->values, attr->name, value))) {
+      if (xQNodeList_alloc_init(&list, 1) != XQ_OK) {
+        xmlFree(copy);
+        return XQ_OUT_OF_MEMORY;
+      }
+
+      if (xmlHashAddEntry2(self->values, attr->name, value, list) != 0) {
+        xQNodeList_free(list, 1);
+        xmlFree(copy);
+        return XQ_OUT_OF_MEMORY;
+      }
+
+      stats->distinct++;
+    }
+
+    // an element is listed once, even with two attributes of the name
+    if (!list->size || list->list[list->size - 1] != node)
+      status = xQNodeList_push(list, node);
+
+    xmlFree(copy);
+  }
+
+  return status;
+}
+
+/**
+ * Free the entries of the statistics tables
+ */
+static void freeNameStats(void* payload, xmlChar* name) {
+  xQNodeList_free(&(((xQNameStats*) payload)->elements), 0);
+  free(payload);
+}
+
+static void freeAttrStats(void* payload, xmlChar* name) {
+  free(payload);
+}
+
+static void freeValueList(void* payload, xmlChar* name) {
+  xQNodeList_free((xQNodeList*) payload, 1);
+}
+
+/**
+ * Add the memory used by the entries of the statistics tables to the
+ * total pointed to by data
+ */
+static void sumNameBytes(void* payload, void* data, xmlChar* name) {
+  *((unsigned long*) data) += sizeof(xQNameStats) + ((xQNameStats*) payload)->elements.capacity * sizeof(xmlNodePtr);
+}
+
+static void sumValueBytes(void* payload, void* data, xmlChar* name) {
+  *((unsigned long*) data) += sizeof(xQNodeList) + ((xQNodeList*) payload)->capacity * sizeof(xmlNodePtr);
+}
+
+/**
+ * Plan a compiled search with the statistics of the document of context,
+ * if it has any. The filters of every step are ordered by how many
+ * elements they're expected to pass, fewest first, and the first step of
+ * the expression is given the plan it's evaluated with.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQSearchExpr_plan(xQSearchExpr* self, xQ* context) {
+  const xQDocStats* stats = context->docStats;
+  xQSearchExpr* alt;
+  xQSearchExpr* step;
+  xQStatusCode status;
+
+  if (!self || self->plan || !stats || !stats->built)
+    return XQ_OK;
+
+  for (alt = self; alt; alt = alt->alternative)
+    for (step = alt; step; step = step->next)
+      if (xQ_isTraversal(step->operation))
+        orderFilters(stats, step);
+
+  // the programs hold the filters in their old order
+  status = xQSearchExpr_compile(self);
+  if (status != XQ_OK)
+    return status;
+
+  return planSeek(self, context, stats);
+}
+
+/**
+ * Return the name of a plan method
+ */
+const char* xQPlanMethod_name(xQPlanMethod method) {
+  switch (method) {
+    case XQ_PLAN_NAME_SEEK:
+      return "nameSeek";
+    case XQ_PLAN_ATTR_SEEK:
+      return "attributeSeek";
+    default:
+      return "scan";
+  }
+}
+
+/**
+ * Return 1 if a planned seek answers a search from node, which is the
+ * case for the document it was planned for and its root element
+ */
+int xQPlan_covers(const xQPlan* plan, xmlNodePtr node) {
+  return node && node->doc == plan->document &&
+    (node == (xmlNodePtr) plan->document || node == xmlDocGetRootElement(plan->document));
+}
+
+/**
+ * Evaluate a selector planned as a seek against node, which the plan
+ * covers. Each candidate is verified against the last step, then against
+ * the earlier ones by way of its ancestors or siblings. The candidates are
+ * in document order, which is the order a scan produces its matches in.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_evalPlan(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList) {
+  const xQPlan* plan = self->plan;
+  const xQNodeList* candidates = plan->candidates;
+  xQStepStats* step = xQStats_step(plan->compound[plan->compounds - 1]);
+  xQStepStats* outer = xQ_currentStep;
+  xQStatusCode result = XQ_OK;
+  unsigned long i, before = outList->size;
+  xmlNodePtr candidate;
+
+  xQ_currentStep = step;
+
+  for (i = 0; result == XQ_OK && i < candidates->size && !xQ_limitReached(context, outList); i++) {
+    candidate = candidates->list[i];
+
+    if (xQ_isCancelled(context)) {
+      result = XQ_CANCELLED;
+      break;
+    }
+
+    if (context->depthLimit && xQ_depthExceeded(context, xQNode_depth(candidate)))
+      continue;
+
+    if (matchCompound(context, plan, plan->compounds - 1, node, candidate, &result) && result == XQ_OK)
+      result = xQNodeList_push(outList, candidate);
+  }
+
+  xQ_currentStep = outer;
+  if (step) {
+    step->calls++;
+    step->produced += outList->size - before;
+  }
+
+  return result;
+}
+
+/**
+ * Count the matches of a search from node with the indexes of the
+ * document statistics of context, when node is the document they
+ * describe and the search is a single step for a name, or for any
+ * element, with at most a test of one attribute's value. The elements
+ * listed under the value are still tested, as one of them may give the
+ * attribute another value in a different namespace. The indexed
+ * parameter is set to 1 if count holds the answer, 0 if the search has
+ * to be run.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_countIndexed(xQSearchExpr* self, xQ* context, xmlNodePtr node, int* indexed, unsigned long* count) {
+  const xQDocStats* stats = context->docStats;
+  xQSearchExpr* filter = self->next;
+  const xQNodeList* list;
+  xQStatusCode status = XQ_OK;
+  int named = self->operation == _xQ_findDescendantsByName;
+  unsigned long i;
+
+  *indexed = 0;
+
+  if (!stats || !stats->built || node != (xmlNodePtr) stats->document || self->alternative)
+    return XQ_OK;
+
+  // a prefixed name has to be resolved and checked against each element
+  if (!(named && !self->argv[1]) && self->operation != _xQ_findDescendants)
+    return XQ_OK;
+
+  if (!filter) {
+    *indexed = 1;
+    *count = named ? xQDocStats_elementsNamed(stats, self->argv[0], 0) : stats->elements;
+    return XQ_OK;
+  }
+
+  if (filter->operation != _xQ_filterAttributeEquals || filter->next || !stats->valuesComplete)
+    return XQ_OK;
+
+  list = (const xQNodeList*) xmlHashLookup2(stats->values, filter->argv[0], filter->argv[1]);
+
+  for (i = 0, *count = 0; list && i < list->size && status == XQ_OK; i++)
+    if ((!named || xmlStrcmp(list->list[i]->name, self->argv[0]) == 0) &&
+        passesFilters(context, filter, list->list[i], &status))
+      (*count)++;
+
+  *indexed = status == XQ_OK;
+  return status;
+}
+
+/**
+ * Write a description of how a compiled search is evaluated against the
+ * current context to out, one line for each step and then one for the
+ * plan of each selector and one for the indexes the search reads. A step
+ * shows the number of nodes it's expected to produce, when the context
+ * has the statistics of its document, and the number it produced when
+ * the search was run with measured collecting statistics. A traversal
+ * step also shows the filters compiled with it and the namespace its
+ * prefix resolves to.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQSearchExpr_explain(xQSearchExpr* self, xQ* context, const xQStats* measured, xmlBufferPtr out) {
+  const xQDocStats* stats = context->docStats && context->docStats->built ? context->docStats : 0;
+  int signatures = context->signatures && context->signatures->built;
+  const xQStepStats* counted;
+  xQStatusCode status = XQ_OK;
+  xQSearchExpr* alt;
+  xQSearchExpr* step;
+  unsigned int i = 0, n = 0;
+  double estimate;
+
+  for (alt = self; alt && status == XQ_OK; alt = alt->alternative) {
+    if (self->alternative)
+      status = explainf(out, "selector %u of the group\n", ++n);
+
+    // measured holds the steps in the order xQ_statsCompiled() found them
+    for (step = alt, estimate = 0; step && status == XQ_OK; step = step->next, i++) {
+      counted = measured && i < measured->steps && measured->step[i].calls ? &(measured->step[i]) : 0;
+      status = explainStep(step, context, counted, stats, &estimate, out);
+    }
+
+    if (status == XQ_OK)
+      status = explainPlan(alt, stats, out);
+  }
+
+  if (status == XQ_OK)
+    status = explainf(out, "indexes: %s\n",
+      signatures && stats ? "subtree signatures, document statistics" :
+      signatures ? "subtree signatures" : stats ? "document statistics" : "none");
+
+  if (status == XQ_OK && measured)
+    status = explainf(out, "measured %lu result%s from %lu context node%s in %.3f ms\n",
+      measured->resultSize, measured->resultSize == 1 ? "" : "s",
+      measured->contextSize, measured->contextSize == 1 ? "" : "s",
+      measured->evalNs / 1e6);
+
+  return status;
+}
+
+/**
+ * Return 1 for the operations that test the node they're given
+ */
+static int isFilter(xQSearchOp op) {
+  return op == _xQ_filterAttributeEquals || op == _xQ_filterAttributeExists ||
+    op == _xQ_filterAttributePrefix || op == _xQ_filterAttributeSuffix ||
+    op == _xQ_filterAttributeContains || op == _xQ_filterAttributeWord ||
+    op == _xQ_filterAttributeGreater || op == _xQ_filterAttributeLess ||
+    op == _xQ_filterTextContains || op == _xQ_filterTextEquals;
+}
+
+/**
+ * Return the share of all elements a filter is expected to pass
+ */
+static double filterSelectivity(const xQDocStats* stats, const xQSearchExpr* filter) {
+  double elements = stats->elements ? (double) stats->elements : 1.0;
+  double held;
+
+  if (filter->operation == _xQ_filterTextContains || filter->operation == _xQ_filterTextEquals)
+    return XQ_PLAN_TEXT_SELECTIVITY;
+
+  if (filter->operation == _xQ_filterAttributeEquals)
+    return xQDocStats_elementsWithValue(stats, filter->argv[0], filter->argv[1]) / elements;
+
+  held = xQDocStats_attributeCount(stats, filter->argv[0], 0) / elements;
+
+  if (filter->operation == _xQ_filterAttributeExists)
+    return held;
+
+  if (filter->operation == _xQ_filterAttributeGreater || filter->operation == _xQ_filterAttributeLess)
+    return held * XQ_PLAN_RANGE_SELECTIVITY;
+
+  return held * XQ_PLAN_MATCH_SELECTIVITY;
+}
+
+/**
+ * Return the order a filter runs in among those of its step, lowest first
+ */
+static double filterRank(const xQDocStats* stats, const xQSearchExpr* filter) {
+  double selectivity = filterSelectivity(stats, filter);
+
+  if (filter->operation == _xQ_filterTextContains || filter->operation == _xQ_filterTextEquals)
+    return XQ_PLAN_TEXT_RANK + selectivity;
+
+  return selectivity;
+}
+
+/**
+ * Order the filters following a traversal step by rank, keeping the order
+ * of those ranked the same. Every filter of a step tests the same nodes,
+ * so the order changes how soon a node is rejected but not the result.
+ */
+static void orderFilters(const xQDocStats* stats, xQSearchExpr* step) {
+  xQSearchExpr* sorted = 0;
+  xQSearchExpr* filter = step->next;
+  xQSearchExpr* next;
+  xQSearchExpr** at;
+  double rank;
+
+  while (filter && isFilter(filter->operation)) {
+    next = filter->next;
+    rank = filterRank(stats, filter);
+
+    for (at = &sorted; *at && filterRank(stats, *at) <= rank; at = &((*at)->next))
+      ;
+
+    filter->next = *at;
+    *at = filter;
+    filter = next;
+  }
+
+  for (at = &sorted; *at; at = &((*at)->next))
+    ;
+
+  *at = filter;
+  step->next = sorted;
+}
+
+/**
+ * Return the average depth of the elements of a document
+ */
+static double averageDepth(const xQDocStats* stats) {
+  double total = 0;
+  unsigned int i;
+
+  for (i = 1; i < XQ_DOCSTATS_DEPTHS; i++)
+    total += (double) i * stats->depths[i];
+
+  return stats->elements ? total / stats->elements : 0;
+}
+
+/**
+ * Return 1 if an element matched by a traversal step may hold another
+ * matched by the same step
+ */
+static int holdsOwnName(const xQDocStats* stats, const xQSearchExpr* step) {
+  int nested = 1;
+
+  if (step->operation != _xQ_findDescendants)
+    xQDocStats_elementsNamed(stats, step->argv[0], &nested);
+
+  return nested;
+}
+
+/**
+ * Decide between scanning for a single selector and seeking the elements
+ * that may match its last step, and attach the plan to its first step.
+ * Groups and selectors whose matches a seek might produce in another order
+ * than a scan are left without a plan.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode planSeek(xQSearchExpr* self, xQ* context, const xQDocStats* stats) {
+  xQPlan* plan;
+  xQSearchExpr* step;
+  xQSearchExpr* last = 0;
+  const xQNodeList* list;
+  const xQNameStats* name;
+  const xmlChar* uri;
+  double verify = 0, filters = 0, depth = averageDepth(stats);
+  unsigned int count = 0, i;
+
+  if (self->alternative)
+    return XQ_OK;
+
+  for (step = self; step; step = step->next) {
+    if (xQ_isTraversal(step->operation)) {
+      // an earlier step holding another of its name produces the later
+      // steps' matches out of document order, or more than once
+      if (last && holdsOwnName(stats, last))
+        return XQ_OK;
+
+      if (count)
+        verify += step->operation == _xQ_findDescendants || step->operation == _xQ_findDescendantsByName ? depth : 1;
+
+      last = step;
+      count++;
+      filters = 0;
+
+    } else if (isFilter(step->operation) && last) {
+      filters++;
+
+    } else
+      return XQ_OK;
+  }
+
+  if (!count)
+    return XQ_OK;
+
+  plan = (xQPlan*) xQ_malloc(sizeof(xQPlan) + count * (sizeof(xQSearchExpr*) + sizeof(xmlChar*)));
+  if (!plan)
+    return XQ_OUT_OF_MEMORY;
+
+  memset(plan, 0, sizeof(xQPlan));
+  plan->document = stats->document;
+  plan->compounds = count;
+  plan->compound = (xQSearchExpr**) (plan + 1);
+  plan->uris = (const xmlChar**) (plan->compound + count);
+  plan->scanCost = (double) stats->elements;
+
+  for (i = 0, step = self; step; step = step->next) {
+    if (!xQ_isTraversal(step->operation))
+      continue;
+
+    uri = step->operation == _xQ_findDescendants ? 0 : step->argv[1];
+    if (uri && uri != XQ_EMPTY_NAMESPACE)
+      uri = xQ_namespaceForPrefix(context, uri);
+
+    plan->compound[i] = step;
+    plan->uris[i++] = uri;
+
+    // a prefix that's never declared is reported by the scan, and only
+    // if the scan gets as far as the step using it
+    if (!uri && step->operation != _xQ_findDescendants && step->argv[1])
+      last = 0;
+  }
+
+  self->plan = plan;
+
+  if (!last)
+    return XQ_OK;
+
+  // the elements the last step names, or the whole document for "*"
+  if (last->operation != _xQ_findDescendants) {
+    name = (const xQNameStats*) xmlHashLookup(stats->names, last->argv[0]);
+    plan->method = XQ_PLAN_NAME_SEEK;
+    plan->candidates = name ? &(name->elements) : &noElements;
+    plan->key = last->argv[0];
+  }
+
+  plan->estimate = plan->candidates ? (double) plan->candidates->size : (double) stats->elements;
+
+  // an attribute value required of the last step may narrow it further
+  for (step = last->next; step; step = step->next) {
+    plan->estimate *= filterSelectivity(stats, step);
+
+    if (step->operation != _xQ_filterAttributeEquals || !stats->valuesComplete)
+      continue;
+
+    if (!(list = (const xQNodeList*) xmlHashLookup2(stats->values, step->argv[0], step->argv[1])))
+      list = &noElements;
+
+    if (!plan->candidates || list->size < plan->candidates->size) {
+      plan->method = XQ_PLAN_ATTR_SEEK;
+      plan->candidates = list;
+      plan->key = step->argv[0];
+      plan->value = step->argv[1];
+    }
+  }
+
+  if (plan->candidates)
+    plan->seekCost = plan->candidates->size * XQ_PLAN_SEEK_COST * (1 + filters + verify);
+
+  if (plan->method != XQ_PLAN_SCAN && plan->seekCost >= plan->scanCost)
+    plan->method = XQ_PLAN_SCAN;
+
+  return XQ_OK;
+}
+
+/**
+ * Return 1 if node matches the name and filters of compound i, and is
+ * reached by its traversal from a match of the compound before it, or
+ * from top for the first. Errors from the filters are set in status.
+ */
+static int matchCompound(xQ* context, const xQPlan* plan, unsigned int i, xmlNodePtr top, xmlNodePtr node, xQStatusCode* status) {
+  const xQSearchExpr* step = plan->compound[i];
+  xQProgramRun run = { step->program, 0, plan->uris[i] };
+
+  if (step->program)
+    return _xQ_programMatches(&run, node, status) && *status == XQ_OK &&
+      reachedFrom(context, plan, i, top, node, status);
+
+  if (node->type != XML_ELEMENT_NODE)
+    return 0;
+
+  xQ_countVisited(1);
+
+  if (step->operation != _xQ_findDescendants &&
+      (xmlStrcmp(step->argv[0], node->name) != 0 || !nsMatch(node, plan->uris[i])))
+    return 0;
+
+  return passesFilters(context, step->next, node, status) && reachedFrom(context, plan, i, top, node, status);
+}
+
+/**
+ * Return 1 if the traversal of compound i reaches node from top, for the
+ * first compound, or from a match of the compound before it
+ */
+static int reachedFrom(xQ* context, const xQPlan* plan, unsigned int i, xmlNodePtr top, xmlNodePtr node, xQStatusCode* status) {
+  xQSearchOp op = plan->compound[i]->operation;
+  xmlNodePtr from;
+
+  if (op == _xQ_findDescendants || op == _xQ_findDescendantsByName) {
+    // every element but the root is below the document and the root
+    if (!i)
+      return node != top;
+
+    for (from = node->parent; from && from != top && *status == XQ_OK; from = from->parent)
+      if (matchCompound(context, plan, i - 1, top, from, status))
+        return 1;
+
+    return 0;
+  }
+
+  from = op == _xQ_findChildrenByName ? node->parent : xmlPreviousElementSibling(node);
+
+  if (!from || from == top)
+    return from && !i;
+
+  return i && matchCompound(context, plan, i - 1, top, from, status);
+}
+
+/**
+ * Return 1 if node passes filter and the filters following it, up to the
+ * next traversal step
+ */
+static int passesFilters(xQ* context, xQSearchExpr* filter, xmlNodePtr node, xQStatusCode* status) {
+  xmlNodePtr match;
+  xQNodeList matches;
+
+  // a filter passes on the node it's given or nothing, so one slot will do
+  matches.list = &match;
+  matches.capacity = 1;
+  matches.countOnly = 0;
+
+  for (; filter && isFilter(filter->operation); filter = filter->next) {
+    matches.size = 0;
+
+    if ((*status = filter->operation(context, filter->argv, node, &matches)) != XQ_OK || !matches.size)
+      return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * Write the line describing a step of a search. The estimate parameter
+ * holds the number of nodes the steps before it are expected to produce,
+ * and is updated for this step.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode explainStep(const xQSearchExpr* step, xQ* context, const xQStepStats* measured, const xQDocStats* stats, double* estimate, xmlBufferPtr out) {
+  const xmlChar* prefix = xQ_isTraversal(step->operation) && step->operation != _xQ_findDescendants ? step->argv[1] : 0;
+  const xmlChar* uri;
+  xQStatusCode status;
+  int named = step->argc == 2 && step->argv[0];
+
+  // filters are set under the traversal whose elements they test
+  status = explainf(out, "%s%s(%s%s%s)",
+    xQ_isTraversal(step->operation) ? "  " : "    ",
+    xQSearchOp_name(step->operation),
+    named ? (const char*) step->argv[0] : "",
+    named && step->argv[1] && step->argv[1] != XQ_EMPTY_NAMESPACE ? ", " : "",
+    named && step->argv[1] && step->argv[1] != XQ_EMPTY_NAMESPACE ? (const char*) step->argv[1] : "");
+
+  if (stats) {
+    if (step->operation == _xQ_findDescendants)
+      *estimate = (double) stats->elements;
+    else if (xQ_isTraversal(step->operation))
+      *estimate = (double) xQDocStats_elementsNamed(stats, step->argv[0], 0);
+    else if (isFilter(step->operation))
+      *estimate *= filterSelectivity(stats, step);
+
+    // a tenth of an element says more than none
+    if (status == XQ_OK)
+      status = explainf(out, ", estimated %.*f", *estimate < 10 ? 1 : 0, *estimate);
+  }
+
+  // the selectors of a group share a walk, whose visits go to the first
+  if (measured && status == XQ_OK)
+    status = measured->visited ?
+      explainf(out, ", produced %lu of %lu visited", measured->produced, measured->visited) :
+      explainf(out, ", produced %lu", measured->produced);
+
+  if (step->program && status == XQ_OK)
+    status = explainf(out, ", compiled with %u filter%s",
+      step->program->length - (step->operation != _xQ_findDescendants),
+      step->program->length - (step->operation != _xQ_findDescendants) == 1 ? "" : "s");
+
+  if (prefix == XQ_EMPTY_NAMESPACE && status == XQ_OK)
+    status = explainf(out, ", in no namespace");
+  else if (prefix && status == XQ_OK) {
+    uri = xQ_namespaceForPrefix(context, prefix);
+    status = uri ?
+      explainf(out, ", prefix %s is %s", (const char*) prefix, (const char*) uri) :
+      explainf(out, ", prefix %s is undeclared", (const char*) prefix);
+  }
+
+  return status == XQ_OK ? explainf(out, "\n") : status;
+}
+
+/**
+ * Write the line describing the plan of a selector
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode explainPlan(const xQSearchExpr* self, const xQDocStats* stats, xmlBufferPtr out) {
+  const xQPlan* plan = self->plan;
+
+  if (!stats)
+    return explainf(out, "  plan: scan, without document statistics\n");
+
+  // groups, and selectors a seek would answer out of order, aren't planned
+  if (!plan || !plan->candidates)
+    return explainf(out, "  plan: scan of about %.0f elements\n", (double) stats->elements);
+
+  if (plan->method == XQ_PLAN_SCAN)
+    return explainf(out, "  plan: scan of about %.0f elements, cheaper than a seek of about %.0f\n",
+      plan->scanCost, plan->seekCost);
+
+  return explainf(out, "  plan: %s(%s%s%s) of about %.0f elements, cheaper than a scan of about %.0f, estimated results %.*f\n",
+    xQPlanMethod_name(plan->method),
+    (const char*) plan->key,
+    plan->value ? "=" : "",
+    plan->value ? (const char*) plan->value : "",
+    plan->seekCost, plan->scanCost,
+    plan->estimate < 10 ? 1 : 0, plan->estimate);
+}
+
+/**
+ * Append formatted text to a description
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode explainf(xmlBufferPtr out, const char* format, ...) {
+  char line[256];
+  char* text = line;
+  va_list args;
+  int length, result;
+
+  va_start(args, format);
+  length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  if (length < 0)
+    return XQ_OUTPUT_ERROR;
+
+  // long names and values don't fit the line, so are formatted again
+  if ((size_t) length >= sizeof(line)) {
+    text = (char*) xQ_malloc(length + 1);
+    if (!text)
+      return XQ_OUT_OF_MEMORY;
+
+    va_start(args, format);
+    vsnprintf(text, length + 1, format, args);
+    va_end(args);
+  }
+
+  result = xmlBufferAdd(out, (const xmlChar*) text, length);
+
+  if (text != line)
+    free(text);
+
+  return result ? XQ_OUT_OF_MEMORY : XQ_OK;
+}
@@ -48,15 +48,24 @@ static xQStatusCode xQSearchExpr_alloc_init_allDescendants(xQSearchExpr** self);
 static xQStatusCode xQSearchExpr_alloc_init_searchDescendants(xQSearchExpr** self, xmlChar* name, xmlChar* ns);
 static xQStatusCode xQSearchExpr_alloc_init_searchImmediate(xQSearchExpr** self, xmlChar* name, xmlChar* ns);
 static xQStatusCode xQSearchExpr_alloc_init_searchNextSibling(xQSearchExpr** self, xmlChar* name, xmlChar* ns);
-static xQStatusCode xQSearchExpr_alloc_init_filterAttrEquals(xQSearchExpr** self, xmlChar* name, xmlChar* value);
+static xQStatusCode xQSearchExpr_alloc_init_filter(xQSearchExpr** self, xQSearchOp operation, xmlChar* name, xmlChar* value);
+static xQStatusCode xQSearchExpr_parseGroup(xQSearchExpr** expr, xQToken* tok, int filter);
 static xQStatusCode xQSearchExpr_parseSelector(xQSearchExpr** expr, xQToken* tok);
 static XQINLINE xQStatusCode xQSearchExpr_parseSingleSelector(xQSearchExpr** expr, xQToken* tok);
 static XQINLINE xQStatusCode xQSearchExpr_parseCombinator(xQToken* tok, xQSearchExprCtorPtr* ctor);
 static XQINLINE xQStatusCode xQSearchExpr_parseSimpleSelector(xQSearchExpr** expr, xQToken* tok, xQSearchExprCtorPtr ctor);
+static xQStatusCode xQSearchExpr_evalSteps(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList);
+static xQStatusCode xQSearchExpr_evalGroup(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList);
+static xQStatusCode xQSearchExpr_evalStats(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList);
 static XQINLINE xQStatusCode xQSearchExpr_parseElementName(xQToken* tok, xmlChar** nsPrefix, xmlChar** name, int* isWildcard);
 static xQStatusCode xQSearchExpr_parseAttribs(xQSearchExpr** expr, xQToken* tok);
+static xQStatusCode xQSearchExpr_parsePseudo(xQSearchExpr** expr, xQToken* tok);
+static xQSignature xQSearchExpr_computeNames(xQSearchExpr* self);
+static int opcodeFor(xQSearchOp op, xQOpcode* opcode);
+static xQStatusCode xQSearchExpr_evalProgram(const xQProgram* program, xQ* context, xmlNodePtr node, xQNodeList* outList);
 static xQStatusCode nextToken(xQToken* tokenContext);
 static int xmlstrpos(const xmlChar* haystack, xmlChar needle);
+static int startsPseudo(const xmlChar* str);
 #define initToken(t) memset(t, 0, sizeof(xQToken))
 #define copyToken(dest, src) memcpy(dest, src, sizeof(xQToken))
 #define tokenFirstChar(t) ((t)->content ? (t)->content[0] : 0)
@@ -67,16 +76,21 @@ static int xmlstrpos(const xmlChar* haystack, xmlChar needle);
 /*
  * Selector grammar:
  *
+ * group           ::= selector | selector ',' group
  * selector        ::= single_selector | single_selector selector
  * single_selector ::= combinator simple_selector | simple_selector
  * combinator      ::= '>' | '+'
  * simple_selector ::= element_name | element_name attribs
  * element_name    ::= IDENT ':' IDENT | IDENT | '*'
- * attribs         ::=  attrib | attrib attribs
- * attrib          ::= '[' IDENT  '='  ( string | IDENT ) ']'
+ * attribs         ::=  ( attrib | pseudo ) | ( attrib | pseudo ) attribs
+ * pseudo          ::= ':' ( 'contains' | 'text' ) '(' ( string | IDENT ) ')'
+ * attrib          ::= '[' IDENT ']' | '[' IDENT attrib_op ( string | IDENT ) ']' | '[' IDENT num_op number ']'
+ * attrib_op       ::= '=' | '^=' | '$=' | '*=' | '~='
+ * num_op          ::= '>' | '<'
+ * number          ::= string | IDENT, either holding only a decimal number
  * string          ::= '"' ( [^'"\\] | "'" | escape )* '"' | "'" ( [^'"\\] | '"' | escape )* "'"
  * escape          ::= '\' [\\'"]
- * IDENT           ::= [^ \t\r\n"'*+:=>\[\\\]]+
+ * IDENT           ::= [^ \t\r\n"'$()*+,:<=>\[\\\]^~]+
  */
 
 // table for tokenizing
@@ -123,15 +137,15 @@ static const xQCharacterClass characterClassTable[] = {
   XQ_TYPE_NS | XQ_TYPE_NQ,
   XQ_TYPE_TOKEN, // "
   XQ_TYPE_NS | XQ_TYPE_NQ,
-  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ, // $
   XQ_TYPE_NS | XQ_TYPE_NQ,
   XQ_TYPE_NS | XQ_TYPE_NQ,
   XQ_TYPE_TOKEN, // '
-  XQ_TYPE_NS | XQ_TYPE_NQ,
-  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ, // (
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ, // )
   XQ_TYPE_TOKEN | XQ_TYPE_NQ, // *
   XQ_TYPE_TOKEN | XQ_TYPE_NQ, // +
-  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ, // ,
   XQ_TYPE_NS | XQ_TYPE_NQ,
   XQ_TYPE_NS | XQ_TYPE_NQ,
   XQ_TYPE_NS | XQ_TYPE_NQ,
@@ -147,7 +161,7 @@ static const xQCharacterClass characterClassTable[] = {
   XQ_TYPE_NS | XQ_TYPE_NQ,
   XQ_TYPE_TOKEN | XQ_TYPE_NQ, // :
   XQ_TYPE_NS | XQ_TYPE_NQ,
-  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ, // <
   XQ_TYPE_TOKEN | XQ_TYPE_NQ, // =
   XQ_TYPE_TOKEN | XQ_TYPE_NQ, // >
   XQ_TYPE_NS | XQ_TYPE_NQ,
@@ -180,9 +194,42 @@ static const xQCharacterClass characterClassTable[] = {
   XQ_TYPE_NS | XQ_TYPE_NQ,
   XQ_TYPE_TOKEN | XQ_TYPE_NQ, // [
   XQ_TYPE_TOKEN, // backslash
-  XQ_TYPE_TOKEN | XQ_TYPE_NQ // ]
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ, // ]
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ, // ^
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_NS | XQ_TYPE_NQ,
+  XQ_TYPE_TOKEN | XQ_TYPE_NQ // ~
 };
-#define LAST_TABLE_ENTRY ']'
+#define LAST_TABLE_ENTRY '~'
 #define DEFAULT_CHARACTER_CLASS (XQ_TYPE_NS | XQ_TYPE_NQ)
 
 #define xqCharacterClass(c) (c > LAST_TABLE_ENTRY ? DEFAULT_CHARACTER_CLASS : characterClassTable[c])
@@ -192,6 +239,19 @@ static const xQCharacterClass characterClassTable[] = {
 #define xqIsNotQuote(c) (xqCharacterClass(c) & XQ_TYPE_NQ)
 
 
+/**
+ * Return true if str, which follows a ':', holds the name of a pseudo
+ * followed by '(' rather than the local part of a qualified name
+ */
+static int startsPseudo(const xmlChar* str) {
+  const xmlChar* end = str;
+  
+  while (xqIsNotSpace(*end))
+    ++end;
+  
+  return end > str && *end == '(';
+}
+
 /**
  * Return the position of needle in haystack or -1
  */
@@ -232,7 +292,7 @@ static xQStatusCode nextToken(xQToken* tokenContext) {
   if (*start == '"' || *start == '\'') {
     ++(tokenContext->strPtr);
 
-    strStr = malloc(xmlStrlen(tokenContext->strPtr));
+    strStr = xQ_malloc(xmlStrlen(tokenContext->strPtr));
     if ((!strStr) && *(tokenContext->strPtr))
       return tokenContext->lastStatus = XQ_OUT_OF_MEMORY;
     strOut = strStr;
@@ -289,41 +349,36 @@ static xQStatusCode nextToken(xQToken* tokenContext) {
     
   }
     
-  tokenContext->content = xmlStrndup(start, tokenContext->strPtr - start);
+  tokenContext->content = xQ_strndup(start, tokenContext->strPtr - start);
   tokenContext->length = tokenContext->strPtr - start;
   return tokenContext->lastStatus = XQ_OK;
 }
 
 
-/*
-void dumpAST(xQSearchExpr* self, int level) {
-  int i;
-  
-  if (level == 0)
-    printf("parsed expression:\n ");
-  else
-    printf(" ");
+/**
+ * Return the next token from the string, where an unquoted value is read
+ * as an IDENT running up to the next space or terminator, so it may hold
+ * characters that are tokens elsewhere in a selector
+ */
+static xQStatusCode nextValue(xQToken* tokenContext, xmlChar terminator) {
+  const xmlChar* start = tokenContext->strPtr;
   
-  for (i = 0; i < level; i++) { printf(" "); }
+  while (*start && xqIsSpace(*start))
+    ++start;
   
-  printf("0x%lx ", (long)self);
+  if (!*start || *start == '"' || *start == '\'' || *start == terminator)
+    return nextToken(tokenContext);
   
-  if (self->operation == _xQ_findDescendantsByName) {
-    printf("_xQ_findDescendantsByName %s\n", self->argv[0]);
-  } else if (self->operation == _xQ_findChildrenByName) {
-    printf("_xQ_findChildrenByName %s\n", self->argv[0]);
-  } else if (self->operation == _xQ_filterAttributeEquals) {
-    printf("_xQ_filterAttributeEquals %s %s\n", self->argv[0], self->argv[1]);
-  } else if (self->operation == _xQ_addToOutput) {
-    printf("_xQ_addToOutput\n");
-  } else {
-    printf("unknown\n");
-  }
+  if (tokenContext->content) xmlFree(tokenContext->content);
+  tokenContext->type = XQ_TT_IDENT;
+  tokenContext->strPtr = start;
+  while (*(tokenContext->strPtr) && !xqIsSpace(*(tokenContext->strPtr)) && *(tokenContext->strPtr) != terminator)
+    ++(tokenContext->strPtr);
   
-  if (self->next)
-    dumpAST(self->next, level + 1);
+  tokenContext->content = xQ_strndup(start, tokenContext->strPtr - start);
+  tokenContext->length = tokenContext->strPtr - start;
+  return tokenContext->lastStatus = tokenContext->content ? XQ_OK : XQ_OUT_OF_MEMORY;
 }
-*/
 
 
 /**
@@ -333,7 +388,6 @@ void dumpAST(xQSearchExpr* self, int level) {
  * Returns a pointer to the new instance or 0 on error
  */
 xQStatusCode xQSearchExpr_alloc_init(xQSearchExpr** self, const xmlChar* expr) {
-  const xmlChar* ptr = expr;
   xQStatusCode status = XQ_OK;
   xQToken tok;
   
@@ -342,22 +396,19 @@ xQStatusCode xQSearchExpr_alloc_init(xQSearchExpr** self, const xmlChar* expr) {
   tok.strPtr = expr;
   nextToken(&tok);
   
-  status = xQSearchExpr_parseSelector(self, &tok);
-  
-  if (status == XQ_NO_MATCH) {
-    if (tok.lastStatus != XQ_OK && tok.lastStatus != XQ_NO_TOKEN)
-      status = tok.lastStatus;
-    else if (tok.type != XQ_TT_NONE)
-      status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
-    else
-      status = XQ_OK;
-  }
+  status = xQSearchExpr_parseGroup(self, &tok, 0);
 
   destroyToken(&tok);
   
   if (status == XQ_OK && (!*self))
     status = xQSearchExpr_alloc_init_copy(self);
   
+  if (status == XQ_OK)
+    xQSearchExpr_computeNames(*self);
+  
+  if (status == XQ_OK)
+    status = xQSearchExpr_compile(*self);
+  
   if (status != XQ_OK) {
     xQSearchExpr_free(*self);
     *self = 0;
@@ -374,7 +425,6 @@ xQStatusCode xQSearchExpr_alloc_init(xQSearchExpr** self, const xmlChar* expr) {
  * Returns a pointer to the new instance or 0 on error
  */
 xQStatusCode xQSearchExpr_alloc_initFilter(xQSearchExpr** self, const xmlChar* expr) {
-  const xmlChar* ptr = expr;
   xQStatusCode status = XQ_OK;
   xQToken tok;
   
@@ -383,35 +433,53 @@ xQStatusCode xQSearchExpr_alloc_initFilter(xQSearchExpr** self, const xmlChar* e
   tok.strPtr = expr;
   nextToken(&tok);
   
-  status = xQSearchExpr_parseSelector(self, &tok);
-  
-  if (status == XQ_NO_MATCH) {
-    if (tok.lastStatus != XQ_OK && tok.lastStatus != XQ_NO_TOKEN)
-      status = tok.lastStatus;
-    else if (tok.type != XQ_TT_NONE)
-      status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
-    else
-      status = XQ_OK;
-  }
+  status = xQSearchExpr_parseGroup(self, &tok, 1);
 
   destroyToken(&tok);
 
   if (status == XQ_OK && (!*self))
     status = xQSearchExpr_alloc_init_copy(self);
-  else if (status == XQ_OK) {
-    // convert to self-search
-    if ((*self)->operation == _xQ_findDescendants)
-      (*self)->operation = _xQ_addToOutput;
-    else if ((*self)->operation == _xQ_findDescendantsByName)
-      (*self)->operation = _xQ_filterByName;
-  }
   
-  if (status != XQ_OK)
+  if (status == XQ_OK)
+    xQSearchExpr_computeNames(*self);
+  
+  if (status == XQ_OK)
+    status = xQSearchExpr_compile(*self);
+  
+  if (status != XQ_OK) {
     xQSearchExpr_free(*self);
+    *self = 0;
+  }
   
   return status;
 }
 
+/**
+ * Set the names of each step of an expression and its alternatives to the
+ * names of its own step and those after it. Every step after a search of
+ * a node's descendants stays among those descendants, so a subtree that
+ * doesn't hold all of these names can't produce a match.
+ *
+ * Returns the names of the first step
+ */
+static xQSignature xQSearchExpr_computeNames(xQSearchExpr* self) {
+  xQSignature names;
+  
+  if (!self)
+    return 0;
+  
+  if (self->alternative)
+    xQSearchExpr_computeNames(self->alternative);
+  
+  names = xQSearchExpr_computeNames(self->next);
+  
+  if (self->operation == _xQ_findDescendantsByName || self->operation == _xQ_findChildrenByName ||
+      self->operation == _xQ_findNextSiblingByName || self->operation == _xQ_filterByName)
+    names |= xQSignature_forName(self->argv[0]);
+  
+  return self->names = names;
+}
+
 /**
  * Return the tail from an xQSearchExpr list
  */
@@ -424,6 +492,60 @@ static XQINLINE xQSearchExpr* expressionTail(xQSearchExpr** expr) {
   return lastExpr;
 }
 
+/**
+ * Parse a group of comma separated selectors from the string, linking
+ * each selector after the first to the one before it as an alternative.
+ * When filter is non-zero, each selector is converted to search the node
+ * it's applied to instead of its descendants.
+ *
+ * Grammar:
+ *
+ * group           ::= selector | selector ',' group
+ */
+static xQStatusCode xQSearchExpr_parseGroup(xQSearchExpr** expr, xQToken* tok, int filter) {
+  xQSearchExpr** alt = expr;
+  xQStatusCode status = XQ_OK;
+  int more = 1;
+  *expr = 0;
+  
+  while (status == XQ_OK && more) {
+    
+    // selector
+    status = xQSearchExpr_parseSelector(alt, tok);
+    
+    if (status != XQ_NO_MATCH)
+      break;
+    
+    if (tok->lastStatus != XQ_OK && tok->lastStatus != XQ_NO_TOKEN)
+      return tok->lastStatus;
+    
+    status = XQ_OK;
+    more = tok->type == XQ_TT_TOKEN && tokenFirstChar(tok) == ',';
+    
+    // every selector in a group must be non-empty
+    if ((more || alt != expr) && !*alt)
+      status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+    else if (!more && tok->type != XQ_TT_NONE)
+      status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+    
+    if (status == XQ_OK && filter && *alt) {
+      // convert to self-search
+      if ((*alt)->operation == _xQ_findDescendants)
+        (*alt)->operation = _xQ_addToOutput;
+      else if ((*alt)->operation == _xQ_findDescendantsByName)
+        (*alt)->operation = _xQ_filterByName;
+    }
+    
+    // ',' group
+    if (status == XQ_OK && more) {
+      nextToken(tok);
+      alt = &((*alt)->alternative);
+    }
+  }
+  
+  return status;
+}
+
 /**
  * Parse a selector from the string
  *
@@ -537,15 +659,15 @@ static XQINLINE xQStatusCode xQSearchExpr_parseElementName(xQToken* tok, xmlChar
   // IDENT ':' IDENT | IDENT
   if (tok->type == XQ_TT_IDENT) {
     
-    *name = xmlStrndup(tok->content, tok->length);
+    *name = xQ_strndup(tok->content, tok->length);
     if (!(*name))
       status = XQ_OUT_OF_MEMORY;
     
     if (status == XQ_OK)
       nextToken(tok);
     
-    // IDENT ':' IDENT
-    if (status == XQ_OK && tok->type == XQ_TT_TOKEN && tokenFirstChar(tok) == ':') {
+    // IDENT ':' IDENT, unless the ':' begins a pseudo
+    if (status == XQ_OK && tok->type == XQ_TT_TOKEN && tokenFirstChar(tok) == ':' && !startsPseudo(tok->strPtr)) {
       
       nextToken(tok);
       
@@ -554,7 +676,7 @@ static XQINLINE xQStatusCode xQSearchExpr_parseElementName(xQToken* tok, xmlChar
       
       if (status == XQ_OK) {
         *nsPrefix = *name;
-        *name = xmlStrndup(tok->content, tok->length);
+        *name = xQ_strndup(tok->content, tok->length);
       }
       
       if (status == XQ_OK)
@@ -589,11 +711,14 @@ static XQINLINE xQStatusCode xQSearchExpr_parseElementName(xQToken* tok, xmlChar
  *
  * Grammar:
  *
- * attribs         ::=  attrib | attrib attribs
- * attrib          ::= '[' IDENT  '='  ( string | IDENT ) ']'
+ * attribs         ::=  ( attrib | pseudo ) | ( attrib | pseudo ) attribs
+ * attrib          ::= '[' IDENT ']' | '[' IDENT attrib_op ( string | IDENT ) ']' | '[' IDENT num_op number ']'
+ * attrib_op       ::= '=' | '^=' | '$=' | '*=' | '~='
+ * num_op          ::= '>' | '<'
  */
 static xQStatusCode xQSearchExpr_parseAttribs(xQSearchExpr** expr, xQToken* tok) {
   xQStatusCode status = XQ_OK;
+  xQSearchOp operation = 0;
   xmlChar* attrName = 0;
   xmlChar* attrValue = 0;
   
@@ -607,37 +732,62 @@ static xQStatusCode xQSearchExpr_parseAttribs(xQSearchExpr** expr, xQToken* tok)
       status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
     
     if (status == XQ_OK)
-      status = (attrName = xmlStrndup(tok->content, tok->length)) ? XQ_OK : XQ_OUT_OF_MEMORY;
+      status = (attrName = xQ_strndup(tok->content, tok->length)) ? XQ_OK : XQ_OUT_OF_MEMORY;
     
     if (status == XQ_OK)
       nextToken(tok);
 
-    // =
-    if (status == XQ_OK && (tok->type != XQ_TT_TOKEN || tokenFirstChar(tok) != '='))
+    // ] | attrib_op | num_op
+    if (status == XQ_OK && tok->type == XQ_TT_TOKEN) {
+      switch (tokenFirstChar(tok)) {
+        case ']': operation = _xQ_filterAttributeExists; break;
+        case '=': operation = _xQ_filterAttributeEquals; break;
+        case '^': operation = _xQ_filterAttributePrefix; break;
+        case '$': operation = _xQ_filterAttributeSuffix; break;
+        case '*': operation = _xQ_filterAttributeContains; break;
+        case '~': operation = _xQ_filterAttributeWord; break;
+        case '>': operation = _xQ_filterAttributeGreater; break;
+        case '<': operation = _xQ_filterAttributeLess; break;
+      }
+    }
+    
+    if (status == XQ_OK && !operation)
       status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
-
-    if (status == XQ_OK)
+    
+    // the rest of a two character attrib_op
+    if (status == XQ_OK && xmlStrchr((const xmlChar*) "^$*~", tokenFirstChar(tok))) {
       nextToken(tok);
+      
+      if (tok->type != XQ_TT_TOKEN || tokenFirstChar(tok) != '=')
+        status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+    }
     
-    // string | IDENT
-    if (status == XQ_OK && (tok->type != XQ_TT_STRING && tok->type != XQ_TT_IDENT))
-      status = tok->lastStatus == XQ_OK ? XQ_INVALID_SEL_UNEXPECTED_TOKEN : tok->lastStatus;
+    if (status == XQ_OK && operation != _xQ_filterAttributeExists) {
+      nextValue(tok, ']');
+      
+      // string | IDENT
+      if (tok->type != XQ_TT_STRING && tok->type != XQ_TT_IDENT)
+        status = tok->lastStatus == XQ_OK ? XQ_INVALID_SEL_UNEXPECTED_TOKEN : tok->lastStatus;
 
-    if (status == XQ_OK)
-      status = (attrValue = xmlStrndup(tok->content, tok->length)) ? XQ_OK : XQ_OUT_OF_MEMORY;
+      if (status == XQ_OK)
+        status = (attrValue = xQ_strndup(tok->content, tok->length)) ? XQ_OK : XQ_OUT_OF_MEMORY;
 
-    if (status == XQ_OK)
-      nextToken(tok);
+      if (status == XQ_OK)
+        nextToken(tok);
 
-    // ]
-    if (status == XQ_OK && (tok->type != XQ_TT_TOKEN || tokenFirstChar(tok) != ']'))
-      status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+      // ]
+      if (status == XQ_OK && (tok->type != XQ_TT_TOKEN || tokenFirstChar(tok) != ']'))
+        status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+    }
 
     if (status == XQ_OK)
       nextToken(tok);
 
-    if (status == XQ_OK)
-      status = xQSearchExpr_alloc_init_filterAttrEquals(expr, attrName, attrValue);
+    // the expression owns the strings from here, even if it fails
+    if (status == XQ_OK) {
+      status = xQSearchExpr_alloc_init_filter(expr, operation, attrName, attrValue);
+      attrName = attrValue = 0;
+    }
     
     if (status != XQ_OK) {
       freeAndResetPtr(attrName);
@@ -647,11 +797,177 @@ static xQStatusCode xQSearchExpr_parseAttribs(xQSearchExpr** expr, xQToken* tok)
     if (status == XQ_OK)
       return xQSearchExpr_parseAttribs(&((*expr)->next), tok);
     
+  // | pseudo
+  } else if (tok->type == XQ_TT_TOKEN && tokenFirstChar(tok) == ':') {
+    
+    status = xQSearchExpr_parsePseudo(expr, tok);
+    
+    if (status == XQ_OK)
+      return xQSearchExpr_parseAttribs(&((*expr)->next), tok);
+    
+  }
+  
+  return status;
+}
+
+/**
+ * Parse a pseudo, which filters on text content, from the string
+ *
+ * Grammar:
+ *
+ * pseudo          ::= ':' ( 'contains' | 'text' ) '(' ( string | IDENT ) ')'
+ */
+static xQStatusCode xQSearchExpr_parsePseudo(xQSearchExpr** expr, xQToken* tok) {
+  xQStatusCode status = XQ_OK;
+  xQSearchOp operation = 0;
+  xmlChar* text = 0;
+  
+  // ':'
+  nextToken(tok);
+  
+  // 'contains' | 'text'
+  if (tok->type == XQ_TT_IDENT && xmlStrcmp(tok->content, (xmlChar*)"contains") == 0)
+    operation = _xQ_filterTextContains;
+  else if (tok->type == XQ_TT_IDENT && xmlStrcmp(tok->content, (xmlChar*)"text") == 0)
+    operation = _xQ_filterTextEquals;
+  else
+    status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+  
+  if (status == XQ_OK)
+    nextToken(tok);
+  
+  // '('
+  if (status == XQ_OK && (tok->type != XQ_TT_TOKEN || tokenFirstChar(tok) != '('))
+    status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+  
+  if (status == XQ_OK)
+    nextValue(tok, ')');
+  
+  // string | IDENT
+  if (status == XQ_OK && (tok->type != XQ_TT_STRING && tok->type != XQ_TT_IDENT))
+    status = tok->lastStatus == XQ_OK ? XQ_INVALID_SEL_UNEXPECTED_TOKEN : tok->lastStatus;
+  
+  if (status == XQ_OK)
+    status = (text = xQ_strndup(tok->content, tok->length)) ? XQ_OK : XQ_OUT_OF_MEMORY;
+  
+  if (status == XQ_OK)
+    nextToken(tok);
+  
+  // ')'
+  if (status == XQ_OK && (tok->type != XQ_TT_TOKEN || tokenFirstChar(tok) != ')'))
+    status = XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+  
+  if (status == XQ_OK)
+    nextToken(tok);
+  
+  // the expression owns the string from here, even if it fails
+  if (status == XQ_OK) {
+    status = xQSearchExpr_alloc_init_filter(expr, operation, text, 0);
+    text = 0;
   }
   
+  freeAndResetPtr(text);
+  
   return status;
 }
 
+/**
+ * Compile each traversal step of an expression and its alternatives that
+ * is followed by filters into a program, which tests the name of an
+ * element and runs the filters on it in one pass. Programs compiled
+ * before are replaced, so an expression whose filters have been reordered
+ * can be compiled again.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQSearchExpr_compile(xQSearchExpr* self) {
+  xQSearchExpr* alt;
+  xQSearchExpr* step;
+  xQSearchExpr* filter;
+  xQProgram* program;
+  xQInstr* instr;
+  xQOpcode opcode;
+  unsigned int length;
+  int named;
+  
+  for (alt = self; alt; alt = alt->alternative) {
+    for (step = alt; step; step = step->next) {
+      free(step->program);
+      step->program = 0;
+      
+      if (!xQ_isTraversal(step->operation))
+        continue;
+      
+      for (length = 0, filter = step->next; filter && opcodeFor(filter->operation, &opcode); filter = filter->next)
+        length++;
+      
+      if (!length)
+        continue;
+      
+      named = step->operation != _xQ_findDescendants;
+      
+      program = (xQProgram*) xQ_malloc(sizeof(xQProgram) + (length + named - 1) * sizeof(xQInstr));
+      if (!program)
+        return XQ_OUT_OF_MEMORY;
+      
+      program->traversal = step->operation;
+      program->next = filter;
+      program->length = length + named;
+      instr = program->code;
+      
+      if (named) {
+        instr->opcode = XQ_INSTR_NAME;
+        instr->name = step->argv[0];
+        instr->arg = step->argv[1];
+        instr++;
+      }
+      
+      for (filter = step->next; filter != program->next; filter = filter->next, instr++) {
+        opcodeFor(filter->operation, &(instr->opcode));
+        instr->name = filter->argv[0];
+        instr->arg = instr->opcode == XQ_INSTR_ATTR_GREATER || instr->opcode == XQ_INSTR_ATTR_LESS ?
+          (const xmlChar*) xQ_filterBound(filter->argv) : filter->argv[1];
+      }
+      
+      step->program = program;
+    }
+  }
+  
+  return XQ_OK;
+}
+
+/**
+ * Find the instruction that runs a filter operation
+ *
+ * Returns 1 and sets opcode if there is one, 0 otherwise
+ */
+static int opcodeFor(xQSearchOp op, xQOpcode* opcode) {
+  if (op == _xQ_filterAttributeEquals)
+    *opcode = XQ_INSTR_ATTR_EQUALS;
+  else if (op == _xQ_filterAttributeExists)
+    *opcode = XQ_INSTR_ATTR_EXISTS;
+  else if (op == _xQ_filterAttributePrefix)
+    *opcode = XQ_INSTR_ATTR_PREFIX;
+  else if (op == _xQ_filterAttributeSuffix)
+    *opcode = XQ_INSTR_ATTR_SUFFIX;
+  else if (op == _xQ_filterAttributeContains)
+    *opcode = XQ_INSTR_ATTR_CONTAINS;
+  else if (op == _xQ_filterAttributeWord)
+    *opcode = XQ_INSTR_ATTR_WORD;
+  else if (op == _xQ_filterAttributeGreater)
+    *opcode = XQ_INSTR_ATTR_GREATER;
+  else if (op == _xQ_filterAttributeLess)
+    *opcode = XQ_INSTR_ATTR_LESS;
+  else if (op == _xQ_filterTextContains)
+    *opcode = XQ_INSTR_TEXT_CONTAINS;
+  else if (op == _xQ_filterTextEquals)
+    *opcode = XQ_INSTR_TEXT_EQUALS;
+  else
+    return 0;
+  
+  return 1;
+}
+
 /**
  * Allocate and initialize a new xQSearchExpr object that copies the
  * input node to the output.
@@ -660,7 +976,7 @@ static xQStatusCode xQSearchExpr_parseAttribs(xQSearchExpr** expr, xQToken* tok)
  */
 static xQStatusCode xQSearchExpr_alloc_init_copy(xQSearchExpr** self) {
   
-  *self = (xQSearchExpr*) malloc(sizeof(xQSearchExpr));
+  *self = (xQSearchExpr*) xQ_malloc(sizeof(xQSearchExpr));
   if (!*self)
     return XQ_OUT_OF_MEMORY;
   
@@ -668,6 +984,10 @@ static xQStatusCode xQSearchExpr_alloc_init_copy(xQSearchExpr** self) {
   (*self)->argv = 0;
   (*self)->operation = _xQ_addToOutput;
   (*self)->next = 0;
+  (*self)->alternative = 0;
+  (*self)->names = 0;
+  (*self)->plan = 0;
+  (*self)->program = 0;
   
   return XQ_OK;
 }
@@ -680,7 +1000,7 @@ static xQStatusCode xQSearchExpr_alloc_init_copy(xQSearchExpr** self) {
  */
 static xQStatusCode xQSearchExpr_alloc_init_allDescendants(xQSearchExpr** self) {
 
-  *self = (xQSearchExpr*) malloc(sizeof(xQSearchExpr));
+  *self = (xQSearchExpr*) xQ_malloc(sizeof(xQSearchExpr));
   if (!*self)
     return XQ_OUT_OF_MEMORY;
   
@@ -688,6 +1008,10 @@ static xQStatusCode xQSearchExpr_alloc_init_allDescendants(xQSearchExpr** self)
   (*self)->argv = 0;
   (*self)->operation = _xQ_findDescendants;
   (*self)->next = 0;
+  (*self)->alternative = 0;
+  (*self)->names = 0;
+  (*self)->plan = 0;
+  (*self)->program = 0;
   
   return XQ_OK;
 }
@@ -700,19 +1024,23 @@ static xQStatusCode xQSearchExpr_alloc_init_allDescendants(xQSearchExpr** self)
  */
 static xQStatusCode xQSearchExpr_alloc_init_searchDescendants(xQSearchExpr** self, xmlChar* name, xmlChar* ns) {
   
-  *self = (xQSearchExpr*) malloc(sizeof(xQSearchExpr));
+  *self = (xQSearchExpr*) xQ_malloc(sizeof(xQSearchExpr));
   if (!(*self)) {
     xmlFree(name);
     return XQ_OUT_OF_MEMORY;
   }
   
-  (*self)->argv = (xmlChar**) malloc(sizeof(xmlChar*) * 2);
+  (*self)->argv = (xmlChar**) xQ_malloc(sizeof(xmlChar*) * 2);
   if ((*self)->argv) {
     (*self)->argc = 2;
     (*self)->argv[0] = name;
     (*self)->argv[1] = ns;
     (*self)->operation = _xQ_findDescendantsByName;
     (*self)->next = 0;
+    (*self)->alternative = 0;
+    (*self)->names = 0;
+    (*self)->plan = 0;
+    (*self)->program = 0;
   } else {
     xmlFree(name);
     free(*self);
@@ -730,19 +1058,23 @@ static xQStatusCode xQSearchExpr_alloc_init_searchDescendants(xQSearchExpr** sel
  */
 static xQStatusCode xQSearchExpr_alloc_init_searchImmediate(xQSearchExpr** self, xmlChar* name, xmlChar* ns) {
   
-  *self = (xQSearchExpr*) malloc(sizeof(xQSearchExpr));
+  *self = (xQSearchExpr*) xQ_malloc(sizeof(xQSearchExpr));
   if (!(*self)) {
     xmlFree(name);
     return XQ_OUT_OF_MEMORY;
   }
   
-  (*self)->argv = (xmlChar**) malloc(sizeof(xmlChar*) * 2);
+  (*self)->argv = (xmlChar**) xQ_malloc(sizeof(xmlChar*) * 2);
   if ((*self)->argv) {
     (*self)->argc = 2;
     (*self)->argv[0] = name;
     (*self)->argv[1] = ns;
     (*self)->operation = _xQ_findChildrenByName;
     (*self)->next = 0;
+    (*self)->alternative = 0;
+    (*self)->names = 0;
+    (*self)->plan = 0;
+    (*self)->program = 0;
   } else {
     xmlFree(name);
     free(*self);
@@ -760,19 +1092,23 @@ static xQStatusCode xQSearchExpr_alloc_init_searchImmediate(xQSearchExpr** self,
  */
 static xQStatusCode xQSearchExpr_alloc_init_searchNextSibling(xQSearchExpr** self, xmlChar* name, xmlChar* ns) {
   
-  *self = (xQSearchExpr*) malloc(sizeof(xQSearchExpr));
+  *self = (xQSearchExpr*) xQ_malloc(sizeof(xQSearchExpr));
   if (!(*self)) {
     xmlFree(name);
     return XQ_OUT_OF_MEMORY;
   }
   
-  (*self)->argv = (xmlChar**) malloc(sizeof(xmlChar*) * 2);
+  (*self)->argv = (xmlChar**) xQ_malloc(sizeof(xmlChar*) * 2);
   if ((*self)->argv) {
     (*self)->argc = 2;
     (*self)->argv[0] = name;
     (*self)->argv[1] = ns;
     (*self)->operation = _xQ_findNextSiblingByName;
     (*self)->next = 0;
+    (*self)->alternative = 0;
+    (*self)->names = 0;
+    (*self)->plan = 0;
+    (*self)->program = 0;
   } else {
     xmlFree(name);
     free(*self);
@@ -784,26 +1120,45 @@ static xQStatusCode xQSearchExpr_alloc_init_searchNextSibling(xQSearchExpr** sel
 
 /**
  * Allocate and initialize a new xQSearchExpr object that copies the
- * input node only if it has a named attribute with a given value.
+ * input node only if it passes a filter operation taking up to two
+ * strings, such as _xQ_filterAttributeEquals with an attribute name and
+ * value. The value is 0 for operations that take only one. The value of a
+ * numeric comparison is parsed once here and its bound kept after the
+ * strings, where xQ_filterBound() finds it.
  *
  * Returns a pointer to the new instance or 0 on error
  */
-static xQStatusCode xQSearchExpr_alloc_init_filterAttrEquals(xQSearchExpr** self, xmlChar* name, xmlChar* value) {
+static xQStatusCode xQSearchExpr_alloc_init_filter(xQSearchExpr** self, xQSearchOp operation, xmlChar* name, xmlChar* value) {
+  int numeric = operation == _xQ_filterAttributeGreater || operation == _xQ_filterAttributeLess;
+  double bound = 0;
+  
+  (*self) = 0;
+  if (numeric && !xQ_parseNumber(value, &bound)) {
+    xmlFree(name);
+    xmlFree(value);
+    return XQ_INVALID_SEL_UNEXPECTED_TOKEN;
+  }
 
-  (*self) = (xQSearchExpr*) malloc(sizeof(xQSearchExpr));
-  if (!self) {
+  (*self) = (xQSearchExpr*) xQ_malloc(sizeof(xQSearchExpr));
+  if (!*self) {
     xmlFree(name);
     xmlFree(value);
     return XQ_OUT_OF_MEMORY;
   }
   
-  (*self)->argv = (xmlChar**) malloc(sizeof(xmlChar*) * 2);
+  (*self)->argv = (xmlChar**) xQ_malloc(sizeof(xmlChar*) * 2 + (numeric ? sizeof(double) : 0));
   if ((*self)->argv) {
+    if (numeric)
+      *((double*) xQ_filterBound((*self)->argv)) = bound;
     (*self)->argc = 2;
     (*self)->argv[0] = name;
     (*self)->argv[1] = value;
-    (*self)->operation = _xQ_filterAttributeEquals;
+    (*self)->operation = operation;
     (*self)->next = 0;
+    (*self)->alternative = 0;
+    (*self)->names = 0;
+    (*self)->plan = 0;
+    (*self)->program = 0;
   } else {
     xmlFree(name);
     xmlFree(value);
@@ -824,14 +1179,23 @@ xQStatusCode xQSearchExpr_free(xQSearchExpr* self) {
   
   if (!self)
     return XQ_OK;
+  
+  if (self->alternative)
+    xQSearchExpr_free(self->alternative);
 
-  if (self->argv)
+  if (self->argv) {
     for (i = 0; i < self->argc; i++)
       if (self->argv[i] && self->argv[i] != XQ_EMPTY_NAMESPACE)
         xmlFree(self->argv[i]);
+    free(self->argv);
+  }
   
   if (self->next)
-    return xQSearchExpr_free(self->next);
+    xQSearchExpr_free(self->next);
+  
+  free(self->plan);
+  free(self->program);
+  free(self);
   
   return XQ_OK;
 }
@@ -842,19 +1206,219 @@ xQStatusCode xQSearchExpr_free(xQSearchExpr* self) {
  * Returns a 0 (XQ_OK) on success, an error code otherwise
  */
 xQStatusCode xQSearchExpr_eval(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList) {
+  
+  if (xQ_isCancelled(context))
+    return XQ_CANCELLED;
+  
+  if (xQ_limitReached(context, outList))
+    return XQ_OK;
+  
+  if (xQ_isSeek(self) && xQPlan_covers(self->plan, node))
+    return _xQ_evalPlan(self, context, node, outList);
+  
+  if (self->alternative)
+    return xQSearchExpr_evalGroup(self, context, node, outList);
+  
+  return xQSearchExpr_evalSteps(self, context, node, outList);
+}
+
+/**
+ * Evaluate the steps of a single selector, ignoring any alternatives
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQSearchExpr_evalSteps(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList) {
   xQNodeList tmpList;
   xQStatusCode result;
   unsigned int i;
   
+  if (xQ_currentStats)
+    return xQSearchExpr_evalStats(self, context, node, outList);
+  
+  context->subtreeNames = self->names;
+  
+  if (self->program)
+    return xQSearchExpr_evalProgram(self->program, context, node, outList);
+  
   if (!self->next)
     return self->operation(context, self->argv, node, outList);
     
   xQNodeList_init(&tmpList, 8);
   result = self->operation(context, self->argv, node, &tmpList);
   
-  for (i = 0; result == XQ_OK && i < tmpList.size; i++)
+  for (i = 0; result == XQ_OK && i < tmpList.size && !xQ_limitReached(context, outList); i++)
+    result = xQSearchExpr_eval(self->next, context, tmpList.list[i], outList);
+  
+  xQNodeList_free(&tmpList, 0);
+  return result;
+}
+
+/**
+ * Evaluate a compiled step and the filters it includes, then the steps
+ * after them
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQSearchExpr_evalProgram(const xQProgram* program, xQ* context, xmlNodePtr node, xQNodeList* outList) {
+  xQNodeList tmpList;
+  xQStatusCode result;
+  unsigned int i;
+  
+  if (!program->next)
+    return _xQ_runProgram(context, program, node, outList);
+  
+  xQNodeList_init(&tmpList, 8);
+  result = _xQ_runProgram(context, program, node, &tmpList);
+  
+  for (i = 0; result == XQ_OK && i < tmpList.size && !xQ_limitReached(context, outList); i++)
+    result = xQSearchExpr_eval(program->next, context, tmpList.list[i], outList);
+  
+  xQNodeList_free(&tmpList, 0);
+  return result;
+}
+
+/**
+ * Evaluate a group of selectors against a node, producing each match once
+ * and in document order. When every selector in the group starts with a
+ * descendant search, a single walk of the subtree tests all of them.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQSearchExpr_evalGroup(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList) {
+  xQSearchExpr* alt;
+  xQNodeList matches;
+  xQNodeList* limitList = context->limitList;
+  xQStatusCode result = XQ_OK;
+  unsigned long i;
+  int singleWalk = 1, singleStep = 1;
+  
+  for (alt = self; alt; alt = alt->alternative) {
+    if (alt->operation != _xQ_findDescendants && alt->operation != _xQ_findDescendantsByName)
+      singleWalk = 0;
+    if (alt->next)
+      singleStep = 0;
+  }
+  
+  // a walk testing single step selectors ("a, b, c") meets each match
+  // once, in document order, so it can write straight to the output
+  if (singleWalk && singleStep)
+    return _xQ_findGroupDescendants(context, self, node, outList);
+  
+  if (XQ_OK != (result = xQNodeList_init(&matches, 8)))
+    return result;
+  
+  // the limit applies once the matches are merged
+  context->limitList = 0;
+  
+  if (singleWalk)
+    result = _xQ_findGroupDescendants(context, self, node, &matches);
+  else
+    for (alt = self; result == XQ_OK && alt; alt = alt->alternative)
+      result = xQSearchExpr_evalSteps(alt, context, node, &matches);
+  
+  context->limitList = limitList;
+  
+  if (result == XQ_OK && matches.size > 1)
+    result = xQNodeList_sortUnique(&matches, node);
+  
+  for (i = 0; result == XQ_OK && i < matches.size && !xQ_limitReached(context, outList); i++)
+    result = xQNodeList_push(outList, matches.list[i]);
+  
+  xQNodeList_free(&matches, 0);
+  return result;
+}
+
+/**
+ * Return the statistics recorded for a step of the search currently
+ * collecting them, or 0
+ */
+xQStepStats* xQStats_step(const xQSearchExpr* expr) {
+  unsigned int i;
+  
+  if (xQ_currentStats)
+    for (i = 0; i < xQ_currentStats->steps; i++)
+      if (xQ_currentStats->step[i].expr == expr)
+        return &(xQ_currentStats->step[i]);
+  
+  return 0;
+}
+
+/**
+ * Evaluate a search expression as xQSearchExpr_eval does, recording the
+ * work done by each step in the statistics of the current search
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQSearchExpr_evalStats(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList) {
+  xQStepStats* step = xQStats_step(self);
+  xQStepStats* outer = xQ_currentStep;
+  xQNodeList tmpList;
+  xQNodeList* stepList = self->next ? &tmpList : outList;
+  xQStatusCode result;
+  unsigned long before;
+  unsigned int i;
+  
+  if (self->next && XQ_OK != (result = xQNodeList_init(&tmpList, 8)))
+    return result;
+  
+  before = stepList->size;
+  xQ_currentStep = step;
+  context->subtreeNames = self->names;
+  
+  result = self->operation(context, self->argv, node, stepList);
+  
+  xQ_currentStep = outer;
+  if (step) {
+    step->calls++;
+    step->produced += stepList->size - before;
+  }
+  
+  if (!self->next)
+    return result;
+  
+  for (i = 0; result == XQ_OK && i < tmpList.size && !xQ_limitReached(context, outList); i++)
     result = xQSearchExpr_eval(self->next, context, tmpList.list[i], outList);
   
   xQNodeList_free(&tmpList, 0);
   return result;
 }
+
+/**
+ * Return the name of a search operation, or "unknown" for an operation
+ * that is not part of libxq
+ */
+const char* xQSearchOp_name(xQSearchOp op) {
+  if (op == _xQ_findDescendants)
+    return "findDescendants";
+  if (op == _xQ_findDescendantsByName)
+    return "findDescendantsByName";
+  if (op == _xQ_findChildrenByName)
+    return "findChildrenByName";
+  if (op == _xQ_findNextSiblingByName)
+    return "findNextSiblingByName";
+  if (op == _xQ_filterAttributeEquals)
+    return "filterAttributeEquals";
+  if (op == _xQ_filterAttributeExists)
+    return "filterAttributeExists";
+  if (op == _xQ_filterAttributePrefix)
+    return "filterAttributePrefix";
+  if (op == _xQ_filterAttributeSuffix)
+    return "filterAttributeSuffix";
+  if (op == _xQ_filterAttributeContains)
+    return "filterAttributeContains";
+  if (op == _xQ_filterAttributeWord)
+    return "filterAttributeWord";
+  if (op == _xQ_filterAttributeGreater)
+    return "filterAttributeGreater";
+  if (op == _xQ_filterAttributeLess)
+    return "filterAttributeLess";
+  if (op == _xQ_filterTextContains)
+    return "filterTextContains";
+  if (op == _xQ_filterTextEquals)
+    return "filterTextEquals";
+  if (op == _xQ_addToOutput)
+    return "addToOutput";
+  if (op == _xQ_filterByName)
+    return "filterByName";
+  return "unknown";
+}
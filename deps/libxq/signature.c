@@ -0,0 +1,309 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Subtree signatures
+ *
+ * A signature is a small Bloom filter of the names of the elements below
+ * a node. A search for a name can skip every subtree whose signature
+ * lacks that name's bits, without visiting any of its nodes. Signatures
+ * are only kept for subtrees large enough for skipping them to pay off,
+ * and fewer of them are kept when the table would outgrow its memory
+ * bound. A node with no signature may hold any name.
+ */
+
+#include "libxq.h"
+#include "xqutil.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct _xQSignatureEntry {
+  xmlNodePtr node;            // 0 for an empty slot
+  xQSignature names;          // names of the elements below node
+  unsigned long descendants;  // number of elements below node
+};
+
+typedef struct _xQSignatureEntry xQSignatureEntry;
+
+// names seen while building, cached by their (usually shared) string
+#define XQ_SIGNATURE_CACHE_SIZE 256
+
+typedef struct _xQNameCache {
+  const xmlChar* name[XQ_SIGNATURE_CACHE_SIZE];
+  xQSignature names[XQ_SIGNATURE_CACHE_SIZE];
+} xQNameCache;
+
+// the table is first allocated with this many slots
+#define XQ_SIGNATURES_INITIAL_CAPACITY 64
+
+#define slotFor(self, node) \
+  ((unsigned long) (((((size_t) (node)) >> 4) * 2654435761UL) ^ (((size_t) (node)) >> 16)) & ((self)->capacity - 1))
+
+// local (private) routines
+static xQStatusCode buildSignature(xQSignatures* self, xQNameCache* cache, xmlNodePtr node, xQSignature* names, unsigned long* descendants);
+static xQStatusCode addSignature(xQSignatures* self, xmlNodePtr node, xQSignature names, unsigned long descendants);
+static xQStatusCode resizeTable(xQSignatures* self, unsigned long capacity);
+static XQINLINE xQSignature cachedSignature(xQNameCache* cache, const xmlChar* name);
+
+
+/**
+ * Allocate and initialize the signatures of a document. They are empty
+ * until xQSignatures_build() is called, so the cost of building them can
+ * be put off until a search needs them. The table of signatures never
+ * uses more than maxBytes, or XQ_SIGNATURES_DEFAULT_MAX_BYTES when
+ * maxBytes is 0.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQSignatures_alloc_init(xQSignatures** self, xmlDocPtr doc, unsigned long maxBytes) {
+  *self = (xQSignatures*) xQ_malloc(sizeof(xQSignatures));
+  if (!*self)
+    return XQ_OUT_OF_MEMORY;
+
+  memset(*self, 0, sizeof(xQSignatures));
+  (*self)->document = doc;
+  (*self)->minDescendants = XQ_SIGNATURES_MIN_DESCENDANTS;
+  (*self)->maxBytes = maxBytes ? maxBytes : XQ_SIGNATURES_DEFAULT_MAX_BYTES;
+
+  return XQ_OK;
+}
+
+/**
+ * Build the signatures of the document in a single pass over it. Does
+ * nothing if they have already been built. The document must not change
+ * once its signatures are built.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQSignatures_build(xQSignatures* self) {
+  xQStatusCode status;
+  xQNameCache* cache;
+  xQSignature names = 0;
+  unsigned long descendants = 0;
+
+  if (self->built || !self->document)
+    return XQ_OK;
+
+  cache = (xQNameCache*) calloc(1, sizeof(xQNameCache));
+  if (!cache)
+    return XQ_OUT_OF_MEMORY;
+
+  status = buildSignature(self, cache, (xmlNodePtr) self->document, &names, &descendants);
+
+  free(cache);
+
+  if (status != XQ_OK) {
+    free(self->table);
+    self->table = 0;
+    self->capacity = self->size = self->bytes = 0;
+    return status;
+  }
+
+  self->built = 1;
+  return XQ_OK;
+}
+
+/**
+ * Free the signatures of a document
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQSignatures_free(xQSignatures* self) {
+  if (!self)
+    return XQ_OK;
+
+  free(self->table);
+  free(self);
+
+  return XQ_OK;
+}
+
+/**
+ * Look up the signature of the elements below node
+ *
+ * Returns 1 and sets names if node has a signature, 0 otherwise
+ */
+int xQSignatures_get(const xQSignatures* self, xmlNodePtr node, xQSignature* names) {
+  unsigned long slot;
+
+  if (!self->size || node->doc != self->document)
+    return 0;
+
+  for (slot = slotFor(self, node); self->table[slot].node; slot = (slot + 1) & (self->capacity - 1)) {
+    if (self->table[slot].node == node) {
+      *names = self->table[slot].names;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Return 0 if the elements below node certainly don't include every name
+ * in the signature names, 1 if they may
+ */
+int xQSignatures_mayHold(const xQSignatures* self, xmlNodePtr node, xQSignature names) {
+  xQSignature held;
+
+  return !xQSignatures_get(self, node, &held) || (held & names) == names;
+}
+
+/**
+ * Return the signature of a single name
+ */
+xQSignature xQSignature_forName(const xmlChar* name) {
+  unsigned long hash = 2166136261UL;
+
+  while (*name) {
+    hash = ((hash ^ *name++) * 16777619UL) & 0xffffffffUL;
+  }
+
+  return ((xQSignature) 1 << (hash & 63)) | ((xQSignature) 1 << ((hash >> 6) & 63));
+}
+
+/**
+ * Compute the signature and the number of the elements below node, adding
+ * the signatures of large enough subtrees to the table on the way
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode buildSignature(xQSignatures* self, xQNameCache* cache, xmlNodePtr node, xQSignature* names, unsigned long* descendants) {
+  xQStatusCode status = XQ_OK;
+  xmlNodePtr cur = node->children;
+  xQSignature childNames;
+  unsigned long childDescendants;
+
+  *names = 0;
+  *descendants = 0;
+
+  while (cur && status == XQ_OK) {
+
+    if (cur->type == XML_ELEMENT_NODE) {
+      *names |= cachedSignature(cache, cur->name);
+      (*descendants)++;
+
+      if (cur->children) {
+        status = buildSignature(self, cache, cur, &childNames, &childDescendants);
+        *names |= childNames;
+        *descendants += childDescendants;
+      }
+    }
+
+    cur = cur->next;
+  }
+
+  if (status == XQ_OK && *descendants >= self->minDescendants)
+    status = addSignature(self, node, *names, *descendants);
+
+  return status;
+}
+
+/**
+ * Add the signature of a subtree to the table. When the table is full
+ * and can't grow, the signatures of the smallest subtrees are dropped to
+ * make room, which may include the one being added.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode addSignature(xQSignatures* self, xmlNodePtr node, xQSignature names, unsigned long descendants) {
+  xQStatusCode status = XQ_OK;
+  unsigned long slot;
+
+  // keep the table at most half full
+  while (status == XQ_OK && (self->size + 1) * 2 > self->capacity) {
+
+    if (self->capacity && self->capacity * 2 * sizeof(xQSignatureEntry) > self->maxBytes) {
+      if (descendants < self->minDescendants * 2)
+        return XQ_OK;
+
+      self->minDescendants *= 2;
+      status = resizeTable(self, self->capacity);
+
+    } else if (!self->capacity && XQ_SIGNATURES_INITIAL_CAPACITY * sizeof(xQSignatureEntry) > self->maxBytes) {
+      return XQ_OK;
+
+    } else {
+      status = resizeTable(self, self->capacity ? self->capacity * 2 : XQ_SIGNATURES_INITIAL_CAPACITY);
+    }
+  }
+
+  if (status != XQ_OK)
+    return status;
+
+  for (slot = slotFor(self, node); self->table[slot].node; slot = (slot + 1) & (self->capacity - 1))
+    ;
+
+  self->table[slot].node = node;
+  self->table[slot].names = names;
+  self->table[slot].descendants = descendants;
+  self->size++;
+
+  return XQ_OK;
+}
+
+/**
+ * Move the table to a new one with the given capacity, keeping only the
+ * signatures of subtrees that are still large enough
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode resizeTable(xQSignatures* self, unsigned long capacity) {
+  xQSignatureEntry* old = self->table;
+  unsigned long oldCapacity = self->capacity;
+  unsigned long i, slot;
+
+  xQ_countAlloc(capacity * sizeof(xQSignatureEntry));
+  self->table = (xQSignatureEntry*) calloc(capacity, sizeof(xQSignatureEntry));
+  if (!self->table) {
+    self->table = old;
+    return XQ_OUT_OF_MEMORY;
+  }
+
+  self->capacity = capacity;
+  self->bytes = capacity * sizeof(xQSignatureEntry);
+  self->size = 0;
+
+  for (i = 0; i < oldCapacity; i++) {
+    if (!old[i].node || old[i].descendants < self->minDescendants)
+      continue;
+
+    for (slot = slotFor(self, old[i].node); self->table[slot].node; slot = (slot + 1) & (capacity - 1))
+      ;
+
+    self->table[slot] = old[i];
+    self->size++;
+  }
+
+  free(old);
+
+  return XQ_OK;
+}
+
+/**
+ * Return the signature of a name, computing it only if it isn't cached
+ */
+static XQINLINE xQSignature cachedSignature(xQNameCache* cache, const xmlChar* name) {
+  unsigned int slot = (unsigned int) ((((size_t) name) >> 3) & (XQ_SIGNATURE_CACHE_SIZE - 1));
+
+  if (cache->name[slot] != name) {
+    cache->name[slot] = name;
+    cache->names[slot] = xQSignature_forName(name);
+  }
+
+  return cache->names[slot];
+}
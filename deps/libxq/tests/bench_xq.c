@@ -0,0 +1,444 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Microbenchmarks for libxq
+ *
+ * Times selector compilation, selector evaluation and each traversal
+ * kernel directly against libxml2 documents, without the JavaScript
+ * binding, so engine changes can be measured on their own. For each
+ * benchmark it reports the time per operation and per node visited,
+ * the allocations made through libxml2's allocator (counted with an
+ * xmlMemSetup() hook), and cache misses where perf_event_open() is
+ * available. Results are printed as JSON.
+ *
+ * usage: bench_xq [-n records] [-t milliseconds]
+ */
+
+#include "config.h"
+
+#include <libxq.h>
+#include <libxml/xmlmemory.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define DEPTH 32
+
+/**
+ * Allocation counting hooks for libxml2's allocator
+ */
+static unsigned long allocCount = 0;
+static unsigned long allocBytes = 0;
+
+static void* countingMalloc(size_t size) {
+  ++allocCount;
+  allocBytes += size;
+  return malloc(size);
+}
+
+static void* countingRealloc(void* ptr, size_t size) {
+  ++allocCount;
+  allocBytes += size;
+  return realloc(ptr, size);
+}
+
+static char* countingStrdup(const char* str) {
+  ++allocCount;
+  allocBytes += strlen(str) + 1;
+  return strdup(str);
+}
+
+/**
+ * Cache miss counter. perfFd is -1 when counters aren't available.
+ */
+static int perfFd = -1;
+
+static void perfOpen() {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+  struct perf_event_attr attr;
+  
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  
+  perfFd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static void perfStart() {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+  if (perfFd >= 0) {
+    ioctl(perfFd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(perfFd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+static long long perfStop() {
+  long long count = -1;
+  
+#ifdef HAVE_LINUX_PERF_EVENT_H
+  if (perfFd >= 0) {
+    ioctl(perfFd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(perfFd, &count, sizeof(count)) != sizeof(count))
+      count = -1;
+  }
+#endif
+  
+  return count;
+}
+
+/**
+ * Return a monotonic time in nanoseconds
+ */
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Build a document with `count` shallow records
+ */
+static xmlDocPtr buildWide(int count) {
+  xmlDocPtr doc = xmlNewDoc((xmlChar*)"1.0");
+  xmlNodePtr root = xmlNewDocNode(doc, 0, (xmlChar*)"records", 0);
+  xmlNodePtr record;
+  char buf[32];
+  int i;
+
+  xmlDocSetRootElement(doc, root);
+
+  for (i = 0; i < count; i++) {
+    snprintf(buf, sizeof(buf), "%d", i);
+    record = xmlNewChild(root, 0, (xmlChar*)"record", 0);
+    xmlNewProp(record, (xmlChar*)"id", (xmlChar*)buf);
+    xmlNewProp(xmlNewChild(record, 0, (xmlChar*)"item", (xmlChar*)"value"), (xmlChar*)"type", (xmlChar*)((i % 3) ? "a" : "b"));
+    xmlNewProp(xmlNewChild(record, 0, (xmlChar*)"item", (xmlChar*)buf), (xmlChar*)"type", (xmlChar*)"c");
+  }
+
+  return doc;
+}
+
+/**
+ * Build a document with `count` records, each nested DEPTH levels deep
+ */
+static xmlDocPtr buildDeep(int count) {
+  xmlDocPtr doc = xmlNewDoc((xmlChar*)"1.0");
+  xmlNodePtr root = xmlNewDocNode(doc, 0, (xmlChar*)"records", 0);
+  xmlNodePtr cur, record;
+  char buf[32];
+  int i, d;
+
+  xmlDocSetRootElement(doc, root);
+
+  for (i = 0; i < count / DEPTH + 1; i++) {
+    cur = root;
+    for (d = 0; d < DEPTH; d++)
+      cur = xmlNewChild(cur, 0, (xmlChar*)"level", 0);
+    
+    snprintf(buf, sizeof(buf), "%d", i);
+    record = xmlNewChild(cur, 0, (xmlChar*)"record", 0);
+    xmlNewProp(record, (xmlChar*)"id", (xmlChar*)buf);
+    xmlNewProp(xmlNewChild(record, 0, (xmlChar*)"item", (xmlChar*)"value"), (xmlChar*)"type", (xmlChar*)((i % 3) ? "a" : "b"));
+  }
+
+  return doc;
+}
+
+/**
+ * Count the nodes below node, of any type
+ */
+static unsigned long countNodes(xmlNodePtr node) {
+  unsigned long count = 0;
+  xmlNodePtr cur;
+  
+  for (cur = node->children; cur; cur = cur->next)
+    count += 1 + countNodes(cur);
+  
+  return count;
+}
+
+/**
+ * Print a string as a JSON string
+ */
+static void printJsonString(const char* str) {
+  putchar('"');
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      putchar('\\');
+    putchar(*str);
+  }
+  putchar('"');
+}
+
+/**
+ * What a benchmark runs: one call of fn(arg) is one operation
+ */
+typedef void (*benchFn)(void* arg);
+
+static int minTime = 200;
+static int firstResult = 1;
+
+/**
+ * Time fn until minTime ms have passed and print the result
+ */
+static void measure(const char* shape, const char* name, benchFn fn, void* arg, unsigned long visited) {
+  unsigned long iterations = 0, allocs, bytes;
+  long long misses;
+  double start, total = 0;
+  
+  // warm up
+  fn(arg);
+  
+  allocCount = allocBytes = 0;
+  perfStart();
+  
+  while (total < minTime * 1e6 || !iterations) {
+    start = now();
+    fn(arg);
+    total += now() - start;
+    ++iterations;
+  }
+  
+  misses = perfStop();
+  allocs = allocCount;
+  bytes = allocBytes;
+  
+  printf("%s    {\"shape\": \"%s\", \"name\": ", firstResult ? "" : ",\n", shape);
+  printJsonString(name);
+  printf(", \"iterations\": %lu, \"nsPerOp\": %.1f, "
+         "\"nodesVisited\": %lu, \"nsPerNode\": %.3f, \"xmlAllocsPerOp\": %.2f, \"xmlBytesPerOp\": %.1f, "
+         "\"cacheMissesPerOp\": ",
+         iterations, total / iterations,
+         visited, visited ? total / iterations / visited : 0.0,
+         (double) allocs / iterations, (double) bytes / iterations);
+  
+  if (misses >= 0)
+    printf("%.1f}", (double) misses / iterations);
+  else
+    printf("null}");
+  
+  firstResult = 0;
+}
+
+/**
+ * Selector compilation
+ */
+static void benchCompile(void* arg) {
+  xQSearchExpr* expr;
+  
+  if (xQSearchExpr_alloc_init(&expr, (const xmlChar*) arg) == XQ_OK)
+    xQSearchExpr_free(expr);
+}
+
+/**
+ * State for running one expression or kernel against a node
+ */
+typedef struct {
+  xQ* context;
+  xQSearchExpr* expr;
+  xQSearchOp op;
+  xmlChar* args[2];
+  xQNodeList nodes;
+  xQNodeList out;
+} evalState;
+
+/**
+ * Selector evaluation against one node. The output list keeps its
+ * capacity between runs so only the engine's own allocations count.
+ */
+static void benchEval(void* arg) {
+  evalState* state = (evalState*) arg;
+  
+  state->out.size = 0;
+  xQSearchExpr_eval(state->expr, state->context, state->nodes.list[0], &(state->out));
+}
+
+/**
+ * A traversal kernel applied to every node in a list
+ */
+static void benchKernel(void* arg) {
+  evalState* state = (evalState*) arg;
+  unsigned long i;
+  
+  state->out.size = 0;
+  for (i = 0; i < state->nodes.size; i++)
+    state->op(state->context, state->args, state->nodes.list[i], &(state->out));
+}
+
+/**
+ * Collect the elements named name below node
+ */
+static void collect(xmlNodePtr node, const char* name, xQNodeList* list) {
+  xmlNodePtr cur;
+  
+  for (cur = node->children; cur; cur = cur->next) {
+    if (cur->type == XML_ELEMENT_NODE) {
+      if (xmlStrcmp(cur->name, (const xmlChar*) name) == 0)
+        xQNodeList_push(list, cur);
+      collect(cur, name, list);
+    }
+  }
+}
+
+/**
+ * Run every benchmark against a document
+ */
+static void runAll(const char* shape, xmlDocPtr doc) {
+  static const char* selectors[] = {
+    "item",
+    "records item",
+    "record > item",
+    "item[type=\"b\"]",
+    "record item + item",
+    0
+  };
+  evalState state;
+  xmlNodePtr root = xmlDocGetRootElement(doc);
+  unsigned long total = countNodes((xmlNodePtr) doc), visited, i;
+  char name[128];
+  const char** sel;
+  
+  memset(&state, 0, sizeof(state));
+  xQ_alloc_initDoc(&(state.context), doc);
+  xQNodeList_init(&(state.nodes), 64);
+  xQNodeList_init(&(state.out), 64);
+  
+  for (sel = selectors; *sel; sel++) {
+    snprintf(name, sizeof(name), "xQSearchExpr_alloc_init %s", *sel);
+    measure(shape, name, benchCompile, (void*) *sel, 0);
+  }
+  
+  // evaluation from the document, visiting up to every node
+  xQNodeList_push(&(state.nodes), (xmlNodePtr) doc);
+  
+  for (sel = selectors; *sel; sel++) {
+    if (xQSearchExpr_alloc_init(&(state.expr), (const xmlChar*) *sel) != XQ_OK)
+      continue;
+    
+    snprintf(name, sizeof(name), "xQSearchExpr_eval %s", *sel);
+    measure(shape, name, benchEval, &state, total);
+    
+    xQSearchExpr_free(state.expr);
+    state.expr = 0;
+  }
+  
+  // descendant kernels from the document
+  state.args[0] = (xmlChar*) "item";
+  state.args[1] = 0;
+  
+  state.op = _xQ_findDescendants;
+  measure(shape, "_xQ_findDescendants", benchKernel, &state, total);
+  
+  state.op = _xQ_findDescendantsByName;
+  measure(shape, "_xQ_findDescendantsByName", benchKernel, &state, total);
+  
+  // child, sibling and filter kernels over every record or item
+  state.nodes.size = 0;
+  collect(root, "record", &(state.nodes));
+  
+  for (visited = 0, i = 0; i < state.nodes.size; i++) {
+    xmlNodePtr cur;
+    for (cur = state.nodes.list[i]->children; cur; cur = cur->next)
+      ++visited;
+  }
+  
+  state.op = _xQ_findChildrenByName;
+  measure(shape, "_xQ_findChildrenByName", benchKernel, &state, visited);
+  
+  state.nodes.size = 0;
+  collect(root, "item", &(state.nodes));
+  
+  state.op = _xQ_findNextSiblingByName;
+  measure(shape, "_xQ_findNextSiblingByName", benchKernel, &state, state.nodes.size);
+  
+  state.op = _xQ_filterByName;
+  measure(shape, "_xQ_filterByName", benchKernel, &state, state.nodes.size);
+  
+  state.args[0] = (xmlChar*) "type";
+  state.args[1] = (xmlChar*) "b";
+  state.op = _xQ_filterAttributeEquals;
+  measure(shape, "_xQ_filterAttributeEquals", benchKernel, &state, state.nodes.size);
+  
+  state.op = _xQ_addToOutput;
+  measure(shape, "_xQ_addToOutput", benchKernel, &state, state.nodes.size);
+  
+  xQNodeList_free(&(state.out), 0);
+  xQNodeList_free(&(state.nodes), 0);
+  xQ_free(state.context, 1);
+}
+
+int main(int argc, char** argv) {
+  int records = 10000;
+  int opt;
+  xmlDocPtr doc;
+  
+  while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+    switch (opt) {
+    case 'n':
+      records = atoi(optarg);
+      break;
+    case 't':
+      minTime = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n records] [-t milliseconds]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  
+  // must be installed before libxml2 allocates anything
+  xmlMemSetup(free, countingMalloc, countingRealloc, countingStrdup);
+  xmlInitParser();
+  
+  perfOpen();
+  
+  printf("{\n  \"benchmark\": \"bench_xq\",\n  \"records\": %d,\n  \"minTimeMs\": %d,\n"
+         "  \"cacheMisses\": %s,\n  \"results\": [\n",
+         records, minTime, perfFd >= 0 ? "true" : "false");
+  
+  doc = buildWide(records);
+  runAll("wide", doc);
+  xmlFreeDoc(doc);
+  
+  doc = buildDeep(records);
+  runAll("deep", doc);
+  xmlFreeDoc(doc);
+  
+  printf("\n  ]\n}\n");
+  
+  if (perfFd >= 0)
+    close(perfFd);
+  
+  xmlCleanupParser();
+  
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <check.h>
+
+#include <libxq.h>
+
+#include <string.h>
+
+#define singleTestCase(suite, var, name, test) do { \
+    TCase* var = tcase_create(name); \
+    tcase_add_test(var, test); \
+    suite_add_tcase(s, var); \
+  } while(0)
+
+/**
+ * Build a document with `count` <item> elements, each holding a few children
+ */
+static xmlDocPtr buildItems(int count) {
+  xmlDocPtr doc = xmlNewDoc((xmlChar*)"1.0");
+  xmlNodePtr root = xmlNewDocNode(doc, 0, (xmlChar*)"doc", 0);
+  xmlNodePtr item;
+  char buf[32];
+  int i;
+
+  xmlDocSetRootElement(doc, root);
+
+  for (i = 0; i < count; i++) {
+    item = xmlNewChild(root, 0, (xmlChar*)"item", 0);
+    snprintf(buf, sizeof(buf), "%d", i);
+    xmlNewChild(item, 0, (xmlChar*)"name", (xmlChar*)buf);
+    if (i % 3 == 0) {
+      xmlNewChild(xmlNewChild(item, 0, (xmlChar*)"group", 0), 0, (xmlChar*)"name", (xmlChar*)"nested");
+    }
+  }
+
+  return doc;
+}
+
+/**
+ * Run the same find serially and in parallel and compare the results,
+ * along with the counts of each
+ */
+static void compareFind(xQ* context, const char* selector) {
+  xQ* serial;
+  xQ* parallel;
+  xQStatusCode status;
+  unsigned long i, serialCount, parallelCount;
+
+  xQ_setParallelism(context, 1, 1024);
+  status = xQ_find(context, (xmlChar*)selector, &serial);
+  ck_assert(status == XQ_OK);
+  status = xQ_count(context, (xmlChar*)selector, &serialCount);
+  ck_assert(status == XQ_OK);
+
+  xQ_setParallelism(context, 4, 2);
+  status = xQ_find(context, (xmlChar*)selector, &parallel);
+  ck_assert(status == XQ_OK);
+  status = xQ_count(context, (xmlChar*)selector, &parallelCount);
+  ck_assert(status == XQ_OK);
+
+  // results carry the settings of the search they came from
+  ck_assert(serial->threads == 1 && serial->threshold == 1024);
+  ck_assert(parallel->threads == 4 && parallel->threshold == 2);
+
+  xQ_setParallelism(context, 1, 1024);
+
+  ck_assert(serialCount == xQ_length(serial));
+  ck_assert(parallelCount == xQ_length(serial));
+
+  ck_assert(xQ_length(serial) > 0);
+  ck_assert(xQ_length(serial) == xQ_length(parallel));
+
+  for (i = 0; i < xQ_length(serial); i++)
+    ck_assert(serial->context.list[i] == parallel->context.list[i]);
+
+  xQ_free(parallel, 1);
+  xQ_free(serial, 1);
+}
+
+/**
+ * Test that a parallel find returns the same nodes in the same order
+ */
+START_TEST (test_parallel_matches_serial)
+{
+  xQ* x;
+  xQ* items;
+  xQStatusCode status;
+  xmlDocPtr doc = buildItems(500);
+
+  status = xQ_alloc_initDoc(&x, doc);
+  ck_assert(status == XQ_OK);
+
+  status = xQ_find(x, (xmlChar*)"item", &items);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(items) == 500);
+
+  compareFind(items, "name");
+  compareFind(items, "> name");
+  compareFind(items, "group name");
+  compareFind(items, "name + group");
+
+  xQ_free(items, 1);
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test that a descendant search from a single large root is split by
+ * subtree and still returns the nodes of a serial search in order
+ */
+START_TEST (test_parallel_subtree_scan)
+{
+  xQ* x;
+  xmlDocPtr doc = buildItems(5000);
+  xmlNodePtr deep = xmlDocGetRootElement(doc);
+  xQStatusCode status;
+  int i;
+
+  // a long chain of nested groups ending in a wide one forces the scan
+  // to split inside a single large subtree
+  for (i = 0; i < 3000; i++)
+    deep = xmlNewChild(deep, 0, (xmlChar*)"group", 0);
+  for (i = 0; i < 20000; i++)
+    xmlNewChild(xmlNewChild(deep, 0, (xmlChar*)"item", 0), 0, (xmlChar*)"name", (xmlChar*)"wide");
+
+  status = xQ_alloc_initDoc(&x, doc);
+  ck_assert(status == XQ_OK);
+
+  compareFind(x, "*");
+  compareFind(x, "name");
+  compareFind(x, "item name");
+  compareFind(x, "group > name");
+  compareFind(x, "doc > item");
+
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test that a subtree scan tests elements with the compiled filters of
+ * the step and skips subtrees by their signatures as a serial search does
+ */
+START_TEST (test_parallel_subtree_indexes)
+{
+  xQ* x;
+  xQSignatures* signatures;
+  xmlDocPtr doc = buildItems(20000);
+  xmlNodePtr deep = xmlDocGetRootElement(doc);
+  xQStatusCode status;
+  unsigned long count;
+  int i;
+
+  for (i = 0; i < 1000; i++)
+    deep = xmlNewChild(deep, 0, (xmlChar*)"group", 0);
+  xmlNewChild(deep, 0, (xmlChar*)"rare", (xmlChar*)"deep");
+
+  status = xQ_alloc_initDoc(&x, doc);
+  ck_assert(status == XQ_OK);
+
+  compareFind(x, "name:contains(99)");
+  compareFind(x, "group > name:text(nested)");
+  compareFind(x, "*:contains(deep)");
+
+  status = xQSignatures_alloc_init(&signatures, doc, XQ_SIGNATURES_DEFAULT_MAX_BYTES);
+  ck_assert(status == XQ_OK);
+  status = xQSignatures_build(signatures);
+  ck_assert(status == XQ_OK);
+  x->signatures = signatures;
+
+  compareFind(x, "rare");
+  compareFind(x, "group rare");
+  compareFind(x, "item name:contains(99)");
+  compareFind(x, "group > name:text(nested)");
+  compareFind(x, "*:contains(deep)");
+
+  // an unknown prefix fails the same way on every path
+  xQ_setParallelism(x, 4, 2);
+  status = xQ_count(x, (xmlChar*)"x:name:contains(1)", &count);
+  ck_assert(status == XQ_UNKNOWN_NS_PREFIX);
+
+  xQ_free(x, 1);
+  xQSignatures_free(signatures);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test the parallelism settings
+ */
+START_TEST (test_parallelism_settings)
+{
+  xQ* x;
+  xQ* copy;
+  xQStatusCode status;
+  xmlDocPtr doc = buildItems(10);
+
+  status = xQ_alloc_initDoc(&x, doc);
+  ck_assert(status == XQ_OK);
+  ck_assert(x->threads == 1);
+  ck_assert(x->threshold == XQ_PARALLEL_DEFAULT_THRESHOLD);
+
+  xQ_setParallelism(x, 0, 0);
+  ck_assert(x->threads == 1);
+  ck_assert(x->threshold == 1);
+
+  xQ_setParallelism(x, 4, 100);
+  ck_assert(x->threads == 4);
+  ck_assert(x->threshold == 100);
+
+  // a copy searched on another thread keeps the settings
+  status = xQ_alloc_initCopy(&copy, x);
+  ck_assert(status == XQ_OK);
+  ck_assert(copy->threads == 4);
+  ck_assert(copy->threshold == 100);
+
+  xQ_free(copy, 1);
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+
+
+/**
+ * Test suite
+ */
+Suite* parallel_suite() {
+  Suite* s = suite_create("xQ parallel");
+
+  singleTestCase(s, tc_parallel_matches_serial, "parallel find matches serial", test_parallel_matches_serial);
+
+  singleTestCase(s, tc_parallel_subtree_scan, "parallel subtree scan", test_parallel_subtree_scan);
+
+  singleTestCase(s, tc_parallel_subtree_indexes, "parallel subtree scan with indexes", test_parallel_subtree_indexes);
+
+  singleTestCase(s, tc_parallelism_settings, "parallelism settings", test_parallelism_settings);
+
+  return s;
+}
+
+
+int main() {
+  int numFailed;
+  Suite* s = parallel_suite();
+  SRunner *sr = srunner_create(s);
+  
+  srunner_run_all(sr, CK_NORMAL);
+  
+  numFailed = srunner_ntests_failed(sr);
+  
+  srunner_free(sr);
+  
+  return (numFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,559 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <check.h>
+
+#include <libxq.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define singleTestCase(suite, var, name, test) do { \
+    TCase* var = tcase_create(name); \
+    tcase_add_test(var, test); \
+    suite_add_tcase(s, var); \
+  } while(0)
+
+#define SECTIONS 20
+#define ITEMS 30
+
+/**
+ * Build a document with SECTIONS <section> elements of ITEMS <item>
+ * elements each. Every item has an id, a class of "odd" or "even" and a
+ * <name>, and one item in the last section also holds a <rare> element.
+ * The sections are grouped in <part> elements, which nest.
+ */
+static xmlDocPtr buildSections() {
+  xmlDocPtr doc = xmlNewDoc((xmlChar*)"1.0");
+  xmlNodePtr root = xmlNewDocNode(doc, 0, (xmlChar*)"doc", 0);
+  xmlNodePtr part = xmlNewChild(root, 0, (xmlChar*)"part", 0);
+  xmlNodePtr section, item;
+  char id[32];
+  int i, j;
+
+  xmlDocSetRootElement(doc, root);
+  part = xmlNewChild(part, 0, (xmlChar*)"part", 0);
+
+  for (i = 0; i < SECTIONS; i++) {
+    section = xmlNewChild(part, 0, (xmlChar*)"section", 0);
+
+    for (j = 0; j < ITEMS; j++) {
+      item = xmlNewChild(section, 0, (xmlChar*)"item", 0);
+      snprintf(id, sizeof(id), "i%d-%d", i, j);
+      xmlSetProp(item, (xmlChar*)"id", (xmlChar*)id);
+      xmlSetProp(item, (xmlChar*)"class", (xmlChar*)(j % 2 ? "odd" : "even"));
+      xmlNewChild(item, 0, (xmlChar*)"name", (xmlChar*)id);
+      if (i == SECTIONS - 1 && j == ITEMS / 2)
+        xmlNewChild(item, 0, (xmlChar*)"rare", (xmlChar*)"y");
+    }
+  }
+
+  return doc;
+}
+
+/**
+ * Search with and without document statistics and compare the results.
+ * Returns the method the search was planned with.
+ */
+static xQPlanMethod compareFind(xQ* context, xQDocStats* docStats, const char* selector, unsigned long limit, unsigned int maxDepth) {
+  xQ* plain;
+  xQ* planned;
+  xQSearchExpr* expr;
+  xQPlanMethod method;
+  xQStatusCode status;
+  unsigned long i, count;
+  int found;
+
+  context->docStats = 0;
+  status = xQ_findLimited(context, (xmlChar*)selector, limit, maxDepth, &plain);
+  ck_assert(status == XQ_OK);
+
+  context->docStats = docStats;
+  status = xQ_findLimited(context, (xmlChar*)selector, limit, maxDepth, &planned);
+  ck_assert(status == XQ_OK);
+
+  ck_assert(xQ_length(plain) == xQ_length(planned));
+  for (i = 0; i < xQ_length(plain); i++)
+    ck_assert(plain->context.list[i] == planned->context.list[i]);
+
+  if (!limit && !maxDepth) {
+    status = xQ_count(context, (xmlChar*)selector, &count);
+    ck_assert(status == XQ_OK && count == xQ_length(plain));
+
+    found = 0;
+    status = xQ_exists(context, (xmlChar*)selector, &found);
+    ck_assert(status == XQ_OK && found == (xQ_length(plain) > 0));
+  }
+
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)selector);
+  ck_assert(status == XQ_OK);
+  status = xQSearchExpr_plan(expr, context);
+  ck_assert(status == XQ_OK);
+  method = expr->plan ? expr->plan->method : XQ_PLAN_SCAN;
+  xQSearchExpr_free(expr);
+
+  context->docStats = 0;
+  xQ_free(plain, 1);
+  xQ_free(planned, 1);
+
+  return method;
+}
+
+/**
+ * Test gathering the statistics of a document
+ */
+START_TEST (test_planner_stats)
+{
+  xmlDocPtr doc = buildSections();
+  xQDocStats* docStats;
+  xQStatusCode status;
+  unsigned long distinct;
+  int nested;
+
+  status = xQDocStats_alloc_init(&docStats, doc);
+  ck_assert(status == XQ_OK);
+
+  // nothing is known until they're built
+  ck_assert(!docStats->built);
+  ck_assert(xQDocStats_elementsNamed(docStats, (xmlChar*)"item", &nested) == 0);
+
+  status = xQDocStats_build(docStats);
+  ck_assert(status == XQ_OK);
+  ck_assert(docStats->built && docStats->valuesComplete);
+  ck_assert(docStats->bytes > 0);
+
+  ck_assert(docStats->elements == 3 + SECTIONS * (1 + ITEMS * 2) + 1);
+  ck_assert(docStats->depths[0] == 0);
+  ck_assert(docStats->depths[1] == 1);
+  ck_assert(docStats->depths[4] == SECTIONS);
+  ck_assert(docStats->depths[5] == SECTIONS * ITEMS);
+  ck_assert(docStats->depths[6] == SECTIONS * ITEMS + 1);
+
+  ck_assert(xQDocStats_elementsNamed(docStats, (xmlChar*)"item", &nested) == SECTIONS * ITEMS);
+  ck_assert(!nested);
+  ck_assert(xQDocStats_elementsNamed(docStats, (xmlChar*)"part", &nested) == 2);
+  ck_assert(nested);
+  ck_assert(xQDocStats_elementsNamed(docStats, (xmlChar*)"missing", &nested) == 0);
+
+  ck_assert(xQDocStats_attributeCount(docStats, (xmlChar*)"id", &distinct) == SECTIONS * ITEMS);
+  ck_assert(distinct == SECTIONS * ITEMS);
+  ck_assert(xQDocStats_attributeCount(docStats, (xmlChar*)"class", &distinct) == SECTIONS * ITEMS);
+  ck_assert(distinct == 2);
+  ck_assert(xQDocStats_elementsWithValue(docStats, (xmlChar*)"class", (xmlChar*)"odd") == SECTIONS * ITEMS / 2);
+  ck_assert(xQDocStats_elementsWithValue(docStats, (xmlChar*)"id", (xmlChar*)"i3-4") == 1);
+  ck_assert(xQDocStats_elementsWithValue(docStats, (xmlChar*)"id", (xmlChar*)"none") == 0);
+
+  xQDocStats_free(docStats);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test choosing between a scan and a seek, and that both find the same
+ * nodes in the same order
+ */
+START_TEST (test_planner_choice)
+{
+  xmlDocPtr doc = buildSections();
+  xQDocStats* docStats;
+  xQ* context;
+  xQ* root;
+  xQStats stats;
+  xQ* result;
+  xQStatusCode status;
+
+  status = xQ_alloc_initDoc(&context, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_alloc_init(&docStats, doc);
+  ck_assert(status == XQ_OK);
+
+  // unbuilt statistics plan nothing
+  ck_assert(compareFind(context, docStats, "rare", 0, 0) == XQ_PLAN_SCAN);
+
+  status = xQDocStats_build(docStats);
+  ck_assert(status == XQ_OK);
+
+  // rare names and values are sought
+  ck_assert(compareFind(context, docStats, "rare", 0, 0) == XQ_PLAN_NAME_SEEK);
+  ck_assert(compareFind(context, docStats, "section", 0, 0) == XQ_PLAN_NAME_SEEK);
+  ck_assert(compareFind(context, docStats, "missing", 0, 0) == XQ_PLAN_NAME_SEEK);
+  ck_assert(compareFind(context, docStats, "item[id='i3-4']", 0, 0) == XQ_PLAN_ATTR_SEEK);
+  ck_assert(compareFind(context, docStats, "*[id='i3-4']", 0, 0) == XQ_PLAN_ATTR_SEEK);
+  ck_assert(compareFind(context, docStats, "item[id='none']", 0, 0) == XQ_PLAN_ATTR_SEEK);
+  ck_assert(compareFind(context, docStats, "section > item[class=odd] + item[id='i19-16']", 0, 0) == XQ_PLAN_ATTR_SEEK);
+  ck_assert(compareFind(context, docStats, "section item rare", 0, 0) == XQ_PLAN_NAME_SEEK);
+  ck_assert(compareFind(context, docStats, "item > rare", 0, 0) == XQ_PLAN_NAME_SEEK);
+  ck_assert(compareFind(context, docStats, "item + item > rare", 0, 0) == XQ_PLAN_NAME_SEEK);
+  ck_assert(compareFind(context, docStats, "section:contains('x') rare", 0, 0) == XQ_PLAN_NAME_SEEK);
+
+  // common names are scanned, when verifying them costs more
+  ck_assert(compareFind(context, docStats, "item name", 0, 0) == XQ_PLAN_SCAN);
+  ck_assert(compareFind(context, docStats, "section item[class=odd] name", 0, 0) == XQ_PLAN_SCAN);
+  ck_assert(compareFind(context, docStats, "*", 0, 0) == XQ_PLAN_SCAN);
+  ck_assert(compareFind(context, docStats, "*[class]", 0, 0) == XQ_PLAN_SCAN);
+  compareFind(context, docStats, "name", 0, 0);
+  compareFind(context, docStats, "item[class=odd]", 0, 0);
+
+  // a seek could change the order or repeat matches
+  ck_assert(compareFind(context, docStats, "part rare", 0, 0) == XQ_PLAN_SCAN);
+  ck_assert(compareFind(context, docStats, "* rare", 0, 0) == XQ_PLAN_SCAN);
+  ck_assert(compareFind(context, docStats, "rare, section", 0, 0) == XQ_PLAN_SCAN);
+
+  // bounded searches agree too
+  compareFind(context, docStats, "item[class=even]", 3, 0);
+  compareFind(context, docStats, "section > item", 0, 4);
+  compareFind(context, docStats, "section", 0, 3);
+  compareFind(context, docStats, "rare", 1, 5);
+
+  // as do searches from the root element, and from elsewhere
+  status = xQ_find(context, (xmlChar*)"doc", &root);
+  ck_assert(status == XQ_OK && xQ_length(root) == 1);
+  compareFind(root, docStats, "section item rare", 0, 0);
+  compareFind(root, docStats, "doc", 0, 0);
+  compareFind(root, docStats, "> part", 0, 0);
+  xQ_free(root, 1);
+
+  status = xQ_find(context, (xmlChar*)"section", &root);
+  ck_assert(status == XQ_OK && xQ_length(root) == SECTIONS);
+  compareFind(root, docStats, "rare", 0, 0);
+  compareFind(root, docStats, "item[id='i3-4']", 0, 0);
+  xQ_free(root, 1);
+
+  // the statistics name the seek and count its work
+  context->docStats = docStats;
+  context->stats = &stats;
+  status = xQ_find(context, (xmlChar*)"section item rare", &result);
+  ck_assert(status == XQ_OK && xQ_length(result) == 1);
+  ck_assert(strstr(stats.plan, " via nameSeek(rare)") != 0);
+  ck_assert(stats.docStatsBytes == docStats->bytes);
+  ck_assert(stats.step[2].produced == 1);
+  ck_assert(stats.step[2].visited < 10);
+  xQ_free(result, 1);
+  context->stats = 0;
+  context->docStats = 0;
+
+  xQ_free(context, 1);
+  xQDocStats_free(docStats);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test that the filters of a step are ordered most selective first
+ */
+START_TEST (test_planner_filters)
+{
+  xmlDocPtr doc = buildSections();
+  xQDocStats* docStats;
+  xQ* context;
+  xQSearchExpr* expr;
+  xQStatusCode status;
+
+  status = xQ_alloc_initDoc(&context, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_alloc_init(&docStats, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_build(docStats);
+  ck_assert(status == XQ_OK);
+  context->docStats = docStats;
+
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"item:contains('i3')[class][class=odd][id='i3-3'] name");
+  ck_assert(status == XQ_OK);
+  status = xQSearchExpr_plan(expr, context);
+  ck_assert(status == XQ_OK);
+
+  ck_assert(expr->next->operation == _xQ_filterAttributeEquals);
+  ck_assert(xmlStrcmp(expr->next->argv[0], (xmlChar*)"id") == 0);
+  ck_assert(expr->next->next->operation == _xQ_filterAttributeEquals);
+  ck_assert(xmlStrcmp(expr->next->next->argv[0], (xmlChar*)"class") == 0);
+  ck_assert(expr->next->next->next->operation == _xQ_filterAttributeExists);
+  ck_assert(expr->next->next->next->next->operation == _xQ_filterTextContains);
+  ck_assert(expr->next->next->next->next->next->operation == _xQ_findDescendantsByName);
+  xQSearchExpr_free(expr);
+
+  compareFind(context, docStats, "item:contains('i3')[class][class=odd][id='i3-3'] name", 0, 0);
+
+  xQ_free(context, 1);
+  xQDocStats_free(docStats);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test that defaults from a DTD keep values from being sought, and that
+ * namespaces are resolved as a scan resolves them
+ */
+START_TEST (test_planner_documents)
+{
+  const char* xml =
+    "<!DOCTYPE doc [<!ATTLIST item kind CDATA \"plain\">]>"
+    "<doc xmlns:a=\"urn:a\"><item/><item kind=\"special\"/><a:item/><item/></doc>";
+  xmlDocPtr doc;
+  xQDocStats* docStats;
+  xQ* context;
+  xQ* result;
+  xQStatusCode status;
+
+  status = xQ_alloc_initMemory(&context, xml, strlen(xml), &doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_alloc_init(&docStats, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_build(docStats);
+  ck_assert(status == XQ_OK);
+  ck_assert(!docStats->valuesComplete);
+
+  ck_assert(compareFind(context, docStats, "item[kind=plain]", 0, 0) != XQ_PLAN_ATTR_SEEK);
+
+  context->docStats = docStats;
+  status = xQ_find(context, (xmlChar*)"item[kind=plain]", &result);
+  ck_assert(status == XQ_OK && xQ_length(result) == 3);
+  xQ_free(result, 1);
+
+  // an undeclared prefix is only an error once a scan reaches it
+  status = xQ_find(context, (xmlChar*)"missing x:item", &result);
+  ck_assert(status == XQ_OK && xQ_length(result) == 0);
+  xQ_free(result, 1);
+  status = xQ_find(context, (xmlChar*)"x:item", &result);
+  ck_assert(status == XQ_UNKNOWN_NS_PREFIX);
+  context->docStats = 0;
+
+  status = xQ_addNamespace(context, (xmlChar*)"a", (xmlChar*)"urn:a");
+  ck_assert(status == XQ_OK);
+  compareFind(context, docStats, "a:item", 0, 0);
+  compareFind(context, docStats, "doc > a:item", 0, 0);
+
+  xQ_free(context, 1);
+  xQDocStats_free(docStats);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Count with statistics and return 1 if no step of the search ran
+ */
+static int countIndexed(xQ* context, const char* selector, unsigned long expected) {
+  xQStats stats;
+  xQStatusCode status;
+  unsigned long count = 0;
+
+  context->stats = &stats;
+  status = xQ_count(context, (xmlChar*)selector, &count);
+  context->stats = 0;
+  ck_assert(status == XQ_OK);
+  ck_assert(count == expected);
+  ck_assert(stats.resultSize == expected);
+
+  return stats.step[0].calls == 0;
+}
+
+/**
+ * Test that counts of a name or attribute value in the whole document are
+ * read from the indexes
+ */
+START_TEST (test_planner_count)
+{
+  xmlDocPtr doc = buildSections();
+  const char* xml = "<doc xmlns:p=\"urn:p\"><e p:id=\"x\" id=\"y\"/><e id=\"y\"/></doc>";
+  xmlDocPtr nsDoc;
+  xQDocStats* docStats;
+  xQ* context;
+  xQ* sections;
+  xQStatusCode status;
+
+  status = xQ_alloc_initDoc(&context, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_alloc_init(&docStats, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_build(docStats);
+  ck_assert(status == XQ_OK);
+
+  // without statistics every count searches
+  ck_assert(!countIndexed(context, "item", SECTIONS * ITEMS));
+
+  context->docStats = docStats;
+  ck_assert(countIndexed(context, "item", SECTIONS * ITEMS));
+  ck_assert(countIndexed(context, "rare", 1));
+  ck_assert(countIndexed(context, "missing", 0));
+  ck_assert(countIndexed(context, "*", 3 + SECTIONS * (1 + ITEMS * 2) + 1));
+  ck_assert(countIndexed(context, "item[class=odd]", SECTIONS * ITEMS / 2));
+  ck_assert(countIndexed(context, "*[id='i3-4']", 1));
+  ck_assert(countIndexed(context, "name[id='i3-4']", 0));
+  ck_assert(countIndexed(context, "item[id='none']", 0));
+
+  // other tests, several filters or selectors and other context nodes search
+  ck_assert(!countIndexed(context, "item[class]", SECTIONS * ITEMS));
+  ck_assert(!countIndexed(context, "item[class=odd][id='i3-3']", 1));
+  ck_assert(!countIndexed(context, "rare, missing", 1));
+
+  status = xQ_find(context, (xmlChar*)"section", &sections);
+  ck_assert(status == XQ_OK);
+  ck_assert(!countIndexed(sections, "item", SECTIONS * ITEMS));
+  xQ_free(sections, 1);
+
+  xQ_free(context, 1);
+  xQDocStats_free(docStats);
+  xmlFreeDoc(doc);
+
+  // an element listed under a value it gives in another namespace only
+  status = xQ_alloc_initMemory(&context, xml, strlen(xml), &nsDoc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_alloc_init(&docStats, nsDoc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_build(docStats);
+  ck_assert(status == XQ_OK);
+
+  context->docStats = docStats;
+  compareFind(context, docStats, "e[id=y]", 0, 0);
+  compareFind(context, docStats, "e[id=x]", 0, 0);
+
+  xQ_free(context, 1);
+  xQDocStats_free(docStats);
+  xmlFreeDoc(nsDoc);
+}
+END_TEST
+
+/**
+ * Test describing how searches are compiled, planned and run
+ */
+START_TEST (test_planner_explain)
+{
+  xmlDocPtr doc = buildSections();
+  xQDocStats* docStats;
+  xQ* context;
+  xQ* empty;
+  xmlChar* text;
+  xQStatusCode status;
+
+  status = xQ_alloc_initDoc(&context, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_alloc_init(&docStats, doc);
+  ck_assert(status == XQ_OK);
+  status = xQDocStats_build(docStats);
+  ck_assert(status == XQ_OK);
+
+  // without statistics, only what the steps produced is known
+  status = xQ_explain(context, (xmlChar*)"section item[class=odd] rare", &text);
+  ck_assert(status == XQ_OK && text);
+  ck_assert(strstr((char*) text,
+    "  findDescendantsByName(section), produced 20 of 1224 visited\n"
+    "  findDescendantsByName(item), produced 600 of 1201 visited, compiled with 1 filter\n"
+    "    filterAttributeEquals(class, odd), produced 300 of 600 visited\n"
+    "  findDescendantsByName(rare), produced 1 of 301 visited\n"
+    "  plan: scan, without document statistics\n"
+    "indexes: none\n"
+    "measured 1 result from 1 context node in ") == (char*) text);
+  xmlFree(text);
+
+  // a seek only measures the step it verifies candidates for
+  context->docStats = docStats;
+  status = xQ_explain(context, (xmlChar*)"section item[class=odd] rare", &text);
+  ck_assert(status == XQ_OK && text);
+  ck_assert(strstr((char*) text,
+    "  findDescendantsByName(section), estimated 20\n"
+    "  findDescendantsByName(item), estimated 600, compiled with 1 filter\n"
+    "    filterAttributeEquals(class, odd), estimated 147\n"
+    "  findDescendantsByName(rare), estimated 1.0, produced 1 of 3 visited\n"
+    "  plan: nameSeek(rare) of about 24 elements, cheaper than a scan of about 1224, estimated results 1.0\n"
+    "indexes: document statistics\n") == (char*) text);
+  xmlFree(text);
+
+  // a group is explained one selector at a time, and never sought
+  status = xQ_explain(context, (xmlChar*)"rare, item[id=i3-4]", &text);
+  ck_assert(status == XQ_OK && text);
+  ck_assert(strstr((char*) text,
+    "selector 1 of the group\n"
+    "  findDescendantsByName(rare), estimated 1.0, produced 1 of 1224 visited\n"
+    "  plan: scan of about 1224 elements\n"
+    "selector 2 of the group\n"
+    "  findDescendantsByName(item), estimated 600, produced 600, compiled with 1 filter\n"
+    "    filterAttributeEquals(id, i3-4), estimated 0.5, produced 1 of 600 visited\n"
+    "  plan: scan of about 1224 elements\n"
+    "indexes: document statistics\n"
+    "measured 2 results from 1 context node in ") == (char*) text);
+  xmlFree(text);
+
+  // prefixes are shown as they resolve, and a failing search is explained
+  status = xQ_addNamespace(context, (xmlChar*)"a", (xmlChar*)"urn:a");
+  ck_assert(status == XQ_OK);
+  status = xQ_explain(context, (xmlChar*)"a:section > x:item", &text);
+  ck_assert(status == XQ_OK && text);
+  ck_assert(strstr((char*) text, "  findDescendantsByName(section, a), estimated 20, produced 0 of 1224 visited, prefix a is urn:a\n") != 0);
+  ck_assert(strstr((char*) text, "  findChildrenByName(item, x), estimated 600, prefix x is undeclared\n") != 0);
+  xmlFree(text);
+
+  status = xQ_explain(context, (xmlChar*)"x:item", &text);
+  ck_assert(status == XQ_OK && text);
+  ck_assert(strstr((char*) text, "search failed with status ") != 0);
+  ck_assert(strstr((char*) text, "measured") == 0);
+  xmlFree(text);
+
+  // nothing is run against an empty context
+  status = xQ_alloc_init(&empty);
+  ck_assert(status == XQ_OK);
+  status = xQ_explain(empty, (xmlChar*)"item > name", &text);
+  ck_assert(status == XQ_OK && text);
+  ck_assert(strcmp((char*) text,
+    "  findDescendantsByName(item)\n"
+    "  findChildrenByName(name)\n"
+    "  plan: scan, without document statistics\n"
+    "indexes: none\n") == 0);
+  xmlFree(text);
+
+  status = xQ_explain(empty, (xmlChar*)"item[", &text);
+  ck_assert(status != XQ_OK && text == 0);
+  xQ_free(empty, 1);
+
+  xQ_free(context, 1);
+  xQDocStats_free(docStats);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+
+/**
+ * Test suite
+ */
+Suite* planner_suite() {
+  Suite* s = suite_create("xQ planner");
+
+  singleTestCase(s, tc_planner_stats, "document statistics", test_planner_stats);
+
+  singleTestCase(s, tc_planner_choice, "scan or seek", test_planner_choice);
+
+  singleTestCase(s, tc_planner_filters, "filter order", test_planner_filters);
+
+  singleTestCase(s, tc_planner_documents, "DTDs and namespaces", test_planner_documents);
+
+  singleTestCase(s, tc_planner_count, "indexed count", test_planner_count);
+
+  singleTestCase(s, tc_planner_explain, "explain", test_planner_explain);
+
+  return s;
+}
+
+
+int main() {
+  int numFailed;
+  Suite* s = planner_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+
+  numFailed = srunner_ntests_failed(sr);
+
+  srunner_free(sr);
+
+  return (numFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -381,6 +381,273 @@ START_TEST (test_invalid_expressions)
   ck_assert(status == XQ_INVALID_SEL_UNTERMINATED_STR);
   ck_assert(expr == 0);
   
+  // empty group members
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem,");
+  ck_assert(status != XQ_OK);
+  ck_assert(expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)", elem");
+  ck_assert(status != XQ_OK);
+  ck_assert(expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem1, , elem2");
+  ck_assert(status != XQ_OK);
+  ck_assert(expr == 0);
+  
+}
+END_TEST
+
+/**
+ * Test the attribute operators
+ */
+START_TEST (test_attr_operators)
+{
+  xQSearchExpr* expr;
+  xQStatusCode status;
+  const char* selectors[] = {
+    "elem[attr]", "elem[attr^=v]", "elem[attr$=\"v\"]", "elem[attr*=v]",
+    "elem[attr~=v]", "elem[attr>5]", "elem[attr<'-1.5']"
+  };
+  xQSearchOp operations[] = {
+    _xQ_filterAttributeExists, _xQ_filterAttributePrefix, _xQ_filterAttributeSuffix, _xQ_filterAttributeContains,
+    _xQ_filterAttributeWord, _xQ_filterAttributeGreater, _xQ_filterAttributeLess
+  };
+  const char* notNumbers[] = {
+    "elem[attr>0x5]", "elem[attr<inf]", "elem[attr>'-infinity']", "elem[attr<nan]",
+    "elem[attr>1e]", "elem[attr>'.']", "elem[attr<'1 2']", "elem[attr>'+-1']"
+  };
+  int i;
+  
+  for (i = 0; i < 7; i++) {
+    status = xQSearchExpr_alloc_init(&expr, (xmlChar*) selectors[i]);
+    
+    ck_assert(status == XQ_OK);
+    ck_assert(expr->next != 0);
+    ck_assert(expr->next->operation == operations[i]);
+    ck_assert(xmlStrcmp(expr->next->argv[0], (xmlChar*)"attr") == 0);
+    ck_assert(i == 0 ? expr->next->argv[1] == 0 : expr->next->argv[1] != 0);
+    ck_assert(expr->next->next == 0);
+    
+    xQSearchExpr_free(expr);
+  }
+  
+  // combined with other attributes and combinators
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem[a][b^=\"x\"] > child");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->next->operation == _xQ_filterAttributeExists);
+  ck_assert(expr->next->next->operation == _xQ_filterAttributePrefix);
+  ck_assert(expr->next->next->next->operation == _xQ_findChildrenByName);
+  
+  xQSearchExpr_free(expr);
+  
+  // incomplete or invalid operators
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem[attr^v]");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem[attr~]");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem[attr>=5]");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem[attr>five]");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem[attr<]");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  // only decimal numbers are bounds
+  for (i = 0; i < 8; i++) {
+    status = xQSearchExpr_alloc_init(&expr, (xmlChar*) notNumbers[i]);
+    ck_assert(status == XQ_INVALID_SEL_UNEXPECTED_TOKEN && expr == 0);
+  }
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem[a>' -.5e1 '][b<+2.]");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->next->operation == _xQ_filterAttributeGreater);
+  ck_assert(expr->next->next->operation == _xQ_filterAttributeLess);
+  
+  xQSearchExpr_free(expr);
+}
+END_TEST
+
+/**
+ * Test a selector group
+ */
+START_TEST (test_group_selector)
+{
+  xQSearchExpr* expr;
+  xQStatusCode status;
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem1, elem2 > elem3,*");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->operation == _xQ_findDescendantsByName);
+  ck_assert(xmlStrcmp(expr->argv[0], (xmlChar*)"elem1") == 0);
+  ck_assert(expr->next == 0);
+  ck_assert(expr->alternative != 0);
+  
+  ck_assert(expr->alternative->operation == _xQ_findDescendantsByName);
+  ck_assert(xmlStrcmp(expr->alternative->argv[0], (xmlChar*)"elem2") == 0);
+  ck_assert(expr->alternative->next != 0);
+  ck_assert(expr->alternative->next->operation == _xQ_findChildrenByName);
+  ck_assert(xmlStrcmp(expr->alternative->next->argv[0], (xmlChar*)"elem3") == 0);
+  ck_assert(expr->alternative->alternative != 0);
+  
+  ck_assert(expr->alternative->alternative->operation == _xQ_findDescendants);
+  ck_assert(expr->alternative->alternative->alternative == 0);
+
+  xQSearchExpr_free(expr);
+}
+END_TEST
+
+/**
+ * Test unquoted attribute values holding characters that are tokens
+ */
+START_TEST (test_unquoted_values)
+{
+  xQSearchExpr* expr;
+  xQStatusCode status;
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"a[t=a,b]");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->next->operation == _xQ_filterAttributeEquals);
+  ck_assert(xmlStrcmp(expr->next->argv[1], (xmlChar*)"a,b") == 0);
+  ck_assert(expr->next->next == 0);
+  ck_assert(expr->alternative == 0);
+  
+  xQSearchExpr_free(expr);
+  
+  // a quoted value or a space ends the value before a group's comma
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"a[t='a,b'],c[t=$1 ],d");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(xmlStrcmp(expr->next->argv[1], (xmlChar*)"a,b") == 0);
+  ck_assert(expr->alternative != 0);
+  ck_assert(xmlStrcmp(expr->alternative->argv[0], (xmlChar*)"c") == 0);
+  ck_assert(xmlStrcmp(expr->alternative->next->argv[1], (xmlChar*)"$1") == 0);
+  ck_assert(expr->alternative->alternative != 0);
+  ck_assert(xmlStrcmp(expr->alternative->alternative->argv[0], (xmlChar*)"d") == 0);
+  
+  xQSearchExpr_free(expr);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"a[t=a b]");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"a[t=a,b");
+  ck_assert(status != XQ_OK && expr == 0);
+}
+END_TEST
+
+/**
+ * Test the text pseudos
+ */
+START_TEST (test_text_pseudos)
+{
+  xQSearchExpr* expr;
+  xQStatusCode status;
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem:contains('a b')[attr]:text(ab)");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->operation == _xQ_findDescendantsByName);
+  ck_assert(expr->argv[1] == 0);
+  ck_assert(expr->next->operation == _xQ_filterTextContains);
+  ck_assert(xmlStrcmp(expr->next->argv[0], (xmlChar*)"a b") == 0);
+  ck_assert(expr->next->argv[1] == 0);
+  ck_assert(expr->next->next->operation == _xQ_filterAttributeExists);
+  ck_assert(expr->next->next->next->operation == _xQ_filterTextEquals);
+  ck_assert(xmlStrcmp(expr->next->next->next->argv[0], (xmlChar*)"ab") == 0);
+  ck_assert(expr->next->next->next->next == 0);
+  
+  xQSearchExpr_free(expr);
+  
+  // a prefixed name is still a prefixed name
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"ns:contains:contains(\"x)\")");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(xmlStrcmp(expr->argv[0], (xmlChar*)"contains") == 0);
+  ck_assert(xmlStrcmp(expr->argv[1], (xmlChar*)"ns") == 0);
+  ck_assert(expr->next->operation == _xQ_filterTextContains);
+  ck_assert(xmlStrcmp(expr->next->argv[0], (xmlChar*)"x)") == 0);
+  
+  xQSearchExpr_free(expr);
+  
+  // unquoted arguments and attribute values may hold parentheses and commas
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"a[href=x(1)]:contains(a,b[c]), d");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(xmlStrcmp(expr->next->argv[1], (xmlChar*)"x(1)") == 0);
+  ck_assert(expr->next->next->operation == _xQ_filterTextContains);
+  ck_assert(xmlStrcmp(expr->next->next->argv[0], (xmlChar*)"a,b[c]") == 0);
+  ck_assert(expr->next->next->next == 0);
+  ck_assert(expr->alternative != 0);
+  
+  xQSearchExpr_free(expr);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem:contains(a");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem:contains()");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem:first(a)");
+  ck_assert(status != XQ_OK && expr == 0);
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"elem:text('a)");
+  ck_assert(status != XQ_OK && expr == 0);
+}
+END_TEST
+
+/**
+ * Test that traversal steps are compiled with the filters after them
+ */
+START_TEST (test_compiled_steps)
+{
+  xQSearchExpr* expr;
+  xQStatusCode status;
+  
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"item[a=b][c]:contains('x') > name");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->program != 0);
+  ck_assert(expr->next->program == 0);
+  ck_assert(expr->next->next->next->operation == _xQ_filterTextContains);
+  ck_assert(expr->next->next->next->program == 0);
+  ck_assert(expr->next->next->next->next->operation == _xQ_findChildrenByName);
+  ck_assert(expr->next->next->next->next->program == 0);
+  
+  // compiling again replaces the programs
+  status = xQSearchExpr_compile(expr);
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->program != 0);
+  
+  xQSearchExpr_free(expr);
+  
+  // steps without filters are left alone
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"item name");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->program == 0);
+  ck_assert(expr->next->program == 0);
+  
+  xQSearchExpr_free(expr);
+  
+  // as are the steps of every selector in a group
+  status = xQSearchExpr_alloc_init(&expr, (xmlChar*)"item, s + item[id], *[id]");
+  
+  ck_assert(status == XQ_OK);
+  ck_assert(expr->program == 0);
+  ck_assert(expr->alternative->program == 0);
+  ck_assert(expr->alternative->next->operation == _xQ_findNextSiblingByName);
+  ck_assert(expr->alternative->next->program != 0);
+  ck_assert(expr->alternative->alternative->operation == _xQ_findDescendants);
+  ck_assert(expr->alternative->alternative->program != 0);
+  
+  xQSearchExpr_free(expr);
 }
 END_TEST
 
@@ -406,6 +673,15 @@ Suite* search_suite() {
   singleTestCase(s, tc_single_attr_combi, "single attrib +", test_single_attr_combinator);
   singleTestCase(s, tc_dual_attr, "dual attrib", test_dual_attr);
 
+  singleTestCase(s, tc_attr_ops, "attrib operators", test_attr_operators);
+
+  singleTestCase(s, tc_group, "group", test_group_selector);
+  singleTestCase(s, tc_unquoted, "unquoted values", test_unquoted_values);
+
+  singleTestCase(s, tc_text_pseudos, "text pseudos", test_text_pseudos);
+
+  singleTestCase(s, tc_compiled, "compiled steps", test_compiled_steps);
+
   singleTestCase(s, tc_invalid_expr, "invalid expressions", test_invalid_expressions);
 
   return s;
@@ -0,0 +1,269 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <check.h>
+
+#include <libxq.h>
+
+#include <string.h>
+
+#define singleTestCase(suite, var, name, test) do { \
+    TCase* var = tcase_create(name); \
+    tcase_add_test(var, test); \
+    suite_add_tcase(s, var); \
+  } while(0)
+
+#define SECTIONS 50
+#define ITEMS 40
+
+/**
+ * Build a document with SECTIONS <section> elements of ITEMS <item>
+ * elements each, where only the last section holds a <rare> element
+ */
+static xmlDocPtr buildSections() {
+  xmlDocPtr doc = xmlNewDoc((xmlChar*)"1.0");
+  xmlNodePtr root = xmlNewDocNode(doc, 0, (xmlChar*)"doc", 0);
+  xmlNodePtr section, item;
+  int i, j;
+
+  xmlDocSetRootElement(doc, root);
+
+  for (i = 0; i < SECTIONS; i++) {
+    section = xmlNewChild(root, 0, (xmlChar*)"section", 0);
+
+    for (j = 0; j < ITEMS; j++) {
+      item = xmlNewChild(section, 0, (xmlChar*)"item", 0);
+      xmlNewChild(item, 0, (xmlChar*)"name", (xmlChar*)"x");
+      if (i == SECTIONS - 1 && j == ITEMS / 2)
+        xmlNewChild(item, 0, (xmlChar*)"rare", (xmlChar*)"y");
+    }
+  }
+
+  return doc;
+}
+
+/**
+ * Search with and without signatures and compare the results. Returns
+ * the number of nodes visited by the first step with signatures.
+ */
+static unsigned long compareFind(xQ* context, xQSignatures* signatures, const char* selector) {
+  xQ* plain;
+  xQ* pruned;
+  xQStats stats;
+  xQStatusCode status;
+  unsigned long i;
+
+  context->signatures = 0;
+  status = xQ_find(context, (xmlChar*)selector, &plain);
+  ck_assert(status == XQ_OK);
+
+  context->signatures = signatures;
+  context->stats = &stats;
+  status = xQ_find(context, (xmlChar*)selector, &pruned);
+  ck_assert(status == XQ_OK);
+  context->stats = 0;
+  context->signatures = 0;
+
+  ck_assert(xQ_length(plain) == xQ_length(pruned));
+  for (i = 0; i < xQ_length(plain); i++)
+    ck_assert(plain->context.list[i] == pruned->context.list[i]);
+
+  ck_assert(stats.signatureBytes == signatures->bytes);
+
+  xQ_free(plain, 1);
+  xQ_free(pruned, 1);
+
+  return stats.step[0].visited;
+}
+
+/**
+ * Test building signatures and looking them up
+ */
+START_TEST (test_signature_build)
+{
+  xmlDocPtr doc = buildSections();
+  xmlNodePtr root = xmlDocGetRootElement(doc);
+  xQSignatures* signatures;
+  xQSignature held = 0;
+  xQStatusCode status;
+
+  status = xQSignatures_alloc_init(&signatures, doc, 0);
+  ck_assert(status == XQ_OK);
+  ck_assert(signatures->maxBytes == XQ_SIGNATURES_DEFAULT_MAX_BYTES);
+
+  // nothing is known until they're built
+  ck_assert(!signatures->built);
+  ck_assert(!xQSignatures_get(signatures, root, &held));
+  ck_assert(xQSignatures_mayHold(signatures, root->children, xQSignature_forName((xmlChar*)"rare")));
+
+  status = xQSignatures_build(signatures);
+  ck_assert(status == XQ_OK);
+  ck_assert(signatures->built);
+
+  // the document, its root and every section have enough descendants
+  ck_assert(signatures->size == SECTIONS + 2);
+  ck_assert(signatures->bytes > 0 && signatures->bytes <= signatures->maxBytes);
+
+  ck_assert(xQSignatures_get(signatures, root, &held));
+  ck_assert((held & xQSignature_forName((xmlChar*)"item")) == xQSignature_forName((xmlChar*)"item"));
+  ck_assert(xQSignatures_mayHold(signatures, root, xQSignature_forName((xmlChar*)"rare")));
+  ck_assert(xQSignatures_mayHold(signatures, root->last, xQSignature_forName((xmlChar*)"rare")));
+  ck_assert(!xQSignatures_mayHold(signatures, root->children, xQSignature_forName((xmlChar*)"rare")));
+
+  // a small subtree has no signature and may hold anything
+  ck_assert(!xQSignatures_get(signatures, root->children->children, &held));
+  ck_assert(xQSignatures_mayHold(signatures, root->children->children, xQSignature_forName((xmlChar*)"rare")));
+
+  // building again does nothing
+  status = xQSignatures_build(signatures);
+  ck_assert(status == XQ_OK);
+  ck_assert(signatures->size == SECTIONS + 2);
+
+  xQSignatures_free(signatures);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test that searches skip subtrees without the names they need and find
+ * the same nodes
+ */
+START_TEST (test_signature_search)
+{
+  xmlDocPtr doc = buildSections();
+  xQSignatures* signatures;
+  xQ* context;
+  xQStatusCode status;
+  unsigned long visited;
+
+  status = xQ_alloc_initDoc(&context, doc);
+  ck_assert(status == XQ_OK);
+  status = xQSignatures_alloc_init(&signatures, doc, 0);
+  ck_assert(status == XQ_OK);
+
+  // unbuilt signatures don't change anything
+  visited = compareFind(context, signatures, "rare");
+  ck_assert(visited == 1 + SECTIONS * (1 + ITEMS * 2) + 1);
+
+  status = xQSignatures_build(signatures);
+  ck_assert(status == XQ_OK);
+
+  // only the last section is searched, though every section is visited
+  visited = compareFind(context, signatures, "rare");
+  ck_assert(visited == 1 + SECTIONS + ITEMS * 2 + 1);
+
+  // the names of later steps prune the first
+  visited = compareFind(context, signatures, "section item rare");
+  ck_assert(visited < SECTIONS * ITEMS);
+  visited = compareFind(context, signatures, "* rare");
+  ck_assert(visited < SECTIONS * ITEMS);
+  visited = compareFind(context, signatures, "section > item + item > rare");
+  ck_assert(visited < SECTIONS * ITEMS);
+
+  // names found everywhere prune nothing
+  visited = compareFind(context, signatures, "name");
+  ck_assert(visited == 1 + SECTIONS * (1 + ITEMS * 2) + 1);
+
+  compareFind(context, signatures, "missing");
+  compareFind(context, signatures, "section name");
+  compareFind(context, signatures, "item[id]");
+  compareFind(context, signatures, "*");
+
+  // a group is pruned only where every selector in it can be
+  visited = compareFind(context, signatures, "rare, missing");
+  ck_assert(visited < SECTIONS * ITEMS);
+  visited = compareFind(context, signatures, "rare, name");
+  ck_assert(visited == 1 + SECTIONS * (1 + ITEMS * 2) + 1);
+  compareFind(context, signatures, "item rare, section missing");
+
+  xQ_free(context, 1);
+  xQSignatures_free(signatures);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test that the table stays within its memory bound by dropping the
+ * signatures of the smallest subtrees
+ */
+START_TEST (test_signature_bound)
+{
+  xmlDocPtr doc = buildSections();
+  xQSignatures* signatures;
+  xQ* context;
+  xQStatusCode status;
+  xQSignature held;
+
+  status = xQ_alloc_initDoc(&context, doc);
+  ck_assert(status == XQ_OK);
+
+  // too small for even the smallest table
+  status = xQSignatures_alloc_init(&signatures, doc, 16);
+  ck_assert(status == XQ_OK);
+  status = xQSignatures_build(signatures);
+  ck_assert(status == XQ_OK);
+  ck_assert(signatures->size == 0 && signatures->bytes == 0);
+  compareFind(context, signatures, "section item rare");
+  xQSignatures_free(signatures);
+
+  // room for 32 signatures, fewer than there are sections
+  status = xQSignatures_alloc_init(&signatures, doc, 64 * 2 * sizeof(xQSignature) + 64 * sizeof(void*));
+  ck_assert(status == XQ_OK);
+  status = xQSignatures_build(signatures);
+  ck_assert(status == XQ_OK);
+  ck_assert(signatures->bytes > 0 && signatures->bytes <= signatures->maxBytes);
+  ck_assert(signatures->minDescendants > ITEMS * 2);
+
+  // the largest subtrees keep theirs
+  ck_assert(xQSignatures_get(signatures, xmlDocGetRootElement(doc), &held));
+  ck_assert(!xQSignatures_get(signatures, xmlDocGetRootElement(doc)->children, &held));
+  compareFind(context, signatures, "section item rare");
+  xQSignatures_free(signatures);
+
+  xQ_free(context, 1);
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+
+/**
+ * Test suite
+ */
+Suite* signature_suite() {
+  Suite* s = suite_create("xQ signatures");
+
+  singleTestCase(s, tc_signature_build, "build signatures", test_signature_build);
+
+  singleTestCase(s, tc_signature_search, "search with signatures", test_signature_search);
+
+  singleTestCase(s, tc_signature_bound, "signature memory bound", test_signature_bound);
+
+  return s;
+}
+
+
+int main() {
+  int numFailed;
+  Suite* s = signature_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+
+  numFailed = srunner_ntests_failed(sr);
+
+  srunner_free(sr);
+
+  return (numFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
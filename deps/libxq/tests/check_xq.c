@@ -145,6 +145,895 @@ START_TEST (test_xml_no_children)
 }
 END_TEST
 
+/**
+ * Test searching an xQ made from a list of nodes
+ */
+START_TEST (test_node_list)
+{
+  xQ* x;
+  xQ* x2;
+  xQ* x3;
+  xQStatusCode status;
+  const char* xml = "<doc><a><b/></a><a><b/><b/></a></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  status = xQ_find(x, (xmlChar*)"a", &x2);
+  ck_assert(status == XQ_OK && xQ_length(x2) == 2);
+  
+  status = xQ_alloc_initNodeList(&x3, &(x2->context));
+  ck_assert(status == XQ_OK);
+  xQ_free(x2, 1);
+  
+  status = xQ_find(x3, (xmlChar*)"b", &x2);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(x2) == 3);
+  
+  xQ_free(x2, 1);
+  xQ_free(x3, 1);
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test searching a copy and cancelling a search
+ */
+START_TEST (test_copy_cancel)
+{
+  xQ* x;
+  xQ* copy;
+  xQ* x2;
+  xQStatusCode status;
+  const char* xml = "<doc xmlns:nsb=\"http://csv.comcast.com/B\"><item>A</item><nsb:item>B</nsb:item></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  xmlChar* txt;
+  volatile int cancelled = 0;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  status = xQ_addNamespace(x, (xmlChar*)"nsB", (xmlChar*)"http://csv.comcast.com/B");
+  ck_assert(status == XQ_OK);
+  
+  status = xQ_alloc_initCopy(&copy, x);
+  ck_assert(status == XQ_OK);
+  
+  // the copy keeps its namespaces after the original is gone
+  xQ_free(x, 1);
+  
+  copy->cancelled = &cancelled;
+  
+  status = xQ_find(copy, (xmlChar*)"nsB:item", &x2);
+
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(x2) == 1);
+  ck_assert(xmlStrcmp((txt = xQ_getText(x2)), (xmlChar*)"B") == 0);
+  
+  xmlFree(txt);
+  xQ_free(x2, 1);
+  
+  cancelled = 1;
+  
+  status = xQ_find(copy, (xmlChar*)"item", &x2);
+  ck_assert(status == XQ_CANCELLED);
+  ck_assert(x2 == 0);
+  
+  status = xQ_filter(copy, (xmlChar*)"doc", &x2);
+  ck_assert(status == XQ_CANCELLED);
+  ck_assert(x2 == 0);
+  
+  xQ_free(copy, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+
+/**
+ * Test node text with and without copying
+ */
+START_TEST (test_node_text)
+{
+  xQ* x;
+  xQStatusCode status;
+  const char* xml = "<!DOCTYPE doc [<!ENTITY e \"ent\">]><doc><one>single</one><cdata><![CDATA[a<b]]></cdata><mixed>a<b>b<c>c</c></b><![CDATA[d]]><!-- x -->e</mixed><empty/><ref>a&e;</ref></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  xmlNodePtr nodes[5], cur;
+  xmlChar* txt;
+  const xmlChar* ref;
+  int i, len;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  for (i = 0, cur = xmlDocGetRootElement(doc)->children; i < 5 && cur; cur = cur->next)
+    nodes[i++] = cur;
+  ck_assert(i == 5);
+  
+  // a single text child is returned in place
+  ref = xQNode_getTextRef(nodes[0], &len);
+  ck_assert(ref == nodes[0]->children->content);
+  ck_assert(len == 6);
+  
+  ref = xQNode_getTextRef(nodes[1], &len);
+  ck_assert(ref != 0);
+  ck_assert(len == 3 && memcmp(ref, "a<b", 3) == 0);
+  
+  ck_assert(xQNode_getTextRef(nodes[2], &len) == 0);
+  
+  // copies match xmlNodeGetContent
+  for (i = 0; i < 5; i++) {
+    xmlChar* expected = xmlNodeGetContent(nodes[i]);
+    
+    txt = xQNode_getText(nodes[i], &len);
+    ck_assert(xmlStrcmp(txt, expected) == 0);
+    ck_assert(len == xmlStrlen(expected));
+    
+    xmlFree(txt);
+    xmlFree(expected);
+  }
+  
+  txt = xQNode_getText(nodes[2], 0);
+  ck_assert(xmlStrcmp(txt, (xmlChar*)"abcde") == 0);
+  xmlFree(txt);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test reading attribute values in place
+ */
+START_TEST (test_node_attr_ref)
+{
+  xQ* x;
+  xQStatusCode status;
+  const char* xml = "<!DOCTYPE doc [<!ENTITY e \"ent\"><!ATTLIST doc d CDATA \"dflt\">]><doc a=\"one\" b=\"\" c=\"x&e;y\" xmlns:n=\"urn:n\" n:z=\"ns\"/>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  xmlNodePtr root;
+  xmlChar* value;
+  const xmlChar* ref;
+  int len;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  root = xmlDocGetRootElement(doc);
+  
+  ref = xQNode_getAttrRef(root, (xmlChar*)"a", &len);
+  ck_assert(ref != 0 && len == 3 && memcmp(ref, "one", 3) == 0);
+  
+  ref = xQNode_getAttrRef(root, (xmlChar*)"b", &len);
+  ck_assert(ref != 0 && len == 0);
+  
+  ref = xQNode_getAttrRef(root, (xmlChar*)"z", &len);
+  ck_assert(ref != 0 && len == 2 && memcmp(ref, "ns", 2) == 0);
+  
+  ck_assert(xQNode_getAttrRef(root, (xmlChar*)"missing", &len) == 0);
+  
+  // values that aren't stored in one piece are left to xmlGetProp
+  ck_assert(xQNode_getAttrRef(root, (xmlChar*)"c", &len) == 0);
+  ck_assert(xmlStrcmp((value = xmlGetProp(root, (xmlChar*)"c")), (xmlChar*)"xenty") == 0);
+  xmlFree(value);
+  
+  ck_assert(xQNode_getAttrRef(root, (xmlChar*)"d", &len) == 0);
+  ck_assert(xmlStrcmp((value = xmlGetProp(root, (xmlChar*)"d")), (xmlChar*)"dflt") == 0);
+  xmlFree(value);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test writing XML to an output buffer matches libxml2's own dumps
+ */
+START_TEST (test_node_write_xml)
+{
+  xQ* x;
+  xQStatusCode status;
+  const char* xml = "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><doc><a b=\"c\">caf\xe9 &amp; more</a><empty/></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  xmlBufferPtr expected, buff;
+  xmlOutputBufferPtr out;
+  xmlChar* str;
+  int len;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  // a document
+  xmlDocDumpMemory(doc, &str, &len);
+  expected = xmlBufferCreate();
+  xmlBufferAdd(expected, str, len);
+  xmlFree(str);
+  
+  str = xQNode_getXml((xmlNodePtr) doc, &len);
+  ck_assert(len == xmlBufferLength(expected));
+  ck_assert(xmlStrcmp(str, xmlBufferContent(expected)) == 0);
+  xmlFree(str);
+  
+  // an element, then the document, through one output buffer
+  str = xmlStrdup(xmlBufferContent(expected));
+  xmlBufferEmpty(expected);
+  xmlNodeDump(expected, doc, xmlDocGetRootElement(doc)->children, 0, 0);
+  xmlBufferCat(expected, str);
+  xmlFree(str);
+  
+  buff = xmlBufferCreate();
+  out = xmlOutputBufferCreateBuffer(buff, 0);
+  
+  ck_assert(xQNode_writeXml(xmlDocGetRootElement(doc)->children, out) == XQ_OK);
+  ck_assert(xQNode_writeXml((xmlNodePtr) doc, out) == XQ_OK);
+  ck_assert(xmlOutputBufferClose(out) >= 0);
+  
+  ck_assert(xmlBufferLength(buff) == xmlBufferLength(expected));
+  ck_assert(memcmp(xmlBufferContent(buff), xmlBufferContent(expected), xmlBufferLength(buff)) == 0);
+  
+  xmlBufferFree(buff);
+  xmlBufferFree(expected);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+
+/**
+ * Test writing a list of nodes with a separator
+ */
+START_TEST (test_list_write_xml)
+{
+  xQ* x;
+  xQStatusCode status;
+  const char* xml = "<doc><a>1</a><b/><c>3</c></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  xmlNodePtr root;
+  xQNodeList list;
+  xmlBufferPtr buff;
+  xmlOutputBufferPtr out;
+  const char* expected = "<a>1</a>, , <b/>, <c>3</c>";
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  root = xmlDocGetRootElement(doc);
+  
+  // the text node has no XML of its own
+  ck_assert(xQNodeList_init(&list, 4) == XQ_OK);
+  ck_assert(xQNodeList_push(&list, root->children) == XQ_OK);
+  ck_assert(xQNodeList_push(&list, root->children->children) == XQ_OK);
+  ck_assert(xQNodeList_push(&list, root->children->next) == XQ_OK);
+  ck_assert(xQNodeList_push(&list, root->children->next->next) == XQ_OK);
+  
+  ck_assert(!xQNode_hasXml(root->children->children));
+  ck_assert(xQNode_hasXml(root->children->next));
+  
+  buff = xmlBufferCreate();
+  out = xmlOutputBufferCreateBuffer(buff, 0);
+  
+  ck_assert(xQNodeList_writeXml(&list, out, BAD_CAST ", ") == XQ_OK);
+  ck_assert(xmlOutputBufferClose(out) >= 0);
+  
+  ck_assert(xmlBufferLength(buff) == strlen(expected));
+  ck_assert(memcmp(xmlBufferContent(buff), expected, strlen(expected)) == 0);
+  
+  xmlBufferFree(buff);
+  xQNodeList_free(&list, 0);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test collecting search statistics
+ */
+START_TEST (test_stats)
+{
+  xQ* x;
+  xQ* result;
+  xQStats stats;
+  xQStatusCode status;
+  const char* xml = "<doc><item type='a'/><item type='b'/><other/><item type='b'/></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  // nothing is recorded unless stats are requested
+  status = xQ_find(x, (xmlChar*)"item", &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(result->stats == 0);
+  xQ_free(result, 1);
+  
+  x->stats = &stats;
+  
+  status = xQ_find(x, (xmlChar*)"item[type=\"b\"]", &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(result) == 2);
+  
+  ck_assert(strcmp(stats.plan, "findDescendantsByName(item) -> filterAttributeEquals(type, b)") == 0);
+  ck_assert(stats.steps == 2);
+  ck_assert(strcmp(stats.step[0].operation, "findDescendantsByName") == 0);
+  ck_assert(stats.step[0].calls == 1);
+  ck_assert(stats.step[0].visited == 5);
+  ck_assert(stats.step[0].produced == 3);
+  ck_assert(strcmp(stats.step[1].operation, "filterAttributeEquals") == 0);
+  ck_assert(stats.step[1].calls == 3);
+  ck_assert(stats.step[1].visited == 3);
+  ck_assert(stats.step[1].produced == 2);
+  ck_assert(stats.contextSize == 1);
+  ck_assert(stats.resultSize == 2);
+  ck_assert(stats.allocations > 0);
+  ck_assert(stats.bytesAllocated > 0);
+  ck_assert(stats.compileNs >= 0 && stats.evalNs >= 0);
+  xQ_free(result, 1);
+  
+  // a failed compile still finishes collecting
+  status = xQ_find(x, (xmlChar*)"item[", &result);
+  ck_assert(status != XQ_OK);
+  ck_assert(stats.resultSize == 0);
+  
+  status = xQ_children(x, (xmlChar*)"doc", &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(strcmp(stats.plan, "filterByName(doc)") == 0);
+  ck_assert(stats.step[0].calls == 1);
+  ck_assert(stats.resultSize == 1);
+  xQ_free(result, 1);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test searches bounded by a result limit and depth
+ */
+START_TEST (test_find_limited)
+{
+  xQ* x;
+  xQ* result;
+  xQStats stats;
+  xQStatusCode status;
+  const char* xml = "<doc><item id='1'><item id='2'><item id='3'/></item></item><item id='4'/></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  xmlChar* id;
+  int found;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  x->stats = &stats;
+  
+  // the search stops at the first match
+  status = xQ_findLimited(x, (xmlChar*)"item", 1, 0, &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(result) == 1);
+  id = xmlGetProp(result->context.list[0], (xmlChar*)"id");
+  ck_assert(xmlStrcmp(id, (xmlChar*)"1") == 0);
+  xmlFree(id);
+  ck_assert(stats.step[0].visited == 2);
+  xQ_free(result, 1);
+  
+  // limits apply to the final step, not to intermediate ones
+  status = xQ_findLimited(x, (xmlChar*)"item[id=\"3\"]", 1, 0, &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(result) == 1);
+  xQ_free(result, 1);
+  
+  status = xQ_findLimited(x, (xmlChar*)"item > item", 2, 0, &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(result) == 2);
+  xQ_free(result, 1);
+  
+  // the document is the context, so doc is at depth 1
+  status = xQ_findLimited(x, (xmlChar*)"item", 0, 2, &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(result) == 2);
+  xQ_free(result, 1);
+  
+  status = xQ_findLimited(x, (xmlChar*)"item item", 0, 3, &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(result) == 1);
+  xQ_free(result, 1);
+  
+  // bounds don't outlive the search
+  ck_assert(x->limit == 0 && x->maxDepth == 0);
+  status = xQ_find(x, (xmlChar*)"item", &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(xQ_length(result) == 4);
+  xQ_free(result, 1);
+  
+  status = xQ_exists(x, (xmlChar*)"item[id=\"4\"]", &found);
+  ck_assert(status == XQ_OK);
+  ck_assert(found == 1);
+  
+  status = xQ_exists(x, (xmlChar*)"other", &found);
+  ck_assert(status == XQ_OK);
+  ck_assert(found == 0);
+  
+  status = xQ_exists(x, (xmlChar*)"item[", &found);
+  ck_assert(status != XQ_OK);
+  ck_assert(found == 0);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test matching without building a result
+ */
+START_TEST (test_is_exists)
+{
+  xQ* x;
+  xQ* items;
+  xQStatusCode status;
+  const char* xml = "<doc><item id='1'><part/></item><item id='2'/><other/></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  int found;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  status = xQ_find(x, (xmlChar*)"item", &items);
+  ck_assert(status == XQ_OK);
+  
+  status = xQ_is(items, (xmlChar*)"item", &found);
+  ck_assert(status == XQ_OK && found == 1);
+  
+  status = xQ_is(items, (xmlChar*)"item[id=\"2\"]", &found);
+  ck_assert(status == XQ_OK && found == 1);
+  
+  status = xQ_is(items, (xmlChar*)"other", &found);
+  ck_assert(status == XQ_OK && found == 0);
+  
+  // a descendant match isn't the node itself
+  status = xQ_is(items, (xmlChar*)"item part", &found);
+  ck_assert(status == XQ_OK && found == 0);
+  
+  status = xQ_exists(items, (xmlChar*)"part", &found);
+  ck_assert(status == XQ_OK && found == 1);
+  
+  status = xQ_exists(items, (xmlChar*)"other", &found);
+  ck_assert(status == XQ_OK && found == 0);
+  
+  status = xQ_is(items, (xmlChar*)"item[", &found);
+  ck_assert(status != XQ_OK && found == 0);
+  
+  ck_assert(items->limit == 0 && items->limitList == 0);
+  
+  xQ_free(items, 1);
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test counting matches
+ */
+START_TEST (test_count)
+{
+  xQ* x;
+  xQ* result;
+  unsigned long findAllocations;
+  xQStats stats;
+  xQStatusCode status;
+  const char* xml = "<doc><entry><entry/></entry><entry type='a'/><other/></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  unsigned long count;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  status = xQ_count(x, (xmlChar*)"entry", &count);
+  ck_assert(status == XQ_OK && count == 3);
+  
+  status = xQ_count(x, (xmlChar*)"entry entry", &count);
+  ck_assert(status == XQ_OK && count == 1);
+  
+  status = xQ_count(x, (xmlChar*)"entry[type=\"a\"]", &count);
+  ck_assert(status == XQ_OK && count == 1);
+  
+  status = xQ_count(x, (xmlChar*)"missing", &count);
+  ck_assert(status == XQ_OK && count == 0);
+  
+  status = xQ_count(x, (xmlChar*)"entry[", &count);
+  ck_assert(status != XQ_OK && count == 0);
+  
+  // nothing is stored for the final step, unlike a find
+  x->stats = &stats;
+  status = xQ_find(x, (xmlChar*)"*", &result);
+  ck_assert(status == XQ_OK);
+  findAllocations = stats.allocations;
+  xQ_free(result, 1);
+  
+  status = xQ_count(x, (xmlChar*)"*", &count);
+  ck_assert(status == XQ_OK && count == 5);
+  ck_assert(stats.resultSize == 5);
+  ck_assert(stats.allocations < findAllocations);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * The id attribute of an element in the group tests
+ */
+static const char* nodeId(xmlNodePtr node) {
+  return (const char*) node->properties->children->content;
+}
+
+/**
+ * Test searching with selector groups
+ */
+START_TEST (test_group)
+{
+  xQ* x;
+  xQ* result;
+  xQ* other;
+  xQStatusCode status;
+  const char* xml = "<doc><b id='1'><a id='2'><c id='3'/></a></b><a id='4'/><c id='5'/></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  unsigned long count;
+  int found;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  // single step selectors come back in document order without duplicates
+  status = xQ_find(x, (xmlChar*)"c, a, b, a", &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(result->context.size == 5);
+  ck_assert(strcmp(nodeId(result->context.list[0]), "1") == 0);
+  ck_assert(strcmp(nodeId(result->context.list[2]), "3") == 0);
+  ck_assert(strcmp(nodeId(result->context.list[4]), "5") == 0);
+  xQ_free(result, 1);
+  
+  // longer selectors are merged into document order
+  status = xQ_find(x, (xmlChar*)"a > c, b, doc > c", &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(result->context.size == 3);
+  ck_assert(strcmp(nodeId(result->context.list[0]), "1") == 0);
+  ck_assert(strcmp(nodeId(result->context.list[1]), "3") == 0);
+  ck_assert(strcmp(nodeId(result->context.list[2]), "5") == 0);
+  xQ_free(result, 1);
+  
+  status = xQ_count(x, (xmlChar*)"a, c, a c", &count);
+  ck_assert(status == XQ_OK && count == 4);
+  
+  // an unquoted value runs up to a space or ]
+  status = xQ_count(x, (xmlChar*)"a[id=4],c", &count);
+  ck_assert(status == XQ_OK && count == 3);
+  
+  status = xQ_count(x, (xmlChar*)"a[id=4,c]", &count);
+  ck_assert(status == XQ_OK && count == 0);
+  
+  status = xQ_count(x, (xmlChar*)"a[id='4,c'], c[id=5]", &count);
+  ck_assert(status == XQ_OK && count == 1);
+  
+  status = xQ_findLimited(x, (xmlChar*)"c, a", 2, 0, &result);
+  ck_assert(status == XQ_OK);
+  ck_assert(result->context.size == 2);
+  ck_assert(strcmp(nodeId(result->context.list[1]), "3") == 0);
+  xQ_free(result, 1);
+  
+  status = xQ_find(x, (xmlChar*)"b, a", &result);
+  ck_assert(status == XQ_OK);
+  
+  status = xQ_is(result, (xmlChar*)"c, a[id=\"4\"]", &found);
+  ck_assert(status == XQ_OK && found == 1);
+  
+  status = xQ_is(result, (xmlChar*)"c, other", &found);
+  ck_assert(status == XQ_OK && found == 0);
+  
+  status = xQ_find(result, (xmlChar*)"foo:a, a", &other);
+  ck_assert(status == XQ_UNKNOWN_NS_PREFIX && other == 0);
+  
+  xQ_free(result, 1);
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test extracting several selectors at once
+ */
+START_TEST (test_extract)
+{
+  xQ* x;
+  xQ* found;
+  xQ* results[5];
+  xQStats stats;
+  xQStatusCode status;
+  const char* xml = "<doc><b id='1'><a id='2'><a id='3'><c id='4'/></a></a></b><c id='5'/></doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  const xmlChar* selectors[] = {
+    (xmlChar*)"c",
+    (xmlChar*)"a c",
+    (xmlChar*)"missing",
+    (xmlChar*)"doc > c",
+    (xmlChar*)"c, b"
+  };
+  unsigned int i;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  x->stats = &stats;
+  status = xQ_extract(x, selectors, 5, results);
+  ck_assert(status == XQ_OK);
+  
+  // each result matches what a separate find returns
+  for (i = 0; i < 5; i++) {
+    unsigned long j;
+    
+    ck_assert(xQ_find(x, selectors[i], &found) == XQ_OK);
+    ck_assert(results[i]->context.size == found->context.size);
+    for (j = 0; j < found->context.size; j++)
+      ck_assert(results[i]->context.list[j] == found->context.list[j]);
+    
+    xQ_free(found, 1);
+  }
+  
+  ck_assert(results[0]->context.size == 2);
+  ck_assert(strcmp(nodeId(results[0]->context.list[1]), "5") == 0);
+  ck_assert(results[1]->context.size == 2);
+  ck_assert(results[2]->context.size == 0);
+  ck_assert(results[4]->context.size == 3);
+  
+  for (i = 0; i < 5; i++)
+    xQ_free(results[i], 1);
+  
+  // the selectors are compiled into a single plan
+  status = xQ_extract(x, selectors, 2, results);
+  ck_assert(status == XQ_OK);
+  ck_assert(strcmp(stats.plan, "findDescendantsByName(c), findDescendantsByName(a) -> findDescendantsByName(c)") == 0);
+  ck_assert(stats.resultSize == 4);
+  ck_assert(stats.step[0].visited == 6);
+  x->stats = 0;
+  
+  for (i = 0; i < 2; i++)
+    xQ_free(results[i], 1);
+  
+  selectors[1] = (xmlChar*)"a[";
+  status = xQ_extract(x, selectors, 2, results);
+  ck_assert(status != XQ_OK);
+  ck_assert(results[0] == 0 && results[1] == 0);
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test searching with the attribute operators
+ */
+START_TEST (test_attr_operators)
+{
+  xQ* x;
+  xQStatusCode status;
+  const char* xml =
+    "<!DOCTYPE doc [<!ATTLIST e d CDATA 'dflt'>]>"
+    "<doc>"
+    "<e id='1' class='one two' href='http://a/x.xml' n='10'/>"
+    "<e id='2' class='onetwo' href='https://a/x.json' n=' 2.5 '/>"
+    "<e id='3' class='' href='&amp;x.xml' n='-3'/>"
+    "<e id='4' n='ten'/>"
+    "<f n='0x10'/><f n='inf'/><f n='-INF'/><f n='nan'/><f n='1e2'/><f n='.5'/><f n='5.'/>"
+    "</doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  unsigned long count;
+  unsigned int i;
+  struct { const char* selector; unsigned long count; } cases[] = {
+    {"e[class]", 3},
+    {"e[missing]", 0},
+    {"e[d]", 4},
+    {"e[d=dflt]", 4},
+    {"e[href^=\"http:\"]", 1},
+    {"e[href^=http]", 2},
+    {"e[href^='']", 0},
+    {"e[href$='.xml']", 2},
+    {"e[href$='&x.xml']", 1},
+    {"e[href$=\"\"]", 0},
+    {"e[href*=a]", 2},
+    {"e[href*=x]", 3},
+    {"e[class~=two]", 1},
+    {"e[class~=one]", 1},
+    {"e[class~='one two']", 0},
+    {"e[class~='']", 0},
+    {"e[n>2]", 2},
+    {"e[n>'-3']", 2},
+    {"e[n<0]", 1},
+    {"e[n<100][n>-100]", 3},
+    {"e[class][n<5]", 2},
+    {"f[n>0]", 3},
+    {"f[n<1]", 1},
+    {"f[n>'-1e300'], f[n<1e300]", 3},
+    {"f[n>' -.5e1 '][n<+5.]", 1},
+    {"f[n>4.99][n<5.01]", 1}
+  };
+  xQStats stats;
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    status = xQ_count(x, (xmlChar*) cases[i].selector, &count);
+    ck_assert(status == XQ_OK);
+    ck_assert(count == cases[i].count);
+  }
+  
+  // searches that collect statistics run the filters uncompiled
+  x->stats = &stats;
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    status = xQ_count(x, (xmlChar*) cases[i].selector, &count);
+    ck_assert(status == XQ_OK);
+    ck_assert(count == cases[i].count);
+  }
+  x->stats = 0;
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+/**
+ * Test searching with the text pseudos
+ */
+START_TEST (test_text_pseudos)
+{
+  xQ* x;
+  xQStatusCode status;
+  const char* xml =
+    "<!DOCTYPE doc [<!ENTITY ent 'xy'>]>"
+    "<doc>"
+    "<p id='1'>ab<b>cd</b>e</p>"
+    "<p id='2'>a<![CDATA[<b>]]>c<!-- bc --></p>"
+    "<p id='3'>w&ent;z</p>"
+    "<p id='4' href='x(1)'></p>"
+    "<p id='5'>0123456789012345678901234567890123456789<i>0123456789012345678901234567890123456789</i>0123456789012345678901234567890123456789</p>"
+    "</doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  unsigned long count;
+  unsigned int i;
+  struct { const char* selector; unsigned long count; } cases[] = {
+    {"p:contains(bc)", 1},
+    {"p:contains('abcde')", 1},
+    {"p:contains('abcdef')", 0},
+    {"p:contains(d)", 1},
+    {"p:contains('<b>')", 1},
+    {"p:contains('a<b>c')", 1},
+    {"p:contains('wxyz')", 1},
+    {"p:contains('')", 5},
+    {"b:contains(c)", 1},
+    {"p:contains(\"901234567890123456789012345678901234567890123456789012345678901234567890\")", 1},
+    {"p:contains(\"90123456789012345678901234567890123456789012345678901234567890123456789x\")", 0},
+    {"p:text(abcde)", 1},
+    {"p:text(abcd)", 0},
+    {"p:text(bcde)", 0},
+    {"p:text('a<b>c')", 1},
+    {"p:text(wxyz)", 1},
+    {"p:text('')", 1},
+    {"p:contains(a):text(abcde)", 1},
+    {"p[id=2]:contains(c)", 1},
+    {"doc:contains('ezA') p", 0},
+    {"doc:contains('ea<') p", 5},
+    {"p:contains(a<b>c)", 1},
+    {"p[href=x(1)]", 1},
+    {"p[href=x(1)]:text(''), p:text(wxyz)", 2}
+  };
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    status = xQ_count(x, (xmlChar*) cases[i].selector, &count);
+    ck_assert(status == XQ_OK);
+    ck_assert(count == cases[i].count);
+  }
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
+
+
+/**
+ * Test that compiled steps find what the steps they're compiled from do.
+ * Searches that collect statistics run the steps one at a time.
+ */
+START_TEST (test_compiled_steps)
+{
+  xQ* x;
+  xQ* fused;
+  xQ* stepped;
+  xQStats stats;
+  xQStatusCode status;
+  const char* xml =
+    "<doc xmlns:t='urn:t'>"
+    "<s><item id='1' class='a b'>one<name>x</name></item><item id='2'><name>y</name></item></s>"
+    "<s><t:item id='3' class='b'>two<name>x</name></t:item><item id='10' lang='en-US'/></s>"
+    "<item class='a'><item id='4'>one</item></item>"
+    "</doc>";
+  int xmlLen = strlen(xml);
+  xmlDocPtr doc;
+  unsigned long i, j;
+  const char* selectors[] = {
+    "item[id]",
+    "item[class~=b] > name",
+    "t:item[id=3]",
+    "s > item[id][class]",
+    "item + item[lang|=en]",
+    "item[id>2]",
+    "item[id<3]:contains(one)",
+    "*[class^=a]",
+    "*[class$=b] name:text(x)",
+    "item:text(one), s > *[id*=0]",
+    "item item[id]",
+    "item[missing]"
+  };
+  
+  status = xQ_alloc_initMemory(&x, xml, xmlLen, &doc);
+  ck_assert(status == XQ_OK);
+  status = xQ_addNamespace(x, (xmlChar*)"t", (xmlChar*)"urn:t");
+  ck_assert(status == XQ_OK);
+  
+  for (i = 0; i < sizeof(selectors) / sizeof(selectors[0]); i++) {
+    status = xQ_find(x, (xmlChar*) selectors[i], &fused);
+    ck_assert(status == XQ_OK);
+    
+    x->stats = &stats;
+    status = xQ_find(x, (xmlChar*) selectors[i], &stepped);
+    ck_assert(status == XQ_OK);
+    x->stats = 0;
+    
+    ck_assert(xQ_length(fused) == xQ_length(stepped));
+    for (j = 0; j < xQ_length(fused); j++)
+      ck_assert(fused->context.list[j] == stepped->context.list[j]);
+    
+    xQ_free(fused, 1);
+    xQ_free(stepped, 1);
+  }
+  
+  xQ_free(x, 1);
+
+  xmlFreeDoc(doc);
+}
+END_TEST
 
 
 /**
@@ -159,6 +1048,35 @@ Suite* search_suite() {
 
   singleTestCase(s, tc_xml_no_children, "xml without children", test_xml_no_children);
 
+  singleTestCase(s, tc_node_list, "node list", test_node_list);
+
+  singleTestCase(s, tc_copy_cancel, "copy and cancel", test_copy_cancel);
+
+  singleTestCase(s, tc_node_text, "node text", test_node_text);
+
+  singleTestCase(s, tc_node_attr_ref, "node attribute reference", test_node_attr_ref);
+
+  singleTestCase(s, tc_node_write_xml, "node write xml", test_node_write_xml);
+  singleTestCase(s, tc_list_write_xml, "list write xml", test_list_write_xml);
+
+  singleTestCase(s, tc_stats, "search statistics", test_stats);
+
+  singleTestCase(s, tc_find_limited, "limited find", test_find_limited);
+
+  singleTestCase(s, tc_is_exists, "is and exists", test_is_exists);
+
+  singleTestCase(s, tc_count, "count", test_count);
+
+  singleTestCase(s, tc_group, "selector groups", test_group);
+
+  singleTestCase(s, tc_extract, "extract", test_extract);
+
+  singleTestCase(s, tc_attr_ops, "attribute operators", test_attr_operators);
+
+  singleTestCase(s, tc_text_pseudos, "text pseudos", test_text_pseudos);
+
+  singleTestCase(s, tc_compiled, "compiled steps", test_compiled_steps);
+
   return s;
 }
 
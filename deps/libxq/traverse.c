@@ -19,20 +19,67 @@
  */
 
 #include "libxq.h"
+#include "xqutil.h"
 
+#include <stdlib.h>
 #include <string.h>
 
-// namespace macros
-#define nsLookup(ctx,ns) \
-   if ((ns) && ((ns) != XQ_EMPTY_NAMESPACE)) { \
-     if (!((ns) = xQ_namespaceForPrefix((ctx), (ns)))) \
-       return XQ_UNKNOWN_NS_PREFIX; \
-  }
+static xQStatusCode findDescendants(xQ* context, xmlNodePtr node, unsigned int depth, xQSignature names, xQNodeList* outList);
+static xQStatusCode findDescendantsByName(xQ* context, const xmlChar* name, const xmlChar* ns, xmlNodePtr node, unsigned int depth, xQSignature names, xQNodeList* outList);
+static xQStatusCode findEachDescendants(xQ* context, xQSearchExpr** exprs, const xmlChar** uris, unsigned int count, xmlNodePtr node, unsigned int depth, xQNodeList** outLists);
+static int subtreeLacksAll(xQ* context, xQSearchExpr** exprs, unsigned int count, xmlNodePtr node);
+static xQStatusCode runDescendants(xQ* context, const xQProgramRun* run, xmlNodePtr node, unsigned int depth, xQSignature names, xQNodeList* outList);
+
+// tests an attribute value against the argument of a filter
+typedef int (*xQAttrTest)(const xmlChar* value, const xmlChar* arg);
+
+static xQStatusCode filterAttribute(const xmlChar* name, const xmlChar* arg, xmlNodePtr node, xQNodeList* outList, xQAttrTest test);
+static int matchAttribute(const xmlChar* name, const xmlChar* arg, xmlNodePtr node, xQAttrTest test);
+static int attrEquals(const xmlChar* value, const xmlChar* arg);
+static int attrExists(const xmlChar* value, const xmlChar* arg);
+static int attrHasPrefix(const xmlChar* value, const xmlChar* arg);
+static int attrHasSuffix(const xmlChar* value, const xmlChar* arg);
+static int attrContains(const xmlChar* value, const xmlChar* arg);
+static int attrHasWord(const xmlChar* value, const xmlChar* arg);
+static int attrGreater(const xmlChar* value, const xmlChar* arg);
+static int attrLess(const xmlChar* value, const xmlChar* arg);
+
+#define isAttrSpace(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+
+// state of a match against text that's read one segment at a time
+typedef struct _xQTextMatch {
+  const xmlChar* needle;
+  int needleLen;
+  int offset;        // bytes of needle matched so far, or -1 on a mismatch
+  xmlChar* carry;    // the last needleLen - 1 bytes read, plus room to join the next segment
+  int carryLen;
+  int found;
+} xQTextMatch;
+
+// takes the next segment of text, returning non-zero once the match is decided
+typedef int (*xQTextSegmentFunc)(xQTextMatch* match, const xmlChar* text, int len);
 
-#define nsMatch(node,nsuri) \
-  ( (!(nsuri)) || \
-    ((nsuri) == XQ_EMPTY_NAMESPACE && (!(node)->ns)) || \
-    ((node)->ns && (xmlStrcmp((node)->ns->href, (nsuri)) == 0)) )
+static xQStatusCode filterText(xmlChar** args, xmlNodePtr node, xQNodeList* outList, xQTextSegmentFunc segment);
+static xQStatusCode matchText(const xmlChar* needle, xmlNodePtr node, xQTextSegmentFunc segment, int* matched);
+static int eachTextSegment(xmlNodePtr node, xQTextSegmentFunc segment, xQTextMatch* match);
+static int containsSegment(xQTextMatch* match, const xmlChar* text, int len);
+static int equalsSegment(xQTextMatch* match, const xmlChar* text, int len);
+static int findBytes(const xmlChar* haystack, int len, const xmlChar* needle, int needleLen);
+
+// joined segments up to this size are held on the stack
+#define XQ_TEXT_CARRY_SIZE 128
+
+/**
+ * Return the depth of node below its document, which is at depth 0
+ */
+unsigned int xQNode_depth(xmlNodePtr node) {
+  unsigned int depth = 0;
+  
+  while (node && (node = node->parent))
+    depth++;
+  
+  return depth;
+}
 
 /**
  * Search all decendants of node for elements and populate the output
@@ -41,16 +88,38 @@
  * Returns a 0 (XQ_OK) on success, an error code otherwise
  */
 xQStatusCode _xQ_findDescendants(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  if (!node)
+    return XQ_OK;
+  
+  return findDescendants(context, node, context->depthLimit ? xQNode_depth(node) + 1 : 0, context->subtreeNames, outList);
+}
+
+/**
+ * Search the decendants of node for elements, stopping at the depth and
+ * result limits of the search and skipping subtrees that lack the names
+ * the rest of the search needs. The depth parameter is the depth of the
+ * children of node.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode findDescendants(xQ* context, xmlNodePtr node, unsigned int depth, xQSignature names, xQNodeList* outList) {
   xQStatusCode result = XQ_OK;
-  xmlNodePtr cur = node ? node->children : node;
+  xmlNodePtr cur = node->children;
   
-  while (cur && result == XQ_OK) {
+  if (xQ_depthExceeded(context, depth) || xQ_subtreeLacks(context, node, names))
+    return XQ_OK;
+  
+  while (cur && result == XQ_OK && !xQ_limitReached(context, outList)) {
+    
+    if (xQ_isCancelled(context))
+      return XQ_CANCELLED;
     
     if (cur->type == XML_ELEMENT_NODE) {
+      xQ_countVisited(1);
       result = xQNodeList_push(outList, cur);
       
       if (cur->children && result == XQ_OK)
-        result = _xQ_findDescendants(context, args, cur, outList);
+        result = findDescendants(context, cur, depth + 1, names, outList);
     }
     
     cur = cur->next;
@@ -68,20 +137,174 @@ xQStatusCode _xQ_findDescendants(xQ* context, xmlChar** args, xmlNodePtr node, x
 xQStatusCode _xQ_findDescendantsByName(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
   const xmlChar* name = args[0];
   const xmlChar* ns = args[1];
-  xQStatusCode result = XQ_OK;
-  xmlNodePtr cur = node ? node->children : node;
   
   nsLookup(context, ns);
   
-  while (cur && result == XQ_OK) {
+  if (!node)
+    return XQ_OK;
+  
+  return findDescendantsByName(context, name, ns, node, context->depthLimit ? xQNode_depth(node) + 1 : 0, context->subtreeNames, outList);
+}
+
+/**
+ * Search the decendants of node for elements matching name, stopping at
+ * the depth and result limits of the search and skipping subtrees that
+ * lack the names the rest of the search needs. The depth parameter is the
+ * depth of the children of node.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode findDescendantsByName(xQ* context, const xmlChar* name, const xmlChar* ns, xmlNodePtr node, unsigned int depth, xQSignature names, xQNodeList* outList) {
+  xQStatusCode result = XQ_OK;
+  xmlNodePtr cur = node->children;
+  
+  if (xQ_depthExceeded(context, depth) || xQ_subtreeLacks(context, node, names))
+    return XQ_OK;
+  
+  while (cur && result == XQ_OK && !xQ_limitReached(context, outList)) {
+    
+    if (xQ_isCancelled(context))
+      return XQ_CANCELLED;
     
     if (cur->type == XML_ELEMENT_NODE) {
+      xQ_countVisited(1);
       if ( (xmlStrcmp(name, cur->name) == 0) && nsMatch(cur, ns) )
             
         result = xQNodeList_push(outList, cur);
       
       if (cur->children && result == XQ_OK)
-        result = _xQ_findDescendantsByName(context, args, cur, outList);
+        result = findDescendantsByName(context, name, ns, cur, depth + 1, names, outList);
+    }
+    
+    cur = cur->next;
+  }
+  
+  return result;
+}
+
+/**
+ * Search all decendants of node in a single walk for elements matching
+ * any selector in a group, where every selector starts with a descendant
+ * search. An element matching a single step selector is added to the
+ * output once; the remaining steps of a longer selector are evaluated
+ * from each element matching its first step.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_findGroupDescendants(xQ* context, xQSearchExpr* group, xmlNodePtr node, xQNodeList* outList) {
+  xQStatusCode result;
+  xQSearchExpr** exprs;
+  xQNodeList** outLists;
+  xQSearchExpr* alt;
+  unsigned int count = 0, i;
+  
+  for (alt = group; alt; alt = alt->alternative)
+    count++;
+  
+  exprs = (xQSearchExpr**) xQ_malloc((sizeof(xQSearchExpr*) + sizeof(xQNodeList*)) * count);
+  if (!exprs)
+    return XQ_OUT_OF_MEMORY;
+  outLists = (xQNodeList**) (exprs + count);
+  
+  for (alt = group, i = 0; alt; alt = alt->alternative, i++) {
+    exprs[i] = alt;
+    outLists[i] = outList;
+  }
+  
+  result = _xQ_findEachDescendants(context, exprs, count, node, outLists);
+  
+  free(exprs);
+  
+  return result;
+}
+
+/**
+ * Search all decendants of node in a single walk for several selectors,
+ * each starting with a descendant search, adding the matches for exprs[i]
+ * to outLists[i]. An element matching consecutive single step selectors
+ * that share a list is added to it once; the remaining steps of a longer
+ * selector are evaluated from each element matching its first step.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_findEachDescendants(xQ* context, xQSearchExpr** exprs, unsigned int count, xmlNodePtr node, xQNodeList** outLists) {
+  xQStatusCode result = XQ_OK;
+  xQStepStats* outer = xQ_currentStep;
+  const xmlChar** uris;
+  unsigned int i;
+  
+  if (!node || !count)
+    return XQ_OK;
+  
+  // resolve namespace prefixes once for the whole walk
+  uris = (const xmlChar**) xQ_malloc(sizeof(xmlChar*) * count);
+  if (!uris)
+    return XQ_OUT_OF_MEMORY;
+  
+  for (i = 0; i < count; i++) {
+    uris[i] = exprs[i]->operation == _xQ_findDescendantsByName ? exprs[i]->argv[1] : 0;
+    
+    if (uris[i] && uris[i] != XQ_EMPTY_NAMESPACE && !(uris[i] = xQ_namespaceForPrefix(context, uris[i])))
+      result = XQ_UNKNOWN_NS_PREFIX;
+    
+    if (xQ_currentStats && xQStats_step(exprs[i]))
+      xQStats_step(exprs[i])->calls++;
+  }
+  
+  // the walk is counted against the first selector
+  if (xQ_currentStats)
+    xQ_currentStep = xQStats_step(exprs[0]);
+  
+  if (result == XQ_OK)
+    result = findEachDescendants(context, exprs, uris, count, node, context->depthLimit ? xQNode_depth(node) + 1 : 0, outLists);
+  
+  xQ_currentStep = outer;
+  free(uris);
+  
+  return result;
+}
+
+/**
+ * Search the decendants of node for elements matching several selectors,
+ * stopping at the depth and result limits of the search. The depth
+ * parameter is the depth of the children of node.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode findEachDescendants(xQ* context, xQSearchExpr** exprs, const xmlChar** uris, unsigned int count, xmlNodePtr node, unsigned int depth, xQNodeList** outLists) {
+  xQStatusCode result = XQ_OK;
+  xmlNodePtr cur = node->children;
+  xQNodeList* added;
+  unsigned int i;
+  
+  if (xQ_depthExceeded(context, depth) || subtreeLacksAll(context, exprs, count, node))
+    return XQ_OK;
+  
+  while (cur && result == XQ_OK && !xQ_limitReached(context, outLists[0])) {
+    
+    if (xQ_isCancelled(context))
+      return XQ_CANCELLED;
+    
+    if (cur->type == XML_ELEMENT_NODE) {
+      xQ_countVisited(1);
+      added = 0;
+      
+      for (i = 0; i < count && result == XQ_OK; i++) {
+        if (exprs[i]->operation == _xQ_findDescendantsByName &&
+            !((xmlStrcmp(exprs[i]->argv[0], cur->name) == 0) && nsMatch(cur, uris[i])))
+          continue;
+        
+        if (xQ_currentStats && xQStats_step(exprs[i]))
+          xQStats_step(exprs[i])->produced++;
+        
+        if (exprs[i]->next)
+          result = xQSearchExpr_eval(exprs[i]->next, context, cur, outLists[i]);
+        else if (added != outLists[i] && (added = outLists[i]))
+          result = xQNodeList_push(outLists[i], cur);
+      }
+      
+      if (cur->children && result == XQ_OK)
+        result = findEachDescendants(context, exprs, uris, count, cur, depth + 1, outLists);
     }
     
     cur = cur->next;
@@ -90,6 +313,24 @@ xQStatusCode _xQ_findDescendantsByName(xQ* context, xmlChar** args, xmlNodePtr n
   return result;
 }
 
+/**
+ * Return true if the signatures of the search rule out the elements below
+ * node holding all the names needed by any of several selectors
+ */
+static int subtreeLacksAll(xQ* context, xQSearchExpr** exprs, unsigned int count, xmlNodePtr node) {
+  xQSignature held;
+  unsigned int i;
+  
+  if (!context->signatures || !xQSignatures_get(context->signatures, node, &held))
+    return 0;
+  
+  for (i = 0; i < count; i++)
+    if ((held & exprs[i]->names) == exprs[i]->names)
+      return 0;
+  
+  return 1;
+}
+
 /**
  * Search immediate children of node for elements matching name and populate
  * the output list with the results.
@@ -104,9 +345,13 @@ xQStatusCode _xQ_findChildrenByName(xQ* context, xmlChar** args, xmlNodePtr node
   
   nsLookup(context, ns);
   
-  while (cur && result == XQ_OK) {
+  if (context->depthLimit && cur && xQ_depthExceeded(context, xQNode_depth(cur)))
+    return XQ_OK;
+  
+  while (cur && result == XQ_OK && !xQ_limitReached(context, outList)) {
     
     if (cur->type == XML_ELEMENT_NODE) {
+      xQ_countVisited(1);
       if ( (xmlStrcmp(name, cur->name) == 0) && nsMatch(cur, ns) )
         result = xQNodeList_push(outList, cur);
     }
@@ -132,6 +377,7 @@ xQStatusCode _xQ_findNextSiblingByName(xQ* context, xmlChar** args, xmlNodePtr n
   nsLookup(context, ns);
   
   if (node->type == XML_ELEMENT_NODE && (sibling = xmlNextElementSibling(node))) {
+    xQ_countVisited(1);
     if ( (xmlStrcmp(name, sibling->name) == 0) && nsMatch(sibling, ns) )
       result = xQNodeList_push(outList, sibling);
   }
@@ -139,12 +385,166 @@ xQStatusCode _xQ_findNextSiblingByName(xQ* context, xmlChar** args, xmlNodePtr n
   return result;
 }
 
+/**
+ * Run a compiled step from node: reach elements as its traversal would
+ * and add those passing every test of the program to the output list, in
+ * a single pass with no call or list for each of its filters.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_runProgram(xQ* context, const xQProgram* program, xmlNodePtr node, xQNodeList* outList) {
+  xQStatusCode result;
+  xQProgramRun run;
+  xmlNodePtr cur;
+  
+  if ((result = _xQ_initProgramRun(&run, context, program, node ? node->doc : 0)) != XQ_OK || !node)
+    return result;
+  
+  if (program->traversal == _xQ_findDescendants || program->traversal == _xQ_findDescendantsByName)
+    return runDescendants(context, &run, node, context->depthLimit ? xQNode_depth(node) + 1 : 0, context->subtreeNames, outList);
+  
+  if (program->traversal == _xQ_findChildrenByName) {
+    cur = node->children;
+    
+    if (context->depthLimit && cur && xQ_depthExceeded(context, xQNode_depth(cur)))
+      return XQ_OK;
+    
+    for (; cur && result == XQ_OK && !xQ_limitReached(context, outList); cur = cur->next)
+      if (_xQ_programMatches(&run, cur, &result) && result == XQ_OK)
+        result = xQNodeList_push(outList, cur);
+    
+    return result;
+  }
+  
+  if (node->type == XML_ELEMENT_NODE && (cur = xmlNextElementSibling(node)) && _xQ_programMatches(&run, cur, &result) && result == XQ_OK)
+    result = xQNodeList_push(outList, cur);
+  
+  return result;
+}
+
+/**
+ * Prepare to run a compiled step against the elements of doc, resolving
+ * the namespace prefix of its name.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_initProgramRun(xQProgramRun* run, xQ* context, const xQProgram* program, xmlDocPtr doc) {
+  run->program = program;
+  run->interned = 0;
+  run->uri = program->code[0].opcode == XQ_INSTR_NAME ? program->code[0].arg : 0;
+  
+  nsLookup(context, run->uri);
+  
+  // names parsed into the document's dictionary compare by address, which
+  // pays for looking the name up when a whole subtree is searched
+  if ((program->traversal == _xQ_findDescendants || program->traversal == _xQ_findDescendantsByName) &&
+      program->code[0].opcode == XQ_INSTR_NAME && doc && doc->dict)
+    run->interned = xmlDictExists(doc->dict, program->code[0].name, -1);
+  
+  return XQ_OK;
+}
+
+/**
+ * Run a compiled descendant search below node, stopping at the depth and
+ * result limits of the search and skipping subtrees that lack the names
+ * the rest of the search needs. The depth parameter is the depth of the
+ * children of node.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode runDescendants(xQ* context, const xQProgramRun* run, xmlNodePtr node, unsigned int depth, xQSignature names, xQNodeList* outList) {
+  xQStatusCode result = XQ_OK;
+  xmlNodePtr cur = node->children;
+  
+  if (xQ_depthExceeded(context, depth) || xQ_subtreeLacks(context, node, names))
+    return XQ_OK;
+  
+  while (cur && result == XQ_OK && !xQ_limitReached(context, outList)) {
+    
+    if (xQ_isCancelled(context))
+      return XQ_CANCELLED;
+    
+    if (cur->type == XML_ELEMENT_NODE) {
+      if (_xQ_programMatches(run, cur, &result) && result == XQ_OK)
+        result = xQNodeList_push(outList, cur);
+      
+      if (cur->children && result == XQ_OK)
+        result = runDescendants(context, run, cur, depth + 1, names, outList);
+    }
+    
+    cur = cur->next;
+  }
+  
+  return result;
+}
+
+/**
+ * Run the tests of a compiled step against node, in order, stopping at
+ * the first that fails. An error reading the text of node is set in
+ * status.
+ *
+ * Returns 1 if node passes every test, or 0
+ */
+int _xQ_programMatches(const xQProgramRun* run, xmlNodePtr node, xQStatusCode* status) {
+  const xQInstr* instr = run->program->code;
+  const xQInstr* end = instr + run->program->length;
+  int matched = 1;
+  
+  if (node->type != XML_ELEMENT_NODE)
+    return 0;
+  
+  xQ_countVisited(1);
+  
+  for (; matched && instr < end; instr++) {
+    switch (instr->opcode) {
+      case XQ_INSTR_NAME:
+        matched = (node->name == run->interned ||
+          (node->name[0] == instr->name[0] && xmlStrcmp(node->name, instr->name) == 0)) &&
+          nsMatch(node, run->uri);
+        break;
+      case XQ_INSTR_ATTR_EQUALS:
+        matched = matchAttribute(instr->name, instr->arg, node, attrEquals);
+        break;
+      case XQ_INSTR_ATTR_EXISTS:
+        matched = matchAttribute(instr->name, instr->arg, node, attrExists);
+        break;
+      case XQ_INSTR_ATTR_PREFIX:
+        matched = matchAttribute(instr->name, instr->arg, node, attrHasPrefix);
+        break;
+      case XQ_INSTR_ATTR_SUFFIX:
+        matched = matchAttribute(instr->name, instr->arg, node, attrHasSuffix);
+        break;
+      case XQ_INSTR_ATTR_CONTAINS:
+        matched = matchAttribute(instr->name, instr->arg, node, attrContains);
+        break;
+      case XQ_INSTR_ATTR_WORD:
+        matched = matchAttribute(instr->name, instr->arg, node, attrHasWord);
+        break;
+      case XQ_INSTR_ATTR_GREATER:
+        matched = matchAttribute(instr->name, instr->arg, node, attrGreater);
+        break;
+      case XQ_INSTR_ATTR_LESS:
+        matched = matchAttribute(instr->name, instr->arg, node, attrLess);
+        break;
+      case XQ_INSTR_TEXT_CONTAINS:
+      case XQ_INSTR_TEXT_EQUALS:
+        if (XQ_OK != (*status = matchText(instr->name, node,
+            instr->opcode == XQ_INSTR_TEXT_CONTAINS ? containsSegment : equalsSegment, &matched)))
+          return 0;
+        break;
+    }
+  }
+  
+  return matched;
+}
+
 /**
  * Copy node to the output list
  *
  * Returns a 0 (XQ_OK) on success, an error code otherwise
  */
 xQStatusCode _xQ_addToOutput(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  xQ_countVisited(1);
   return xQNodeList_push(outList, node);
 }
 
@@ -155,23 +555,454 @@ xQStatusCode _xQ_addToOutput(xQ* context, xmlChar** args, xmlNodePtr node, xQNod
  * Returns a 0 (XQ_OK) on success, an error code otherwise
  */
 xQStatusCode _xQ_filterAttributeEquals(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
-  const xmlChar* name = args[0];
-  const xmlChar* value = args[1];
-  xmlChar* thisValue;
-  xQStatusCode result = XQ_OK;
+  return filterAttribute(args[0], args[1], node, outList, attrEquals);
+}
+
+/**
+ * Add the node to the output list only if it has an attribute with a
+ * given name, whatever its value.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterAttributeExists(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterAttribute(args[0], args[1], node, outList, attrExists);
+}
+
+/**
+ * Add the node to the output list only if it has an attribute whose value
+ * begins with a given, non-empty string.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterAttributePrefix(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterAttribute(args[0], args[1], node, outList, attrHasPrefix);
+}
+
+/**
+ * Add the node to the output list only if it has an attribute whose value
+ * ends with a given, non-empty string.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterAttributeSuffix(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterAttribute(args[0], args[1], node, outList, attrHasSuffix);
+}
+
+/**
+ * Add the node to the output list only if it has an attribute whose value
+ * contains a given, non-empty string.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterAttributeContains(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterAttribute(args[0], args[1], node, outList, attrContains);
+}
+
+/**
+ * Add the node to the output list only if it has an attribute whose value
+ * is a whitespace separated list of words, one of which is exactly a
+ * given word.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterAttributeWord(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterAttribute(args[0], args[1], node, outList, attrHasWord);
+}
+
+/**
+ * Add the node to the output list only if it has an attribute whose value
+ * is a number greater than a given number.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterAttributeGreater(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterAttribute(args[0], (const xmlChar*) xQ_filterBound(args), node, outList, attrGreater);
+}
+
+/**
+ * Add the node to the output list only if it has an attribute whose value
+ * is a number less than a given number.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterAttributeLess(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterAttribute(args[0], (const xmlChar*) xQ_filterBound(args), node, outList, attrLess);
+}
+
+/**
+ * Add the node to the output list only if its text content, as
+ * xQNode_getText() would return it, contains a given string.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterTextContains(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterText(args, node, outList, containsSegment);
+}
+
+/**
+ * Add the node to the output list only if its text content, as
+ * xQNode_getText() would return it, is exactly a given string.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode _xQ_filterTextEquals(xQ* context, xmlChar** args, xmlNodePtr node, xQNodeList* outList) {
+  return filterText(args, node, outList, equalsSegment);
+}
+
+/**
+ * Skip the decimal digits at the start of str.
+ *
+ * Returns the number of digits skipped
+ */
+static int skipDigits(const xmlChar** str) {
+  const xmlChar* start = *str;
   
-  if (node) {
-    thisValue = xmlGetProp(node, name);
-    if (thisValue) {
-      
-      if (xmlStrcmp(thisValue, value) == 0)
-        result = xQNodeList_push(outList, node);
-      
-      xmlFree(thisValue);
+  while (**str >= '0' && **str <= '9')
+    ++(*str);
+  
+  return *str - start;
+}
+
+/**
+ * Parse a string holding only a decimal number, such as "-1.5" or "2e3",
+ * with optional surrounding space. Hexadecimal numbers, infinities and
+ * NaN are not numbers here, though strtod() would read them.
+ *
+ * Returns non-zero and sets number if the whole string is a number, or 0
+ */
+int xQ_parseNumber(const xmlChar* str, double* number) {
+  const xmlChar* end;
+  int digits;
+  
+  while (isAttrSpace(*str))
+    ++str;
+  
+  end = str;
+  if (*end == '+' || *end == '-')
+    ++end;
+  
+  digits = skipDigits(&end);
+  if (*end == '.') {
+    ++end;
+    digits += skipDigits(&end);
+  }
+  
+  if (!digits)
+    return 0;
+  
+  if (*end == 'e' || *end == 'E') {
+    ++end;
+    if (*end == '+' || *end == '-')
+      ++end;
+    if (!skipDigits(&end))
+      return 0;
+  }
+  
+  while (isAttrSpace(*end))
+    ++end;
+  
+  if (*end)
+    return 0;
+  
+  *number = strtod((const char*) str, 0);
+  return 1;
+}
+
+/**
+ * Add the node to the output list if the value of the attribute name
+ * passes test, which is given the value and arg.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode filterAttribute(const xmlChar* name, const xmlChar* arg, xmlNodePtr node, xQNodeList* outList, xQAttrTest test) {
+  if (!node)
+    return XQ_OK;
+  
+  xQ_countVisited(1);
+  
+  return matchAttribute(name, arg, node, test) ? xQNodeList_push(outList, node) : XQ_OK;
+}
+
+/**
+ * Test the value of the attribute name of node against arg. The value is
+ * read in place unless it's split across several nodes.
+ *
+ * Returns 1 if node has the attribute and its value passes test, or 0
+ */
+static int matchAttribute(const xmlChar* name, const xmlChar* arg, xmlNodePtr node, xQAttrTest test) {
+  const xmlChar* value;
+  xmlChar* copy = 0;
+  int len, matched;
+  
+  // a missing or split value, or a default from the DTD, needs a copy
+  if (!(value = xQNode_getAttrRef(node, name, &len)) && (value = copy = xmlGetProp(node, name)))
+    xQ_countAlloc(xmlStrlen(copy) + 1);
+  
+  matched = value && test(value, arg);
+  
+  if (copy)
+    xmlFree(copy);
+  
+  return matched;
+}
+
+/**
+ * Add the node to the output list if its text content matches args[0].
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode filterText(xmlChar** args, xmlNodePtr node, xQNodeList* outList, xQTextSegmentFunc segment) {
+  xQStatusCode result;
+  int matched;
+  
+  if (!node)
+    return XQ_OK;
+  
+  xQ_countVisited(1);
+  
+  if (XQ_OK != (result = matchText(args[0], node, segment, &matched)) || !matched)
+    return result;
+  
+  return xQNodeList_push(outList, node);
+}
+
+/**
+ * Test the text content of node against needle, setting matched to 1 if
+ * it passes and to 0 otherwise. The text and CDATA descendants are passed
+ * to segment in place, in document order, without joining them. Text
+ * containing entity references is copied once with xQNode_getText()
+ * instead.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode matchText(const xmlChar* needle, xmlNodePtr node, xQTextSegmentFunc segment, int* matched) {
+  xmlChar stackCarry[XQ_TEXT_CARRY_SIZE];
+  xQTextMatch match;
+  xmlChar* copy;
+  int carrySize, len;
+  
+  memset(&match, 0, sizeof(xQTextMatch));
+  match.needle = needle;
+  match.needleLen = xmlStrlen(needle);
+  match.found = !match.needleLen; // any text contains the empty string
+  
+  // room for the end of one segment joined to the start of the next
+  carrySize = match.needleLen > 1 ? 2 * (match.needleLen - 1) : 0;
+  match.carry = carrySize <= XQ_TEXT_CARRY_SIZE ? stackCarry : (xmlChar*) xQ_malloc(carrySize);
+  if (!match.carry)
+    return XQ_OUT_OF_MEMORY;
+  
+  if (eachTextSegment(node, segment, &match) < 0) {
+    match.offset = match.carryLen = 0;
+    match.found = !match.needleLen;
+    
+    if ((copy = xQNode_getText(node, &len)) != 0) {
+      xQ_countAlloc(len + 1);
+      segment(&match, copy, len);
+      xmlFree(copy);
     }
   }
   
-  return result;
+  // equality is only decided once all the text has been read
+  if (segment == equalsSegment)
+    match.found = match.offset == match.needleLen;
+  
+  *matched = match.found;
+  
+  if (match.carry != stackCarry)
+    free(match.carry);
+  
+  return XQ_OK;
+}
+
+/**
+ * Visit the text and CDATA descendants of an element or document, or a
+ * text node itself, in document order, passing each to segment until it
+ * returns non-zero.
+ *
+ * Returns 0, or -1 if an entity reference or another type of node was
+ * found and the text must be read some other way
+ */
+static int eachTextSegment(xmlNodePtr node, xQTextSegmentFunc segment, xQTextMatch* match) {
+  xmlNodePtr cur;
+  
+  if (XML_TEXT_NODE == node->type || XML_CDATA_SECTION_NODE == node->type) {
+    if (node->content)
+      segment(match, node->content, xmlStrlen(node->content));
+    return 0;
+  }
+  
+  if (XML_ELEMENT_NODE != node->type && XML_DOCUMENT_NODE != node->type)
+    return -1;
+  
+  cur = node->children;
+  
+  while (cur) {
+    
+    if (XML_TEXT_NODE == cur->type || XML_CDATA_SECTION_NODE == cur->type) {
+      if (cur->content && segment(match, cur->content, xmlStrlen(cur->content)))
+        return 0;
+    
+    } else if (XML_ENTITY_REF_NODE == cur->type) {
+      return -1;
+    
+    } else if (XML_ELEMENT_NODE == cur->type && cur->children) {
+      cur = cur->children;
+      continue;
+    }
+    
+    while (!cur->next && cur->parent != node)
+      cur = cur->parent;
+    
+    cur = cur->next;
+  }
+  
+  return 0;
+}
+
+/**
+ * Search the next segment of text for the needle, including matches that
+ * begin in earlier segments
+ */
+static int containsSegment(xQTextMatch* match, const xmlChar* text, int len) {
+  int keep = match->needleLen - 1;
+  int take = len < keep ? len : keep;
+  
+  // a match that straddles the last segment and this one
+  if (match->carryLen && take) {
+    memcpy(match->carry + match->carryLen, text, take);
+    
+    if (findBytes(match->carry, match->carryLen + take, match->needle, match->needleLen) >= 0)
+      return match->found = 1;
+  }
+  
+  if (findBytes(text, len, match->needle, match->needleLen) >= 0)
+    return match->found = 1;
+  
+  // hold on to the end of the text for the next segment
+  if (keep <= 0)
+    return 0;
+  
+  if (len >= keep) {
+    memcpy(match->carry, text + len - keep, keep);
+    match->carryLen = keep;
+  
+  } else {
+    // joined above unless there was nothing to join to
+    if (!match->carryLen)
+      memcpy(match->carry, text, len);
+    
+    match->carryLen += len;
+    if (match->carryLen > keep) {
+      memmove(match->carry, match->carry + match->carryLen - keep, keep);
+      match->carryLen = keep;
+    }
+  }
+  
+  return 0;
+}
+
+/**
+ * Compare the next segment of text with the part of the needle it should
+ * equal
+ */
+static int equalsSegment(xQTextMatch* match, const xmlChar* text, int len) {
+  if (match->offset < 0 || len > match->needleLen - match->offset ||
+      memcmp(match->needle + match->offset, text, len) != 0) {
+    match->offset = -1;
+    return 1;
+  }
+  
+  match->offset += len;
+  return 0;
+}
+
+/**
+ * Return the offset of needle in the first len bytes of haystack, or -1.
+ * Candidates are found by scanning for the first byte of needle with
+ * memchr(), which C libraries implement with vector instructions.
+ */
+static int findBytes(const xmlChar* haystack, int len, const xmlChar* needle, int needleLen) {
+  const xmlChar* p;
+  int start = 0;
+  
+  if (!needleLen)
+    return 0;
+  
+  while (start <= len - needleLen) {
+    if (!(p = (const xmlChar*) memchr(haystack + start, needle[0], len - needleLen - start + 1)))
+      return -1;
+    
+    start = (int) (p - haystack);
+    if (memcmp(p + 1, needle + 1, needleLen - 1) == 0)
+      return start;
+    
+    ++start;
+  }
+  
+  return -1;
+}
+
+// the tests applied by each attribute filter
+
+static int attrEquals(const xmlChar* value, const xmlChar* arg) {
+  return xmlStrcmp(value, arg) == 0;
+}
+
+static int attrExists(const xmlChar* value, const xmlChar* arg) {
+  return 1;
+}
+
+static int attrHasPrefix(const xmlChar* value, const xmlChar* arg) {
+  return *arg && xmlStrncmp(value, arg, xmlStrlen(arg)) == 0;
+}
+
+static int attrHasSuffix(const xmlChar* value, const xmlChar* arg) {
+  int valueLen = xmlStrlen(value);
+  int argLen = xmlStrlen(arg);
+  
+  return argLen && valueLen >= argLen && xmlStrcmp(value + valueLen - argLen, arg) == 0;
+}
+
+static int attrContains(const xmlChar* value, const xmlChar* arg) {
+  return *arg && xmlStrstr(value, arg) != 0;
+}
+
+static int attrHasWord(const xmlChar* value, const xmlChar* arg) {
+  int argLen = xmlStrlen(arg);
+  const xmlChar* start;
+  int i;
+  
+  // a word can't be empty or contain space
+  for (i = 0; i < argLen; i++)
+    if (isAttrSpace(arg[i]))
+      return 0;
+  
+  while (argLen && *value) {
+    while (isAttrSpace(*value))
+      ++value;
+    
+    for (start = value; *value && !isAttrSpace(*value); ++value)
+      ;
+    
+    if (value - start == argLen && xmlStrncmp(start, arg, argLen) == 0)
+      return 1;
+  }
+  
+  return 0;
+}
+
+// the numeric comparisons are given the bound of the filter as arg
+static int attrGreater(const xmlChar* value, const xmlChar* arg) {
+  double number;
+  
+  return xQ_parseNumber(value, &number) && number > *(const double*) arg;
+}
+
+static int attrLess(const xmlChar* value, const xmlChar* arg) {
+  double number;
+  
+  return xQ_parseNumber(value, &number) && number < *(const double*) arg;
 }
 
 /**
@@ -187,6 +1018,7 @@ xQStatusCode _xQ_filterByName(xQ* context, xmlChar** args, xmlNodePtr node, xQNo
   nsLookup(context, ns);
   
   if (node) {
+    xQ_countVisited(1);
     
     if (node->type == XML_ELEMENT_NODE) {
       if ( (xmlStrcmp(name, node->name) == 0) && nsMatch(node, ns) )
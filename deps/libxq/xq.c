@@ -19,14 +19,33 @@
  */
 
 #include "libxq.h"
+#include "xqparallel.h"
 
+#include <libxml/xmlsave.h>
+
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+XQ_THREAD_LOCAL xQStats* xQ_currentStats = 0;
+XQ_THREAD_LOCAL xQStepStats* xQ_currentStep = 0;
+
 // local (private) routines
 static void* nsItemCopy(void* payload, xmlChar* name);
 static void nsItemDestroy(void* payload, xmlChar* name);
 static xQStatusCode xQ_alloc_initResult(xQ** self, xQ* other);
+static double xQ_now();
+static void xQ_statsBegin(xQ* self);
+static void xQ_statsCompiled(xQSearchExpr* expr);
+static void xQ_statsEnd(xQ* result);
+static xQStatusCode xQ_firstMatch(xQ* self, xQSearchExpr* expr, int matchSelf, int* found);
+static xQStatusCode xQ_findInto(xQ* self, xQSearchExpr* expr, xQNodeList* outList);
 
 /**
  * Allocate and initialize a new empty xQ
@@ -39,7 +58,7 @@ static xQStatusCode xQ_alloc_initResult(xQ** self, xQ* other);
 xQStatusCode xQ_alloc_init(xQ** self) {
   xQStatusCode status = XQ_OK;
   
-  *self = (xQ*) malloc(sizeof(xQ));
+  *self = (xQ*) xQ_malloc(sizeof(xQ));
   if (!*self)
     return XQ_OUT_OF_MEMORY;
   
@@ -173,12 +192,23 @@ xQStatusCode xQ_alloc_initMemory(xQ** self, const char* buffer, int size, xmlDoc
 xQStatusCode xQ_alloc_initNodeList(xQ** self, xQNodeList* list) {
   xQStatusCode status = XQ_OK;
 
-  *self = (xQ*) malloc(sizeof(xQ));
+  *self = (xQ*) xQ_malloc(sizeof(xQ));
   if (!*self)
     return XQ_OUT_OF_MEMORY;
   
   (*self)->document = list->size > 0 ? list->list[0]->doc : 0;
   (*self)->nsPrefixes = 0;
+  (*self)->cancelled = 0;
+  (*self)->stats = 0;
+  (*self)->limit = 0;
+  (*self)->maxDepth = 0;
+  (*self)->signatures = 0;
+  (*self)->docStats = 0;
+  (*self)->limitList = 0;
+  (*self)->depthLimit = 0;
+  (*self)->subtreeNames = 0;
+  (*self)->threads = 1;
+  (*self)->threshold = XQ_PARALLEL_DEFAULT_THRESHOLD;
   
   status = xQNodeList_init(&((*self)->context), list->size);
   
@@ -193,6 +223,41 @@ xQStatusCode xQ_alloc_initNodeList(xQ** self, xQNodeList* list) {
   return status;
 }
 
+/**
+ * Allocate and initialize a new xQ with the same document, nodes and
+ * namespace prefixes as `other`. The copy shares nothing with the
+ * original, so it can be searched on another thread while the original
+ * continues to be used.
+ *
+ * The parameter self is set to the pointer to the new instance on success
+ * or 0 on error.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_alloc_initCopy(xQ** self, xQ* other) {
+  xQStatusCode status;
+
+  status = xQ_alloc_initNodeList(self, &(other->context));
+
+  if (status == XQ_OK) {
+    (*self)->document = other->document;
+    (*self)->signatures = other->signatures;
+    (*self)->docStats = other->docStats;
+    (*self)->threads = other->threads;
+    (*self)->threshold = other->threshold;
+  }
+
+  if (status == XQ_OK && other->nsPrefixes)
+    status = (((*self)->nsPrefixes = xmlHashCopy(other->nsPrefixes, nsItemCopy)) != 0) ? XQ_OK : XQ_OUT_OF_MEMORY;
+
+  if (status != XQ_OK && *self) {
+    xQ_free(*self, 1);
+    *self = 0;
+  }
+
+  return status;
+}
+
 /**
  * Allocate and initialize a new xQ that can be used for a search result
  * based on `other`.
@@ -204,8 +269,13 @@ static xQStatusCode xQ_alloc_initResult(xQ** self, xQ* other) {
 
   status = xQ_alloc_init(self);
 
-  if (status == XQ_OK)
+  if (status == XQ_OK) {
     (*self)->document = other->document;
+    (*self)->signatures = other->signatures;
+    (*self)->docStats = other->docStats;
+    (*self)->threads = other->threads;
+    (*self)->threshold = other->threshold;
+  }
   
   if (status == XQ_OK && other->nsPrefixes)
     status = (((*self)->nsPrefixes = xmlHashCopy(other->nsPrefixes, nsItemCopy)) != 0) ? XQ_OK : XQ_OUT_OF_MEMORY;
@@ -227,6 +297,17 @@ static xQStatusCode xQ_alloc_initResult(xQ** self, xQ* other) {
 xQStatusCode xQ_init(xQ* self) {
   self->document = 0;
   self->nsPrefixes = 0;
+  self->cancelled = 0;
+  self->stats = 0;
+  self->limit = 0;
+  self->maxDepth = 0;
+  self->signatures = 0;
+  self->docStats = 0;
+  self->limitList = 0;
+  self->depthLimit = 0;
+  self->subtreeNames = 0;
+  self->threads = 1;
+  self->threshold = XQ_PARALLEL_DEFAULT_THRESHOLD;
   return xQNodeList_init(&(self->context), 8);
 }
 
@@ -265,7 +346,116 @@ xmlChar* xQ_getText(xQ* self) {
   if ( (!self->context.size) || (!self->context.list[0]) || (!self->context.list[0]->children) )
     return xmlCharStrdup("");
   
-  return xmlNodeGetContent(self->context.list[0]);
+  return xQNode_getText(self->context.list[0], 0);
+}
+
+/**
+ * Return a pointer to the text content of a node if it's stored in one
+ * piece: the node is a text or CDATA node, or an element or document
+ * whose only child is one. The length of the text in bytes is stored in
+ * len. No copy is made; the text belongs to the document.
+ *
+ * Returns a pointer to the text, or 0 if the content is spread across
+ * several nodes
+ */
+const xmlChar* xQNode_getTextRef(xmlNodePtr node, int* len) {
+  xmlNodePtr text = 0;
+  
+  if (!node)
+    return 0;
+  
+  if (XML_TEXT_NODE == node->type || XML_CDATA_SECTION_NODE == node->type)
+    text = node;
+  
+  else if ( (XML_ELEMENT_NODE == node->type || XML_DOCUMENT_NODE == node->type) &&
+            node->children && node->children == node->last &&
+            (XML_TEXT_NODE == node->children->type || XML_CDATA_SECTION_NODE == node->children->type) )
+    text = node->children;
+  
+  if (!text)
+    return 0;
+  
+  *len = text->content ? xmlStrlen(text->content) : 0;
+  
+  return text->content ? text->content : (const xmlChar*) "";
+}
+
+/**
+ * Visit the text and CDATA descendants of an element or document in
+ * document order, either measuring them (out is 0) or copying them into
+ * out.
+ *
+ * Returns the number of bytes of text, or -1 if an entity reference was
+ * found
+ */
+static int xQNode_collectText(xmlNodePtr node, xmlChar* out) {
+  xmlNodePtr cur = node->children;
+  int total = 0, len;
+  
+  while (cur) {
+    
+    if (XML_TEXT_NODE == cur->type || XML_CDATA_SECTION_NODE == cur->type) {
+      if (cur->content) {
+        len = xmlStrlen(cur->content);
+        if (out)
+          memcpy(out + total, cur->content, len);
+        total += len;
+      }
+    
+    } else if (XML_ENTITY_REF_NODE == cur->type) {
+      return -1;
+    
+    } else if (XML_ELEMENT_NODE == cur->type && cur->children) {
+      cur = cur->children;
+      continue;
+    }
+    
+    while (!cur->next && cur->parent != node)
+      cur = cur->parent;
+    
+    cur = cur->next;
+  }
+  
+  return total;
+}
+
+/**
+ * Return a copy of the text content of a node, the same as
+ * xmlNodeGetContent(), built in a single allocation of the final size.
+ * If len isn't null, the length of the text in bytes is stored there.
+ *
+ * Returns a pointer to the string copy on success, or 0 on failure. The
+ * caller is responsible for freeing any returned string by calling
+ * xmlFree().
+ */
+xmlChar* xQNode_getText(xmlNodePtr node, int* len) {
+  const xmlChar* ref;
+  xmlChar* str;
+  int size;
+  
+  if (!node)
+    return 0;
+  
+  if ((ref = xQNode_getTextRef(node, &size)) != 0) {
+    str = xmlStrndup(ref, size);
+  
+  } else if ( (XML_ELEMENT_NODE == node->type || XML_DOCUMENT_NODE == node->type) &&
+              (size = xQNode_collectText(node, 0)) >= 0 ) {
+    if ((str = (xmlChar*) xmlMallocAtomic(size + 1)) != 0) {
+      xQNode_collectText(node, str);
+      str[size] = 0;
+    }
+  
+  } else {
+    // entity references and other node types are left to libxml2
+    str = xmlNodeGetContent(node);
+    size = str ? xmlStrlen(str) : 0;
+  }
+  
+  if (len)
+    *len = str ? size : 0;
+  
+  return str;
 }
 
 /**
@@ -288,9 +478,15 @@ xQStatusCode xQ_children(xQ* self, const xmlChar* selector, xQ** result) {
   *result = 0;
   tmpList.list = 0;
   
+  xQ_statsBegin(self);
+  
   retcode = selector ? xQSearchExpr_alloc_initFilter(&expr, selector) : XQ_OK;
-  if (retcode != XQ_OK)
+  if (retcode != XQ_OK) {
+    xQ_statsEnd(0);
     return retcode;
+  }
+  
+  xQ_statsCompiled(expr);
   
   retcode = xQ_alloc_initResult(result, self);
 
@@ -325,6 +521,8 @@ xQStatusCode xQ_children(xQ* self, const xmlChar* selector, xQ** result) {
     *result = 0;
   }
   
+  xQ_statsEnd(*result);
+  
   xQNodeList_free(&tmpList, 0);
   xQSearchExpr_free(expr);
 
@@ -339,9 +537,17 @@ xQStatusCode xQ_children(xQ* self, const xmlChar* selector, xQ** result) {
 #define setupSearch(self, expr, selector, result, retcode) \
   *result = 0; \
   \
+  xQ_statsBegin(self); \
+  \
   retcode = xQSearchExpr_alloc_init(&expr, selector); \
-  if (retcode != XQ_OK) \
+  if (retcode == XQ_OK && XQ_OK != (retcode = xQSearchExpr_plan(expr, self))) \
+    xQSearchExpr_free(expr); \
+  if (retcode != XQ_OK) { \
+    xQ_statsEnd(0); \
     return retcode; \
+  } \
+  \
+  xQ_statsCompiled(expr); \
   \
   retcode = xQ_alloc_initResult(result, self);
 
@@ -352,9 +558,15 @@ xQStatusCode xQ_children(xQ* self, const xmlChar* selector, xQ** result) {
 #define setupFilter(self, expr, selector, result, retcode) \
   *result = 0; \
   \
+  xQ_statsBegin(self); \
+  \
   retcode = xQSearchExpr_alloc_initFilter(&expr, selector); \
-  if (retcode != XQ_OK) \
+  if (retcode != XQ_OK) { \
+    xQ_statsEnd(0); \
     return retcode; \
+  } \
+  \
+  xQ_statsCompiled(expr); \
   \
   retcode = xQ_alloc_initResult(result, self);
 
@@ -365,9 +577,15 @@ xQStatusCode xQ_children(xQ* self, const xmlChar* selector, xQ** result) {
   expr = 0; \
   *result = 0; \
   \
+  xQ_statsBegin(self); \
+  \
   retcode = selector ? xQSearchExpr_alloc_initFilter(&expr, selector) : XQ_OK; \
-  if (retcode != XQ_OK) \
+  if (retcode != XQ_OK) { \
+    xQ_statsEnd(0); \
     return retcode; \
+  } \
+  \
+  xQ_statsCompiled(expr); \
   \
   retcode = xQ_alloc_initResult(result, self);
 
@@ -389,6 +607,7 @@ xQStatusCode xQ_children(xQ* self, const xmlChar* selector, xQ** result) {
     *result = 0; \
   } \
   \
+  xQ_statsEnd(*result); \
   xQSearchExpr_free(expr);
 
 /**
@@ -567,18 +786,392 @@ xQStatusCode xQ_closest(xQ* self, const xmlChar* selector, xQ** result) {
 xQStatusCode xQ_find(xQ* self, const xmlChar* selector, xQ** result) {
   xQStatusCode retcode = XQ_OK;
   xQSearchExpr* expr;
-  unsigned int i;
   
   setupSearch(self, expr, selector, result, retcode);
   
-  for (i = 0; retcode == XQ_OK && i < self->context.size; i++)
-    retcode = xQSearchExpr_eval(expr, self, self->context.list[i], &((*result)->context));
+  if (retcode == XQ_OK)
+    retcode = xQ_findInto(self, expr, &((*result)->context));
   
   completeSearch(result, expr, retcode);
 
   return retcode;
 }
 
+/**
+ * Evaluate a compiled search against every node in the current context,
+ * appending the matches to outList
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQ_findInto(xQ* self, xQSearchExpr* expr, xQNodeList* outList) {
+  xQStatusCode retcode = XQ_OK;
+  unsigned int i;
+  
+  // large context sets and large subtrees are split across threads, except
+  // when collecting statistics, which are only gathered on this thread,
+  // for bounded searches, which stop as soon as they're satisfied, and
+  // for seeks, which don't walk the subtrees
+  if (self->threads > 1 && !self->stats && !self->limit && !self->maxDepth && !xQ_isSeek(expr))
+    return xQ_findParallel(self, expr, outList);
+  
+  self->limitList = self->limit ? outList : 0;
+  
+  for (i = 0; retcode == XQ_OK && i < self->context.size && !xQ_limitReached(self, outList); i++) {
+    self->depthLimit = self->maxDepth ? xQNode_depth(self->context.list[i]) + self->maxDepth : 0;
+    retcode = xQSearchExpr_eval(expr, self, self->context.list[i], outList);
+  }
+  
+  self->limitList = 0;
+  self->depthLimit = 0;
+  
+  return retcode;
+}
+
+/**
+ * Count the matches for selector in the current context without storing
+ * them. The count parameter is set to the number of nodes xQ_find would
+ * return, or 0 on failure. When the document statistics are attached, a
+ * count of one name or attribute value from the document is read from
+ * their indexes without a search.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_count(xQ* self, const xmlChar* selector, unsigned long* count) {
+  xQStatusCode retcode = XQ_OK;
+  xQSearchExpr* expr;
+  xQNodeList counter;
+  int indexed = 0;
+  
+  *count = 0;
+  
+  xQ_statsBegin(self);
+  
+  retcode = xQSearchExpr_alloc_init(&expr, selector);
+  if (retcode == XQ_OK && XQ_OK != (retcode = xQSearchExpr_plan(expr, self)))
+    xQSearchExpr_free(expr);
+  if (retcode != XQ_OK) {
+    xQ_statsEnd(0);
+    return retcode;
+  }
+  
+  xQ_statsCompiled(expr);
+  
+  xQNodeList_initCounter(&counter);
+  
+  // a count of a name or attribute value in the whole document is indexed
+  if (self->context.size == 1)
+    retcode = _xQ_countIndexed(expr, self, self->context.list[0], &indexed, &(counter.size));
+  
+  if (retcode == XQ_OK && !indexed)
+    retcode = xQ_findInto(self, expr, &counter);
+  
+  if (retcode == XQ_OK)
+    *count = counter.size;
+  
+  xQ_statsEnd(0);
+  xQSearchExpr_free(expr);
+  
+  if (self->stats)
+    self->stats->resultSize = *count;
+  
+  return retcode;
+}
+
+/**
+ * Describe how selector is searched for in the current context, as
+ * written by xQSearchExpr_explain(). The search is planned with the
+ * indexes attached to self and, when the context isn't empty, run to
+ * measure what each step produces; if that search fails, the description
+ * ends with its status. The explanation parameter is set to the
+ * description, or 0 on failure. The caller is responsible for freeing
+ * it by calling xmlFree().
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_explain(xQ* self, const xmlChar* selector, xmlChar** explanation) {
+  xQStatusCode retcode = XQ_OK;
+  xQStatusCode searchStatus;
+  char failure[64];
+  xQSearchExpr* expr;
+  xQNodeList counter;
+  xQStats* stats = self->stats;
+  xQStats measured;
+  xmlBufferPtr buff;
+  
+  *explanation = 0;
+  
+  // the steps record what they produce the same as when stats are asked for
+  self->stats = &measured;
+  xQ_statsBegin(self);
+  
+  retcode = xQSearchExpr_alloc_init(&expr, selector);
+  if (retcode == XQ_OK && XQ_OK != (retcode = xQSearchExpr_plan(expr, self)))
+    xQSearchExpr_free(expr);
+  if (retcode != XQ_OK) {
+    xQ_statsEnd(0);
+    self->stats = stats;
+    return retcode;
+  }
+  
+  xQ_statsCompiled(expr);
+  
+  xQNodeList_initCounter(&counter);
+  
+  // a search that fails, say on an undeclared prefix, is still described
+  searchStatus = xQ_findInto(self, expr, &counter);
+  
+  xQ_statsEnd(0);
+  measured.resultSize = counter.size;
+  self->stats = stats;
+  
+  buff = xmlBufferCreate();
+  if (!buff)
+    retcode = XQ_OUT_OF_MEMORY;
+  
+  if (retcode == XQ_OK)
+    retcode = xQSearchExpr_explain(expr, self, self->context.size && searchStatus == XQ_OK ? &measured : 0, buff);
+  
+  if (retcode == XQ_OK && searchStatus != XQ_OK) {
+    snprintf(failure, sizeof(failure), "search failed with status %d\n", searchStatus);
+    if (xmlBufferCCat(buff, failure))
+      retcode = XQ_OUT_OF_MEMORY;
+  }
+  
+  // the string is taken from the buffer rather than copied
+  if (retcode == XQ_OK)
+    *explanation = xmlBufferDetach(buff);
+  
+  if (buff)
+    xmlBufferFree(buff);
+  
+  xQSearchExpr_free(expr);
+  
+  return retcode;
+}
+
+/**
+ * Search the current context for several selectors at once. The results
+ * parameter is an array of count pointers, each assigned a new xQ object
+ * holding the matches xQ_find would return for the selector at the same
+ * position. Selectors that start with a descendant search are all
+ * answered by a single walk of each context node's subtree. The caller is
+ * responsible for freeing the results. On failure, every result is set to
+ * null.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_extract(xQ* self, const xmlChar** selectors, unsigned int count, xQ** results) {
+  xQStatusCode retcode = XQ_OK;
+  xQSearchExpr** exprs;
+  xQSearchExpr** walked;
+  xQNodeList** walkLists;
+  unsigned int i, walkCount = 0;
+  unsigned long total = 0;
+  
+  for (i = 0; i < count; i++)
+    results[i] = 0;
+  
+  if (!count)
+    return XQ_OK;
+  
+  xQ_statsBegin(self);
+  
+  // compiled selectors, the ones answered by the walk and their results
+  exprs = (xQSearchExpr**) xQ_malloc(count * (2 * sizeof(xQSearchExpr*) + sizeof(xQNodeList*)));
+  if (!exprs) {
+    xQ_statsEnd(0);
+    return XQ_OUT_OF_MEMORY;
+  }
+  walked = exprs + count;
+  walkLists = (xQNodeList**) (walked + count);
+  
+  for (i = 0; i < count; i++)
+    exprs[i] = 0;
+  
+  for (i = 0; retcode == XQ_OK && i < count; i++)
+    if (XQ_OK == (retcode = xQSearchExpr_alloc_init(&exprs[i], selectors[i])))
+      retcode = xQSearchExpr_plan(exprs[i], self);
+  
+  for (i = 0; retcode == XQ_OK && i < count; i++) {
+    xQ_statsCompiled(exprs[i]);
+    retcode = xQ_alloc_initResult(&results[i], self);
+  }
+  
+  // the walk meets the first step matches of each selector in document
+  // order, just as xQ_find evaluates them, so the results are identical;
+  // selectors planned as seeks are cheaper answered on their own
+  for (i = 0; retcode == XQ_OK && i < count; i++) {
+    if (!exprs[i]->alternative && !xQ_isSeek(exprs[i]) && (exprs[i]->operation == _xQ_findDescendants || exprs[i]->operation == _xQ_findDescendantsByName)) {
+      walked[walkCount] = exprs[i];
+      walkLists[walkCount++] = &(results[i]->context);
+    } else
+      retcode = xQ_findInto(self, exprs[i], &(results[i]->context));
+  }
+  
+  self->limitList = 0;
+  
+  for (i = 0; retcode == XQ_OK && walkCount && i < self->context.size; i++) {
+    self->depthLimit = self->maxDepth ? xQNode_depth(self->context.list[i]) + self->maxDepth : 0;
+    retcode = _xQ_findEachDescendants(self, walked, walkCount, self->context.list[i], walkLists);
+  }
+  
+  self->depthLimit = 0;
+  
+  for (i = 0; i < count; i++) {
+    if (retcode != XQ_OK) {
+      xQ_free(results[i], 1);
+      results[i] = 0;
+    } else
+      total += results[i]->context.size;
+    
+    if (exprs[i])
+      xQSearchExpr_free(exprs[i]);
+  }
+  
+  xQ_statsEnd(0);
+  
+  if (self->stats)
+    self->stats->resultSize = total;
+  
+  free(exprs);
+  
+  return retcode;
+}
+
+/**
+ * Search the current context for selector as xQ_find does, returning at
+ * most limit results (0 for no limit) from no more than maxDepth levels
+ * below each node in the context (0 for no bound). The search stops as
+ * soon as it has found enough results.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_findLimited(xQ* self, const xmlChar* selector, unsigned long limit, unsigned int maxDepth, xQ** result) {
+  xQStatusCode retcode;
+  unsigned long oldLimit = self->limit;
+  unsigned int oldMaxDepth = self->maxDepth;
+  
+  self->limit = limit;
+  self->maxDepth = maxDepth;
+  
+  retcode = xQ_find(self, selector, result);
+  
+  self->limit = oldLimit;
+  self->maxDepth = oldMaxDepth;
+  
+  return retcode;
+}
+
+/**
+ * Evaluate a compiled expression against each node in the context until
+ * it produces a match. When self is non-zero, a node only matches if the
+ * expression produces that same node, as for a filter. Nothing is
+ * allocated for the result: the search stops at the first match.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+static xQStatusCode xQ_firstMatch(xQ* self, xQSearchExpr* expr, int matchSelf, int* found) {
+  xQStatusCode retcode = XQ_OK;
+  xmlNodePtr match;
+  xQNodeList matches;
+  unsigned long oldLimit = self->limit;
+  unsigned int i;
+  
+  // a single slot is enough, as the search stops once it is filled
+  matches.list = &match;
+  matches.size = 0;
+  matches.capacity = 1;
+  matches.countOnly = 0;
+  
+  self->limit = 1;
+  self->limitList = &matches;
+  
+  for (i = 0; retcode == XQ_OK && !*found && i < self->context.size; i++) {
+    xQNodeList_clear(&matches);
+    
+    self->depthLimit = self->maxDepth ? xQNode_depth(self->context.list[i]) + self->maxDepth : 0;
+    retcode = xQSearchExpr_eval(expr, self, self->context.list[i], &matches);
+    
+    *found = retcode == XQ_OK && matches.size && (!matchSelf || match == self->context.list[i]);
+  }
+  
+  self->limit = oldLimit;
+  self->limitList = 0;
+  self->depthLimit = 0;
+  
+  return retcode;
+}
+
+/**
+ * Determine whether the current context has a descendant matching a
+ * selector. The found parameter is set to 1 if it does, 0 otherwise. The
+ * search stops at the first match and allocates no result.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_exists(xQ* self, const xmlChar* selector, int* found) {
+  xQStatusCode retcode = XQ_OK;
+  xQSearchExpr* expr;
+  
+  *found = 0;
+  
+  xQ_statsBegin(self);
+  
+  retcode = xQSearchExpr_alloc_init(&expr, selector);
+  if (retcode == XQ_OK && XQ_OK != (retcode = xQSearchExpr_plan(expr, self)))
+    xQSearchExpr_free(expr);
+  if (retcode != XQ_OK) {
+    xQ_statsEnd(0);
+    return retcode;
+  }
+  
+  xQ_statsCompiled(expr);
+  
+  retcode = xQ_firstMatch(self, expr, 0, found);
+  
+  xQ_statsEnd(0);
+  xQSearchExpr_free(expr);
+  
+  if (self->stats)
+    self->stats->resultSize = *found;
+  
+  return retcode;
+}
+
+/**
+ * Determine whether any node in the current context matches a selector.
+ * The found parameter is set to 1 if one does, 0 otherwise. Matching
+ * stops at the first node that matches and allocates no result.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQ_is(xQ* self, const xmlChar* selector, int* found) {
+  xQStatusCode retcode = XQ_OK;
+  xQSearchExpr* expr;
+  
+  *found = 0;
+  
+  xQ_statsBegin(self);
+  
+  retcode = xQSearchExpr_alloc_initFilter(&expr, selector);
+  if (retcode != XQ_OK) {
+    xQ_statsEnd(0);
+    return retcode;
+  }
+  
+  xQ_statsCompiled(expr);
+  
+  retcode = xQ_firstMatch(self, expr, 1, found);
+  
+  xQ_statsEnd(0);
+  xQSearchExpr_free(expr);
+  
+  if (self->stats)
+    self->stats->resultSize = *found;
+  
+  return retcode;
+}
+
 /**
  * Filter the current context for items matching a selector and return
  * the result as a new xQ object. The result parameter is assigned the
@@ -829,6 +1422,41 @@ xmlChar* xQ_getAttr(xQ* self, const char* name) {
   return xmlGetProp(self->context.list[0], (xmlChar*)name);
 }
 
+/**
+ * Return a pointer to the value of the named attribute of a node if it's
+ * stored in one piece. The length of the value in bytes is stored in len.
+ * No copy is made; the value belongs to the document. Like xmlGetProp(),
+ * the first attribute with the name is used regardless of namespace.
+ *
+ * Returns a pointer to the value, or 0 if the node has no such attribute
+ * or the value is split across several nodes (such as around an entity
+ * reference). Use xmlGetProp() in that case.
+ */
+const xmlChar* xQNode_getAttrRef(xmlNodePtr node, const xmlChar* name, int* len) {
+  xmlAttrPtr attr;
+  
+  if (!node || XML_ELEMENT_NODE != node->type)
+    return 0;
+  
+  for (attr = node->properties; attr && !xmlStrEqual(attr->name, name); attr = attr->next)
+    ;
+  
+  if (!attr)
+    return 0;
+  
+  if (!attr->children) {
+    *len = 0;
+    return (const xmlChar*) "";
+  }
+  
+  if (attr->children->next || XML_TEXT_NODE != attr->children->type)
+    return 0;
+  
+  *len = attr->children->content ? xmlStrlen(attr->children->content) : 0;
+  
+  return attr->children->content ? attr->children->content : (const xmlChar*) "";
+}
+
 /**
  * Return the XML of the first item in an xQ's collection.
  *
@@ -837,45 +1465,129 @@ xmlChar* xQ_getAttr(xQ* self, const char* name) {
  * xmlFree().
  */
 xmlChar* xQ_getXml(xQ* self) {
-  xmlNodePtr node = 0;
-  xmlBufferPtr buff = 0;
-  xmlChar* str = 0;
-  int strSize = 0;
-  
-  if ( (!self->context.size) || (!self->context.list[0]) ||
-       (!self->context.list[0]->children && XML_ELEMENT_NODE != self->context.list[0]->type) )
+  if (!self->context.size || !xQNode_hasXml(self->context.list[0]))
     return xmlCharStrdup("");
   
-  node = self->context.list[0];
-  
-  // dump an entire document
-  if (XML_DOCUMENT_NODE == node->type) {
+  return xQNode_getXml(self->context.list[0], 0);
+}
 
-    xmlDocDumpMemory((xmlDoc*)node, &str, &strSize);
-    if (!strSize)
-      return 0;
+/**
+ * Determine whether xQ_getXml() would produce any XML for a node. Nodes
+ * without children other than elements produce an empty string.
+ *
+ * Returns non-zero if the node has XML, 0 otherwise
+ */
+int xQNode_hasXml(xmlNodePtr node) {
+  return node && (node->children || XML_ELEMENT_NODE == node->type);
+}
 
-  // dump a node from within the document
-  } else {
+/**
+ * Write the XML of a node to an output buffer. A document is written
+ * with its XML declaration, the same as xmlDocDumpMemory(); any other
+ * node the same as xmlNodeDump(). Output may remain in the buffer until
+ * it's flushed or closed.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQNode_writeXml(xmlNodePtr node, xmlOutputBufferPtr out) {
+  xmlSaveCtxtPtr save;
+  
+  if (!node || !out)
+    return XQ_ARGUMENT_OUT_OF_BOUNDS;
+  
+  if (XML_DOCUMENT_NODE == node->type) {
     
-    buff = xmlBufferCreate();
-    if (!buff)
-      return 0;
-      
-    if (!xmlNodeDump(buff, node->doc, node, 0, 0)) {
-      xmlBufferFree(buff);
-      return 0;
+    // documents are saved through their own context writing to the
+    // same destination, so anything already buffered goes first
+    if (xmlOutputBufferFlush(out) < 0)
+      return XQ_OUTPUT_ERROR;
+    
+    save = xmlSaveToIO(out->writecallback, 0, out->context, (const char*) ((xmlDocPtr) node)->encoding, 0);
+    if (!save)
+      return XQ_OUT_OF_MEMORY;
+    
+    if (xmlSaveDoc(save, (xmlDocPtr) node) < 0) {
+      xmlSaveClose(save);
+      return XQ_OUTPUT_ERROR;
     }
     
-    str = (xmlChar*) xmlBufferContent(buff);
-    if (str) str = xmlStrdup(str);
-    xmlBufferFree(buff);
+    if (xmlSaveClose(save) < 0)
+      return XQ_OUTPUT_ERROR;
+  
+  } else {
+    xmlNodeDumpOutput(out, node->doc, node, 0, 0, 0);
+  }
+  
+  return out->error ? XQ_OUTPUT_ERROR : XQ_OK;
+}
 
+/**
+ * Return the XML of a node, as written by xQNode_writeXml(). If len isn't
+ * null, the length of the XML in bytes is stored there.
+ *
+ * Returns a pointer to the string on success, or 0 on failure. The
+ * caller is responsible for freeing any returned string by calling
+ * xmlFree().
+ */
+xmlChar* xQNode_getXml(xmlNodePtr node, int* len) {
+  xmlBufferPtr buff;
+  xmlOutputBufferPtr out;
+  xmlChar* str = 0;
+  xQStatusCode status;
+  
+  buff = xmlBufferCreate();
+  if (!buff)
+    return 0;
+  
+  out = xmlOutputBufferCreateBuffer(buff, 0);
+  if (!out) {
+    xmlBufferFree(buff);
+    return 0;
+  }
+  
+  status = xQNode_writeXml(node, out);
+  
+  if (xmlOutputBufferClose(out) < 0)
+    status = XQ_OUTPUT_ERROR;
+  
+  // the string is taken from the buffer rather than copied
+  if (status == XQ_OK) {
+    if (len)
+      *len = xmlBufferLength(buff);
+    str = xmlBufferDetach(buff);
   }
   
+  xmlBufferFree(buff);
+  
   return str;
 }
 
+/**
+ * Write the XML of every node in a list to an output buffer, in order,
+ * with an optional separator between them. Each node is written as
+ * xQ_getXml() would write it on its own, so nodes without XML leave
+ * nothing between their separators.
+ *
+ * Returns a 0 (XQ_OK) on success, an error code otherwise
+ */
+xQStatusCode xQNodeList_writeXml(xQNodeList* list, xmlOutputBufferPtr out, const xmlChar* separator) {
+  xQStatusCode status = XQ_OK;
+  unsigned long i;
+  
+  if (!list || !out)
+    return XQ_ARGUMENT_OUT_OF_BOUNDS;
+  
+  for (i = 0; status == XQ_OK && i < list->size; i++) {
+    if (i && separator && *separator && xmlOutputBufferWriteString(out, (const char*) separator) < 0)
+      return XQ_OUTPUT_ERROR;
+    
+    if (xQNode_hasXml(list->list[i]))
+      status = xQNode_writeXml(list->list[i], out);
+  }
+  
+  return status;
+}
+
 /**
  * Create a new xQ object containing only the first item from the current
  * context (if any). The result parameter is assigned the newly allocated
@@ -967,6 +1679,121 @@ const xmlChar* xQ_namespaceForPrefix(xQ* self, const xmlChar* prefix) {
   return (const xmlChar*)xmlHashLookup(self->nsPrefixes, prefix);
 }
 
+/**
+ * Return a monotonic clock reading in nanoseconds
+ */
+static double xQ_now() {
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double) count.QuadPart * 1e9 / (double) frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) now.tv_sec * 1e9 + (double) now.tv_nsec;
+#endif
+}
+
+/**
+ * Start collecting statistics for a search run against self, if self
+ * has somewhere to put them
+ */
+static void xQ_statsBegin(xQ* self) {
+  if (!self->stats)
+    return;
+  
+  memset(self->stats, 0, sizeof(xQStats));
+  self->stats->contextSize = self->context.size;
+  self->stats->signatureBytes = self->signatures ? self->signatures->bytes : 0;
+  self->stats->docStatsBytes = self->docStats ? self->docStats->bytes : 0;
+  self->stats->startNs = xQ_now();
+  
+  xQ_currentStats = self->stats;
+  xQ_currentStep = 0;
+}
+
+/**
+ * Record the compile time and plan of the expression for the search
+ * currently collecting statistics. A search that compiles several
+ * expressions records each in turn, adding to the plan.
+ */
+static void xQ_statsCompiled(xQSearchExpr* expr) {
+  xQStats* stats = xQ_currentStats;
+  xQSearchExpr* alt;
+  const char* sep;
+  size_t used;
+  int written;
+  
+  if (!stats)
+    return;
+  
+  stats->compileNs += xQ_now() - stats->startNs;
+  used = strlen(stats->plan);
+  
+  // steps of a selector are joined by " -> ", selectors of a group by ", "
+  for (alt = expr; alt; alt = alt->alternative) {
+    sep = used ? ", " : "";
+    
+    for (expr = alt; expr && stats->steps < XQ_STATS_MAX_STEPS; expr = expr->next) {
+      xQStepStats* step = &(stats->step[stats->steps++]);
+      
+      step->expr = expr;
+      step->operation = xQSearchOp_name(expr->operation);
+      
+      if (used >= XQ_STATS_PLAN_SIZE)
+        continue;
+      
+      if (expr->argc == 2 && expr->argv[0])
+        written = snprintf(stats->plan + used, XQ_STATS_PLAN_SIZE - used, "%s%s(%s%s%s)",
+          sep, step->operation,
+          (const char*) expr->argv[0],
+          (expr->argv[1] && expr->argv[1] != XQ_EMPTY_NAMESPACE) ? ", " : "",
+          (expr->argv[1] && expr->argv[1] != XQ_EMPTY_NAMESPACE) ? (const char*) expr->argv[1] : "");
+      else
+        written = snprintf(stats->plan + used, XQ_STATS_PLAN_SIZE - used, "%s%s()",
+          sep, step->operation);
+      
+      used += written > 0 ? (size_t) written : 0;
+      sep = " -> ";
+    }
+    
+    // a seek names the index it reads its candidates from
+    if (xQ_isSeek(alt) && used < XQ_STATS_PLAN_SIZE) {
+      written = snprintf(stats->plan + used, XQ_STATS_PLAN_SIZE - used, " via %s(%s%s%s)",
+        xQPlanMethod_name(alt->plan->method),
+        (const char*) alt->plan->key,
+        alt->plan->value ? "=" : "",
+        alt->plan->value ? (const char*) alt->plan->value : "");
+      used += written > 0 ? (size_t) written : 0;
+    }
+  }
+  
+  stats->startNs = xQ_now();
+}
+
+/**
+ * Finish collecting statistics for the current search, which produced
+ * result (0 if it failed)
+ */
+static void xQ_statsEnd(xQ* result) {
+  xQStats* stats = xQ_currentStats;
+  unsigned int i;
+  
+  if (!stats)
+    return;
+  
+  stats->evalNs = xQ_now() - stats->startNs;
+  stats->resultSize = result ? result->context.size : 0;
+  
+  // the compiled steps are freed once the search completes
+  for (i = 0; i < stats->steps; i++)
+    stats->step[i].expr = 0;
+  
+  xQ_currentStats = 0;
+  xQ_currentStep = 0;
+}
+
 /**
  * Performs an item copy operation for the ns prefix table
  */
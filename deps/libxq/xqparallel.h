@@ -0,0 +1,56 @@
+#ifndef __XQPARALLEL_H_INCLUDED__
+#define __XQPARALLEL_H_INCLUDED__
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Internal thread pool interface used by the parallel search routines
+ */
+
+#include "libxq.h"
+#include "xqutil.h"
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <sched.h>
+#define XQ_HAVE_THREADS 1
+typedef pthread_mutex_t xQMutex;
+#define xQMutex_init(m) pthread_mutex_init((m), 0)
+#define xQMutex_destroy(m) pthread_mutex_destroy(m)
+#define xQMutex_lock(m) pthread_mutex_lock(m)
+#define xQMutex_unlock(m) pthread_mutex_unlock(m)
+#define xQThread_yield() sched_yield()
+#else
+typedef int xQMutex;
+#define xQMutex_init(m) (*(m) = 0)
+#define xQMutex_destroy(m)
+#define xQMutex_lock(m)
+#define xQMutex_unlock(m)
+#define xQThread_yield()
+#endif
+
+/**
+ * A job is run once by each participating worker. The worker index is
+ * in the range [0, workers), where workers is the number of threads the
+ * pool was able to provide; index 0 is always the calling thread.
+ */
+typedef void (*xQJobFunc)(void* ctx, unsigned int worker, unsigned int workers);
+
+unsigned int xQThreadPool_run(xQJobFunc job, void* ctx, unsigned int workers);
+
+xQStatusCode xQ_findParallel(xQ* self, xQSearchExpr* expr, xQNodeList* outList);
+
+#endif // __XQPARALLEL_H_INCLUDED__
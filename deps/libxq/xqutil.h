@@ -24,5 +24,119 @@
 #define XQINLINE
 #endif
 
+// true if the evaluation running against ctx has been cancelled
+#define xQ_isCancelled(ctx) ((ctx)->cancelled && *((ctx)->cancelled))
+
+#ifdef _MSC_VER
+#define XQ_THREAD_LOCAL __declspec(thread)
+#else
+#define XQ_THREAD_LOCAL __thread
+#endif
+
+// statistics for the search running on this thread, and the step of it
+// being evaluated; both are 0 unless statistics are being collected
+extern XQ_THREAD_LOCAL xQStats* xQ_currentStats;
+extern XQ_THREAD_LOCAL xQStepStats* xQ_currentStep;
+
+// allocation routines that count towards the current statistics
+#define xQ_countAlloc(size) \
+  (xQ_currentStats ? \
+    (void) (xQ_currentStats->allocations++, xQ_currentStats->bytesAllocated += (size)) : \
+    (void) 0)
+#define xQ_malloc(size) (xQ_countAlloc(size), malloc(size))
+#define xQ_realloc(ptr, size) (xQ_countAlloc(size), realloc((ptr), (size)))
+#define xQ_strndup(str, len) (xQ_countAlloc((len) + 1), xmlStrndup((str), (len)))
+
+// true once list holds all the results the search of ctx asked for
+#define xQ_limitReached(ctx, list) \
+  ((list) == (ctx)->limitList && (list)->size >= (ctx)->limit)
+
+// true if a node at depth lies below the depth bound of the search of ctx
+#define xQ_depthExceeded(ctx, depth) \
+  ((ctx)->depthLimit && (depth) > (ctx)->depthLimit)
+
+// true if the signatures of the search of ctx rule out the elements below
+// node holding all of names
+#define xQ_subtreeLacks(ctx, node, names) \
+  ((names) && (ctx)->signatures && !xQSignatures_mayHold((ctx)->signatures, (node), (names)))
+
+// true for the search operations that move from a node to others
+#define xQ_isTraversal(op) \
+  ((op) == _xQ_findDescendants || (op) == _xQ_findDescendantsByName || \
+   (op) == _xQ_findChildrenByName || (op) == _xQ_findNextSiblingByName)
+
+// instructions of a compiled step, each a test of an element
+typedef enum {
+  XQ_INSTR_NAME,          // the element has name, in the namespace of the prefix arg
+  XQ_INSTR_ATTR_EQUALS,   // the attribute name has the value arg, and so on
+  XQ_INSTR_ATTR_EXISTS,
+  XQ_INSTR_ATTR_PREFIX,
+  XQ_INSTR_ATTR_SUFFIX,
+  XQ_INSTR_ATTR_CONTAINS,
+  XQ_INSTR_ATTR_WORD,
+  XQ_INSTR_ATTR_GREATER,
+  XQ_INSTR_ATTR_LESS,
+  XQ_INSTR_TEXT_CONTAINS, // the text of the element contains name
+  XQ_INSTR_TEXT_EQUALS    // the text of the element is name
+} xQOpcode;
+
+typedef struct _xQInstr {
+  xQOpcode opcode;
+  const xmlChar* name; // an element or attribute name, or text
+  const xmlChar* arg;  // a namespace prefix, an attribute value, or the bound of a numeric comparison
+} xQInstr;
+
+// a traversal step and the filters following it, run as one test of
+// each element the traversal reaches
+typedef struct _xQProgram {
+  xQSearchOp traversal;
+  xQSearchExpr* next;  // the step after the compiled ones, or 0
+  unsigned int length;
+  xQInstr code[1];
+} xQProgram;
+
+// a program as it runs against a document
+typedef struct _xQProgramRun {
+  const xQProgram* program;
+  const xmlChar* interned; // the element name in the document's dictionary, or 0
+  const xmlChar* uri;      // the namespace the element must be in, or 0 for any
+} xQProgramRun;
+
+// true if a planned search verifies candidates instead of walking subtrees
+#define xQ_isSeek(expr) ((expr)->plan && (expr)->plan->method != XQ_PLAN_SCAN)
+
+unsigned int xQNode_depth(xmlNodePtr node);
+xQStepStats* xQStats_step(const xQSearchExpr* expr);
+xQStatusCode xQNodeList_sortUnique(xQNodeList* list, xmlNodePtr root);
+xQStatusCode _xQ_findGroupDescendants(xQ* context, xQSearchExpr* group, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_findEachDescendants(xQ* context, xQSearchExpr** exprs, unsigned int count, xmlNodePtr node, xQNodeList** outLists);
+int xQ_parseNumber(const xmlChar* str, double* number);
+int xQPlan_covers(const xQPlan* plan, xmlNodePtr node);
+xQStatusCode _xQ_runProgram(xQ* context, const xQProgram* program, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_initProgramRun(xQProgramRun* run, xQ* context, const xQProgram* program, xmlDocPtr doc);
+int _xQ_programMatches(const xQProgramRun* run, xmlNodePtr node, xQStatusCode* status);
+xQStatusCode _xQ_evalPlan(xQSearchExpr* self, xQ* context, xmlNodePtr node, xQNodeList* outList);
+xQStatusCode _xQ_countIndexed(xQSearchExpr* self, xQ* context, xmlNodePtr node, int* indexed, unsigned long* count);
+
+// the bound of a numeric comparison filter, parsed when the selector is
+// compiled and kept after the attribute name and value in its args
+#define xQ_filterBound(args) ((const double*) ((args) + 2))
+
+// add to the number of nodes examined by the current step
+#define xQ_countVisited(count) \
+  do { if (xQ_currentStep) xQ_currentStep->visited += (count); } while (0)
+
+// namespace macros
+#define nsLookup(ctx,ns) \
+   if ((ns) && ((ns) != XQ_EMPTY_NAMESPACE)) { \
+     if (!((ns) = xQ_namespaceForPrefix((ctx), (ns)))) \
+       return XQ_UNKNOWN_NS_PREFIX; \
+  }
+
+#define nsMatch(node,nsuri) \
+  ( (!(nsuri)) || \
+    ((nsuri) == XQ_EMPTY_NAMESPACE && (!(node)->ns)) || \
+    ((node)->ns && (xmlStrcmp((node)->ns->href, (nsuri)) == 0)) )
+
 
 #endif // __XQUTIL_H_INCLUDED__
@@ -92,7 +92,7 @@
 /* #undef HAVE_LIBLZMA */
 
 /* Define if pthread library is there (-lpthread) */
-/* #undef HAVE_LIBPTHREAD */
+#define HAVE_LIBPTHREAD 1
 
 /* Define if readline library is there (-lreadline) */
 /* #undef HAVE_LIBREADLINE */
@@ -148,7 +148,7 @@
 #define HAVE_PRINTF 1
 
 /* Define if <pthread.h> is there */
-/* #undef HAVE_PTHREAD_H */
+#define HAVE_PTHREAD_H 1
 
 /* Define to 1 if you have the `putenv' function. */
 #define HAVE_PUTENV 1
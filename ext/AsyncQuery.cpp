@@ -0,0 +1,174 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "AsyncQuery.h"
+#include "xQWrapper.h"
+#include "utils.h"
+
+namespace xmlselector {
+
+/**
+ * Class initialization. Query handles aren't exported; they're only
+ * created by searchAsync() and filterAsync().
+ */
+void AsyncQuery::Init(v8::Handle<v8::Object> exports, InstanceData* data) {
+  v8::Local<v8::FunctionTemplate> tpl = NanNew<v8::FunctionTemplate>(New);
+
+  tpl->SetClassName(NanNew<v8::String>("Query"));
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  NanSetPrototypeTemplate(tpl, "cancel", FUNCTION_VALUE(Cancel));
+
+  NanAssignPersistent(data->queryConstructor, tpl->GetFunction());
+}
+
+/**
+ * Constructor. Takes ownership of copy and selector.
+ */
+AsyncQuery::AsyncQuery(NanCallback* callback, xQ* copy, xmlChar* selector, Operation op) :
+  NanAsyncWorker(callback), _copy(copy), _selector(selector), _op(op), _result(0), _cancelled(0) {
+  _copy->cancelled = &_cancelled;
+}
+
+/**
+ * Destructor
+ */
+AsyncQuery::~AsyncQuery() {
+  if (_result)
+    xQ_free(_result, 1);
+  if (_copy)
+    xQ_free(_copy, 1);
+  if (_selector)
+    xmlFree(_selector);
+}
+
+/**
+ * Start evaluating a selector against a copy of xq on the thread pool.
+ * The callback receives an error or a new xQ with the results.
+ *
+ * Returns the handle for the query, or an empty handle if an exception
+ * was thrown
+ */
+v8::Local<v8::Object> AsyncQuery::Queue(v8::Local<v8::Object> source, xQ* xq, const char* selector, Operation op, v8::Local<v8::Function> callback) {
+  NanEscapableScope();
+
+  InstanceData* data = InstanceData::Current();
+  xQ* copy = 0;
+  xmlChar* selectorCopy = xmlStrdup((const xmlChar*) selector);
+
+  xQStatusCode result = selectorCopy ? xQ_alloc_initCopy(&copy, xq) : XQ_OUT_OF_MEMORY;
+
+  if (result != XQ_OK) {
+    if (selectorCopy)
+      xmlFree(selectorCopy);
+    NanThrowError(xQWrapper::statusString(result));
+    return v8::Local<v8::Object>();
+  }
+
+  v8::Local<v8::Object> handle = NanNew(data->queryConstructor)->NewInstance();
+  if (handle.IsEmpty()) {
+    xQ_free(copy, 1);
+    xmlFree(selectorCopy);
+    return handle;
+  }
+
+  AsyncQuery* query = new AsyncQuery(new NanCallback(callback), copy, selectorCopy, op);
+  if (!query) {
+    xQ_free(copy, 1);
+    xmlFree(selectorCopy);
+    NanThrowError("Out of memory");
+    return v8::Local<v8::Object>();
+  }
+
+  // the source wrapper holds the documents the copy points into
+  query->SaveToPersistent("source", source);
+  query->SaveToPersistent("handle", handle);
+  NanSetInternalFieldPointer(handle, 0, query);
+
+  NanAsyncQueueWorker(query);
+
+  return NanEscapeScope(handle);
+}
+
+/**
+ * Evaluate the selector. Runs on a thread pool thread.
+ */
+void AsyncQuery::Execute() {
+  xQStatusCode result = _op(_copy, _selector, &_result);
+
+  if (result != XQ_OK)
+    SetErrorMessage(xQWrapper::statusString(result));
+}
+
+/**
+ * Deliver the result or error
+ */
+void AsyncQuery::WorkComplete() {
+  NanScope();
+
+  NanSetInternalFieldPointer(GetFromPersistent("handle"), 0, 0);
+
+  // a query cancelled after its search finished still reports the cancel
+  if (_cancelled && !ErrorMessage())
+    SetErrorMessage(xQWrapper::statusString(XQ_CANCELLED));
+
+  NanAsyncWorker::WorkComplete();
+}
+
+/**
+ * Call back with the results, wrapped without creating their node
+ * objects up front
+ */
+void AsyncQuery::HandleOKCallback() {
+  NanScope();
+
+  v8::Local<v8::Object> out = xQWrapper::New(_result, GetFromPersistent("source"));
+  _result = 0;
+
+  v8::Local<v8::Value> argv[] = {NanNull(), out};
+  callback->Call(2, argv);
+}
+
+/**
+ * `new Query()`
+ */
+NAN_METHOD(AsyncQuery::New) {
+  NanScope();
+
+  if (!args.IsConstructCall())
+    ThrowEx("Query constructor called incorrectly");
+
+  NanSetInternalFieldPointer(args.This(), 0, 0);
+
+  NanReturnThis();
+}
+
+/**
+ * Cancel the query. If it was still pending, its callback is called
+ * with a cancellation error and true is returned.
+ */
+NAN_METHOD(AsyncQuery::Cancel) {
+  NanScope();
+
+  AsyncQuery* query = (AsyncQuery*) NanGetInternalFieldPointer(args.This(), 0);
+  if (!query)
+    NanReturnValue(NanFalse());
+
+  query->cancel();
+
+  NanReturnValue(NanTrue());
+}
+
+} // namespace xmlselector
@@ -0,0 +1,63 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __XMLSELECTOR_ASYNCQUERY_H_INCLUDED__
+#define __XMLSELECTOR_ASYNCQUERY_H_INCLUDED__
+
+#include <node.h>
+#include <nan.h>
+#include <libxq.h>
+
+#include "InstanceData.h"
+
+namespace xmlselector {
+
+/**
+ * A selector evaluation running on the libuv thread pool. The query
+ * works on a private copy of an xQ's node list and keeps the source
+ * wrapper (and so its documents) alive until it completes.
+ */
+class AsyncQuery : public NanAsyncWorker {
+public:
+  typedef xQStatusCode (*Operation)(xQ* self, const xmlChar* selector, xQ** result);
+
+  static void Init(v8::Handle<v8::Object> exports, InstanceData* data);
+
+  static v8::Local<v8::Object> Queue(v8::Local<v8::Object> source, xQ* xq, const char* selector, Operation op, v8::Local<v8::Function> callback);
+
+  void cancel() { _cancelled = 1; }
+
+  virtual void Execute();
+  virtual void WorkComplete();
+
+protected:
+  AsyncQuery(NanCallback* callback, xQ* copy, xmlChar* selector, Operation op);
+  virtual ~AsyncQuery();
+
+  virtual void HandleOKCallback();
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(Cancel);
+
+  xQ* _copy;
+  xmlChar* _selector;
+  Operation _op;
+  xQ* _result;
+  volatile int _cancelled;
+};
+
+} // namespace xmlselector
+
+#endif // __XMLSELECTOR_ASYNCQUERY_H_INCLUDED__
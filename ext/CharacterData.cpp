@@ -14,17 +14,15 @@
  * limitations under the License.
  */
 #include "CharacterData.h"
+#include "ExternalString.h"
 #include "utils.h"
 
 namespace xmlselector {
 
-
-v8::Persistent<v8::Function> CharacterData::constructor;
-
 /**
  * Class initialization and exports
  */
-void CharacterData::Init(v8::Handle<v8::Object> exports) {
+void CharacterData::Init(v8::Handle<v8::Object> exports, InstanceData* data) {
   // create a constructor function
   v8::Local<v8::FunctionTemplate> tpl = NanNew<v8::FunctionTemplate>(New);
 
@@ -32,13 +30,13 @@ void CharacterData::Init(v8::Handle<v8::Object> exports) {
   tpl->InstanceTemplate()->SetInternalFieldCount(1);
   
   // inherits from Node
-  tpl->Inherit(NanNew(Node::constructor_template));
+  tpl->Inherit(NanNew(data->nodeTemplate));
 
   tpl->PrototypeTemplate()->SetAccessor(NanNew<v8::String>("data"), Data);
   tpl->PrototypeTemplate()->SetAccessor(NanNew<v8::String>("length"), Length);
 
   // export it
-  NanAssignPersistent(constructor, tpl->GetFunction());
+  NanAssignPersistent(data->characterDataConstructor, tpl->GetFunction());
   exports->Set(NanNew<v8::String>("CharacterData"), tpl->GetFunction());
 }
 
@@ -82,7 +80,14 @@ NAN_PROPERTY_GETTER(CharacterData::Data) {
   assertGotWrapper(obj);
   assertHasNode(obj);
 
-  xmlChar* content = xmlNodeGetContent(obj->node());
+  xmlNodePtr n = obj->node();
+  
+  // text, CDATA and comments hold their content in one piece
+  if ( (n->type == XML_TEXT_NODE || n->type == XML_CDATA_SECTION_NODE || n->type == XML_COMMENT_NODE) &&
+       n->content )
+    NanReturnValue(ExternalString::New(n, n->content));
+  
+  xmlChar* content = xmlNodeGetContent(n);
   
   if (!content)
     NanReturnNull();
@@ -14,21 +14,22 @@
  * limitations under the License.
  */
 #include <libxml/parser.h>
+#include <libxml/parserInternals.h>
 
 #include "Document.h"
+#include "ExternalString.h"
 #include "utils.h"
 
-#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 namespace xmlselector {
 
-
-v8::Persistent<v8::Function> Document::constructor;
-
 /**
  * Class initialization and exports
  */
-void Document::Init(v8::Handle<v8::Object> exports) {
+void Document::Init(v8::Handle<v8::Object> exports, InstanceData* data) {
   // create a constructor function
   v8::Local<v8::FunctionTemplate> tpl = NanNew<v8::FunctionTemplate>(New);
 
@@ -36,12 +37,12 @@ void Document::Init(v8::Handle<v8::Object> exports) {
   tpl->InstanceTemplate()->SetInternalFieldCount(1);
   
   // inherits from Node
-  tpl->Inherit(NanNew(Node::constructor_template));
+  tpl->Inherit(NanNew(data->nodeTemplate));
 
   tpl->PrototypeTemplate()->SetAccessor(NanNew<v8::String>("documentElement"), DocumentElement);
 
   // export it
-  NanAssignPersistent(constructor, tpl->GetFunction());
+  NanAssignPersistent(data->documentConstructor, tpl->GetFunction());
   exports->Set(NanNew<v8::String>("Document"), tpl->GetFunction());
 
   // export standalone functions
@@ -51,18 +52,201 @@ void Document::Init(v8::Handle<v8::Object> exports) {
 /**
  * Constructor
  */
-Document::Document(xmlDocPtr doc) : Node((xmlNodePtr)doc) {
+Document::Document(xmlDocPtr doc) : Node((xmlNodePtr)doc), _ref(0),
+  _interned(0), _internedSize(0), _internedCount(0), _signatures(0), _docStats(0) {
 }
 
 /**
  * Destructor
  */
 Document::~Document() {
+  for (unsigned long i = 0; i < _internedSize; i++) {
+    Interned* entry = _interned[i];
+    
+    while (entry) {
+      Interned* next = entry->next;
+      NanDisposePersistent(entry->handle);
+      delete entry;
+      entry = next;
+    }
+  }
+  
+  delete[] _interned;
+  
+  if (_signatures) {
+    NanAdjustExternalMemory(-((int) _signatures->bytes));
+    xQSignatures_free(_signatures);
+  }
+  
+  if (_docStats) {
+    NanAdjustExternalMemory(-((int) _docStats->bytes));
+    xQDocStats_free(_docStats);
+  }
+  
   if (doc()) {
     xmlDocPtr d = doc();
     cleanTree((xmlNodePtr)d);
-    xmlFreeDoc(d);
+    
+    if (_ref)
+      releaseDoc(_ref);
+    else
+      xmlFreeDoc(d);
+  }
+}
+
+/**
+ * Take a reference to the document. Returns 0 if there is no document or
+ * out of memory.
+ */
+Document::Ref* Document::retainDoc() {
+  if (!doc())
+    return 0;
+  
+  if (!_ref) {
+    _ref = new Ref;
+    if (!_ref)
+      return 0;
+    
+    _ref->doc = doc();
+    _ref->count = 1;
+  }
+  
+  XS_ATOMIC_INC(&(_ref->count));
+  
+  return _ref;
+}
+
+/**
+ * Release a reference to a document, freeing the document once nothing
+ * refers to it
+ */
+void Document::releaseDoc(Ref* ref) {
+  if (XS_ATOMIC_DEC(&(ref->count)) == 0) {
+    xmlFreeDoc(ref->doc);
+    delete ref;
+  }
+}
+
+/**
+ * Determine whether a string is held in the document's dictionary, in
+ * which case it lasts as long as the document and is the only copy of
+ * its value
+ */
+bool Document::ownsString(const xmlChar* str) {
+  return str && doc() && doc()->dict && xmlDictOwns(doc()->dict, str) == 1;
+}
+
+/**
+ * Return the subtree signatures of the document, building them the first
+ * time they're asked for. Their memory is reported to V8 once built.
+ * Returns 0 if they couldn't be built.
+ */
+xQSignatures* Document::signatures() {
+  if (_signatures && _signatures->built)
+    return _signatures;
+  
+  if (!doc())
+    return 0;
+  
+  if (!_signatures && xQSignatures_alloc_init(&_signatures, doc(), 0) != XQ_OK)
+    return 0;
+  
+  if (xQSignatures_build(_signatures) != XQ_OK)
+    return 0;
+  
+  NanAdjustExternalMemory((int) _signatures->bytes);
+  return _signatures;
+}
+
+/**
+ * Return the statistics searches of the document are planned with,
+ * gathering them the first time they're asked for. Their memory is
+ * reported to V8 once built. Returns 0 if they couldn't be built.
+ */
+xQDocStats* Document::docStats() {
+  if (_docStats && _docStats->built)
+    return _docStats;
+  
+  if (!doc())
+    return 0;
+  
+  if (!_docStats && xQDocStats_alloc_init(&_docStats, doc()) != XQ_OK)
+    return 0;
+  
+  if (xQDocStats_build(_docStats) != XQ_OK)
+    return 0;
+  
+  NanAdjustExternalMemory((int) _docStats->bytes);
+  return _docStats;
+}
+
+/**
+ * Hash a dictionary string by its address
+ */
+static inline unsigned long internedSlot(const xmlChar* str, unsigned long size) {
+  uintptr_t key = (uintptr_t) str;
+  return (unsigned long) ((key >> 3) ^ (key >> 11)) & (size - 1);
+}
+
+/**
+ * Return the JS string for len bytes of a string held in the document's
+ * dictionary (see ownsString()). The string is created the first time
+ * it's asked for, shared with V8 if it's ASCII, and the same string is
+ * returned from then on.
+ */
+v8::Local<v8::String> Document::internedString(const xmlChar* str, int len) {
+  NanEscapableScope();
+  
+  if (_internedSize) {
+    for (Interned* entry = _interned[internedSlot(str, _internedSize)]; entry; entry = entry->next) {
+      if (entry->str == str)
+        return NanEscapeScope(NanNew(entry->handle));
+    }
+  }
+  
+  v8::Local<v8::String> handle = ExternalString::Share(this, str, len);
+  if (handle.IsEmpty())
+    handle = NanNew<v8::String>((const char*) str, len);
+  
+  // keep about one entry per slot
+  if (_internedCount >= _internedSize) {
+    unsigned long size = _internedSize ? _internedSize * 2 : 64;
+    Interned** table = new Interned*[size];
+    if (!table)
+      return NanEscapeScope(handle);
+    
+    memset(table, 0, size * sizeof(Interned*));
+    
+    for (unsigned long i = 0; i < _internedSize; i++) {
+      Interned* entry = _interned[i];
+      
+      while (entry) {
+        Interned* next = entry->next;
+        unsigned long slot = internedSlot(entry->str, size);
+        entry->next = table[slot];
+        table[slot] = entry;
+        entry = next;
+      }
+    }
+    
+    delete[] _interned;
+    _interned = table;
+    _internedSize = size;
   }
+  
+  Interned* entry = new Interned;
+  if (!entry)
+    return NanEscapeScope(handle);
+  
+  unsigned long slot = internedSlot(str, _internedSize);
+  
+  entry->str = str;
+  NanAssignPersistent(entry->handle, handle);
+  entry->next = _interned[slot];
+  _interned[slot] = entry;
+  ++_internedCount;
+  
+  return NanEscapeScope(handle);
 }
 
 /**
@@ -97,37 +281,113 @@ NAN_METHOD(Document::New) {
 }
 
 /**
- * Error handling routing for parsing
+ * Append the line of input surrounding the current parser position and a
+ * marker pointing to the error column (mirrors libxml2's own reporting)
  */
-void parseErrorHandler(void *ctx, const char *msg, ...) {
-    va_list args;
-    v8::Array* errors = (v8::Array*)ctx;
+static void appendErrorContext(xmlBufferPtr errors, xmlParserInputPtr input) {
+  const xmlChar* cur;
+  const xmlChar* base;
+  xmlChar content[81];
+  unsigned int n, col;
 
-    // determine the size of the message
-    va_start(args, msg);
-    
-    int strSize = vsnprintf(0, 0, msg, args);
-    if (strSize < 1) strSize = 1024;
-    
-    va_end(args);
-    
-    // allocate memory for the formatted message
-    char* str = new char[strSize + 1];
-    if (!str) return;
-    str[0] = 0;
+  if (!input || !input->cur || !input->base)
+    return;
 
-    // format it
-    va_start(args, msg);
-    
-    vsnprintf(str, strSize + 1, msg, args);
-    
-    va_end(args);
-    
-    str[strSize] = 0;
-    
-    errors->Set(errors->Length(), NanNew<v8::String>(str));
-    
-    delete[] str;
+  cur = input->cur;
+  base = input->base;
+
+  // skip backwards over any end-of-line chars
+  while ((cur > base) && ((*cur == '\n') || (*cur == '\r')))
+    cur--;
+
+  // search backwards for the beginning of the line (up to 80 chars)
+  n = 0;
+  while ((n++ < sizeof(content) - 1) && (cur > base) && (*cur != '\n') && (*cur != '\r'))
+    cur--;
+  if ((*cur == '\n') || (*cur == '\r')) cur++;
+
+  col = input->cur - cur;
+
+  // copy the line up to the next end-of-line
+  n = 0;
+  while ((*cur != 0) && (*cur != '\n') && (*cur != '\r') && (n < sizeof(content) - 1))
+    content[n++] = *cur++;
+  content[n] = 0;
+
+  xmlBufferCat(errors, content);
+  xmlBufferCCat(errors, "\n");
+
+  // marker line, tabs preserved so the caret lines up
+  for (n = 0; n < col && n < sizeof(content) - 1 && content[n]; n++)
+    if (content[n] != '\t')
+      content[n] = ' ';
+  content[n] = 0;
+
+  xmlBufferCat(errors, content);
+  xmlBufferCCat(errors, "^\n");
+}
+
+/**
+ * Structured error handler for parsing. Errors are formatted into the
+ * native buffer attached to the parser context, so no V8 objects are
+ * touched while libxml2 is parsing.
+ */
+static void parseErrorHandler(void* userData, xmlErrorPtr error) {
+  xmlParserCtxtPtr ctxt = (xmlParserCtxtPtr) userData;
+  xmlBufferPtr errors = ctxt ? (xmlBufferPtr) ctxt->_private : 0;
+  char prefix[64];
+
+  if (!errors || !error)
+    return;
+
+  if (error->file) {
+    xmlBufferCCat(errors, error->file);
+    snprintf(prefix, sizeof(prefix), ":%d: ", error->line);
+  } else if (error->line) {
+    snprintf(prefix, sizeof(prefix), "Entity: line %d: ", error->line);
+  } else {
+    prefix[0] = 0;
+  }
+  xmlBufferCCat(errors, prefix);
+
+  xmlBufferCCat(errors, error->domain == XML_FROM_NAMESPACE ? "namespace " : "parser ");
+  xmlBufferCCat(errors, error->level == XML_ERR_WARNING ? "warning : " : "error : ");
+  xmlBufferCCat(errors, error->message ? error->message : "unknown error\n");
+
+  appendErrorContext(errors, ctxt->input);
+}
+
+/**
+ * Parse a buffer into a new document using a private parser context.
+ * Errors are collected into the `errors` buffer rather than going through
+ * libxml2's process-wide generic error handler, so this may be called
+ * from any thread.
+ *
+ * Returns the new document, or 0 if the buffer could not be parsed. The
+ * caller is responsible for freeing the document.
+ */
+xmlDocPtr Document::parseBuffer(const char* buffer, int size, xmlBufferPtr errors) {
+  xmlDocPtr doc = 0;
+
+  xmlParserCtxtPtr ctxt = xmlCreateMemoryParserCtxt(buffer, size);
+  if (!ctxt)
+    return 0;
+
+  ctxt->_private = errors;
+  ctxt->sax->serror = parseErrorHandler;
+
+  xmlParseDocument(ctxt);
+
+  if (ctxt->wellFormed) {
+    doc = ctxt->myDoc;
+  } else if (ctxt->myDoc) {
+    xmlFreeDoc(ctxt->myDoc);
+  }
+
+  ctxt->myDoc = 0;
+  xmlFreeParserCtxt(ctxt);
+
+  return doc;
 }
 
 /**
@@ -138,28 +398,27 @@ NAN_METHOD(Document::ParseFromString) {
 
   v8::String::Utf8Value xmlStr(args[0]->ToString());
 
-  v8::Local<v8::Array> errors = NanNew<v8::Array>();
-  xmlSetGenericErrorFunc(*errors, parseErrorHandler);
-  
-  xmlDocPtr doc = xmlParseMemory((const char*) *xmlStr, xmlStr.length());
-  
-  xmlSetGenericErrorFunc(0, 0);
-  
+  xmlBufferPtr errors = xmlBufferCreate();
+  assertPointerValid(errors);
+
+  xmlDocPtr doc = parseBuffer((const char*) *xmlStr, xmlStr.length(), errors);
+
   if (!doc) {
     v8::Local<v8::String> errStr;
-    
-    if (errors->Length() < 1)
+
+    if (xmlBufferLength(errors) < 1)
       errStr = NanNew<v8::String>("Invalid XML");
     else
-      errStr = errors->Get(0)->ToString();
-    
-    for (uint32_t i = 1; i < errors->Length(); i++)
-      errStr = v8::String::Concat(errStr, errors->Get(i)->ToString());
-    
+      errStr = NanNew<v8::String>((const char*) xmlBufferContent(errors), xmlBufferLength(errors));
+
+    xmlBufferFree(errors);
+
     ThrowEx(v8::Exception::Error(errStr));
   }
-  
-  v8::Local<v8::Object> retObj = NanNew(constructor)->NewInstance();
+
+  xmlBufferFree(errors);
+
+  v8::Local<v8::Object> retObj = NanNew(InstanceData::Current()->documentConstructor)->NewInstance();
   if (retObj.IsEmpty()) {
     xmlFreeDoc(doc);
     NanReturnValue(retObj);
@@ -18,16 +18,38 @@
 
 #include "Node.h"
 
+#include <libxq.h>
+
 namespace xmlselector {
 
 class Document : public Node {
 public:
-  static void Init(v8::Handle<v8::Object> exports);
-
-  static v8::Persistent<v8::Function> constructor;
+  static void Init(v8::Handle<v8::Object> exports, InstanceData* data);
 
   xmlDocPtr doc() { return (xmlDocPtr) _node; }
 
+  static xmlDocPtr parseBuffer(const char* buffer, int size, xmlBufferPtr errors);
+
+  /**
+   * Shared ownership of the parsed document, for native objects that can
+   * outlive the wrapper (such as external strings pointing at its text).
+   * The wrapper holds one reference; the document is freed when the last
+   * reference is released.
+   */
+  struct Ref {
+    xmlDocPtr doc;
+    volatile long count;
+  };
+
+  Ref* retainDoc();
+  static void releaseDoc(Ref* ref);
+
+  bool ownsString(const xmlChar* str);
+  v8::Local<v8::String> internedString(const xmlChar* str, int len);
+
+  xQSignatures* signatures();
+  xQDocStats* docStats();
+
 protected:
 
   explicit Document(xmlDocPtr doc);
@@ -41,6 +63,25 @@ protected:
   void doc(xmlDocPtr newDoc) { node((xmlNodePtr) newDoc); }
   void cleanTree(xmlNodePtr n);
 
+  /**
+   * A JS string cached for a string in the document's dictionary, which
+   * holds one copy of each distinct name for the life of the document
+   */
+  struct Interned {
+    const xmlChar* str;
+    v8::Persistent<v8::String> handle;
+    Interned* next;
+  };
+
+  Ref* _ref;
+
+  Interned** _interned;
+  unsigned long _internedSize;
+  unsigned long _internedCount;
+
+  xQSignatures* _signatures;
+  xQDocStats* _docStats;
+
 };
 
 } // namespace xmlselector
@@ -13,18 +13,18 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <libxq.h>
+
 #include "Element.h"
+#include "ExternalString.h"
 #include "utils.h"
 
 namespace xmlselector {
 
-
-v8::Persistent<v8::Function> Element::constructor;
-
 /**
  * Class initialization and exports
  */
-void Element::Init(v8::Handle<v8::Object> exports) {
+void Element::Init(v8::Handle<v8::Object> exports, InstanceData* data) {
   // create a constructor function
   v8::Local<v8::FunctionTemplate> tpl = NanNew<v8::FunctionTemplate>(New);
 
@@ -32,14 +32,14 @@ void Element::Init(v8::Handle<v8::Object> exports) {
   tpl->InstanceTemplate()->SetInternalFieldCount(1);
   
   // inherits from Node
-  tpl->Inherit(NanNew(Node::constructor_template));
+  tpl->Inherit(NanNew(data->nodeTemplate));
 
   NanSetPrototypeTemplate(tpl, "getAttribute", FUNCTION_VALUE(GetAttribute));
 
   tpl->PrototypeTemplate()->SetAccessor(NanNew<v8::String>("tagName"), TagName);
 
   // export it
-  NanAssignPersistent(constructor, tpl->GetFunction());
+  NanAssignPersistent(data->elementConstructor, tpl->GetFunction());
   exports->Set(NanNew<v8::String>("Element"), tpl->GetFunction());
 }
 
@@ -86,7 +86,13 @@ NAN_METHOD(Element::GetAttribute) {
     NanReturnEmptyString();
   
   v8::String::Utf8Value name(args[0]->ToString());
-    
+  
+  int len = 0;
+  const xmlChar* ref = xQNode_getAttrRef(obj->node(), (const xmlChar*)*name, &len);
+  if (ref)
+    NanReturnValue(ExternalString::New(obj->node(), ref, len));
+  
+  // values split across several nodes are put together by libxml2
   xmlChar* value = xmlGetProp(obj->node(), (const xmlChar*)*name);
   
   if (!value)
@@ -112,7 +118,7 @@ NAN_PROPERTY_GETTER(Element::TagName) {
   if (!obj->node()->name)
     NanReturnNull();
   else
-    NanReturnValue(NewUtf8Handle((const char*)obj->node()->name));
+    NanReturnValue(ExternalString::New(obj->node(), obj->node()->name));
 }
 
 
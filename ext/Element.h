@@ -22,9 +22,7 @@ namespace xmlselector {
 
 class Element : public Node {
 public:
-  static void Init(v8::Handle<v8::Object> exports);
-
-  static v8::Persistent<v8::Function> constructor;
+  static void Init(v8::Handle<v8::Object> exports, InstanceData* data);
 
   xmlElementPtr elem() { return (xmlElementPtr) _node; }
 
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "ExternalString.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace xmlselector {
+
+// shorter strings are copied; an external string costs more to create
+// and track than a small copy
+#define XS_EXTERNAL_STRING_MIN 256
+
+/**
+ * Check whether a buffer only contains 7-bit characters, in which case
+ * its UTF-8 and Latin-1 interpretations are the same
+ */
+static bool isAscii(const char* str, size_t len) {
+  const uint64_t highBits = 0x8080808080808080ULL;
+  uint64_t word, found = 0;
+  size_t i = 0;
+
+  for (; i + sizeof(word) <= len; i += sizeof(word)) {
+    memcpy(&word, str + i, sizeof(word));
+    found |= word;
+  }
+
+  for (; i < len; i++)
+    found |= (unsigned char) str[i];
+
+  return (found & highBits) == 0;
+}
+
+/**
+ * Constructor. Takes ownership of a document reference.
+ */
+ExternalString::ExternalString(Document::Ref* ref, const char* data, size_t length) :
+  _ref(ref), _data(data), _length(length) {
+}
+
+/**
+ * Destructor. Called when V8 disposes of the string.
+ */
+ExternalString::~ExternalString() {
+  Document::releaseDoc(_ref);
+}
+
+/**
+ * Return a JS string for len bytes of UTF-8 text belonging to node's
+ * document. Strings from the document's dictionary, such as names, come
+ * from the document's cache of them. Large ASCII text is shared with V8
+ * without copying; other text is decoded directly from the document.
+ */
+v8::Local<v8::String> ExternalString::New(xmlNodePtr node, const xmlChar* str, int len) {
+  Document* doc = (node && node->doc) ? (Document*) node->doc->_private : 0;
+
+  if (doc) {
+    if (doc->ownsString(str))
+      return doc->internedString(str, len);
+
+    if (len >= XS_EXTERNAL_STRING_MIN) {
+      v8::Local<v8::String> shared = Share(doc, str, len);
+      if (!shared.IsEmpty())
+        return shared;
+    }
+  }
+
+  return NanNew<v8::String>((const char*) str, len);
+}
+
+/**
+ * Return a JS string for a null-terminated string belonging to node's
+ * document
+ */
+v8::Local<v8::String> ExternalString::New(xmlNodePtr node, const xmlChar* str) {
+  return New(node, str, xmlStrlen(str));
+}
+
+/**
+ * Return a JS string that shares len bytes of a document's text with V8,
+ * or an empty handle if the text isn't ASCII or the document can't be
+ * retained
+ */
+v8::Local<v8::String> ExternalString::Share(Document* doc, const xmlChar* str, int len) {
+  Document::Ref* ref;
+
+  if (!isAscii((const char*) str, len) || (ref = doc->retainDoc()) == 0)
+    return v8::Local<v8::String>();
+
+  return NanNew(static_cast<NanExternalOneByteStringResource*>(new ExternalString(ref, (const char*) str, len)));
+}
+
+} // namespace xmlselector
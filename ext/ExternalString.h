@@ -0,0 +1,53 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __XMLSELECTOR_EXTERNALSTRING_H_INCLUDED__
+#define __XMLSELECTOR_EXTERNALSTRING_H_INCLUDED__
+
+#include <node.h>
+#include <nan.h>
+
+#include <libxml/tree.h>
+
+#include "Document.h"
+
+namespace xmlselector {
+
+/**
+ * A V8 string that reads its characters directly from a document's text
+ * instead of a copy. The string holds a reference to the document, so the
+ * document stays in memory until V8 disposes of the string.
+ */
+class ExternalString : public NanExternalOneByteStringResource {
+public:
+  static v8::Local<v8::String> New(xmlNodePtr node, const xmlChar* str, int len);
+  static v8::Local<v8::String> New(xmlNodePtr node, const xmlChar* str);
+  static v8::Local<v8::String> Share(Document* doc, const xmlChar* str, int len);
+
+  virtual const char* data() const { return _data; }
+  virtual size_t length() const { return _length; }
+
+protected:
+  ExternalString(Document::Ref* ref, const char* data, size_t length);
+  virtual ~ExternalString();
+
+  Document::Ref* _ref;
+  const char* _data;
+  size_t _length;
+};
+
+} // namespace xmlselector
+
+#endif // __XMLSELECTOR_EXTERNALSTRING_H_INCLUDED__
@@ -0,0 +1,103 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <libxq.h>
+
+#include "InstanceData.h"
+#include "utils.h"
+
+namespace xmlselector {
+
+
+InstanceData* InstanceData::_instances = 0;
+uv_mutex_t InstanceData::_lock;
+uv_once_t InstanceData::_lockOnce = UV_ONCE_INIT;
+
+// an isolate never changes threads in node, so the last lookup on each
+// thread is cached to keep the lock out of the wrapper creation path
+static XS_THREAD_LOCAL InstanceData* _currentData = 0;
+static XS_THREAD_LOCAL v8::Isolate* _currentIsolate = 0;
+
+/**
+ * Constructor
+ */
+InstanceData::InstanceData(v8::Isolate* isolate) : collectStats(false), useSignatures(false), usePlanner(false),
+  parallelThreads(1), parallelThreshold(XQ_PARALLEL_DEFAULT_THRESHOLD), _isolate(isolate), _next(0) {
+}
+
+/**
+ * Initialize the lock protecting the instance list
+ */
+void InstanceData::initLock() {
+  uv_mutex_init(&_lock);
+}
+
+/**
+ * Create and register the instance data for an isolate. It lives as long
+ * as the process. If the module is loaded more than once in the same
+ * isolate the existing data is reused.
+ */
+InstanceData* InstanceData::Create(v8::Isolate* isolate) {
+  uv_once(&_lockOnce, initLock);
+
+  InstanceData* data = lookup(isolate);
+  if (data)
+    return data;
+
+  data = new InstanceData(isolate);
+  if (!data)
+    return 0;
+
+  uv_mutex_lock(&_lock);
+  data->_next = _instances;
+  _instances = data;
+  uv_mutex_unlock(&_lock);
+
+  return data;
+}
+
+/**
+ * Return the instance data for the isolate running on this thread
+ */
+InstanceData* InstanceData::Current() {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+  if (_currentIsolate != isolate || !_currentData) {
+    _currentData = lookup(isolate);
+    _currentIsolate = isolate;
+  }
+
+  return _currentData;
+}
+
+/**
+ * Find the registered instance data for an isolate
+ */
+InstanceData* InstanceData::lookup(v8::Isolate* isolate) {
+  InstanceData* data;
+
+  uv_once(&_lockOnce, initLock);
+  uv_mutex_lock(&_lock);
+
+  for (data = _instances; data && data->_isolate != isolate; data = data->_next)
+    ;
+
+  uv_mutex_unlock(&_lock);
+
+  return data;
+}
+
+
+} // namespace xmlselector
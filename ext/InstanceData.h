@@ -0,0 +1,67 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __XMLSELECTOR_INSTANCEDATA_H_INCLUDED__
+#define __XMLSELECTOR_INSTANCEDATA_H_INCLUDED__
+
+#include <node.h>
+#include <nan.h>
+#include <uv.h>
+
+namespace xmlselector {
+
+/**
+ * Per-isolate state for the addon. Each isolate that loads the module
+ * gets its own constructors, so nothing created in one isolate is ever
+ * used from another.
+ */
+class InstanceData {
+public:
+  static InstanceData* Create(v8::Isolate* isolate);
+  static InstanceData* Current();
+
+  v8::Persistent<v8::Function> xQConstructor;
+  v8::Persistent<v8::FunctionTemplate> nodeTemplate;
+  v8::Persistent<v8::Function> nodeConstructor;
+  v8::Persistent<v8::Function> documentConstructor;
+  v8::Persistent<v8::Function> elementConstructor;
+  v8::Persistent<v8::Function> characterDataConstructor;
+  v8::Persistent<v8::Function> queryConstructor;
+  v8::Persistent<v8::Function> xmlStreamConstructor;
+  v8::Persistent<v8::String> nodesKey;
+
+  bool collectStats;
+  bool useSignatures;
+  bool usePlanner;
+  unsigned int parallelThreads;
+  unsigned long parallelThreshold;
+
+protected:
+  explicit InstanceData(v8::Isolate* isolate);
+
+  static void initLock();
+  static InstanceData* lookup(v8::Isolate* isolate);
+
+  v8::Isolate* _isolate;
+  InstanceData* _next;
+
+  static InstanceData* _instances;
+  static uv_mutex_t _lock;
+  static uv_once_t _lockOnce;
+};
+
+} // namespace xmlselector
+
+#endif // __XMLSELECTOR_INSTANCEDATA_H_INCLUDED__
@@ -16,18 +16,15 @@
 #include "Node.h"
 #include "Element.h"
 #include "CharacterData.h"
+#include "ExternalString.h"
 #include "utils.h"
 
 namespace xmlselector {
 
-
-v8::Persistent<v8::FunctionTemplate> Node::constructor_template;
-v8::Persistent<v8::Function> Node::constructor;
-
 /**
  * Class initialization and exports
  */
-void Node::Init(v8::Handle<v8::Object> exports) {
+void Node::Init(v8::Handle<v8::Object> exports, InstanceData* data) {
   // create a constructor function
   v8::Local<v8::FunctionTemplate> tpl = NanNew<v8::FunctionTemplate>(New);
 
@@ -46,8 +43,8 @@ void Node::Init(v8::Handle<v8::Object> exports) {
   tpl->PrototypeTemplate()->SetAccessor(NanNew<v8::String>("ownerDocument"), OwnerDocument);
 
   // export it
-  NanAssignPersistent(constructor_template, tpl);
-  NanAssignPersistent(constructor, tpl->GetFunction());
+  NanAssignPersistent(data->nodeTemplate, tpl);
+  NanAssignPersistent(data->nodeConstructor, tpl->GetFunction());
   exports->Set(NanNew<v8::String>("Node"), tpl->GetFunction());
 }
 
@@ -74,23 +71,25 @@ v8::Local<v8::Object> Node::New(xmlNodePtr n) {
   if (n->_private)
     return NanEscapeScope(NanObjectWrapHandle( ((Node*)n->_private) ));
   
+  InstanceData* data = InstanceData::Current();
+  
   switch (n->type) {
   case XML_ELEMENT_NODE:
-    return NanEscapeScope(wrapNode(n, Element::constructor));
+    return NanEscapeScope(wrapNode(n, NanNew(data->elementConstructor)));
   case XML_TEXT_NODE:
   case XML_CDATA_SECTION_NODE:
   case XML_COMMENT_NODE:
-    return NanEscapeScope(wrapNode(n, CharacterData::constructor));
+    return NanEscapeScope(wrapNode(n, NanNew(data->characterDataConstructor)));
   default:
-    return NanEscapeScope(wrapNode(n, Node::constructor));
+    return NanEscapeScope(wrapNode(n, NanNew(data->nodeConstructor)));
   }
 }
 
 /**
  * Handles creating a new Javascript object to wrap an XML node
  */
-v8::Local<v8::Object> Node::wrapNode(xmlNodePtr n, v8::Persistent<v8::Function>& ctor) {
-  v8::Local<v8::Object> retObj = NanNew(ctor)->NewInstance();
+v8::Local<v8::Object> Node::wrapNode(xmlNodePtr n, v8::Local<v8::Function> ctor) {
+  v8::Local<v8::Object> retObj = ctor->NewInstance();
   if (retObj.IsEmpty()) return retObj;
 
   Node* obj = node::ObjectWrap::Unwrap<Node>(retObj);
@@ -166,7 +165,7 @@ NAN_PROPERTY_GETTER(Node::NodeName) {
   if (!obj->node()->name)
     NanReturnNull();
   else
-    NanReturnValue(NewUtf8Handle((const char*)obj->node()->name));
+    NanReturnValue(ExternalString::New(obj->node(), obj->node()->name));
 }
 
 /**
@@ -21,15 +21,14 @@
 
 #include <libxml/tree.h>
 
+#include "InstanceData.h"
+
 namespace xmlselector {
 
 class Node : public node::ObjectWrap {
 public:
-  static void Init(v8::Handle<v8::Object> exports);
+  static void Init(v8::Handle<v8::Object> exports, InstanceData* data);
 
-  static v8::Persistent<v8::FunctionTemplate> constructor_template;
-  static v8::Persistent<v8::Function> constructor;
-  
   static v8::Local<v8::Object> New(xmlNodePtr n);
 
   xmlNodePtr node() { return _node; }
@@ -40,7 +39,7 @@ protected:
   explicit Node(xmlNodePtr doc);
   virtual ~Node();
   
-  static v8::Local<v8::Object> wrapNode(xmlNodePtr n, v8::Persistent<v8::Function>& ctor);
+  static v8::Local<v8::Object> wrapNode(xmlNodePtr n, v8::Local<v8::Function> ctor);
 
   static NAN_METHOD(New);
   static NAN_METHOD(HasChildNodes);
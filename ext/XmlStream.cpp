@@ -0,0 +1,406 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "XmlStream.h"
+#include "xQWrapper.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace xmlselector {
+
+/**
+ * Class initialization. Stream handles aren't exported; they're only
+ * created by the xml streaming methods of xQ.
+ */
+void XmlStream::Init(v8::Handle<v8::Object> exports, InstanceData* data) {
+  v8::Local<v8::FunctionTemplate> tpl = NanNew<v8::FunctionTemplate>(New);
+
+  tpl->SetClassName(NanNew<v8::String>("XmlStream"));
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  NanSetPrototypeTemplate(tpl, "resume", FUNCTION_VALUE(Resume));
+  NanSetPrototypeTemplate(tpl, "cancel", FUNCTION_VALUE(Cancel));
+
+  NanAssignPersistent(data->xmlStreamConstructor, tpl->GetFunction());
+}
+
+/**
+ * Constructor
+ */
+XmlStream::XmlStream() : _head(0), _count(0), _separator(0), _status(XQ_OK), _executed(false),
+  _cancelled(0), _paused(false), _finished(false), _onChunk(0), _onDone(0) {
+  _current.data = 0;
+  _current.length = 0;
+  _nodes.list = 0;
+  _nodes.size = 0;
+  _async.data = this;
+
+  uv_mutex_init(&_lock);
+  uv_cond_init(&_space);
+}
+
+/**
+ * Destructor
+ */
+XmlStream::~XmlStream() {
+  if (_current.data)
+    free(_current.data);
+  
+  for (; _count; _count--, _head = (_head + 1) % XS_STREAM_QUEUE_SIZE)
+    free(_queue[_head].data);
+
+  xQNodeList_free(&_nodes, 0);
+
+  if (_separator)
+    xmlFree(_separator);
+
+  delete _onChunk;
+  delete _onDone;
+
+  NanDisposePersistent(_refs);
+
+  uv_cond_destroy(&_space);
+  uv_mutex_destroy(&_lock);
+}
+
+/**
+ * Release a chunk once the Buffer that owns it is collected
+ */
+static void freeChunk(char* data, void* hint) {
+  free(data);
+}
+
+/**
+ * Start serializing a list of nodes, separated by an optional string.
+ * Chunks of XML are passed to onChunk, and onDone is called with an
+ * error or null once all of them have been delivered.
+ *
+ * Returns the handle for the stream, or an empty handle if an exception
+ * was thrown
+ */
+v8::Local<v8::Object> XmlStream::Queue(v8::Local<v8::Object> source, xQNodeList* nodes, const char* separator, v8::Local<v8::Function> onChunk, v8::Local<v8::Function> onDone) {
+  NanEscapableScope();
+
+  InstanceData* data = InstanceData::Current();
+
+  v8::Local<v8::Object> handle = NanNew(data->xmlStreamConstructor)->NewInstance();
+  if (handle.IsEmpty())
+    return handle;
+
+  XmlStream* stream = new XmlStream();
+  if (!stream) {
+    NanThrowError("Out of memory");
+    return v8::Local<v8::Object>();
+  }
+
+  xQStatusCode result = xQNodeList_init(&(stream->_nodes), nodes->size ? nodes->size : 1);
+
+  if (result == XQ_OK)
+    result = xQNodeList_assign(&(stream->_nodes), nodes);
+
+  if (result == XQ_OK && separator && !(stream->_separator = xmlStrdup((const xmlChar*) separator)))
+    result = XQ_OUT_OF_MEMORY;
+
+  if (result != XQ_OK) {
+    delete stream;
+    NanThrowError(xQWrapper::statusString(result));
+    return v8::Local<v8::Object>();
+  }
+
+  uv_async_init(uv_default_loop(), &(stream->_async), notified);
+
+  stream->_onChunk = new NanCallback(onChunk);
+  stream->_onDone = new NanCallback(onDone);
+
+  // the source wrapper holds the documents being serialized
+  v8::Local<v8::Object> refs = NanNew<v8::Object>();
+  refs->Set(NanNew<v8::String>("source"), source);
+  refs->Set(NanNew<v8::String>("handle"), handle);
+  NanAssignPersistent(stream->_refs, refs);
+
+  // the serializer may wait on a slow stream indefinitely, so it gets a
+  // thread of its own rather than one from the pool
+  if (uv_thread_create(&(stream->_thread), run, stream) != 0) {
+    uv_close((uv_handle_t*) &(stream->_async), closed);
+    NanThrowError("Unable to start the serializer thread");
+    return v8::Local<v8::Object>();
+  }
+
+  NanSetInternalFieldPointer(handle, 0, stream);
+
+  return NanEscapeScope(handle);
+}
+
+/**
+ * Serialize the nodes. Runs on the stream's own thread.
+ */
+void XmlStream::run(void* arg) {
+  XmlStream* self = (XmlStream*) arg;
+  xQStatusCode status;
+
+  xmlOutputBufferPtr out = xmlOutputBufferCreateIO(write, 0, self, 0);
+  if (!out)
+    status = XQ_OUT_OF_MEMORY;
+  else
+    status = xQNodeList_writeXml(&(self->_nodes), out, self->_separator);
+
+  if (out && xmlOutputBufferClose(out) < 0 && status == XQ_OK)
+    status = XQ_OUTPUT_ERROR;
+
+  // whatever is left makes up the last chunk
+  if (status == XQ_OK && !self->push())
+    status = XQ_OUTPUT_ERROR;
+
+  uv_mutex_lock(&(self->_lock));
+  self->_status = self->_cancelled ? XQ_CANCELLED : status;
+  self->_executed = true;
+  uv_mutex_unlock(&(self->_lock));
+
+  uv_async_send(&(self->_async));
+}
+
+/**
+ * Output callback for the serializer. Fills chunks and queues each one
+ * as it's completed, waiting while the queue is full.
+ *
+ * Returns the number of bytes written, or -1 if out of memory or the
+ * stream was cancelled
+ */
+int XmlStream::write(void* ctx, const char* buffer, int len) {
+  XmlStream* self = (XmlStream*) ctx;
+  size_t n;
+  int done = 0;
+
+  while (done < len) {
+    if (!self->_current.data) {
+      self->_current.data = (char*) malloc(XS_STREAM_CHUNK_SIZE);
+      self->_current.length = 0;
+      if (!self->_current.data)
+        return -1;
+    }
+
+    n = XS_STREAM_CHUNK_SIZE - self->_current.length;
+    if (n > (size_t)(len - done))
+      n = len - done;
+
+    memcpy(self->_current.data + self->_current.length, buffer + done, n);
+    self->_current.length += n;
+    done += (int) n;
+
+    if (self->_current.length == XS_STREAM_CHUNK_SIZE && !self->push())
+      return -1;
+  }
+
+  return len;
+}
+
+/**
+ * Queue the current chunk for delivery, waiting for space if the queue is
+ * full. Runs on the serializing thread.
+ *
+ * Returns false if the stream was cancelled
+ */
+bool XmlStream::push() {
+  if (!_current.data || !_current.length)
+    return !_cancelled;
+
+  uv_mutex_lock(&_lock);
+
+  while (_count == XS_STREAM_QUEUE_SIZE && !_cancelled)
+    uv_cond_wait(&_space, &_lock);
+
+  if (_cancelled) {
+    uv_mutex_unlock(&_lock);
+    return false;
+  }
+
+  _queue[(_head + _count) % XS_STREAM_QUEUE_SIZE] = _current;
+  ++_count;
+
+  uv_mutex_unlock(&_lock);
+
+  _current.data = 0;
+  _current.length = 0;
+
+  uv_async_send(&_async);
+
+  return true;
+}
+
+/**
+ * Stop serializing and wake the serializer if it's waiting
+ */
+void XmlStream::cancel() {
+  uv_mutex_lock(&_lock);
+  _cancelled = 1;
+  uv_cond_signal(&_space);
+  uv_mutex_unlock(&_lock);
+}
+
+/**
+ * Called on the loop thread when chunks have been queued or
+ * serialization has ended
+ */
+#if UV_VERSION_MAJOR == 0
+void XmlStream::notified(uv_async_t* handle, int status) {
+#else
+void XmlStream::notified(uv_async_t* handle) {
+#endif
+  ((XmlStream*) handle->data)->deliver();
+}
+
+/**
+ * Pass queued chunks to JavaScript until the queue is empty or the
+ * chunk callback asks to pause, and finish once everything has been
+ * delivered
+ */
+void XmlStream::deliver() {
+  if (_finished)
+    return;
+
+  NanScope();
+
+  bool done;
+
+  while (!_paused || _cancelled) {
+    Chunk chunk;
+    bool got;
+
+    uv_mutex_lock(&_lock);
+
+    got = _count > 0;
+    if (got) {
+      chunk = _queue[_head];
+      _head = (_head + 1) % XS_STREAM_QUEUE_SIZE;
+      --_count;
+      uv_cond_signal(&_space);
+    }
+
+    uv_mutex_unlock(&_lock);
+
+    if (!got)
+      break;
+
+    // chunks are dropped once the stream has been cancelled
+    if (_cancelled) {
+      free(chunk.data);
+      continue;
+    }
+
+    v8::Local<v8::Value> argv[] = {NanNewBufferHandle(chunk.data, chunk.length, freeChunk, 0)};
+    v8::Local<v8::Value> result = _onChunk->Call(1, argv);
+
+    if (_finished)
+      return;
+
+    if (!result.IsEmpty() && result->IsFalse())
+      _paused = true;
+  }
+
+  uv_mutex_lock(&_lock);
+  done = _executed && !_count;
+  uv_mutex_unlock(&_lock);
+
+  // the serializer has returned or is about to, so this doesn't block
+  if (done) {
+    uv_thread_join(&_thread);
+    finish();
+  }
+}
+
+/**
+ * Report completion and release the stream
+ */
+void XmlStream::finish() {
+  NanScope();
+
+  _finished = true;
+
+  if (_cancelled)
+    _status = XQ_CANCELLED;
+
+  v8::Local<v8::Object> refs = NanNew(_refs);
+  NanSetInternalFieldPointer(v8::Local<v8::Object>::Cast(refs->Get(NanNew<v8::String>("handle"))), 0, 0);
+
+  if (_status == XQ_OK) {
+    v8::Local<v8::Value> argv[] = {NanNull()};
+    _onDone->Call(1, argv);
+  } else {
+    v8::Local<v8::Value> argv[] = {v8::Exception::Error(NanNew<v8::String>(xQWrapper::statusString(_status)))};
+    _onDone->Call(1, argv);
+  }
+
+  uv_close((uv_handle_t*) &_async, closed);
+}
+
+/**
+ * Called once the async handle is closed, after which nothing refers to
+ * the stream
+ */
+void XmlStream::closed(uv_handle_t* handle) {
+  delete (XmlStream*) handle->data;
+}
+
+/**
+ * `new XmlStream()`
+ */
+NAN_METHOD(XmlStream::New) {
+  NanScope();
+
+  if (!args.IsConstructCall())
+    ThrowEx("XmlStream constructor called incorrectly");
+
+  NanSetInternalFieldPointer(args.This(), 0, 0);
+
+  NanReturnThis();
+}
+
+/**
+ * Resume delivering chunks after the chunk callback returned false
+ */
+NAN_METHOD(XmlStream::Resume) {
+  NanScope();
+
+  XmlStream* stream = (XmlStream*) NanGetInternalFieldPointer(args.This(), 0);
+
+  if (stream && stream->_paused) {
+    stream->_paused = false;
+    stream->deliver();
+  }
+
+  NanReturnUndefined();
+}
+
+/**
+ * Cancel the stream. If it was still running, no more chunks are
+ * delivered, the completion callback receives a cancellation error and
+ * true is returned.
+ */
+NAN_METHOD(XmlStream::Cancel) {
+  NanScope();
+
+  XmlStream* stream = (XmlStream*) NanGetInternalFieldPointer(args.This(), 0);
+  if (!stream)
+    NanReturnValue(NanFalse());
+
+  stream->cancel();
+  stream->deliver();
+
+  NanReturnValue(NanTrue());
+}
+
+} // namespace xmlselector
@@ -0,0 +1,106 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __XMLSELECTOR_XMLSTREAM_H_INCLUDED__
+#define __XMLSELECTOR_XMLSTREAM_H_INCLUDED__
+
+#include <node.h>
+#include <nan.h>
+#include <uv.h>
+#include <libxq.h>
+
+#include "InstanceData.h"
+
+// size of each chunk of output handed to JavaScript
+#define XS_STREAM_CHUNK_SIZE 65536
+
+// number of chunks that may be waiting for JavaScript before the
+// serializer stops and waits
+#define XS_STREAM_QUEUE_SIZE 4
+
+namespace xmlselector {
+
+/**
+ * Serializes nodes to JavaScript in chunks. The XML is written on a
+ * thread of the stream's own into a bounded queue of chunks, which are
+ * passed to JavaScript as Buffers without copying. The chunk callback
+ * returns false to pause delivery (for example when a stream's write()
+ * does), and the serializer waits once the queue is full until resume()
+ * is called. Waiting never holds up a libuv thread pool thread.
+ */
+class XmlStream {
+public:
+  static void Init(v8::Handle<v8::Object> exports, InstanceData* data);
+
+  static v8::Local<v8::Object> Queue(v8::Local<v8::Object> source, xQNodeList* nodes, const char* separator, v8::Local<v8::Function> onChunk, v8::Local<v8::Function> onDone);
+
+protected:
+  struct Chunk {
+    char* data;
+    size_t length;
+  };
+
+  XmlStream();
+  ~XmlStream();
+
+  static void run(void* arg);
+#if UV_VERSION_MAJOR == 0
+  static void notified(uv_async_t* handle, int status);
+#else
+  static void notified(uv_async_t* handle);
+#endif
+  static void closed(uv_handle_t* handle);
+  static int write(void* ctx, const char* buffer, int len);
+
+  bool push();
+  void cancel();
+  void deliver();
+  void finish();
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(Resume);
+  static NAN_METHOD(Cancel);
+
+  uv_thread_t _thread;
+  uv_async_t _async;
+  uv_mutex_t _lock;
+  uv_cond_t _space;
+
+  // chunks ready for JavaScript, protected by _lock
+  Chunk _queue[XS_STREAM_QUEUE_SIZE];
+  unsigned int _head;
+  unsigned int _count;
+
+  // the chunk being filled by the serializer
+  Chunk _current;
+
+  xQNodeList _nodes;
+  xmlChar* _separator;
+  // set by the serializer as it ends, protected by _lock
+  xQStatusCode _status;
+  bool _executed;
+
+  volatile int _cancelled;
+  bool _paused;
+  bool _finished;
+
+  NanCallback* _onChunk;
+  NanCallback* _onDone;
+  v8::Persistent<v8::Object> _refs;
+};
+
+} // namespace xmlselector
+
+#endif // __XMLSELECTOR_XMLSTREAM_H_INCLUDED__
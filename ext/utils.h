@@ -50,4 +50,20 @@
 #define FUNCTION_VALUE(f) \
   NanNew<v8::FunctionTemplate>(f)->GetFunction()
 
+#if defined(_MSC_VER)
+#define XS_THREAD_LOCAL __declspec(thread)
+#else
+#define XS_THREAD_LOCAL __thread
+#endif
+
+// atomic increment/decrement of a volatile long, returning the new value
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define XS_ATOMIC_INC(ptr) _InterlockedIncrement(ptr)
+#define XS_ATOMIC_DEC(ptr) _InterlockedDecrement(ptr)
+#else
+#define XS_ATOMIC_INC(ptr) __sync_add_and_fetch(ptr, 1)
+#define XS_ATOMIC_DEC(ptr) __sync_sub_and_fetch(ptr, 1)
+#endif
+
 #endif // __XMLSELECTOR_UTILS_H_INCLUDED__
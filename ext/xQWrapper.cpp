@@ -16,6 +16,12 @@
 #include "xQWrapper.h"
 #include "utils.h"
 #include "Node.h"
+#include "Document.h"
+#include "AsyncQuery.h"
+#include "ExternalString.h"
+#include "XmlStream.h"
+
+#include <string.h>
 
 static const char* _xqErrors[] = {
   "OK",
@@ -27,10 +33,12 @@ static const char* _xqErrors[] = {
   "Invalid selector",
   "internal error code",
   "Unknown namespace prefix",
+  "Operation cancelled",
+  "Error writing output",
   NULL
 };
 
-#define xQStatusString(code) ((code > 8) ? "Unknown error" : _xqErrors[code])
+#define xQStatusString(code) ((code > 10) ? "Unknown error" : _xqErrors[code])
 
 #define statusToException(code) \
   ThrowEx(xQStatusString(code))
@@ -38,13 +46,10 @@ static const char* _xqErrors[] = {
 #define assertStatusOK(code) \
   if ((code) != XQ_OK) statusToException(code);
 
-
-v8::Persistent<v8::Function> xQWrapper::constructor;
-
 /**
  * Initialize the class
  */
-void xQWrapper::Init(v8::Handle<v8::Object> exports) {
+void xQWrapper::Init(v8::Handle<v8::Object> exports, xmlselector::InstanceData* data) {
   // create a constructor function
   v8::Local<v8::FunctionTemplate> tpl = NanNew<v8::FunctionTemplate>(New);
   
@@ -54,15 +59,26 @@ void xQWrapper::Init(v8::Handle<v8::Object> exports) {
   // populate the prototype
   NanSetPrototypeTemplate(tpl, "addNamespace", FUNCTION_VALUE(AddNamespace));
   NanSetPrototypeTemplate(tpl, "attr", FUNCTION_VALUE(Attr));
+  NanSetPrototypeTemplate(tpl, "attrs", FUNCTION_VALUE(Attrs));
   NanSetPrototypeTemplate(tpl, "children", FUNCTION_VALUE(Children));
   NanSetPrototypeTemplate(tpl, "closest", FUNCTION_VALUE(Closest));
-  NanSetPrototypeTemplate(tpl, "forEach", FUNCTION_VALUE(ForEach));
+  NanSetPrototypeTemplate(tpl, "count", FUNCTION_VALUE(Count));
   NanSetPrototypeTemplate(tpl, "filter", FUNCTION_VALUE(Filter));
+  NanSetPrototypeTemplate(tpl, "filterAsync", FUNCTION_VALUE(FilterAsync));
   NanSetPrototypeTemplate(tpl, "search", FUNCTION_VALUE(Find));
-  NanSetPrototypeTemplate(tpl, "findIndex", FUNCTION_VALUE(FindIndex));
+  NanSetPrototypeTemplate(tpl, "searchAsync", FUNCTION_VALUE(FindAsync));
+  NanSetPrototypeTemplate(tpl, "findFirst", FUNCTION_VALUE(FindFirst));
+  NanSetPrototypeTemplate(tpl, "exists", FUNCTION_VALUE(Exists));
+  NanSetPrototypeTemplate(tpl, "extract", FUNCTION_VALUE(Extract));
+  NanSetPrototypeTemplate(tpl, "explain", FUNCTION_VALUE(Explain));
+  NanSetPrototypeTemplate(tpl, "has", FUNCTION_VALUE(Exists));
+  NanSetPrototypeTemplate(tpl, "is", FUNCTION_VALUE(Is));
+  NanSetPrototypeTemplate(tpl, "toArray", FUNCTION_VALUE(ToArray));
   NanSetPrototypeTemplate(tpl, "first", FUNCTION_VALUE(First));
   NanSetPrototypeTemplate(tpl, "last", FUNCTION_VALUE(Last));
+  NanSetPrototypeTemplate(tpl, "lastStats", FUNCTION_VALUE(LastStats));
   tpl->PrototypeTemplate()->SetAccessor(NanNew<v8::String>("length"), GetLength);
+  NanSetPrototypeTemplate(tpl, "names", FUNCTION_VALUE(Names));
   NanSetPrototypeTemplate(tpl, "next", FUNCTION_VALUE(Next));
   NanSetPrototypeTemplate(tpl, "nextAll", FUNCTION_VALUE(NextAll));
   NanSetPrototypeTemplate(tpl, "nextUntil", FUNCTION_VALUE(NextUntil));
@@ -74,14 +90,93 @@ void xQWrapper::Init(v8::Handle<v8::Object> exports) {
   NanSetPrototypeTemplate(tpl, "prevAll", FUNCTION_VALUE(PrevAll));
   NanSetPrototypeTemplate(tpl, "prevUntil", FUNCTION_VALUE(PrevUntil));
   NanSetPrototypeTemplate(tpl, "text", FUNCTION_VALUE(Text));
+  NanSetPrototypeTemplate(tpl, "texts", FUNCTION_VALUE(Texts));
   NanSetPrototypeTemplate(tpl, "xml", FUNCTION_VALUE(Xml));
+  NanSetPrototypeTemplate(tpl, "xmlToBuffer", FUNCTION_VALUE(XmlToBuffer));
+  NanSetPrototypeTemplate(tpl, "xmlToStream", FUNCTION_VALUE(XmlToStream));
+  NanSetPrototypeTemplate(tpl, "xmlAll", FUNCTION_VALUE(XmlAll));
+  NanSetPrototypeTemplate(tpl, "xmlEach", FUNCTION_VALUE(XmlEach));
+  NanSetPrototypeTemplate(tpl, "xmlAllToStream", FUNCTION_VALUE(XmlAllToStream));
   
   tpl->PrototypeTemplate()->SetIndexedPropertyHandler(GetIndex, SetIndex, QueryIndex, DeleteIndex, EnumIndicies);
 
   
   // export it
-  NanAssignPersistent(constructor, tpl->GetFunction());
+  NanAssignPersistent(data->xQConstructor, tpl->GetFunction());
+  NanAssignPersistent(data->nodesKey, NanNew<v8::String>("_nodes"));
   exports->Set(NanNew<v8::String>("xQ"), tpl->GetFunction());
+  exports->Set(NanNew<v8::String>("setParallelism"), FUNCTION_VALUE(SetParallelism));
+  exports->Set(NanNew<v8::String>("collectStats"), FUNCTION_VALUE(CollectStats));
+  exports->Set(NanNew<v8::String>("useSignatures"), FUNCTION_VALUE(UseSignatures));
+  exports->Set(NanNew<v8::String>("usePlanner"), FUNCTION_VALUE(UsePlanner));
+}
+
+/**
+ * Set the number of threads used by searches from this isolate and the
+ * minimum number of context nodes required before a search is split
+ * across them
+ */
+NAN_METHOD(xQWrapper::SetParallelism) {
+  NanScope();
+
+  xmlselector::InstanceData* data = xmlselector::InstanceData::Current();
+
+  if (args.Length() > 0 && !args[0]->IsUndefined())
+    data->parallelThreads = args[0]->Uint32Value() ? args[0]->Uint32Value() : 1;
+
+  if (args.Length() > 1 && !args[1]->IsUndefined())
+    data->parallelThreshold = args[1]->Uint32Value() ? args[1]->Uint32Value() : 1;
+
+  NanReturnUndefined();
+}
+
+/**
+ * Turn the collection of query statistics on or off for this isolate.
+ * Returns whether statistics were being collected before the call.
+ */
+NAN_METHOD(xQWrapper::CollectStats) {
+  NanScope();
+
+  xmlselector::InstanceData* data = xmlselector::InstanceData::Current();
+  bool previous = data->collectStats;
+
+  if (args.Length() > 0 && !args[0]->IsUndefined())
+    data->collectStats = args[0]->BooleanValue();
+
+  NanReturnValue(NanNew<v8::Boolean>(previous));
+}
+
+/**
+ * Turn the use of subtree signatures by searches on or off for this
+ * isolate. Returns whether they were being used before the call.
+ */
+NAN_METHOD(xQWrapper::UseSignatures) {
+  NanScope();
+
+  xmlselector::InstanceData* data = xmlselector::InstanceData::Current();
+  bool previous = data->useSignatures;
+
+  if (args.Length() > 0 && !args[0]->IsUndefined())
+    data->useSignatures = args[0]->BooleanValue();
+
+  NanReturnValue(NanNew<v8::Boolean>(previous));
+}
+
+/**
+ * Turn the planning of searches with document statistics on or off for
+ * this isolate. Returns whether searches were being planned before the
+ * call.
+ */
+NAN_METHOD(xQWrapper::UsePlanner) {
+  NanScope();
+
+  xmlselector::InstanceData* data = xmlselector::InstanceData::Current();
+  bool previous = data->usePlanner;
+
+  if (args.Length() > 0 && !args[0]->IsUndefined())
+    data->usePlanner = args[0]->BooleanValue();
+
+  NanReturnValue(NanNew<v8::Boolean>(previous));
 }
 
 /**
@@ -89,7 +184,7 @@ void xQWrapper::Init(v8::Handle<v8::Object> exports) {
  */
 v8::Local<v8::Object> xQWrapper::New(xQ* xq) {
   
-  v8::Local<v8::Object> retObj = NanNew(constructor)->NewInstance();
+  v8::Local<v8::Object> retObj = NanNew(xmlselector::InstanceData::Current()->xQConstructor)->NewInstance();
   if (retObj.IsEmpty()) return retObj;
 
   xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(retObj);
@@ -107,6 +202,40 @@ v8::Local<v8::Object> xQWrapper::New(xQ* xq) {
   return retObj;
 }
 
+/**
+ * Create a new wrapped xQWrapper for the results of an asynchronous
+ * query. The node objects are only created when they're first used, so
+ * the wrapper keeps a reference to the source of the query to hold its
+ * documents in memory until then.
+ */
+v8::Local<v8::Object> xQWrapper::New(xQ* xq, v8::Local<v8::Object> source) {
+  
+  v8::Local<v8::Object> retObj = NanNew(xmlselector::InstanceData::Current()->xQConstructor)->NewInstance();
+  if (retObj.IsEmpty()) return retObj;
+
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(retObj);
+  if (!obj) {
+    xQ_free(xq, 1);
+    return retObj;
+  }
+  
+  if (obj->_xq)
+    xQ_free(obj->_xq, 1);
+  
+  obj->_xq = xq;
+  retObj->DeleteHiddenValue(NanNew(xmlselector::InstanceData::Current()->nodesKey));
+  retObj->SetHiddenValue(NanNew<v8::String>("_source"), source);
+
+  return retObj;
+}
+
+/**
+ * Return the message for a libxq status code
+ */
+const char* xQWrapper::statusString(xQStatusCode code) {
+  return xQStatusString(code);
+}
+
 /**
  * Destructor
  */
@@ -114,6 +243,71 @@ xQWrapper::~xQWrapper() {
   if (_xq)
     xQ_free(_xq, 1);
   _xq = 0;
+  
+  if (_stats)
+    free(_stats);
+  _stats = 0;
+}
+
+/**
+ * Point the xQ at somewhere to record statistics for the query about to
+ * run, if statistics are being collected
+ */
+void xQWrapper::beginStats() {
+  _xq->stats = 0;
+  
+  if (!xmlselector::InstanceData::Current()->collectStats)
+    return;
+  
+  if (!_stats)
+    _stats = (xQStats*) calloc(1, sizeof(xQStats));
+  
+  _xq->stats = _stats;
+  _wrapNs = 0;
+}
+
+/**
+ * Point the xQ at the subtree signatures and statistics of its document
+ * for the search about to run, building those that are turned on the
+ * first time a search uses them, and give it the parallelism settings of
+ * this isolate
+ */
+void xQWrapper::attachIndexes() {
+  xmlselector::InstanceData* data = xmlselector::InstanceData::Current();
+  
+  xQ_setParallelism(_xq, data->parallelThreads, data->parallelThreshold);
+  _xq->signatures = 0;
+  _xq->docStats = 0;
+  
+  if ((!data->useSignatures && !data->usePlanner) || !xQ_length(_xq))
+    return;
+  
+  xmlDocPtr doc = _xq->context.list[0]->doc;
+  xmlselector::Document* document = doc ? (xmlselector::Document*) doc->_private : 0;
+  
+  if (!document)
+    return;
+  
+  if (data->useSignatures)
+    _xq->signatures = document->signatures();
+  if (data->usePlanner)
+    _xq->docStats = document->docStats();
+}
+
+/**
+ * Wrap the result of a query, timing the wrap when statistics are being
+ * collected for it
+ */
+v8::Local<v8::Object> xQWrapper::wrapResult(xQ* out) {
+  if (!_xq->stats)
+    return xQWrapper::New(out);
+  
+  uint64_t start = uv_hrtime();
+  v8::Local<v8::Object> wrapper = xQWrapper::New(out);
+  _wrapNs = (double) (uv_hrtime() - start);
+  
+  _xq->stats = 0;
+  return wrapper;
 }
 
 /**
@@ -131,14 +325,99 @@ void xQWrapper::shadowNodeList(v8::Local<v8::Object> wrapper) {
     list->Set(i, xmlselector::Node::New(node));
   }
   
-  wrapper->SetHiddenValue(NanNew<v8::String>("_nodes"), list);
+  wrapper->SetHiddenValue(NanNew(xmlselector::InstanceData::Current()->nodesKey), list);
+}
+
+/**
+ * Return the shadow node list of a wrapper, creating it first if the
+ * wrapper was created without one
+ */
+v8::Local<v8::Array> xQWrapper::nodeList(v8::Local<v8::Object> wrapper) {
+  v8::Local<v8::Value> list = wrapper->GetHiddenValue(NanNew(xmlselector::InstanceData::Current()->nodesKey));
+  
+  if (list.IsEmpty() || !list->IsArray()) {
+    xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(wrapper);
+    if (!obj)
+      return NanNew<v8::Array>(0);
+    
+    obj->shadowNodeList(wrapper);
+    list = wrapper->GetHiddenValue(NanNew(xmlselector::InstanceData::Current()->nodesKey));
+  }
+  
+  return v8::Local<v8::Array>::Cast(list);
+}
+
+/**
+ * Return the text content of a node as a JS string, read in place when
+ * it's held in a single node. Returns an empty handle if out of memory.
+ */
+static v8::Local<v8::String> nodeText(xmlNodePtr node) {
+  int len = 0;
+  
+  if (!node || !node->children)
+    return NanNew<v8::String>("");
+  
+  const xmlChar* ref = xQNode_getTextRef(node, &len);
+  if (ref)
+    return xmlselector::ExternalString::New(node, ref, len);
+  
+  xmlChar* txt = xQNode_getText(node, &len);
+  if (!txt)
+    return v8::Local<v8::String>();
+  
+  v8::Local<v8::String> retTxt = NanNew<v8::String>((const char*)txt, len);
+  
+  xmlFree(txt);
+  
+  return retTxt;
+}
+
+/**
+ * Return an array with the text content of every node in a list, or an
+ * empty handle if out of memory
+ */
+static v8::Local<v8::Array> nodeTexts(xQ* xq) {
+  uint32_t len = (uint32_t) xQ_length(xq);
+  v8::Local<v8::Array> list = NanNew<v8::Array>(len);
+  
+  for (uint32_t i = 0; i < len; i++) {
+    v8::Local<v8::String> txt = nodeText(xq->context.list[i]);
+    if (txt.IsEmpty())
+      return v8::Local<v8::Array>();
+    
+    list->Set(i, txt);
+  }
+  
+  return list;
+}
+
+/**
+ * Return the value of a node's attribute as a JS string, or undefined if
+ * the node doesn't have the attribute
+ */
+static v8::Local<v8::Value> nodeAttr(xmlNodePtr node, const xmlChar* name) {
+  int len = 0;
+  
+  const xmlChar* ref = xQNode_getAttrRef(node, name, &len);
+  if (ref)
+    return xmlselector::ExternalString::New(node, ref, len);
+  
+  xmlChar* txt = node ? xmlGetProp(node, name) : 0;
+  if (!txt)
+    return NanUndefined();
+  
+  v8::Local<v8::String> retTxt = NanNew<v8::String>((const char*)txt);
+  
+  xmlFree(txt);
+  
+  return retTxt;
 }
 
 /**
  * Utility routine to add a JS object to a node list
  */
 static _NAN_METHOD_RETURN_TYPE addToNodeList(xQ* q, v8::Local<v8::Value> val) {
-  v8::Local<v8::TypeSwitch> nodeType = v8::TypeSwitch::New(NanNew(xmlselector::Node::constructor_template));
+  v8::Local<v8::TypeSwitch> nodeType = v8::TypeSwitch::New(NanNew(xmlselector::InstanceData::Current()->nodeTemplate));
   
   if (val->IsObject() && nodeType->match(val)) {
     
@@ -231,17 +510,32 @@ NAN_METHOD(xQWrapper::Attr) {
   assertGotWrapper(obj);
   
   v8::String::Utf8Value name(args[0]->ToString());
-
-  xmlChar* txt = xQ_getAttr(obj->_xq, *name);
   
-  if (!txt)
+  if (!xQ_length(obj->_xq))
     NanReturnUndefined();
   
-  v8::Local<v8::String> retTxt = NanNew<v8::String>((const char*)txt);
+  NanReturnValue(nodeAttr(obj->_xq->context.list[0], (const xmlChar*) *name));
+}
+
+/**
+ * Return an array with the value of the named attribute for every node in
+ * the list. Nodes without the attribute give undefined.
+ */
+NAN_METHOD(xQWrapper::Attrs) {
+  NanScope();
   
-  xmlFree(txt);
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
   
-  NanReturnValue(retTxt);
+  v8::String::Utf8Value name(args[0]->ToString());
+  
+  uint32_t len = (uint32_t) xQ_length(obj->_xq);
+  v8::Local<v8::Array> list = NanNew<v8::Array>(len);
+  
+  for (uint32_t i = 0; i < len; i++)
+    list->Set(i, nodeAttr(obj->_xq->context.list[i], (const xmlChar*) *name));
+  
+  NanReturnValue(list);
 }
 
 /**
@@ -261,10 +555,11 @@ NAN_METHOD(xQWrapper::Children) {
     selectorStr = (xmlChar*) *selector;
 
   xQ* out = 0;
+  obj->beginStats();
   xQStatusCode result = xQ_children(obj->_xq, selectorStr, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -280,132 +575,315 @@ NAN_METHOD(xQWrapper::Closest) {
   v8::String::Utf8Value selector(args[0]->ToString());
   xQ* out = 0;
   
+  obj->beginStats();
   xQStatusCode result = xQ_closest(obj->_xq, (xmlChar*) *selector, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
- * Iterate over the items in this collection, passing each to a user-supplied callback
+ * Return a new xQ instance containing the nodes from this set that match
+ * the provided selector
  */
-NAN_METHOD(xQWrapper::ForEach) {
+NAN_METHOD(xQWrapper::Filter) {
   NanScope();
   
   xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
   assertGotWrapper(obj);
   
-  if (args.Length() < 1 || !args[0]->IsFunction())
-    NanReturnThis();
-
-  v8::Local<v8::Function> callback = v8::Local<v8::Function>::Cast(args[0]);
+  v8::String::Utf8Value selector(args[0]->ToString());
+  xQ* out = 0;
+  
+  obj->beginStats();
+  xQStatusCode result = xQ_filter(obj->_xq, (xmlChar*) *selector, &out);
+  assertStatusOK(result);
+  
+  NanReturnValue(obj->wrapResult(out));
+}
 
-  v8::Handle<v8::Object> thisArg;
-  if (args.Length() > 1 && args[1]->IsObject()) {
-    thisArg = v8::Local<v8::Object>::Cast(args[1]);
-  } else {
-    thisArg = NanGetCurrentContext()->Global();
-  }
+/**
+ * Filter the nodes in this set on a thread pool thread. The callback
+ * receives an error or a new xQ with the results. Returns a handle that
+ * can be used to cancel the query.
+ */
+NAN_METHOD(xQWrapper::FilterAsync) {
+  NanScope();
   
-  uint32_t len = (uint32_t) xQ_length(obj->_xq);
-  v8::Local<v8::Array> list = v8::Local<v8::Array>::Cast(args.This()->GetHiddenValue(NanNew<v8::String>("_nodes")));
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
   
-  v8::TryCatch tryBlock;
+  if (args.Length() < 2 || !args[1]->IsFunction())
+    ThrowEx("filterAsync requires a callback");
   
-  for (uint32_t i = 0; i < len; i++) {
-    const unsigned argc = 3;
-    v8::Local<v8::Value> argv[] = {list->Get(i), NanNew<v8::Integer>(i), args.This()};
-
-    callback->Call(thisArg, argc, argv);
-    
-    if (tryBlock.HasCaught())
-      ReThrowEx(tryBlock);
-  }
+  v8::String::Utf8Value selector(args[0]->ToString());
   
-  NanReturnThis();
+  v8::Local<v8::Object> handle = xmlselector::AsyncQuery::Queue(args.This(), obj->_xq, *selector, xQ_filter, v8::Local<v8::Function>::Cast(args[1]));
+  if (handle.IsEmpty())
+    NanReturnUndefined();
+  
+  NanReturnValue(handle);
 }
 
 /**
- * Return a new xQ instance containing the nodes from this set that match
- * the provided selector
+ * Search the nodes in this set for descendants matching the provided
+ * selector and return a new xQ with the results. The optional second and
+ * third arguments limit the number of results and how deep below each
+ * node the search looks.
  */
-NAN_METHOD(xQWrapper::Filter) {
+NAN_METHOD(xQWrapper::Find) {
   NanScope();
   
   xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
   assertGotWrapper(obj);
   
   v8::String::Utf8Value selector(args[0]->ToString());
+  unsigned long limit = (args.Length() > 1 && args[1]->IsNumber()) ? args[1]->Uint32Value() : 0;
+  unsigned int maxDepth = (args.Length() > 2 && args[2]->IsNumber()) ? args[2]->Uint32Value() : 0;
   xQ* out = 0;
   
-  xQStatusCode result = xQ_filter(obj->_xq, (xmlChar*) *selector, &out);
+  obj->attachIndexes();
+  obj->beginStats();
+  xQStatusCode result = xQ_findLimited(obj->_xq, (xmlChar*) *selector, limit, maxDepth, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
- * Search the nodes in this set for descendants matching the provided
- * selector and return a new xQ with the results
+ * Search the nodes in this set for the first descendant matching the
+ * provided selector and return a new xQ containing it, or an empty xQ.
+ * The search stops at the first match.
  */
-NAN_METHOD(xQWrapper::Find) {
+NAN_METHOD(xQWrapper::FindFirst) {
   NanScope();
   
   xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
   assertGotWrapper(obj);
   
   v8::String::Utf8Value selector(args[0]->ToString());
+  unsigned int maxDepth = (args.Length() > 1 && args[1]->IsNumber()) ? args[1]->Uint32Value() : 0;
   xQ* out = 0;
   
-  xQStatusCode result = xQ_find(obj->_xq, (xmlChar*) *selector, &out);
+  obj->attachIndexes();
+  obj->beginStats();
+  xQStatusCode result = xQ_findLimited(obj->_xq, (xmlChar*) *selector, 1, maxDepth, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
- * Iterate over the items in this collection, passing each to a
- * user-supplied callback. Returns the index of the first item in the
- * collection for which the user-supplied callback returns true. Returns
- * -1 if the callback does not return true for any item.
+ * Return the number of descendants of the nodes in this set that match
+ * the provided selector. The matches are counted, never stored or
+ * wrapped.
  */
-NAN_METHOD(xQWrapper::FindIndex) {
+NAN_METHOD(xQWrapper::Count) {
   NanScope();
   
   xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
   assertGotWrapper(obj);
   
-  if (args.Length() < 1 || !args[0]->IsFunction())
-    NanReturnValue(NanNew<v8::Integer>(-1));
+  v8::String::Utf8Value selector(args[0]->ToString());
+  unsigned long count = 0;
+  
+  obj->attachIndexes();
+  obj->beginStats();
+  xQStatusCode result = xQ_count(obj->_xq, (xmlChar*) *selector, &count);
+  obj->_xq->stats = 0;
+  assertStatusOK(result);
+  
+  NanReturnValue(NanNew<v8::Number>(count));
+}
 
-  v8::Local<v8::Function> callback = v8::Local<v8::Function>::Cast(args[0]);
+/**
+ * Return a description of how a selector is searched for in this set:
+ * its compiled steps, what each is expected to produce and produced, and
+ * the plan and indexes the search would use
+ */
+NAN_METHOD(xQWrapper::Explain) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  v8::String::Utf8Value selector(args[0]->ToString());
+  xmlChar* explanation = 0;
+  
+  obj->attachIndexes();
+  xQStatusCode result = xQ_explain(obj->_xq, (xmlChar*) *selector, &explanation);
+  assertStatusOK(result);
+  
+  v8::Local<v8::String> retTxt = NewUtf8Handle((const char*) explanation);
+  
+  xmlFree(explanation);
+  
+  NanReturnValue(retTxt);
+}
 
-  v8::Handle<v8::Object> thisArg;
-  if (args.Length() > 1 && args[1]->IsObject()) {
-    thisArg = v8::Local<v8::Object>::Cast(args[1]);
-  } else {
-    thisArg = NanGetCurrentContext()->Global();
+/**
+ * Search the nodes in this set for several selectors in a single pass.
+ * Takes an array of selectors and an array naming what to return for
+ * each: "text" for the text of the first match, "texts" for the text of
+ * every match or "nodes" for a new xQ of the matches. Returns an array of
+ * those values in the same order as the selectors.
+ */
+NAN_METHOD(xQWrapper::Extract) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  if (args.Length() < 2 || !args[0]->IsArray() || !args[1]->IsArray())
+    ThrowEx("extract requires arrays of selectors and result types");
+  
+  v8::Local<v8::Array> selectorList = v8::Local<v8::Array>::Cast(args[0]);
+  v8::Local<v8::Array> typeList = v8::Local<v8::Array>::Cast(args[1]);
+  uint32_t count = selectorList->Length();
+  
+  xmlChar** selectors = (xmlChar**) calloc(count + 1, sizeof(xmlChar*));
+  xQ** found = (xQ**) calloc(count + 1, sizeof(xQ*));
+  xQStatusCode result = (selectors && found) ? XQ_OK : XQ_OUT_OF_MEMORY;
+  
+  for (uint32_t i = 0; result == XQ_OK && i < count; i++) {
+    v8::String::Utf8Value selector(selectorList->Get(i)->ToString());
+    if (!(selectors[i] = xmlStrdup((xmlChar*) *selector)))
+      result = XQ_OUT_OF_MEMORY;
   }
   
-  uint32_t len = (uint32_t) xQ_length(obj->_xq);
-  v8::Local<v8::Array> list = v8::Local<v8::Array>::Cast(args.This()->GetHiddenValue(NanNew<v8::String>("_nodes")));
+  if (result == XQ_OK) {
+    obj->attachIndexes();
+    obj->beginStats();
+    result = xQ_extract(obj->_xq, (const xmlChar**) selectors, count, found);
+    obj->_xq->stats = 0;
+  }
   
-  v8::TryCatch tryBlock;
+  for (uint32_t i = 0; selectors && i < count; i++)
+    if (selectors[i])
+      xmlFree(selectors[i]);
+  free(selectors);
   
-  for (uint32_t i = 0; i < len; i++) {
-    const unsigned argc = 3;
-    v8::Local<v8::Value> argv[] = {list->Get(i), NanNew<v8::Integer>(i), args.This()};
-
-    v8::Local<v8::Value> result = callback->Call(thisArg, argc, argv);
+  v8::Local<v8::Array> values = NanNew<v8::Array>(count);
+  
+  for (uint32_t i = 0; result == XQ_OK && i < count; i++) {
+    v8::String::Utf8Value type(typeList->Get(i)->ToString());
+    v8::Local<v8::Value> value;
     
-    if (tryBlock.HasCaught())
-      ReThrowEx(tryBlock);
+    if (strcmp(*type, "nodes") == 0) {
+      value = xQWrapper::New(found[i]);
+      found[i] = 0;
+    } else if (strcmp(*type, "texts") == 0) {
+      value = nodeTexts(found[i]);
+    } else {
+      value = nodeText(xQ_length(found[i]) ? found[i]->context.list[0] : 0);
+    }
     
-    if (result->BooleanValue())
-      NanReturnValue(NanNew<v8::Integer>(i));
+    if (value.IsEmpty())
+      result = XQ_OUT_OF_MEMORY;
+    else
+      values->Set(i, value);
   }
   
-  NanReturnValue(NanNew<v8::Integer>(-1));
+  for (uint32_t i = 0; found && i < count; i++)
+    if (found[i])
+      xQ_free(found[i], 1);
+  free(found);
+  
+  assertStatusOK(result);
+  
+  NanReturnValue(values);
+}
+
+/**
+ * Return true if any descendant of the nodes in this set matches the
+ * provided selector. The search stops at the first match and builds no
+ * result.
+ */
+NAN_METHOD(xQWrapper::Exists) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  v8::String::Utf8Value selector(args[0]->ToString());
+  int found = 0;
+  
+  obj->attachIndexes();
+  obj->beginStats();
+  obj->_xq->maxDepth = (args.Length() > 1 && args[1]->IsNumber()) ? args[1]->Uint32Value() : 0;
+  
+  xQStatusCode result = xQ_exists(obj->_xq, (xmlChar*) *selector, &found);
+  
+  obj->_xq->maxDepth = 0;
+  obj->_xq->stats = 0;
+  assertStatusOK(result);
+  
+  NanReturnValue(NanNew<v8::Boolean>(found != 0));
+}
+
+/**
+ * Return true if any node in this set matches the provided selector.
+ * Matching stops at the first node that matches and builds no result.
+ */
+NAN_METHOD(xQWrapper::Is) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  v8::String::Utf8Value selector(args[0]->ToString());
+  int found = 0;
+  
+  obj->beginStats();
+  xQStatusCode result = xQ_is(obj->_xq, (xmlChar*) *selector, &found);
+  obj->_xq->stats = 0;
+  assertStatusOK(result);
+  
+  NanReturnValue(NanNew<v8::Boolean>(found != 0));
+}
+
+/**
+ * Search the nodes in this set for descendants matching the provided
+ * selector on a thread pool thread. The callback receives an error or a
+ * new xQ with the results. Returns a handle that can be used to cancel
+ * the query.
+ */
+NAN_METHOD(xQWrapper::FindAsync) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  if (args.Length() < 2 || !args[1]->IsFunction())
+    ThrowEx("searchAsync requires a callback");
+  
+  v8::String::Utf8Value selector(args[0]->ToString());
+  
+  obj->attachIndexes();
+  v8::Local<v8::Object> handle = xmlselector::AsyncQuery::Queue(args.This(), obj->_xq, *selector, xQ_find, v8::Local<v8::Function>::Cast(args[1]));
+  if (handle.IsEmpty())
+    NanReturnUndefined();
+  
+  NanReturnValue(handle);
+}
+
+/**
+ * Return a new Array containing the nodes in the list
+ */
+NAN_METHOD(xQWrapper::ToArray) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  uint32_t len = (uint32_t) xQ_length(obj->_xq);
+  v8::Local<v8::Array> list = nodeList(args.This());
+  v8::Local<v8::Array> result = NanNew<v8::Array>(len);
+  
+  for (uint32_t i = 0; i < len; i++)
+    result->Set(i, list->Get(i));
+  
+  NanReturnValue(result);
 }
 
 /**
@@ -440,6 +918,52 @@ NAN_METHOD(xQWrapper::Last) {
   NanReturnValue(xQWrapper::New(out));
 }
 
+/**
+ * Return the statistics recorded for the last query run against this set
+ * while statistics were being collected, or null if there are none
+ */
+NAN_METHOD(xQWrapper::LastStats) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  xQStats* stats = obj->_stats;
+  if (!stats)
+    NanReturnNull();
+  
+  v8::Local<v8::Array> steps = NanNew<v8::Array>(stats->steps);
+  
+  for (unsigned int i = 0; i < stats->steps; i++) {
+    xQStepStats* step = &(stats->step[i]);
+    v8::Local<v8::Object> stepObj = NanNew<v8::Object>();
+    
+    stepObj->Set(NanNew<v8::String>("operation"), NanNew<v8::String>(step->operation));
+    stepObj->Set(NanNew<v8::String>("calls"), NanNew<v8::Number>(step->calls));
+    stepObj->Set(NanNew<v8::String>("visited"), NanNew<v8::Number>(step->visited));
+    stepObj->Set(NanNew<v8::String>("produced"), NanNew<v8::Number>(step->produced));
+    stepObj->Set(NanNew<v8::String>("filtered"), NanNew<v8::Number>(step->visited > step->produced ? step->visited - step->produced : 0));
+    
+    steps->Set(i, stepObj);
+  }
+  
+  v8::Local<v8::Object> retObj = NanNew<v8::Object>();
+  
+  retObj->Set(NanNew<v8::String>("plan"), NewUtf8Handle(stats->plan));
+  retObj->Set(NanNew<v8::String>("steps"), steps);
+  retObj->Set(NanNew<v8::String>("contextSize"), NanNew<v8::Number>(stats->contextSize));
+  retObj->Set(NanNew<v8::String>("resultSize"), NanNew<v8::Number>(stats->resultSize));
+  retObj->Set(NanNew<v8::String>("allocations"), NanNew<v8::Number>(stats->allocations));
+  retObj->Set(NanNew<v8::String>("bytesAllocated"), NanNew<v8::Number>(stats->bytesAllocated));
+  retObj->Set(NanNew<v8::String>("signatureBytes"), NanNew<v8::Number>(stats->signatureBytes));
+  retObj->Set(NanNew<v8::String>("docStatsBytes"), NanNew<v8::Number>(stats->docStatsBytes));
+  retObj->Set(NanNew<v8::String>("compileMs"), NanNew<v8::Number>(stats->compileNs / 1e6));
+  retObj->Set(NanNew<v8::String>("evaluateMs"), NanNew<v8::Number>(stats->evalNs / 1e6));
+  retObj->Set(NanNew<v8::String>("wrapMs"), NanNew<v8::Number>(obj->_wrapNs / 1e6));
+  
+  NanReturnValue(retObj);
+}
+
 /**
  * Return the length/size/count of the xQ instance
  */
@@ -452,6 +976,31 @@ NAN_PROPERTY_GETTER(xQWrapper::GetLength) {
   NanReturnValue(NanNew<v8::Number>((double)xQ_length(obj->_xq)));
 }
 
+/**
+ * Return an array with the name of every node in the list. Nodes without
+ * a name (such as documents) give null.
+ */
+NAN_METHOD(xQWrapper::Names) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  uint32_t len = (uint32_t) xQ_length(obj->_xq);
+  v8::Local<v8::Array> list = NanNew<v8::Array>(len);
+  
+  for (uint32_t i = 0; i < len; i++) {
+    xmlNodePtr node = obj->_xq->context.list[i];
+    
+    if (node->name)
+      list->Set(i, xmlselector::ExternalString::New(node, node->name));
+    else
+      list->Set(i, NanNull());
+  }
+  
+  NanReturnValue(list);
+}
+
 /**
  * Return a new xQ instance containing the next immediate sibling of each
  * node in this set, optionally filtered by a selector
@@ -469,10 +1018,11 @@ NAN_METHOD(xQWrapper::Next) {
     selectorStr = (xmlChar*) *selector;
 
   xQ* out = 0;
+  obj->beginStats();
   xQStatusCode result = xQ_next(obj->_xq, selectorStr, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -492,10 +1042,11 @@ NAN_METHOD(xQWrapper::NextAll) {
     selectorStr = (xmlChar*) *selector;
 
   xQ* out = 0;
+  obj->beginStats();
   xQStatusCode result = xQ_nextAll(obj->_xq, selectorStr, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -511,10 +1062,11 @@ NAN_METHOD(xQWrapper::NextUntil) {
   v8::String::Utf8Value selector(args[0]->ToString());
   xQ* out = 0;
   
+  obj->beginStats();
   xQStatusCode result = xQ_nextUntil(obj->_xq, (xmlChar*) *selector, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -530,10 +1082,11 @@ NAN_METHOD(xQWrapper::Not) {
   v8::String::Utf8Value selector(args[0]->ToString());
   xQ* out = 0;
   
+  obj->beginStats();
   xQStatusCode result = xQ_not(obj->_xq, (xmlChar*) *selector, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -553,10 +1106,11 @@ NAN_METHOD(xQWrapper::Parent) {
     selectorStr = (xmlChar*) *selector;
 
   xQ* out = 0;
+  obj->beginStats();
   xQStatusCode result = xQ_parent(obj->_xq, selectorStr, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -576,10 +1130,11 @@ NAN_METHOD(xQWrapper::Parents) {
     selectorStr = (xmlChar*) *selector;
 
   xQ* out = 0;
+  obj->beginStats();
   xQStatusCode result = xQ_parents(obj->_xq, selectorStr, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -595,10 +1150,11 @@ NAN_METHOD(xQWrapper::ParentsUntil) {
   v8::String::Utf8Value selector(args[0]->ToString());
   xQ* out = 0;
   
+  obj->beginStats();
   xQStatusCode result = xQ_parentsUntil(obj->_xq, (xmlChar*) *selector, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -618,10 +1174,11 @@ NAN_METHOD(xQWrapper::Prev) {
     selectorStr = (xmlChar*) *selector;
 
   xQ* out = 0;
+  obj->beginStats();
   xQStatusCode result = xQ_prev(obj->_xq, selectorStr, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -641,10 +1198,11 @@ NAN_METHOD(xQWrapper::PrevAll) {
     selectorStr = (xmlChar*) *selector;
 
   xQ* out = 0;
+  obj->beginStats();
   xQStatusCode result = xQ_prevAll(obj->_xq, selectorStr, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
@@ -660,14 +1218,16 @@ NAN_METHOD(xQWrapper::PrevUntil) {
   v8::String::Utf8Value selector(args[0]->ToString());
   xQ* out = 0;
   
+  obj->beginStats();
   xQStatusCode result = xQ_prevUntil(obj->_xq, (xmlChar*) *selector, &out);
   assertStatusOK(result);
   
-  NanReturnValue(xQWrapper::New(out));
+  NanReturnValue(obj->wrapResult(out));
 }
 
 /**
- * Return the text content of the first node in the list
+ * Return the text content of the first node in the list. Text held in a
+ * single node is read in place rather than copied out of the document.
  */
 NAN_METHOD(xQWrapper::Text) {
   NanScope();
@@ -675,14 +1235,25 @@ NAN_METHOD(xQWrapper::Text) {
   xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
   assertGotWrapper(obj);
   
-  xmlChar* txt = xQ_getText(obj->_xq);
-  assertPointerValid(txt);
+  v8::Local<v8::String> retTxt = nodeText(xQ_length(obj->_xq) ? obj->_xq->context.list[0] : 0);
+  assertPointerValid(!retTxt.IsEmpty());
   
-  v8::Local<v8::String> retTxt = NanNew<v8::String>((const char*)txt);
+  NanReturnValue(retTxt);
+}
+
+/**
+ * Return an array with the text content of every node in the list
+ */
+NAN_METHOD(xQWrapper::Texts) {
+  NanScope();
   
-  xmlFree(txt);
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
   
-  NanReturnValue(retTxt);
+  v8::Local<v8::Array> list = nodeTexts(obj->_xq);
+  assertPointerValid(!list.IsEmpty());
+  
+  NanReturnValue(list);
 }
 
 /**
@@ -704,6 +1275,219 @@ NAN_METHOD(xQWrapper::Xml) {
   NanReturnValue(retTxt);
 }
 
+/**
+ * Free XML output owned by a Buffer once the Buffer is collected
+ */
+static void freeXmlOutput(char* data, void* hint) {
+  xmlFree(data);
+}
+
+/**
+ * Return the xml content of the first node in the list as a Buffer. The
+ * Buffer takes over libxml2's output rather than copying it.
+ */
+NAN_METHOD(xQWrapper::XmlToBuffer) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  xmlNodePtr node = xQ_length(obj->_xq) ? obj->_xq->context.list[0] : 0;
+  
+  if (!xQNode_hasXml(node))
+    NanReturnValue(NanNewBufferHandle(0));
+  
+  int len = 0;
+  xmlChar* txt = xQNode_getXml(node, &len);
+  assertPointerValid(txt);
+  
+  NanReturnValue(NanNewBufferHandle((char*) txt, len, freeXmlOutput, 0));
+}
+
+/**
+ * Serialize the first node in the list on a thread of its own, passing
+ * the XML to a callback in chunks: `xmlToStream(onChunk, onDone)`.
+ * onChunk receives each chunk as a Buffer and returns false to pause
+ * until the returned handle's resume() is called. onDone receives an
+ * error or null once the last chunk has been delivered.
+ */
+NAN_METHOD(xQWrapper::XmlToStream) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  if (args.Length() < 2 || !args[0]->IsFunction() || !args[1]->IsFunction())
+    ThrowEx("xmlToStream requires chunk and completion callbacks");
+  
+  xQNodeList first;
+  xmlNodePtr node = xQ_length(obj->_xq) ? obj->_xq->context.list[0] : 0;
+  
+  first.list = &node;
+  first.size = node ? 1 : 0;
+  first.capacity = 1;
+  first.countOnly = 0;
+  
+  v8::Local<v8::Object> handle = xmlselector::XmlStream::Queue(args.This(), &first, 0,
+    v8::Local<v8::Function>::Cast(args[0]), v8::Local<v8::Function>::Cast(args[1]));
+  if (handle.IsEmpty())
+    NanReturnUndefined();
+  
+  NanReturnValue(handle);
+}
+
+/**
+ * Return the xml content of every node in the list, joined by an
+ * optional separator: `xmlAll([separator[, asBuffer]])`. All of the nodes
+ * are written through one output buffer, and the result is a String or,
+ * if asBuffer is true, a Buffer that takes over the output.
+ */
+NAN_METHOD(xQWrapper::XmlAll) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  bool asBuffer = args.Length() > 1 && args[1]->BooleanValue();
+  
+  bool hasSeparator = args.Length() > 0 && !args[0]->IsUndefined() && !args[0]->IsNull();
+  v8::String::Utf8Value separator(hasSeparator ? args[0]->ToString() : NanNew<v8::String>(""));
+  
+  xmlBufferPtr buff = xmlBufferCreate();
+  xmlOutputBufferPtr out = buff ? xmlOutputBufferCreateBuffer(buff, 0) : 0;
+  xQStatusCode result = out ? XQ_OK : XQ_OUT_OF_MEMORY;
+  
+  if (out) {
+    result = xQNodeList_writeXml(&(obj->_xq->context), out, (const xmlChar*) *separator);
+    
+    if (xmlOutputBufferClose(out) < 0 && result == XQ_OK)
+      result = XQ_OUTPUT_ERROR;
+  }
+  
+  if (result != XQ_OK) {
+    if (buff)
+      xmlBufferFree(buff);
+    ThrowEx(statusString(result));
+  }
+  
+  int len = xmlBufferLength(buff);
+  v8::Local<v8::Value> retVal;
+  
+  if (asBuffer) {
+    xmlChar* txt = xmlBufferDetach(buff);
+    retVal = txt ?
+      NanNewBufferHandle((char*) txt, len, freeXmlOutput, 0) :
+      NanNewBufferHandle(0);
+  } else {
+    retVal = NanNew<v8::String>((const char*) xmlBufferContent(buff), len);
+  }
+  
+  xmlBufferFree(buff);
+  
+  NanReturnValue(retVal);
+}
+
+/**
+ * Call a function with the xml content of each node in the list, in
+ * order: `xmlEach(callback[, thisArg])`. The callback receives the XML as
+ * a String, its index and this set. One output buffer is reused for all
+ * of the nodes.
+ */
+NAN_METHOD(xQWrapper::XmlEach) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  if (args.Length() < 1 || !args[0]->IsFunction())
+    NanReturnThis();
+
+  v8::Local<v8::Function> callback = v8::Local<v8::Function>::Cast(args[0]);
+
+  v8::Handle<v8::Object> thisArg;
+  if (args.Length() > 1 && args[1]->IsObject()) {
+    thisArg = v8::Local<v8::Object>::Cast(args[1]);
+  } else {
+    thisArg = NanGetCurrentContext()->Global();
+  }
+  
+  xmlBufferPtr buff = xmlBufferCreate();
+  xmlOutputBufferPtr out = buff ? xmlOutputBufferCreateBuffer(buff, 0) : 0;
+  if (!out) {
+    if (buff)
+      xmlBufferFree(buff);
+    ThrowEx(statusString(XQ_OUT_OF_MEMORY));
+  }
+  
+  xQStatusCode result = XQ_OK;
+  v8::TryCatch tryBlock;
+  
+  for (uint32_t i = 0; result == XQ_OK && i < (uint32_t) xQ_length(obj->_xq); i++) {
+    xmlNodePtr node = obj->_xq->context.list[i];
+    
+    xmlBufferEmpty(buff);
+    
+    if (xQNode_hasXml(node))
+      result = xQNode_writeXml(node, out);
+    
+    if (result == XQ_OK && xmlOutputBufferFlush(out) < 0)
+      result = XQ_OUTPUT_ERROR;
+    
+    if (result != XQ_OK)
+      break;
+    
+    const unsigned argc = 3;
+    v8::Local<v8::Value> argv[] = {
+      NanNew<v8::String>((const char*) xmlBufferContent(buff), xmlBufferLength(buff)),
+      NanNew<v8::Integer>(i),
+      args.This()
+    };
+
+    callback->Call(thisArg, argc, argv);
+    
+    if (tryBlock.HasCaught()) {
+      xmlOutputBufferClose(out);
+      xmlBufferFree(buff);
+      ReThrowEx(tryBlock);
+    }
+  }
+  
+  xmlOutputBufferClose(out);
+  xmlBufferFree(buff);
+  
+  if (result != XQ_OK)
+    ThrowEx(statusString(result));
+  
+  NanReturnThis();
+}
+
+/**
+ * Serialize every node in the list on a thread of its own, joined by an
+ * optional separator, passing the XML to a callback in chunks:
+ * `xmlAllToStream(separator, onChunk, onDone)`. Chunks are delivered the
+ * same way as xmlToStream().
+ */
+NAN_METHOD(xQWrapper::XmlAllToStream) {
+  NanScope();
+  
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  assertGotWrapper(obj);
+  
+  if (args.Length() < 3 || !args[1]->IsFunction() || !args[2]->IsFunction())
+    ThrowEx("xmlAllToStream requires a separator and chunk and completion callbacks");
+  
+  bool hasSeparator = !args[0]->IsUndefined() && !args[0]->IsNull();
+  v8::String::Utf8Value separator(hasSeparator ? args[0]->ToString() : NanNew<v8::String>(""));
+  
+  v8::Local<v8::Object> handle = xmlselector::XmlStream::Queue(args.This(), &(obj->_xq->context), *separator,
+    v8::Local<v8::Function>::Cast(args[1]), v8::Local<v8::Function>::Cast(args[2]));
+  
+  if (handle.IsEmpty())
+    NanReturnUndefined();
+  
+  NanReturnValue(handle);
+}
+
 
 
 /**
@@ -712,7 +1496,17 @@ NAN_METHOD(xQWrapper::Xml) {
 NAN_INDEX_GETTER(xQWrapper::GetIndex) {
   NanScope();
   
-  v8::Local<v8::Array> list = v8::Local<v8::Array>::Cast(args.This()->GetHiddenValue(NanNew<v8::String>("_nodes")));
+  xQWrapper* obj = node::ObjectWrap::Unwrap<xQWrapper>(args.This());
+  if (!obj || index >= (uint32_t) xQ_length(obj->_xq))
+    NanReturnUndefined();
+  
+  // a node has at most one wrapper, so one that already exists is what
+  // the shadow list holds for it
+  xmlNodePtr node = obj->_xq->context.list[index];
+  if (node->_private)
+    NanReturnValue(NanObjectWrapHandle((xmlselector::Node*) node->_private));
+  
+  v8::Local<v8::Array> list = nodeList(args.This());
   
   NanReturnValue(list->Get(index));
 }
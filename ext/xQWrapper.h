@@ -20,31 +20,52 @@
 #include <nan.h>
 #include <libxq.h>
 
+#include "InstanceData.h"
+
 class xQWrapper : public node::ObjectWrap {
 public:
-  static void Init(v8::Handle<v8::Object> exports);
+  static void Init(v8::Handle<v8::Object> exports, xmlselector::InstanceData* data);
   
   static v8::Local<v8::Object> New(xQ* xq);
+  static v8::Local<v8::Object> New(xQ* xq, v8::Local<v8::Object> source);
+  
+  static const char* statusString(xQStatusCode code);
 
 protected:
-  xQWrapper() : _xq(0) { };
-  xQWrapper(xQ* val) : _xq(val) { };
+  xQWrapper() : _xq(0), _stats(0), _wrapNs(0) { };
+  xQWrapper(xQ* val) : _xq(val), _stats(0), _wrapNs(0) { };
   ~xQWrapper();
   
+  void beginStats();
+  void attachIndexes();
+  v8::Local<v8::Object> wrapResult(xQ* out);
+  
   void shadowNodeList(v8::Local<v8::Object> wrapper);
+  static v8::Local<v8::Array> nodeList(v8::Local<v8::Object> wrapper);
   
   static NAN_METHOD(New);
   static NAN_METHOD(AddNamespace);
   static NAN_METHOD(Attr);
+  static NAN_METHOD(Attrs);
   static NAN_METHOD(Children);
   static NAN_METHOD(Closest);
+  static NAN_METHOD(CollectStats);
+  static NAN_METHOD(Count);
   static NAN_METHOD(Filter);
+  static NAN_METHOD(FilterAsync);
   static NAN_METHOD(Find);
-  static NAN_METHOD(FindIndex);
+  static NAN_METHOD(FindAsync);
+  static NAN_METHOD(FindFirst);
+  static NAN_METHOD(Exists);
+  static NAN_METHOD(Extract);
+  static NAN_METHOD(Explain);
+  static NAN_METHOD(Is);
   static NAN_METHOD(First);
-  static NAN_METHOD(ForEach);
+  static NAN_METHOD(ToArray);
   static NAN_METHOD(Last);
+  static NAN_METHOD(LastStats);
   static NAN_PROPERTY_GETTER(GetLength);
+  static NAN_METHOD(Names);
   static NAN_METHOD(Next);
   static NAN_METHOD(NextAll);
   static NAN_METHOD(NextUntil);
@@ -55,8 +76,17 @@ protected:
   static NAN_METHOD(Prev);
   static NAN_METHOD(PrevAll);
   static NAN_METHOD(PrevUntil);
+  static NAN_METHOD(SetParallelism);
   static NAN_METHOD(Text);
+  static NAN_METHOD(Texts);
+  static NAN_METHOD(UsePlanner);
+  static NAN_METHOD(UseSignatures);
   static NAN_METHOD(Xml);
+  static NAN_METHOD(XmlToBuffer);
+  static NAN_METHOD(XmlToStream);
+  static NAN_METHOD(XmlAll);
+  static NAN_METHOD(XmlEach);
+  static NAN_METHOD(XmlAllToStream);
   
   static NAN_INDEX_GETTER(GetIndex);
   static NAN_INDEX_QUERY(QueryIndex);
@@ -64,9 +94,9 @@ protected:
   static NAN_INDEX_DELETER(DeleteIndex);
   static NAN_INDEX_ENUMERATOR(EnumIndicies);
   
-  static v8::Persistent<v8::Function> constructor;
-  
   xQ* _xq;
+  xQStats* _stats;
+  double _wrapNs;
 };
 
 #endif // __XQWRAPPER_H_INCLUDED__
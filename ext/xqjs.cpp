@@ -14,20 +14,54 @@
  * limitations under the License.
  */
 #include <node.h>
+#include <uv.h>
+#include <libxml/parser.h>
 #include <libxq.h>
+#include "InstanceData.h"
 #include "xQWrapper.h"
+#include "AsyncQuery.h"
+#include "XmlStream.h"
 #include "Document.h"
 #include "Element.h"
 #include "CharacterData.h"
 
 using namespace v8;
 
+static uv_once_t libxmlInitOnce = UV_ONCE_INIT;
+
+/**
+ * One-time libxml2 setup. This must complete before any isolate parses,
+ * since the library's global state isn't initialized lazily in a
+ * thread-safe way.
+ */
+static void initLibxml() {
+  xmlInitParser();
+}
+
+#if (NODE_MODULE_VERSION > NODE_0_10_MODULE_VERSION)
+void RegisterModule(Handle<Object> target, Handle<Value> module, Handle<Context> context, void* priv) {
+#else
 void RegisterModule(Handle<Object> target) {
-  xQWrapper::Init(target);
-  xmlselector::Node::Init(target);
-  xmlselector::Document::Init(target);
-  xmlselector::Element::Init(target);
-  xmlselector::CharacterData::Init(target);
+#endif
+  uv_once(&libxmlInitOnce, initLibxml);
+
+  xmlselector::InstanceData* data = xmlselector::InstanceData::Create(Isolate::GetCurrent());
+  if (!data) {
+    NanThrowError("Out of memory");
+    return;
+  }
+
+  xQWrapper::Init(target, data);
+  xmlselector::Node::Init(target, data);
+  xmlselector::Document::Init(target, data);
+  xmlselector::Element::Init(target, data);
+  xmlselector::CharacterData::Init(target, data);
+  xmlselector::AsyncQuery::Init(target, data);
+  xmlselector::XmlStream::Init(target, data);
 }
 
+#if (NODE_MODULE_VERSION > NODE_0_10_MODULE_VERSION)
+NODE_MODULE_CONTEXT_AWARE(xqjs, RegisterModule);
+#else
 NODE_MODULE(xqjs, RegisterModule);
+#endif
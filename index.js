@@ -17,15 +17,22 @@ var xqjs = require('bindings')('xqjs')
   , util = require('util')
 ;
 
-// Add JavaScript-based utility functions
+// Add JavaScript-based utility functions. Iteration works on the plain
+// Array returned by toArray(), so it runs at normal JS speed rather than
+// calling from native code back into JS for every node.
 
 /**
  * every function - returns true if all items pass a predicate
  */
 xqjs.xQ.prototype.every = function(predicate, context) {
-  return this.findIndex(function(n, idx, self) {
-    return ! (context ? predicate.call(context, n, idx, self) : predicate(n, idx, self));
-  }) === -1;
+  var nodes = this.toArray(), len = nodes.length;
+  
+  for (var i = 0; i < len; i++) {
+    if (! (context ? predicate.call(context, nodes[i], i, this) : predicate(nodes[i], i, this)))
+      return false;
+  }
+  
+  return true;
 }
 
 /**
@@ -36,12 +43,12 @@ xqjs.xQ.prototype.filter = function(selectorOrFilterFunc, context) {
 
   if ('function' == typeof selectorOrFilterFunc) {
     
-    var nodes = [];
+    var nodes = [], all = this.toArray(), len = all.length;
 
-    this.forEach(function(value, index, q) {
-      if (context ? selectorOrFilterFunc.call(context, value, index, q) : selectorOrFilterFunc(value, index, q))
-        nodes.push(value);
-    });
+    for (var i = 0; i < len; i++) {
+      if (context ? selectorOrFilterFunc.call(context, all[i], i, this) : selectorOrFilterFunc(all[i], i, this))
+        nodes.push(all[i]);
+    }
     
     return xQ(nodes);
     
@@ -54,6 +61,43 @@ xqjs.xQ.prototype.filter = function(selectorOrFilterFunc, context) {
 }
 
 
+/**
+ * findIndex function - returns the index of the first node that passes a
+ * predicate, or -1
+ */
+xqjs.xQ.prototype.findIndex = function(predicate, context) {
+  if ('function' != typeof predicate)
+    return -1;
+  
+  var nodes = this.toArray(), len = nodes.length;
+  
+  for (var i = 0; i < len; i++) {
+    if (context ? predicate.call(context, nodes[i], i, this) : predicate(nodes[i], i, this))
+      return i;
+  }
+  
+  return -1;
+}
+
+/**
+ * forEach function
+ */
+xqjs.xQ.prototype.forEach = function(iterator, context) {
+  if ('function' != typeof iterator)
+    return this;
+  
+  var nodes = this.toArray(), len = nodes.length;
+  
+  for (var i = 0; i < len; i++) {
+    if (context)
+      iterator.call(context, nodes[i], i, this);
+    else
+      iterator(nodes[i], i, this);
+  }
+  
+  return this;
+}
+
 /**
  * find function
  */
@@ -67,21 +111,207 @@ xqjs.xQ.prototype.find = function(selectorOrPredicate, context) {
     
   } else {
     
-    return this.search(selectorOrPredicate);
+    return this.search(selectorOrPredicate, context);
     
   }
 
 }
 
+/**
+ * Search with an optional options.limit on the number of results and
+ * options.maxDepth on how far below each node to look
+ */
+var _search = xqjs.xQ.prototype.search;
+xqjs.xQ.prototype.search = function(selector, options) {
+  
+  if (!options)
+    return _search.call(this, selector);
+  
+  return _search.call(this, selector, options.limit, options.maxDepth);
+}
+
+/**
+ * Search for the first match only, optionally within options.maxDepth
+ */
+var _findFirst = xqjs.xQ.prototype.findFirst;
+xqjs.xQ.prototype.findFirst = function(selector, options) {
+  return _findFirst.call(this, selector, options && options.maxDepth);
+}
+
+/**
+ * Check for any match, optionally within options.maxDepth
+ */
+var _exists = xqjs.xQ.prototype.exists;
+xqjs.xQ.prototype.exists = xqjs.xQ.prototype.has = function(selector, options) {
+  return _exists.call(this, selector, options && options.maxDepth);
+}
+
+/**
+ * Search for several selectors in a single pass. Takes an object mapping
+ * names to either a selector string, which yields the text of the first
+ * match, or an object {selector: ..., as: 'text' | 'texts' | 'nodes'},
+ * and returns an object with the results under the same names.
+ */
+var _extract = xqjs.xQ.prototype.extract;
+xqjs.xQ.prototype.extract = function(fields) {
+  var names = Object.keys(fields || {}), selectors = [], types = [];
+  
+  names.forEach(function(name) {
+    var field = fields[name];
+    
+    if ('string' == typeof field)
+      field = {selector: field};
+    
+    if (!field || 'string' != typeof field.selector)
+      throw new Error('No selector given for extract field ' + name);
+    
+    if (field.as && field.as != 'text' && field.as != 'texts' && field.as != 'nodes')
+      throw new Error('Unsupported result type for extract field ' + name + ': ' + field.as);
+    
+    selectors.push(field.selector);
+    types.push(field.as || 'text');
+  });
+  
+  var values = _extract.call(this, selectors, types), result = {};
+  
+  names.forEach(function(name, i) {
+    result[name] = values[i];
+  });
+  
+  return result;
+}
+
+/**
+ * Wrap a native asynchronous query method so it returns a promise when
+ * it's called without a callback. The promise has a cancel method that
+ * cancels the underlying query.
+ */
+function promisifyQuery(method) {
+  return function(selector, callback) {
+    
+    if ('function' == typeof callback || 'undefined' == typeof Promise)
+      return method.call(this, selector, callback);
+    
+    var self = this, query;
+    
+    var promise = new Promise(function(resolve, reject) {
+      query = method.call(self, selector, function(err, result) {
+        if (err)
+          reject(err);
+        else
+          resolve(result);
+      });
+    });
+    
+    promise.cancel = function() {
+      return query.cancel();
+    };
+    
+    return promise;
+  };
+}
+
+xqjs.xQ.prototype.searchAsync = promisifyQuery(xqjs.xQ.prototype.searchAsync);
+xqjs.xQ.prototype.filterAsync = promisifyQuery(xqjs.xQ.prototype.filterAsync);
+
+/**
+ * Pipe the chunks of a native xml stream into a writable stream, pausing
+ * the serializer whenever the writable stream asks for backpressure. The
+ * writable stream is ended once all of the XML has been written. Errors
+ * go to callback if one is given, otherwise they're emitted on the
+ * writable stream.
+ */
+function streamXml(start, stream, callback) {
+  var job, failed = false;
+  
+  function resume() {
+    job.resume();
+  }
+  
+  function stop() {
+    failed = true;
+    job.cancel();
+  }
+  
+  stream.on('error', stop);
+  stream.on('close', stop);
+  
+  job = start(function(chunk) {
+    if (stream.write(chunk))
+      return true;
+    
+    stream.once('drain', resume);
+    return false;
+  }, function(err) {
+    stream.removeListener('error', stop);
+    stream.removeListener('close', stop);
+    stream.removeListener('drain', resume);
+    
+    if (!err)
+      stream.end();
+    
+    if (callback)
+      callback(err || null);
+    else if (err && !failed)
+      stream.emit('error', err);
+  });
+  
+  return stream;
+}
+
+/**
+ * Write the xml of the first node to a writable stream
+ */
+var _xmlToStream = xqjs.xQ.prototype.xmlToStream;
+xqjs.xQ.prototype.xmlToStream = function(stream, callback) {
+  var self = this;
+  
+  return streamXml(function(onChunk, onDone) {
+    return _xmlToStream.call(self, onChunk, onDone);
+  }, stream, callback);
+}
+
+/**
+ * Serialize every node in the set, joined by options.separator. Returns a
+ * Buffer rather than a String when options.buffer is true.
+ */
+var _xmlAll = xqjs.xQ.prototype.xmlAll;
+xqjs.xQ.prototype.xmlAll = function(options) {
+  options = options || {};
+  
+  return _xmlAll.call(this, options.separator, !!options.buffer);
+}
+
+/**
+ * Pass the xml of every node in the set to a callback, or write all of it
+ * to a writable stream, joined by options.separator
+ */
+var _xmlEach = xqjs.xQ.prototype.xmlEach;
+xqjs.xQ.prototype.xmlEach = function(callbackOrStream, optionsOrThisArg, callback) {
+  
+  if ('function' == typeof callbackOrStream)
+    return _xmlEach.call(this, callbackOrStream, optionsOrThisArg);
+  
+  if ('function' == typeof optionsOrThisArg) {
+    callback = optionsOrThisArg;
+    optionsOrThisArg = undefined;
+  }
+  
+  var self = this, options = optionsOrThisArg || {};
+  
+  return streamXml(function(onChunk, onDone) {
+    return self.xmlAllToStream(options.separator, onChunk, onDone);
+  }, callbackOrStream, callback);
+}
+
 /**
  * map function
  */
 xqjs.xQ.prototype.map = function(iterator, context) {
-  var results = [];
+  var nodes = this.toArray(), len = nodes.length, results = new Array(len);
   
-  this.forEach(function(value, index, q) {
-    results.push(iterator.call(context, value, index, q));
-  });
+  for (var i = 0; i < len; i++)
+    results[i] = iterator.call(context, nodes[i], i, this);
   
   return results;
 }
@@ -90,9 +320,10 @@ xqjs.xQ.prototype.map = function(iterator, context) {
  * reduce function
  */
 xqjs.xQ.prototype.reduce = function(iterator, initialValue, context) {
-  this.forEach(function(value, index, q) {
-    initialValue = iterator.call(this, initialValue, value, index, q);
-  }, context);
+  var nodes = this.toArray(), len = nodes.length;
+  
+  for (var i = 0; i < len; i++)
+    initialValue = iterator.call(context, initialValue, nodes[i], i, this);
   
   return initialValue;
 }
@@ -101,10 +332,12 @@ xqjs.xQ.prototype.reduce = function(iterator, initialValue, context) {
  * reduceRight function
  */
 xqjs.xQ.prototype.reduceRight = function(iterator, initialValue, context) {
-  for (var index = this.length; index > 0; ) {
+  var nodes = this.toArray();
+  
+  for (var index = nodes.length; index > 0; ) {
     initialValue = context ?
-      iterator.call(context, initialValue, this[--index], index, this) :
-      iterator(initialValue, this[--index], index, this);
+      iterator.call(context, initialValue, nodes[--index], index, this) :
+      iterator(initialValue, nodes[--index], index, this);
   }
   
   return initialValue;
@@ -117,6 +350,15 @@ xqjs.xQ.prototype.some = function(predicate, thisArg) {
   return this.findIndex(predicate, thisArg) !== -1;
 }
 
+/**
+ * Make selector instances iterable with for...of and spread
+ */
+if ('undefined' != typeof Symbol && Symbol.iterator) {
+  xqjs.xQ.prototype[Symbol.iterator] = function() {
+    return this.toArray()[Symbol.iterator]();
+  }
+}
+
 
 /**
  * Wrap the native constructor with routines that normalize how it is
@@ -149,3 +391,17 @@ util.inherits(xQ, xqjs.xQ);
 
 module.exports = xQ;
 module.exports.parseFromString = xqjs.parseFromString;
+module.exports.setParallelism = xqjs.setParallelism;
+module.exports.collectStats = xqjs.collectStats;
+module.exports.useSignatures = xqjs.useSignatures;
+module.exports.usePlanner = xqjs.usePlanner;
+
+/**
+ * Describe how a selector is searched for in doc, which may be an XML
+ * string, a node or a set of nodes, or with no nodes if it's not given
+ */
+module.exports.explain = function(selector, doc) {
+  var set = doc instanceof xqjs.xQ ? doc : (doc === undefined ? xQ() : xQ(doc));
+  
+  return set.explain(selector);
+}
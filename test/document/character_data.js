@@ -43,3 +43,13 @@ module.exports['length - should return the character count for multi-byte encodi
   test.strictEqual(doc.documentElement.firstChild.length, 5);
   test.done();
 }
+
+/**
+ * data - should return comment and whitespace content
+ */
+module.exports['data - should return comment and whitespace content'] = function(test) {
+  var doc = $$.parseFromString("<doc><!-- note -->\n  <a/></doc>");
+  test.strictEqual(doc.documentElement.firstChild.data, " note ");
+  test.strictEqual(doc.documentElement.firstChild.nextSibling.data, "\n  ");
+  test.done();
+}
@@ -45,3 +45,31 @@ module.exports['tagName - should return the tag name for an element'] = function
   test.strictEqual(doc.documentElement.tagName, "doc");
   test.done();
 }
+
+/**
+ * getAttribute - should return values made of several parts
+ */
+module.exports['getAttribute - should return values made of several parts'] = function(test) {
+  var doc = $$.parseFromString("<!DOCTYPE doc [<!ENTITY e \"entity\">]><doc a=\"x &e; y\" b=\"café\"></doc>");
+  test.strictEqual(doc.documentElement.getAttribute("a"), "x entity y");
+  test.strictEqual(doc.documentElement.getAttribute("b"), "café");
+  test.done();
+}
+
+/**
+ * tagName - should return the same name for repeated and shared names
+ */
+module.exports['tagName - should return the same name for repeated and shared names'] = function(test) {
+  var doc = $$.parseFromString("<doc><item/><item/><élément/></doc>");
+  var names = [];
+  
+  for (var i = 0; i < 3; i++) {
+    for (var n = doc.documentElement.firstChild; n; n = n.nextSibling)
+      names.push(n.tagName + '/' + n.nodeName);
+  }
+  
+  test.deepEqual(names.slice(0, 3), ["item/item", "item/item", "élément/élément"]);
+  test.deepEqual(names.slice(3, 6), names.slice(0, 3));
+  test.deepEqual(names.slice(6), names.slice(0, 3));
+  test.done();
+}
@@ -48,3 +48,22 @@ module.exports['parseFromString exception - should contain the error details'] =
     test.done();
   }
 }
+
+/**
+ * parseFromString exception - should only contain errors from its own parse
+ */
+module.exports['parseFromString exception - should only contain errors from its own parse'] = function(test) {
+  try {
+    $$.parseFromString("<doc><item></doc>");
+  } catch(e) {
+    test.ok(/Opening and ending tag mismatch/.test(e.message));
+  }
+
+  try {
+    $$.parseFromString("<doc");
+  } catch(e) {
+    test.ok(/Couldn't find end of Start Tag/.test(e.message));
+    test.ok(!/Opening and ending tag mismatch/.test(e.message));
+    test.done();
+  }
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test the attrs() function
+ */
+
+var xQ = require('../index')
+
+/**
+ * Test attrs call on an empty set
+ */
+module.exports.testEmpty = function(test) {
+  var empty = new xQ();
+
+  test.deepEqual(empty.attrs("name"), []);
+  
+  test.done();
+}
+
+/**
+ * Test attrs call on multiple elements
+ */
+module.exports.testMultiple = function(test) {
+  var q = new xQ('<doc><people><person name="Fred" /><person /><person name="" /><person name="Ann &amp; Bob" /></people></doc>');
+  
+  test.deepEqual(q.find('person').attrs('name'), ['Fred', undefined, '', 'Ann & Bob']);
+  test.deepEqual(q.attrs('name'), [undefined]);
+  
+  test.done();
+}
+
+/**
+ * Test attrs agrees with attr for each node
+ */
+module.exports.testMatchesAttr = function(test) {
+  var q = new xQ('<doc><a id="1" /><b id="café" /><c /></doc>').find('*');
+  
+  test.deepEqual(q.attrs('id'), q.map(function(n) { return xQ(n).attr('id'); }));
+  
+  test.done();
+}
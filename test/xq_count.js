@@ -0,0 +1,53 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for the count() method
+ */
+
+var $$ = require('../index');
+
+/**
+ * Test count agrees with search
+ */
+module.exports.testCount = function(test) {
+  var doc = $$('<feed><entry><entry /></entry><entry type="a" /><other /></feed>');
+  
+  ['entry', 'entry entry', 'entry[type="a"]', 'feed > entry', '*', 'missing'].forEach(function(selector) {
+    test.strictEqual(doc.count(selector), doc.search(selector).length, selector);
+  });
+  
+  test.strictEqual(doc.count('entry'), 3);
+  test.strictEqual($$().count('entry'), 0);
+  
+  test.throws(function() {
+    doc.count('entry[');
+  });
+  
+  test.done();
+}
+
+/**
+ * Test counting from a set of several nodes
+ */
+module.exports.testCountSet = function(test) {
+  var entries = $$('<feed><entry><link /><link /></entry><entry><link /></entry></feed>').search('entry');
+  
+  test.strictEqual(entries.count('link'), 3);
+  test.strictEqual(entries.first().count('link'), 2);
+  
+  test.done();
+}
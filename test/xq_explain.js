@@ -0,0 +1,88 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for describing how searches run
+ */
+
+var $$ = require('../index');
+
+var xml = '<doc xmlns:a="urn:a"><section><item id="1" class="odd"><name>one</name></item>' +
+  '<item id="2"><name>two</name></item></section><a:section><item/></a:section></doc>';
+
+/**
+ * Test the steps and what they produced
+ */
+module.exports.testExplain = function(test) {
+  var doc = $$(xml);
+  var text = doc.explain('section > item[id=2] name');
+
+  // the time taken varies from run to run
+  test.strictEqual(text.replace(/in [0-9.]+ ms/, 'in 0 ms'),
+    '  findDescendantsByName(section), produced 2 of 8 visited\n' +
+    '  findChildrenByName(item), produced 3 of 3 visited, compiled with 1 filter\n' +
+    '    filterAttributeEquals(id, 2), produced 1 of 3 visited\n' +
+    '  findDescendantsByName(name), produced 1 of 1 visited\n' +
+    '  plan: scan, without document statistics\n' +
+    'indexes: none\n' +
+    'measured 1 result from 1 context node in 0 ms\n');
+
+  test.throws(function() { doc.explain('item['); });
+
+  test.done();
+}
+
+/**
+ * Test estimates from the document statistics and the plan they choose
+ */
+module.exports.testExplainWithPlanner = function(test) {
+  var doc = $$(xml);
+  var text;
+
+  $$.usePlanner(true);
+  text = doc.explain('item[id=2]');
+  $$.usePlanner(false);
+
+  test.ok(text.indexOf('  findDescendantsByName(item), estimated 3.0, ') === 0, text);
+  test.ok(text.indexOf('\n  plan: ') > 0, text);
+  test.ok(text.indexOf('\nindexes: document statistics\n') > 0, text);
+
+  test.done();
+}
+
+/**
+ * Test explaining with and without a document, and how prefixes resolve
+ */
+module.exports.testExplainDoc = function(test) {
+  var doc = $$(xml);
+
+  test.strictEqual($$.explain('item > name'),
+    '  findDescendantsByName(item)\n' +
+    '  findChildrenByName(name)\n' +
+    '  plan: scan, without document statistics\n' +
+    'indexes: none\n');
+
+  test.ok($$.explain('name', xml).indexOf('measured 2 results') > 0);
+  test.ok($$.explain('name', doc).indexOf('measured 2 results') > 0);
+  test.ok($$.explain('name', doc[0]).indexOf('measured 2 results') > 0);
+
+  test.ok(/prefix a is undeclared\n/.test($$.explain('a:section', doc)));
+  doc.addNamespace('a', 'urn:a');
+  test.ok(/prefix a is urn:a\n/.test($$.explain('a:section item', doc)));
+  test.ok(/search failed with status/.test($$.explain('x:item', doc)));
+
+  test.done();
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for the extract() method
+ */
+
+var $$ = require('../index');
+
+var xml = '<order id="7"><customer><name>Ann</name></customer>' +
+  '<items><item sku="a">Tea</item><item sku="b">Cake</item></items>' +
+  '<note /></order>';
+
+/**
+ * Test extracting fields agrees with separate searches
+ */
+module.exports.testExtract = function(test) {
+  var doc = $$(xml);
+  
+  var result = doc.extract({
+    name: 'customer > name',
+    first: 'item',
+    items: {selector: 'items item', as: 'texts'},
+    skus: {selector: 'item[sku="b"]', as: 'nodes'},
+    note: 'note',
+    missing: 'missing',
+    either: {selector: 'note, name', as: 'texts'}
+  });
+  
+  test.deepEqual(Object.keys(result), ['name', 'first', 'items', 'skus', 'note', 'missing', 'either']);
+  test.strictEqual(result.name, 'Ann');
+  test.strictEqual(result.first, doc.search('item').text());
+  test.deepEqual(result.items, ['Tea', 'Cake']);
+  test.strictEqual(result.skus.length, 1);
+  test.strictEqual(result.skus.attr('sku'), 'b');
+  test.strictEqual(result.note, '');
+  test.strictEqual(result.missing, '');
+  test.deepEqual(result.either, ['Ann', '']);
+  
+  test.deepEqual($$().extract({name: 'name'}), {name: ''});
+  test.deepEqual(doc.extract({}), {});
+  
+  test.done();
+}
+
+/**
+ * Test invalid fields and selectors
+ */
+module.exports.testExtractErrors = function(test) {
+  var doc = $$(xml);
+  
+  test.throws(function() {
+    doc.extract({name: 'name['});
+  });
+  
+  test.throws(function() {
+    doc.extract({name: {as: 'texts'}});
+  });
+  
+  test.throws(function() {
+    doc.extract({name: {selector: 'name', as: 'count'}});
+  });
+  
+  test.done();
+}
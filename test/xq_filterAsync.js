@@ -0,0 +1,61 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test filterAsync function
+ */
+
+var xQ = require('../index');
+var $$ = xQ;
+
+/**
+ * Test results match a synchronous filter
+ */
+module.exports.testMatchesFilter = function(test) {
+  var q = new xQ("<doc><items><number>1</number><number>2</number><string>foo</string><number>3</number></items></doc>");
+  
+  q.find('items *').filterAsync('number', function(err, result) {
+    test.ifError(err);
+    test.deepEqual(result.map(function(n) { return $$(n).text(); }), ['1', '2', '3']);
+    test.done();
+  });
+}
+
+/**
+ * Test attribute filtering
+ */
+module.exports.testAttribute = function(test) {
+  var q = new xQ('<doc><attrs><attr name="fruit"><value>Apple</value></attr><attr name="color"><value>Red</value></attr></attrs></doc>');
+  
+  q.find('attr').filterAsync('attr[name="color"]', function(err, result) {
+    test.ifError(err);
+    test.strictEqual(result.length, 1);
+    test.strictEqual(result.text(), 'Red');
+    test.done();
+  });
+}
+
+/**
+ * Test cancelling a query
+ */
+module.exports.testCancel = function(test) {
+  var q = new xQ("<doc><hello /></doc>");
+  
+  q.filterAsync('doc', function(err, result) {
+    test.strictEqual(err.message, 'Operation cancelled');
+    test.done();
+  }).cancel();
+}
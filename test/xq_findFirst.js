@@ -0,0 +1,72 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for the findFirst() and exists() methods
+ */
+
+var $$ = require('../index');
+
+var xml = '<doc><item id="1"><item id="2" /></item><item id="3" /></doc>';
+
+/**
+ * Test findFirst returns the first match in document order
+ */
+module.exports.testFindFirst = function(test) {
+  var doc = $$(xml);
+  
+  var first = doc.findFirst('item');
+  test.strictEqual(first.length, 1);
+  test.strictEqual(first.attr('id'), '1');
+  
+  test.strictEqual(doc.findFirst('item item').attr('id'), '2');
+  test.strictEqual(doc.findFirst('item[id="3"]').attr('id'), '3');
+  test.strictEqual(doc.findFirst('missing').length, 0);
+  test.strictEqual($$().findFirst('item').length, 0);
+  
+  test.done();
+}
+
+/**
+ * Test findFirst with a depth bound
+ */
+module.exports.testFindFirstMaxDepth = function(test) {
+  var doc = $$(xml).search('doc');
+  
+  test.strictEqual(doc.findFirst('item[id="2"]', {maxDepth: 1}).length, 0);
+  test.strictEqual(doc.findFirst('item[id="2"]', {maxDepth: 2}).length, 1);
+  
+  test.done();
+}
+
+/**
+ * Test exists
+ */
+module.exports.testExists = function(test) {
+  var doc = $$(xml);
+  
+  test.strictEqual(doc.exists('item'), true);
+  test.strictEqual(doc.exists('item[id="3"]'), true);
+  test.strictEqual(doc.exists('missing'), false);
+  test.strictEqual(doc.search('doc').exists('item[id="2"]', {maxDepth: 1}), false);
+  test.strictEqual($$().exists('item'), false);
+  
+  test.throws(function() {
+    doc.exists('item[');
+  });
+  
+  test.done();
+}
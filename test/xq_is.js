@@ -0,0 +1,61 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for the is() and has() methods
+ */
+
+var $$ = require('../index');
+
+var xml = '<doc><route name="a"><target /></route><route name="b" /><fallback /></doc>';
+
+/**
+ * Test is() matches nodes in the set itself
+ */
+module.exports.testIs = function(test) {
+  var routes = $$(xml).search('route');
+  
+  test.strictEqual(routes.is('route'), true);
+  test.strictEqual(routes.is('route[name="b"]'), true);
+  test.strictEqual(routes.is('route[name="c"]'), false);
+  test.strictEqual(routes.is('fallback'), false);
+  
+  // a matching descendant doesn't make the node itself match
+  test.strictEqual(routes.is('route target'), false);
+  
+  test.strictEqual($$().is('route'), false);
+  
+  test.throws(function() {
+    routes.is('route[');
+  });
+  
+  test.done();
+}
+
+/**
+ * Test has() looks at descendants
+ */
+module.exports.testHas = function(test) {
+  var routes = $$(xml).search('route');
+  
+  test.strictEqual(routes.has('target'), true);
+  test.strictEqual(routes.has('route'), false);
+  test.strictEqual(routes.first().has('target'), true);
+  test.strictEqual(routes.last().has('target'), false);
+  test.strictEqual($$(xml).has('route[name="b"]'), true);
+  
+  test.done();
+}
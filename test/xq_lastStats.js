@@ -0,0 +1,105 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test collectStats and lastStats functions
+ */
+
+var xQ = require('../index');
+
+var xml = '<doc><item type="a"/><item type="b"/><other/><item type="b"/></doc>';
+
+/**
+ * Test nothing is recorded while collection is off
+ */
+module.exports.testDisabled = function(test) {
+  var doc = new xQ(xml);
+  
+  test.strictEqual(xQ.collectStats(), false);
+  
+  doc.search('item');
+  test.strictEqual(doc.lastStats(), null);
+  
+  test.done();
+}
+
+/**
+ * Test the statistics recorded for a search
+ */
+module.exports.testSearch = function(test) {
+  var doc = new xQ(xml);
+  
+  test.strictEqual(xQ.collectStats(true), false);
+  
+  var result = doc.search('item[type="b"]');
+  var stats = doc.lastStats();
+  
+  test.strictEqual(xQ.collectStats(false), true);
+  
+  test.strictEqual(result.length, 2);
+  test.strictEqual(stats.plan, 'findDescendantsByName(item) -> filterAttributeEquals(type, b)');
+  test.strictEqual(stats.steps.length, 2);
+  
+  test.strictEqual(stats.steps[0].operation, 'findDescendantsByName');
+  test.strictEqual(stats.steps[0].calls, 1);
+  test.strictEqual(stats.steps[0].produced, 3);
+  test.strictEqual(stats.steps[0].filtered, stats.steps[0].visited - 3);
+  
+  test.strictEqual(stats.steps[1].operation, 'filterAttributeEquals');
+  test.strictEqual(stats.steps[1].calls, 3);
+  test.strictEqual(stats.steps[1].visited, 3);
+  test.strictEqual(stats.steps[1].produced, 2);
+  test.strictEqual(stats.steps[1].filtered, 1);
+  
+  test.strictEqual(stats.contextSize, 1);
+  test.strictEqual(stats.resultSize, 2);
+  test.ok(stats.allocations > 0);
+  test.ok(stats.bytesAllocated > 0);
+  test.ok(stats.compileMs >= 0);
+  test.ok(stats.evaluateMs >= 0);
+  test.ok(stats.wrapMs >= 0);
+  
+  // the result hasn't run a query of its own
+  test.strictEqual(result.lastStats(), null);
+  
+  test.done();
+}
+
+/**
+ * Test the last query replaces earlier statistics
+ */
+module.exports.testLastQuery = function(test) {
+  var items = new xQ(xml).search('item');
+  
+  xQ.collectStats(true);
+  
+  items.filter('item[type="a"]');
+  items.next('other');
+  
+  xQ.collectStats(false);
+  
+  var stats = items.lastStats();
+  
+  test.strictEqual(stats.plan, 'filterByName(other)');
+  test.strictEqual(stats.contextSize, 3);
+  test.strictEqual(stats.resultSize, 1);
+  
+  // statistics survive turning collection off
+  items.search('*');
+  test.strictEqual(items.lastStats().plan, 'filterByName(other)');
+  
+  test.done();
+}
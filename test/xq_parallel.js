@@ -0,0 +1,111 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for parallel searching
+ */
+
+var $$ = require('../index');
+
+function buildDoc(count) {
+  var xml = ['<doc>'];
+  for (var i = 0; i < count; ++i) {
+    xml.push('<item><name>', i, '</name>');
+    if (i % 3 === 0)
+      xml.push('<group><name>nested ', i, '</name></group>');
+    xml.push('</item>');
+  }
+  xml.push('</doc>');
+  return xml.join('');
+}
+
+/**
+ * Test that a parallel search returns the same nodes in the same order
+ */
+module.exports.testParallelMatchesSerial = function(test) {
+  var items = $$(buildDoc(2000)).search('item');
+
+  $$.setParallelism(1);
+  var serial = items.search('name');
+  var serialNested = items.search('group name');
+
+  $$.setParallelism(4, 16);
+  var parallel = items.search('name');
+  var parallelNested = items.search('group name');
+
+  $$.setParallelism(1, 1024);
+
+  test.strictEqual(parallel.length, serial.length);
+  test.strictEqual(parallelNested.length, serialNested.length);
+
+  for (var i = 0; i < serial.length; ++i)
+    test.strictEqual(parallel[i].firstChild.data, serial[i].firstChild.data);
+
+  for (var i = 0; i < serialNested.length; ++i)
+    test.strictEqual(parallelNested[i].firstChild.data, serialNested[i].firstChild.data);
+
+  test.done();
+}
+
+/**
+ * Test that a search from a single large document is split by subtree
+ * and still returns the nodes of a serial search in order
+ */
+module.exports.testParallelSubtreeScan = function(test) {
+  var doc = $$(buildDoc(5000));
+
+  $$.setParallelism(1);
+  var serial = doc.search('name');
+  var serialAll = doc.search('*');
+
+  $$.setParallelism(4, 16);
+  var parallel = doc.search('name');
+  var parallelAll = doc.search('*');
+
+  $$.setParallelism(1, 1024);
+
+  test.strictEqual(parallel.length, serial.length);
+  test.strictEqual(parallelAll.length, serialAll.length);
+
+  for (var i = 0; i < serial.length; ++i)
+    test.strictEqual(parallel[i].firstChild.data, serial[i].firstChild.data);
+
+  for (var i = 0; i < serialAll.length; ++i)
+    test.strictEqual(parallelAll[i].nodeName, serialAll[i].nodeName);
+
+  test.done();
+}
+
+/**
+ * Test that an async search keeps the setting in effect when it's queued,
+ * even if the setting changes while it runs
+ */
+module.exports.testParallelAsync = function(test) {
+  var doc = $$(buildDoc(5000));
+  var serial = doc.search('name');
+
+  $$.setParallelism(4, 16);
+  doc.searchAsync('name', function(err, parallel) {
+    test.ifError(err);
+    test.strictEqual(parallel.length, serial.length);
+
+    for (var i = 0; i < serial.length; ++i)
+      test.strictEqual(parallel[i].firstChild.data, serial[i].firstChild.data);
+
+    test.done();
+  });
+  $$.setParallelism(1, 1024);
+}
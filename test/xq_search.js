@@ -123,3 +123,105 @@ module.exports.testUnmatchedSelector = function(test) {
   
   test.done();
 }
+
+/**
+ * Test searching with a selector group
+ */
+module.exports.testGroup = function(test) {
+  var doc = $$("<doc><b>1</b><a>2<c>3</c></a><c>4</c></doc>");
+  
+  var names = function(n) { return n.nodeName; };
+  
+  test.deepEqual(doc.search('c, a, b').map(names), ['b','a','c','c']);
+  test.deepEqual(doc.search('c, a c').map(names), ['c','c']);
+  test.deepEqual(doc.search('a > c, b').map(names), ['b','c']);
+  test.strictEqual(doc.search('c, missing', {limit: 1}).length, 1);
+  test.strictEqual(doc.search('*').filter('b, c').length, 3);
+  
+  test.throws(function() { doc.search('a,'); });
+  test.throws(function() { doc.search(', a'); });
+  
+  test.done();
+}
+
+/**
+ * Test searching with the attribute operators
+ */
+module.exports.testAttributeOperators = function(test) {
+  var doc = $$('<doc><a id="1" rel="next prev" href="http://x/a.png" n="10" />' +
+    '<a id="2" rel="nextprev" href="https://x/b.jpg" n="2.5" /><a id="3" n="x" /></doc>');
+  var ids = function(selector) {
+    return doc.search(selector).map(function(n) { return n.getAttribute('id'); });
+  };
+  
+  test.deepEqual(ids('a[rel]'), ['1', '2']);
+  test.deepEqual(ids('a[href^="https:"]'), ['2']);
+  test.deepEqual(ids('a[href$=".png"]'), ['1']);
+  test.deepEqual(ids('a[href*="x/"]'), ['1', '2']);
+  test.deepEqual(ids('a[rel~=prev]'), ['1']);
+  test.deepEqual(ids('a[n>3]'), ['1']);
+  test.deepEqual(ids('a[n<3]'), ['2']);
+  test.deepEqual(ids('a[rel][n>0]'), ['1', '2']);
+  test.deepEqual(doc.search('a').filter('a[n<100]').length, 2);
+  
+  test.throws(function() { doc.search('a[n>big]'); });
+  test.throws(function() { doc.search('a[rel~]'); });
+  
+  test.done();
+}
+
+/**
+ * Test the text pseudos
+ */
+module.exports.testTextPseudos = function(test) {
+  var doc = $$('<doc><p id="1">ab<b>cd</b></p><p id="2"><![CDATA[a(b)]]></p><p id="3"/></doc>');
+  var ids = function(selector) {
+    return doc.search(selector).map(function(n) { return n.getAttribute('id'); });
+  };
+  
+  test.deepEqual(ids('p:contains(bc)'), ['1']);
+  test.deepEqual(ids('p:contains("(b)")'), ['2']);
+  test.deepEqual(ids('p:contains("")'), ['1', '2', '3']);
+  test.deepEqual(ids('p:text(abcd)'), ['1']);
+  test.deepEqual(ids('p:text(abc)'), []);
+  test.deepEqual(ids('p[id]:text("")'), ['3']);
+  test.strictEqual(doc.search('p:contains(c) > b').text(), 'cd');
+  
+  test.throws(function() { doc.search('p:contains(a'); });
+  test.throws(function() { doc.search('p:first(a)'); });
+  
+  test.done();
+}
+
+/**
+ * Test the limit option
+ */
+module.exports.testLimit = function(test) {
+  var items = $$("<doc><items><item>1</item><item>2</item><item>3</item></items></doc>");
+  
+  test.strictEqual(items.search('item', {limit: 2}).length, 2);
+  test.strictEqual(items.search('item', {limit: 2}).text(), '1');
+  test.strictEqual(items.search('item', {limit: 5}).length, 3);
+  test.strictEqual(items.search('item', {limit: 0}).length, 3);
+  test.strictEqual(items.search('item', {}).length, 3);
+  
+  // the limit applies to the matches, not the nodes examined on the way
+  test.strictEqual(items.search('items item', {limit: 1}).text(), '1');
+  
+  test.done();
+}
+
+/**
+ * Test the maxDepth option
+ */
+module.exports.testMaxDepth = function(test) {
+  var doc = $$("<doc><a><a><a /></a></a></doc>").search('doc');
+  
+  test.strictEqual(doc.search('a', {maxDepth: 1}).length, 1);
+  test.strictEqual(doc.search('a', {maxDepth: 2}).length, 2);
+  test.strictEqual(doc.search('a').length, 3);
+  test.strictEqual(doc.search('a a', {maxDepth: 2}).length, 1);
+  test.strictEqual(doc.search('a', {maxDepth: 3, limit: 1}).length, 1);
+  
+  test.done();
+}
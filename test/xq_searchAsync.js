@@ -0,0 +1,110 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test searchAsync function
+ */
+
+var xQ = require('../index');
+var $$ = xQ;
+
+/**
+ * Test results match a synchronous search
+ */
+module.exports.testMatchesSearch = function(test) {
+  var q = new xQ("<doc><items><number>1</number><number>2</number><string>foo</string><number>3</number></items></doc>");
+  
+  q.searchAsync('items number', function(err, result) {
+    test.ifError(err);
+    test.strictEqual(result.length, 3);
+    test.deepEqual(result.map(function(n) { return $$(n).text(); }), ['1', '2', '3']);
+    test.strictEqual(result[1], q.search('items number')[1]);
+    test.done();
+  });
+}
+
+/**
+ * Test an invalid selector is reported to the callback
+ */
+module.exports.testInvalidSelector = function(test) {
+  var q = new xQ("<doc><hello /></doc>");
+  
+  q.searchAsync('hello[', function(err, result) {
+    test.ok(err instanceof Error);
+    test.strictEqual(result, undefined);
+    test.done();
+  });
+}
+
+/**
+ * Test cancelling a query
+ */
+module.exports.testCancel = function(test) {
+  var q = new xQ("<doc><hello /></doc>");
+  
+  var query = q.searchAsync('hello', function(err, result) {
+    test.ok(err instanceof Error);
+    test.strictEqual(err.message, 'Operation cancelled');
+    test.strictEqual(query.cancel(), false);
+    test.done();
+  });
+  
+  test.strictEqual(query.cancel(), true);
+}
+
+/**
+ * Test the document outlives the selector that started the query
+ */
+module.exports.testKeepsDocument = function(test) {
+  new xQ("<doc><hello>world</hello></doc>").searchAsync('hello', function(err, result) {
+    test.ifError(err);
+    
+    if (global.gc)
+      global.gc();
+    
+    test.strictEqual(result.text(), 'world');
+    test.strictEqual(result[0].ownerDocument.documentElement.nodeName, 'doc');
+    test.done();
+  });
+  
+  if (global.gc)
+    global.gc();
+}
+
+/**
+ * Test promise results
+ */
+module.exports.testPromise = function(test) {
+  if (typeof Promise == 'undefined')
+    return test.done();
+  
+  var q = new xQ("<doc><hello /><hello /></doc>");
+  
+  q.searchAsync('hello').then(function(result) {
+    test.strictEqual(result.length, 2);
+    
+    var cancelled = q.searchAsync('hello');
+    cancelled.cancel();
+    
+    return cancelled.then(function() {
+      test.ok(false, 'cancelled query resolved');
+    }, function(err) {
+      test.strictEqual(err.message, 'Operation cancelled');
+    });
+  }).then(function() {
+    test.done();
+  });
+}
@@ -52,3 +52,48 @@ module.exports.testMultipleDescendants = function(test) {
   
   test.done();
 }
+
+/**
+ * Test CDATA and mixed text and CDATA content
+ */
+module.exports.testCData = function(test) {
+  var q = new xQ("<doc><a><![CDATA[1 < 2]]></a><b>x<![CDATA[<y>]]>z</b></doc>");
+  
+  test.strictEqual(q.find('a').text(), "1 < 2");
+  test.strictEqual(q.find('b').text(), "x<y>z");
+  
+  test.done();
+}
+
+/**
+ * Test large text payloads, which are read from the document in place
+ */
+module.exports.testLarge = function(test) {
+  var ascii = new Array(10001).join('0123456789')
+    , utf8 = new Array(10001).join('café ☃ ')
+    , q = new xQ("<doc><a>" + ascii + "</a><b>" + utf8 + "</b><c><![CDATA[" + ascii + "]]></c></doc>");
+  
+  test.strictEqual(q.find('a').text(), ascii);
+  test.strictEqual(q.find('b').text(), utf8);
+  test.strictEqual(q.find('c').text(), ascii);
+  
+  test.done();
+}
+
+/**
+ * Test text remains valid after the document has been collected
+ */
+module.exports.testOutlivesDocument = function(test) {
+  var ascii = new Array(10001).join('0123456789')
+    , txt = new xQ("<doc><a>" + ascii + "</a></doc>").find('a').text();
+  
+  if (global.gc)
+    global.gc();
+  
+  new xQ("<doc><a>" + new Array(10001).join('9876543210') + "</a></doc>").find('a').text();
+  
+  test.strictEqual(txt.length, ascii.length);
+  test.strictEqual(txt, ascii);
+  
+  test.done();
+}
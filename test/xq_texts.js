@@ -0,0 +1,54 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test the texts() function
+ */
+
+var xQ = require('../index');
+
+/**
+ * Test an empty set
+ */
+module.exports.testEmpty = function(test) {
+  var empty = new xQ();
+  
+  test.deepEqual(empty.texts(), []);
+  
+  test.done();
+}
+
+/**
+ * Test multiple elements
+ */
+module.exports.testMultiple = function(test) {
+  var q = new xQ("<doc><p>one</p><p></p><p>t<b>w</b>o</p><p><![CDATA[<three>]]></p></doc>");
+  
+  test.deepEqual(q.find('p').texts(), ['one', '', 'two', '<three>']);
+  
+  test.done();
+}
+
+/**
+ * Test texts agrees with text for each node
+ */
+module.exports.testMatchesText = function(test) {
+  var q = new xQ("<doc><a>café</a><b>" + new Array(1001).join('x') + "</b><c/></doc>").find('*');
+  
+  test.deepEqual(q.texts(), q.map(function(n) { return xQ(n).text(); }));
+  
+  test.done();
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test toArray function and iteration
+ */
+
+var xQ = require('../index');
+
+/**
+ * Test empty set
+ */
+module.exports.testEmpty = function(test) {
+  var arr = new xQ().toArray();
+  
+  test.ok(Array.isArray(arr));
+  test.strictEqual(arr.length, 0);
+  
+  test.done();
+}
+
+/**
+ * Test the array holds the same nodes as indexed access
+ */
+module.exports.testNodes = function(test) {
+  var people = new xQ('<doc><person name="Fred" /><person name="Sally" /></doc>').search('person');
+  var arr = people.toArray();
+  
+  test.strictEqual(arr.length, 2);
+  test.strictEqual(arr[0], people[0]);
+  test.strictEqual(arr[1], people[1]);
+  
+  // changing the array doesn't change the set
+  arr.pop();
+  test.strictEqual(people.length, 2);
+  test.strictEqual(people.toArray().length, 2);
+  
+  test.done();
+}
+
+/**
+ * Test for...of iteration where it's supported
+ */
+module.exports.testIterator = function(test) {
+  var people = new xQ('<doc><person name="Fred" /><person name="Sally" /></doc>').search('person');
+  
+  if ('undefined' == typeof Symbol || !Symbol.iterator) {
+    test.done();
+    return;
+  }
+  
+  var it = people[Symbol.iterator](), names = [], step;
+  while (!(step = it.next()).done)
+    names.push(step.value.getAttribute('name'));
+  
+  test.deepEqual(names, ['Fred', 'Sally']);
+  
+  test.done();
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for searching with planned seeks
+ */
+
+var $$ = require('../index');
+
+function buildDoc(sections, items) {
+  var xml = ['<doc><part><part>'];
+  for (var i = 0; i < sections; ++i) {
+    xml.push('<section>');
+    for (var j = 0; j < items; ++j) {
+      xml.push('<item id="i', i, '-', j, '" class="', j % 2 ? 'odd' : 'even', '"><name>', i, '.', j, '</name>');
+      if (i === sections - 1 && j === 0)
+        xml.push('<rare>found</rare>');
+      xml.push('</item>');
+    }
+    xml.push('</section>');
+  }
+  xml.push('</part></part></doc>');
+  return xml.join('');
+}
+
+/**
+ * Test turning the planner on and off
+ */
+module.exports.testUsePlanner = function(test) {
+  test.strictEqual($$.usePlanner(), false);
+  test.strictEqual($$.usePlanner(true), false);
+  test.strictEqual($$.usePlanner(), true);
+  test.strictEqual($$.usePlanner(false), true);
+  test.strictEqual($$.usePlanner(), false);
+  
+  test.done();
+}
+
+/**
+ * Test that planned searches find the same nodes, in the same order
+ */
+module.exports.testSearchWithPlanner = function(test) {
+  var doc = $$(buildDoc(50, 20));
+  var selectors = [
+    'rare', 'section item rare', 'item > rare', 'item[id="i7-3"]', '*[id="i7-3"]',
+    'section > item[class=odd] + item[id="i49-2"]', 'item name', 'part rare',
+    'missing', 'rare, name', 'item[class=odd][id="i3-3"]'
+  ];
+  var plain, planned;
+  
+  for (var i = 0; i < selectors.length; ++i) {
+    plain = doc.search(selectors[i]);
+    
+    $$.usePlanner(true);
+    planned = doc.search(selectors[i]);
+    test.strictEqual(doc.count(selectors[i]), plain.length, selectors[i]);
+    test.strictEqual(doc.exists(selectors[i]), plain.length > 0, selectors[i]);
+    $$.usePlanner(false);
+    
+    test.strictEqual(planned.length, plain.length, selectors[i]);
+    for (var j = 0; j < plain.length; ++j)
+      test.strictEqual(planned[j], plain[j], selectors[i]);
+  }
+  
+  test.done();
+}
+
+/**
+ * Test that the statistics show the seek and the work it saved
+ */
+module.exports.testPlannerStats = function(test) {
+  var doc = $$(buildDoc(50, 20));
+  var stats;
+  
+  $$.collectStats(true);
+  
+  doc.search('section item rare');
+  test.strictEqual(doc.lastStats().docStatsBytes, 0);
+  test.strictEqual(doc.lastStats().plan.indexOf(' via '), -1);
+  
+  $$.usePlanner(true);
+  test.strictEqual(doc.search('section item rare').text(), 'found');
+  stats = doc.lastStats();
+  test.ok(stats.docStatsBytes > 0);
+  test.ok(/ via nameSeek\(rare\)$/.test(stats.plan), stats.plan);
+  test.ok(stats.steps[2].visited < 10);
+  
+  test.strictEqual(doc.search('item[id="i7-3"]').length, 1);
+  test.ok(/ via attributeSeek\(id=i7-3\)$/.test(doc.lastStats().plan));
+  $$.usePlanner(false);
+  
+  $$.collectStats(false);
+  
+  test.done();
+}
+
+/**
+ * Test that asynchronous searches are planned too
+ */
+module.exports.testSearchAsyncWithPlanner = function(test) {
+  var doc = $$(buildDoc(10, 10));
+  
+  $$.usePlanner(true);
+  doc.searchAsync('section rare', function(err, result) {
+    test.ifError(err);
+    test.strictEqual(result.text(), 'found');
+    test.done();
+  });
+  $$.usePlanner(false);
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Unit tests for searching with subtree signatures
+ */
+
+var $$ = require('../index');
+
+function buildDoc(sections, items) {
+  var xml = ['<doc>'];
+  for (var i = 0; i < sections; ++i) {
+    xml.push('<section>');
+    for (var j = 0; j < items; ++j) {
+      xml.push('<item><name>', i, '.', j, '</name>');
+      if (i === sections - 1 && j === 0)
+        xml.push('<rare>found</rare>');
+      xml.push('</item>');
+    }
+    xml.push('</section>');
+  }
+  xml.push('</doc>');
+  return xml.join('');
+}
+
+/**
+ * Test turning signatures on and off
+ */
+module.exports.testUseSignatures = function(test) {
+  test.strictEqual($$.useSignatures(), false);
+  test.strictEqual($$.useSignatures(true), false);
+  test.strictEqual($$.useSignatures(), true);
+  test.strictEqual($$.useSignatures(false), true);
+  test.strictEqual($$.useSignatures(), false);
+  
+  test.done();
+}
+
+/**
+ * Test that searches with signatures find the same nodes while visiting
+ * fewer of them
+ */
+module.exports.testSearchWithSignatures = function(test) {
+  var doc = $$(buildDoc(50, 20));
+  var selectors = ['rare', 'section rare', '* > rare', 'item name', 'missing', 'rare, name'];
+  var plain, pruned, plainStats;
+  
+  $$.collectStats(true);
+  
+  for (var i = 0; i < selectors.length; ++i) {
+    plain = doc.search(selectors[i]);
+    plainStats = doc.lastStats();
+    
+    $$.useSignatures(true);
+    pruned = doc.search(selectors[i]);
+    $$.useSignatures(false);
+    
+    test.strictEqual(pruned.length, plain.length, selectors[i]);
+    for (var j = 0; j < plain.length; ++j)
+      test.strictEqual(pruned[j], plain[j], selectors[i]);
+    
+    test.strictEqual(plainStats.signatureBytes, 0);
+    test.ok(doc.lastStats().signatureBytes > 0);
+    test.ok(doc.lastStats().steps[0].visited <= plainStats.steps[0].visited);
+  }
+  
+  $$.useSignatures(true);
+  test.strictEqual(doc.search('rare').text(), 'found');
+  test.ok(doc.lastStats().steps[0].visited < 200);
+  test.strictEqual(doc.count('section rare'), 1);
+  test.strictEqual(doc.exists('section missing'), false);
+  $$.useSignatures(false);
+  
+  $$.collectStats(false);
+  
+  test.done();
+}
+
+/**
+ * Test that asynchronous searches use signatures built for the document
+ */
+module.exports.testSearchAsyncWithSignatures = function(test) {
+  var doc = $$(buildDoc(10, 10));
+  
+  $$.useSignatures(true);
+  doc.searchAsync('section rare', function(err, result) {
+    test.ifError(err);
+    test.strictEqual(result.text(), 'found');
+    test.done();
+  });
+  $$.useSignatures(false);
+}
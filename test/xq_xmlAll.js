@@ -0,0 +1,71 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test xmlAll function
+ */
+
+var xQ = require('../index');
+var $$ = xQ;
+
+/**
+ * Test empty set
+ */
+module.exports.testEmpty = function(test) {
+  var empty = new xQ();
+  
+  test.strictEqual(empty.xmlAll(), "");
+  test.strictEqual(empty.xmlAll({buffer: true}).length, 0);
+  
+  test.done();
+}
+
+/**
+ * Test every node is serialized as xml() would serialize it
+ */
+module.exports.testMatchesXml = function(test) {
+  var q = new xQ("<doc><a>1</a><b/><c x=\"y\">3</c></doc>").search('doc').children();
+  var each = q.map(function(n) { return $$(n).xml(); });
+  
+  test.strictEqual(q.xmlAll(), each.join(''));
+  test.strictEqual(q.xmlAll({separator: '\n'}), each.join('\n'));
+  
+  test.done();
+}
+
+/**
+ * Test returning a Buffer
+ */
+module.exports.testBuffer = function(test) {
+  var q = new xQ("<doc><a>café</a><a>☃</a></doc>").search('a');
+  var result = q.xmlAll({separator: ',', buffer: true});
+  
+  test.ok(Buffer.isBuffer(result));
+  test.strictEqual(result.toString('utf8'), "<a>café</a>,<a>☃</a>");
+  
+  test.done();
+}
+
+/**
+ * Test documents include their declarations
+ */
+module.exports.testDocuments = function(test) {
+  var q = new xQ("<one/>", "<two/>");
+  
+  test.strictEqual(q.xmlAll({separator: '|'}), q.first().xml() + '|' + q.last().xml());
+  
+  test.done();
+}
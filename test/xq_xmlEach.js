@@ -0,0 +1,84 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test xmlEach function
+ */
+
+var xQ = require('../index')
+  , $$ = xQ
+  , stream = require('stream')
+;
+
+/**
+ * Test the callback receives each node's xml in order
+ */
+module.exports.testCallback = function(test) {
+  var q = new xQ("<doc><a>1</a><b/><c x=\"y\">3</c></doc>").search('doc').children();
+  var results = [];
+  
+  test.strictEqual(q.xmlEach(function(xml, index, self) {
+    test.strictEqual(self, q);
+    results[index] = xml;
+  }), q);
+  
+  test.deepEqual(results, q.map(function(n) { return $$(n).xml(); }));
+  
+  test.done();
+}
+
+/**
+ * Test exceptions thrown by the callback are passed on
+ */
+module.exports.testThrows = function(test) {
+  var q = new xQ("<doc><a/><a/></doc>").search('a');
+  var calls = 0;
+  
+  test.throws(function() {
+    q.xmlEach(function() {
+      ++calls;
+      throw new Error("stop");
+    });
+  });
+  test.strictEqual(calls, 1);
+  
+  test.done();
+}
+
+/**
+ * Test writing every node to a stream
+ */
+module.exports.testStream = function(test) {
+  var items = [];
+  for (var i = 0; i < 5000; i++)
+    items.push("<item id=\"" + i + "\">Item number " + i + "</item>");
+  
+  var q = new xQ("<doc>" + items.join("") + "</doc>").search('item');
+  var out = new stream.Writable({highWaterMark: 1024});
+  var chunks = [];
+  
+  out._write = function(chunk, encoding, callback) {
+    chunks.push(chunk);
+    setImmediate(callback);
+  };
+  
+  out.on('finish', function() {
+    test.strictEqual(Buffer.concat(chunks).toString(), items.join("\n"));
+    test.done();
+  });
+  
+  test.strictEqual(q.xmlEach(out, {separator: "\n"}), out);
+}
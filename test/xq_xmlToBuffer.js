@@ -0,0 +1,56 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test xmlToBuffer function
+ */
+
+var xQ = require('../index')
+
+/**
+ * Test empty set
+ */
+module.exports.testEmpty = function(test) {
+  var empty = new xQ();
+  
+  test.ok(Buffer.isBuffer(empty.xmlToBuffer()));
+  test.strictEqual(empty.xmlToBuffer().length, 0);
+  
+  test.done();
+}
+
+/**
+ * Test the buffer holds the same XML as xml()
+ */
+module.exports.testMatchesXml = function(test) {
+  var q = new xQ("<p>The <i>quick</i> <b>brown <i>fox</i></b> jumps...</p>");
+  
+  test.strictEqual(q.xmlToBuffer().toString(), q.xml());
+  test.strictEqual(q.search('b').xmlToBuffer().toString(), "<b>brown <i>fox</i></b>");
+  
+  test.done();
+}
+
+/**
+ * Test non-ASCII content
+ */
+module.exports.testUtf8 = function(test) {
+  var q = new xQ("<doc>café ☃</doc>");
+  
+  test.strictEqual(q.search('doc').xmlToBuffer().toString('utf8'), "<doc>café ☃</doc>");
+  
+  test.done();
+}
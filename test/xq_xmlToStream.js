@@ -0,0 +1,155 @@
+/**
+ * Copyright 2013-2015 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Test xmlToStream function
+ */
+
+var xQ = require('../index')
+  , stream = require('stream')
+;
+
+/**
+ * Create a writable stream with a small buffer that collects what's
+ * written to it slowly, to exercise backpressure
+ */
+function collector() {
+  var out = new stream.Writable({highWaterMark: 1024});
+  
+  out.chunks = [];
+  out._write = function(chunk, encoding, callback) {
+    out.chunks.push(chunk);
+    setImmediate(callback);
+  };
+  
+  return out;
+}
+
+/**
+ * Build a large document
+ */
+function bigDoc() {
+  var items = [];
+  for (var i = 0; i < 20000; i++)
+    items.push("<item id=\"" + i + "\">Item number " + i + "</item>");
+  return "<doc>" + items.join("") + "</doc>";
+}
+
+/**
+ * Test the stream receives the same XML as xml()
+ */
+module.exports.testMatchesXml = function(test) {
+  var q = new xQ("<p>The <i>quick</i> <b>brown <i>fox</i></b> jumps...</p>");
+  var out = collector();
+  
+  out.on('finish', function() {
+    test.strictEqual(Buffer.concat(out.chunks).toString(), q.xml());
+    test.done();
+  });
+  
+  test.strictEqual(q.xmlToStream(out), out);
+}
+
+/**
+ * Test a large document is written in chunks with backpressure
+ */
+module.exports.testLarge = function(test) {
+  var q = new xQ(bigDoc());
+  var out = collector();
+  
+  q.xmlToStream(out, function(err) {
+    test.ifError(err);
+    
+    out.on('finish', function() {
+      test.ok(out.chunks.length > 1);
+      test.strictEqual(Buffer.concat(out.chunks).toString(), q.xml());
+      test.done();
+    });
+  });
+}
+
+/**
+ * Test an empty set ends the stream without writing
+ */
+module.exports.testEmpty = function(test) {
+  var out = collector();
+  
+  out.on('finish', function() {
+    test.strictEqual(out.chunks.length, 0);
+    test.done();
+  });
+  
+  new xQ().xmlToStream(out);
+}
+
+/**
+ * Test a failing stream stops serialization
+ */
+module.exports.testStreamError = function(test) {
+  var q = new xQ(bigDoc());
+  var out = new stream.Writable({highWaterMark: 1024});
+  
+  out._write = function(chunk, encoding, callback) {
+    callback(new Error("write failed"));
+  };
+  out.on('error', function() {});
+  
+  q.xmlToStream(out, function(err) {
+    test.ok(err instanceof Error);
+    test.strictEqual(err.message, 'Operation cancelled');
+    test.done();
+  });
+}
+
+/**
+ * Test streams stalled on backpressure don't hold up the thread pool
+ */
+module.exports.testStalledStreams = function(test) {
+  var q = new xQ(bigDoc());
+  var stalled = (+process.env.UV_THREADPOOL_SIZE || 4) + 2;
+  var pending = [];
+  var searched = false;
+  var ended = 0;
+  
+  for (var i = 0; i < stalled; i++) {
+    var out = new stream.Writable({highWaterMark: 1024});
+    
+    // writes fail once the search is done, and stall until then
+    out._write = function(chunk, encoding, callback) {
+      if (searched)
+        callback(new Error("write failed"));
+      else
+        pending.push(callback);
+    };
+    out.on('error', function() {});
+    
+    q.xmlToStream(out, function(err) {
+      test.ok(err instanceof Error);
+      if (++ended === stalled)
+        test.done();
+    });
+  }
+  
+  q.searchAsync('item', function(err, result) {
+    test.ifError(err);
+    test.strictEqual(result.length, 20000);
+    
+    searched = true;
+    pending.forEach(function(callback) {
+      callback(new Error("write failed"));
+    });
+  });
+}